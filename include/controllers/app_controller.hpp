@@ -20,6 +20,7 @@
  *   - BOOK:   Book content viewer
  *   - OPTION: Application options viewer and edition
  *   - TOC:    Currsent book Table of Content
+ *   - SEARCH: Pages of the current book found by a search
  * 
  * Each Controller must implements the following methods (No use of abstract class):
  * 
@@ -43,7 +44,7 @@ class AppController
      * LAST allows for the
      * selection of the last controller in charge before the current one.
      */
-    enum class Ctrl { NONE, DIR, PARAM, BOOK, OPTION, TOC, LAST };
+    enum class Ctrl { NONE, DIR, PARAM, BOOK, OPTION, TOC, SEARCH, LAST };
     
     AppController();
 
@@ -51,8 +52,12 @@ class AppController
      * @brief Start the application
      * 
      * Start the application, giving control to the DIR controller. 
+     * When resuming from deep sleep, the BOOK controller is started
+     * directly, the DIR controller being considered as the previous one.
+     * 
+     * @param first_ctrl The first controller to take control
      */
-    void start();
+    void start(Ctrl first_ctrl = Ctrl::DIR);
 
     /**
      * @brief Set the controller object
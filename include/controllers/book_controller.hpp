@@ -21,7 +21,8 @@ class BookController
     void leave(bool going_to_deep_sleep = false);
     bool open_book_file(const std::string & book_title, 
                         const std::string & book_filename, 
-                        const PageLocs::PageId & page_id);
+                        const PageLocs::PageId & page_id,
+                        bool show_loading_msg = true);
     void put_str(const char * str, int xpos, int ypos);
 
     inline const PageLocs::PageId & get_current_page_id() { return current_page_id; }
@@ -15,12 +15,18 @@ class BookParamController
     bool book_params_form_is_shown;
     bool wait_for_key_after_wifi;
     bool delete_current_book;
+    bool searching;                  ///< The keyboard screen is shown
+
+    #if INKPLATE_6PLUS || TOUCH_TRIAL
+      void search_input_event(const EventMgr::Event & event);
+    #endif
 
   public:
     BookParamController() : 
       book_params_form_is_shown(false), 
         wait_for_key_after_wifi(false),
-            delete_current_book(false) { };
+            delete_current_book(false),
+                      searching(false) { };
 
     void    input_event(const EventMgr::Event & event);
     void          enter();
@@ -30,6 +36,7 @@ class BookParamController
     inline void set_book_params_form_is_shown() { book_params_form_is_shown = true; }
     inline void   set_wait_for_key_after_wifi() { wait_for_key_after_wifi   = true; }
     inline void       set_delete_current_book() { delete_current_book       = true; }
+    inline void                 set_searching() { searching                 = true; }
 };
 
 #if __BOOK_PARAM_CONTROLLER__
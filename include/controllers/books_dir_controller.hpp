@@ -8,6 +8,8 @@
 #include "controllers/event_mgr.hpp"
 #include "models/epub.hpp"
 #include "models/page_locs.hpp"
+#include "models/resume_state.hpp"
+#include "models/books_dir.hpp"
 #include "viewers/books_dir_viewer.hpp"
 
 class BooksDirController
@@ -23,19 +25,60 @@ class BooksDirController
     int16_t     last_read_book_index;
     std::string book_filename;
     bool        book_was_shown;
+    bool        library_loaded;    ///< false after a resume, until the books directory is needed
+    uint32_t    resumed_book_id;
 
     PageLocs::PageId book_page_id;
     BooksDirViewer * books_dir_viewer;
     int8_t viewer_id;
 
+    void      load_library();
+    void save_resume_state(uint32_t book_id, const PageLocs::PageId & page_id);
+
+    #if INKPLATE_6PLUS || TOUCH_TRIAL
+      bool searching;                  ///< The keyboard screen is shown
+
+      void           open_book(int16_t idx);
+      void         change_view(BooksDir::Order order, const std::string & query);
+      void         show_search();
+      void  search_input_event(const EventMgr::Event & event);
+    #endif
+
   public:
-    BooksDirController() {};
+    #if INKPLATE_6PLUS || TOUCH_TRIAL
+      BooksDirController() : library_loaded(false), searching(false) {};
+    #else
+      BooksDirController() : library_loaded(false) {};
+    #endif
     void setup();
+
+    /**
+     * @brief Reopen the book shown before deep sleep
+     *
+     * The books directory is not read: this is done the first time
+     * the user leaves the book.
+     *
+     * @param snapshot The reading state retrieved from deep sleep
+     * @return true The book is open and ready to be shown
+     */
+    bool resume(const ResumeState::Snapshot & snapshot);
+
     void input_event(const EventMgr::Event & event);
     void enter();
     void leave(bool going_to_deep_sleep = false);
     void save_last_book(const PageLocs::PageId & page_id, bool going_to_deep_sleep);
     void show_last_book();
+
+    #if INKPLATE_6PLUS || TOUCH_TRIAL
+      /**
+       * @brief Show the keyboard to filter the books list
+       *
+       * The books matching the query are listed at each keystroke. The
+       * order of the list is changed by tapping the title.
+       */
+      void start_search();
+    #endif
+
     void new_orientation() { if (books_dir_viewer != nullptr) books_dir_viewer->setup(); }
 
     inline int16_t get_current_book_index() { return current_book_index; }
@@ -0,0 +1,114 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#if INKPLATE_6PLUS || TOUCH_TRIAL
+
+#include "controllers/event_mgr.hpp"
+
+/**
+ * class GestureClassifier - Touch gestures recognition
+ *
+ * Classifies the stream of touch samples received from a touch controller
+ * into TAP, HOLD / RELEASE, SWIPE_LEFT / SWIPE_RIGHT and PINCH_ENLARGE /
+ * PINCH_REDUCE events. Every sample carries its timestamp: holds are
+ * detected from the press duration and swipes from the move distance and
+ * the finger velocity at release, not from the rate at which the samples
+ * are received.
+ *
+ * The classifier doesn't know about the controller transport: it can be
+ * fed from the I2C reads of a device or from recorded traces.
+ */
+
+class GestureClassifier
+{
+  public:
+    static constexpr uint8_t  MAX_POINTS      =    5;
+    static constexpr uint16_t SWIPE_DISTANCE  =  100;  ///< Minimum horizontal move of a slow swipe (pixels)
+    static constexpr uint16_t FLICK_DISTANCE  =   40;  ///< Minimum horizontal move of a quick swipe (pixels)
+    static constexpr uint16_t FLICK_VELOCITY  =  500;  ///< Minimum release velocity of a quick swipe (pixels/s)
+    static constexpr uint16_t HOLD_MOVE       =   30;  ///< Maximum move during a hold (pixels)
+    static constexpr uint32_t HOLD_TIME       =  600;  ///< Press duration of a hold (ms)
+    static constexpr uint16_t PINCH_STEP      =   10;  ///< Fingers distance change reported by a pinch event (pixels)
+    static constexpr uint32_t RELEASE_TIMEOUT = 4000;  ///< A gesture without samples for that long is ended (ms)
+    static constexpr uint32_t VELOCITY_WINDOW =  100;  ///< Period over which the release velocity is measured (ms)
+
+    struct Point {
+      uint8_t  id;
+      uint16_t x, y;
+    };
+
+    struct Sample {
+      uint32_t time_ms;
+      uint8_t  count;                ///< Number of fingers on the screen
+      Point    points[MAX_POINTS];
+    };
+
+  private:
+    static constexpr char const * TAG = "GestureClassifier";
+
+    static constexpr uint8_t HISTORY_SIZE = 8;
+
+    enum class State : uint8_t { IDLE, TOUCHING, HOLDING, PINCHING };
+
+    struct Track {
+      uint32_t time_ms;
+      uint16_t x, y;
+    };
+
+    State    state;
+    Track    start;
+    Track    history[HISTORY_SIZE]; ///< Most recent positions, a ring
+    uint8_t  history_count;
+    uint8_t  history_next;
+    uint16_t max_move;              ///< Largest distance from the start position
+    uint16_t pinch_dist;
+    uint32_t last_time_ms;
+    int32_t  velocity;              ///< Horizontal velocity at release (pixels/s)
+
+    void          track(const Sample & sample);
+    void compute_velocity();
+    bool          release(uint32_t time_ms, EventMgr::Event & event);
+    bool            pinch(const Sample & sample, EventMgr::Event & event);
+
+  public:
+    GestureClassifier() { reset(); }
+
+    void reset();
+
+    /**
+     * @brief Add a touch sample
+     *
+     * @param sample The sample, a count of 0 meaning all fingers released
+     * @param event The recognized event, if any
+     * @return true An event has been recognized
+     */
+    bool add_sample(const Sample & sample, EventMgr::Event & event);
+
+    /**
+     * @brief Check time based events when no sample has been received
+     *
+     * A finger kept still may not generate samples: the hold is then
+     * detected here. A gesture without samples for RELEASE_TIMEOUT is ended.
+     *
+     * @param time_ms Current time
+     * @param event The recognized event, if any
+     * @return true An event has been recognized
+     */
+    bool check_timeouts(uint32_t time_ms, EventMgr::Event & event);
+
+    /**
+     * @brief Time at which check_timeouts() must be called
+     *
+     * @return uint32_t The deadline. Only meaningful when is_active() is true.
+     */
+    uint32_t get_deadline() const;
+
+    inline bool    is_active()    const { return state != State::IDLE; }
+    inline int32_t get_velocity() const { return velocity; }
+};
+
+#endif
@@ -0,0 +1,60 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#if INKPLATE_6PLUS || TOUCH_TRIAL
+
+#include "controllers/gesture_classifier.hpp"
+
+/**
+ * class GT911 - Goodix GT911 touch controller data format
+ *
+ * The touch buffer is read in one burst starting at the status register:
+ * the status byte (bit 7: buffer ready, bits 0-3: number of points) is
+ * followed by up to five 8 bytes point entries (track id, x, y and size,
+ * little endian). The status register must be cleared once the buffer
+ * has been read.
+ *
+ * The I2C transport is left to the caller.
+ */
+
+class GT911
+{
+  public:
+    static constexpr uint16_t PRODUCT_ID_REG = 0x8140;
+    static constexpr uint16_t STATUS_REG     = 0x814E;
+    static constexpr uint8_t  POINT_SIZE     = 8;
+    static constexpr uint8_t  BUFFER_SIZE    = 1 + POINT_SIZE * GestureClassifier::MAX_POINTS;
+
+    static constexpr uint8_t  BUFFER_READY   = 0x80;
+
+    /**
+     * @brief Decode a touch buffer
+     *
+     * @param buffer BUFFER_SIZE bytes read from STATUS_REG
+     * @param time_ms Time at which the controller signaled the buffer
+     * @param sample The decoded sample
+     * @return true The buffer was ready and the sample is valid
+     */
+    static bool decode(const uint8_t * buffer, uint32_t time_ms, GestureClassifier::Sample & sample) {
+      if ((buffer[0] & BUFFER_READY) == 0) return false;
+
+      sample.time_ms = time_ms;
+      sample.count   = buffer[0] & 0x0F;
+      if (sample.count > GestureClassifier::MAX_POINTS) sample.count = GestureClassifier::MAX_POINTS;
+
+      const uint8_t * p = &buffer[1];
+      for (uint8_t i = 0; i < sample.count; i++, p += POINT_SIZE) {
+        sample.points[i].id = p[0];
+        sample.points[i].x  = p[1] | (p[2] << 8);
+        sample.points[i].y  = p[3] | (p[4] << 8);
+      }
+
+      return true;
+    }
+};
+
+#endif
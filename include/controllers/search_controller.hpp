@@ -0,0 +1,53 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include "controllers/event_mgr.hpp"
+#include "viewers/search_viewer.hpp"
+
+#include <string>
+#include <vector>
+
+/**
+ * class SearchController - Full-text search within the current book
+ *
+ * The pages found are presented by the SearchViewer. Selecting one of
+ * them shows it in the book viewer.
+ */
+
+class SearchController
+{
+  private:
+    static constexpr char const * TAG = "SearchController";
+
+    std::string          query;
+    std::vector<int16_t> page_nbrs;
+    int16_t              current_entry_index;
+
+  public:
+    SearchController() : current_entry_index(-1) {}
+
+    /**
+     * @brief Search the current book and show the pages found
+     *
+     * The pages locations of the book must be completed.
+     *
+     * @param the_query Words, separated with spaces. A word ending with '*'
+     *                  matches all the words beginning with it.
+     * @return false The book search index is not available
+     */
+    bool search(const std::string & the_query);
+
+    void input_event(const EventMgr::Event & event);
+    void enter();
+    void leave(bool going_to_deep_sleep = false) {}
+};
+
+#if __SEARCH_CONTROLLER__
+  SearchController search_controller;
+#else
+  extern SearchController search_controller;
+#endif
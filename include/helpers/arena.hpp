@@ -0,0 +1,209 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+
+/**
+ * class Arena - Scoped memory allocation
+ *
+ * Memory is taken from fixed size chunks, bumping a pointer. It is never
+ * released piece by piece: all the chunks of an arena are released at once
+ * when the arena is reset or destroyed, without calling any destructor. The
+ * structures built in an arena must then only use memory from the same arena
+ * (see ArenaAllocator and ArenaString below).
+ *
+ * Arenas are organized by scope. The book arena lives as long as the
+ * application. Each item (the current one and the one being paginated) has
+ * its arena, child of the book arena, and each page render has its arena,
+ * child of the item arena. A child arena gets its chunks from its parent and
+ * gives them back in one operation: the chunks freed by a scope are reused
+ * by the following one, instead of being returned to the heap. The book
+ * arena returns its chunks to the heap when the book is closed.
+ *
+ * An allocation larger than a chunk gets its own chunk, taken from the heap
+ * and returned to it when the arena is reset.
+ *
+ * An arena is used by one thread at a time. Its children can be used by
+ * other threads.
+ */
+
+class Arena
+{
+  public:
+    static constexpr uint32_t CHUNK_SIZE = 4096;
+
+    struct Stats {
+      uint32_t chunks;      ///< Chunks in use by the arena
+      uint32_t large;       ///< Chunks in use by the arena for large allocations
+      uint32_t spare;       ///< Chunks released by the children, kept for reuse
+      uint32_t lent;        ///< Chunks held by the children arenas
+      uint32_t high_water;  ///< Maximum chunks held by the arena and its children
+      uint32_t bytes;       ///< Bytes allocated since the last reset
+      uint32_t from_heap;   ///< Chunks taken from the heap
+      uint32_t resets;
+    };
+
+  private:
+    static constexpr char const * TAG = "Arena";
+
+    struct Chunk {
+      Chunk *  next;
+      uint32_t size;
+    };
+
+    struct ChunkList {
+      Chunk *  first = nullptr;
+      Chunk *  last  = nullptr;
+      uint32_t count = 0;
+
+      void clear() { first = last = nullptr; count = 0; }
+      void push(Chunk * chunk) {
+        chunk->next = first;
+        if (first == nullptr) last = chunk;
+        first = chunk;
+        count++;
+      }
+      Chunk * pop() {
+        Chunk * chunk = first;
+        if ((first = chunk->next) == nullptr) last = nullptr;
+        count--;
+        return chunk;
+      }
+      void splice(ChunkList & list) {
+        if (list.first == nullptr) return;
+        list.last->next = first;
+        if (first == nullptr) last = list.last;
+        first  = list.first;
+        count += list.count;
+        list.clear();
+      }
+    };
+
+    const char * name;
+    Arena *      parent;
+    std::mutex   mutex;         ///< The children take and give back chunks from their own thread
+
+    ChunkList    chunks;        ///< The first one is the current chunk
+    ChunkList    large_chunks;
+    ChunkList    spare_chunks;
+    char *       current;       ///< Free space in the current chunk
+    char *       end;
+    uint32_t     bytes;
+    uint32_t     lent, high_water, from_heap, resets;
+
+    static Chunk *  heap_chunk(uint32_t size);
+    static void    free_chunks(ChunkList & list);
+
+    inline void update_high_water() {
+      uint32_t held = chunks.count + large_chunks.count + spare_chunks.count + lent;
+      if (held > high_water) high_water = held;
+    }
+
+    Chunk *  get_chunk();
+    Chunk * lend_chunk();
+    void     take_back(ChunkList & list);
+
+  public:
+    /**
+     * @brief Construct a new Arena
+     *
+     * Nothing is allocated before the first allocate() call. The constructor
+     * being constexpr, a static arena is built before, and destroyed after,
+     * the globals using it.
+     *
+     * @param arena_name Reported name, for debugging
+     * @param parent_arena The arena the chunks are taken from. nullptr: the heap.
+     */
+    constexpr Arena(const char * arena_name, Arena * parent_arena = nullptr) :
+      name(arena_name), parent(parent_arena),
+      current(nullptr), end(nullptr), bytes(0),
+      lent(0), high_water(0), from_heap(0), resets(0) { }
+   ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena & operator=(const Arena &) = delete;
+
+    /**
+     * @brief Allocate memory in the arena
+     *
+     * @param size The number of bytes
+     * @param align The required alignment, a power of 2
+     * @return void * The memory, nullptr if none available
+     */
+    void * allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+    /**
+     * @brief Construct an object in the arena
+     *
+     * Its destructor will never be called.
+     */
+    template <class T, class... Args> T * make(Args &&... args) {
+      void * ptr = allocate(sizeof(T), alignof(T));
+      return (ptr == nullptr) ? nullptr : new (ptr) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Release all the memory of the arena
+     *
+     * Everything allocated in the arena becomes invalid. The chunks in use
+     * and the spare ones are returned to the parent arena, or to the heap.
+     * The children arenas keep their chunks.
+     */
+    void reset();
+
+    /**
+     * @brief Get the arena statistics
+     *
+     * The bytes count is only exact when called from the arena thread.
+     */
+    Stats get_stats();
+    inline const char * get_name() const { return name; }
+
+    /**
+     * @brief MemoryPool block allocator
+     *
+     * A pool built with it, with an arena as context, gets its blocks from
+     * that arena.
+     */
+    static void * pool_block(void * arena, size_t size) { return ((Arena *) arena)->allocate(size); }
+};
+
+/**
+ * @brief STL allocator taking its memory from an arena
+ *
+ * The memory is only released with the arena: a container using it can be
+ * abandoned with the arena, without being destroyed.
+ */
+
+template <class T>
+class ArenaAllocator
+{
+  private:
+    Arena * arena;
+
+    template <class U> friend class ArenaAllocator;
+
+  public:
+    typedef T value_type;
+
+    ArenaAllocator(Arena & the_arena) noexcept : arena(&the_arena) {}
+    template <class U> ArenaAllocator(const ArenaAllocator<U> & other) noexcept : arena(other.arena) {}
+
+    inline T * allocate(size_t n) { return (T *) arena->allocate(n * sizeof(T), alignof(T)); }
+    inline void deallocate(T * p, size_t n) noexcept { }
+
+    inline Arena & get_arena() const { return *arena; }
+
+    template <class U> bool operator==(const ArenaAllocator<U> & other) const { return arena == other.arena; }
+    template <class U> bool operator!=(const ArenaAllocator<U> & other) const { return arena != other.arena; }
+};
+
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
@@ -0,0 +1,85 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#if EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "models/bfnt.hpp"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * class FontCompiler - TrueType/OpenType fonts precompiled for a device
+ *
+ * Command line tool available with the headless Linux build. The glyphs
+ * of the fonts are rasterized with FreeType for a screen resolution and a
+ * list of font sizes, and written beside each font in the BFNT format. The
+ * device then uses them instead of rasterizing the glyphs itself (see the
+ * FontFactory class). All characters of a font are compiled, with the
+ * kerning pairs of its kern table.
+ *
+ * Without font files, all TrueType/OpenType fonts of the fonts_list.xml
+ * file of the SD card image (MAIN_FOLDER) are compiled.
+ *
+ * The sizes are by default the font sizes offered to the user for the books.
+ * The other sizes (headings, sizes set by the books stylesheets, application
+ * forms) are rasterized on the device from the font itself.
+ *
+ * Usage: epub-inkplate -b [-r <resolution>] [-s <size>[,<size>...]] [-o <folder>]
+ *                         [<font file>...]
+ *
+ * The resolution is in pixels per inch: 212 for the Paper S3 and the
+ * Inkplate 6PLUS, 166 for the Inkplate 6, 150 for the Inkplate 10. The
+ * default is the one of the Linux build screen. The compiled fonts are
+ * written in the folder of their font unless -o is used.
+ */
+
+class FontCompiler
+{
+  private:
+    static constexpr char const * TAG = "FontCompiler";
+
+    FT_Library           library;
+    uint16_t             resolution;
+    std::vector<int16_t> sizes;
+    std::string          folder;
+
+    static void add_fonts(std::vector<std::string> & fonts);
+    static void encode(const FT_Bitmap & bitmap, std::vector<uint8_t> & out);
+
+  public:
+    FontCompiler() : library(nullptr), resolution(0) {}
+
+    /**
+     * @brief Compile a font
+     *
+     * @param font_filename The TrueType/OpenType font.
+     * @param bfnt_filename The resulting BFNT font.
+     * @return true The font was compiled.
+     */
+    bool compile(const std::string & font_filename, const std::string & bfnt_filename);
+
+    /**
+     * @brief Run the tool
+     *
+     * The fonts and screen must have been setup. argv[1] is the -b option.
+     *
+     * @return int The process exit code
+     */
+    int run(int argc, char ** argv);
+};
+
+#if __FONT_COMPILER__
+  FontCompiler font_compiler;
+#else
+  extern FontCompiler font_compiler;
+#endif
+
+#endif
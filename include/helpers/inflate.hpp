@@ -0,0 +1,58 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+/**
+ * class Inflate - Whole buffer DEFLATE decoder
+ *
+ * Decompresses a raw DEFLATE stream (RFC 1951) held in memory into a buffer
+ * of the exact decompressed size, as found in the zip central directory.
+ * The output being the whole entry, matches are copied from it directly:
+ * there is no sliding window to maintain. The decoder follows the design of
+ * libdeflate:
+ *
+ * - The input is read 56 bits at a time, with a single unaligned load,
+ *   enough for a complete length and distance pair.
+ * - Huffman codes are decoded with tables indexed by the next input bits,
+ *   with sub-tables for the longest codes. A length or distance code and
+ *   its extra bits are consumed at once. For large outputs, a literal/length
+ *   table entry holds two literals when both codes fit in the table index.
+ * - Matches are copied 8 bytes at a time.
+ *
+ * The tables (about 12KB) are allocated for each call, not on the stack.
+ *
+ * The CRC-32 of the data is computed 8 bytes at a time (slicing-by-8), with
+ * tables built at compile time. It gives the same values as mz_crc32().
+ */
+
+class Inflate
+{
+  private:
+    static constexpr char const * TAG = "Inflate";
+
+  public:
+    /**
+     * @brief Decompress a raw DEFLATE stream
+     *
+     * @param in The compressed data
+     * @param in_size The compressed data size
+     * @param out The output buffer
+     * @param out_size The exact decompressed size
+     * @return true The stream was complete and decompressed to exactly out_size bytes
+     * @return false Corrupted or truncated stream, wrong size or no memory for the tables
+     */
+    static bool decompress(const uint8_t * in, uint32_t in_size, uint8_t * out, uint32_t out_size);
+
+    /**
+     * @brief Update a CRC-32
+     *
+     * @param crc The CRC of the preceding data, 0 to start
+     * @param data The data
+     * @param size The data size
+     * @return uint32_t The CRC including the data
+     */
+    static uint32_t update_crc32(uint32_t crc, const uint8_t * data, size_t size);
+};
@@ -0,0 +1,191 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+
+/**
+ * class MemoryBudget - Accounting of the large memory consumers
+ *
+ * The glyphs bitmaps byte pools, the images bitmaps, the e-book items
+ * data, the table of content buffers and the arenas chunks are allocated
+ * through this class.
+ * The memory used by each one of them is accounted for, with its
+ * high-water mark and an optional budget.
+ *
+ * The caches register a shrinker that releases their content. When an
+ * allocation would go over the total memory cap, or if it fails, the
+ * caches are shrunk in priority order (glyphs, images, items) and the
+ * allocation retried before returning nullptr to the caller. A consumer
+ * that goes over its own budget gets its cache shrunk.
+ *
+ * A cache cannot be released while some code keeps pointers into it (the
+ * glyphs of a page being laid out, the XML nodes of the item being shown).
+ * That code declares its use of the cache with an InUse instance. A shrink
+ * request made during that time is deferred up to the moment the last user
+ * leaves. The cache of the consumer being allocated for is never shrunk
+ * immediately, as its caller is in the middle of using it.
+ *
+ * There is no memory cap by default: on the devices, the shrinking happens
+ * when the PSRAM allocation fails. On the Linux build, a cap can be set to
+ * reproduce low memory conditions.
+ */
+
+class MemoryBudget
+{
+  public:
+    enum class Consumer : uint8_t { GLYPHS, IMAGES, ITEMS, TOC, ARENAS, OTHER, COUNT };
+
+    typedef std::function<void ()> Shrinker;
+
+    struct Usage {
+      uint32_t current;     ///< Bytes allocated
+      uint32_t high_water;  ///< Maximum bytes allocated at once
+      uint32_t budget;      ///< 0: No budget
+      uint32_t shrinks;     ///< Number of times the cache was shrunk
+      uint32_t failures;    ///< Allocations refused or failed
+    };
+
+  private:
+    static constexpr char const * TAG = "MemoryBudget";
+
+    #if EPUB_INKPLATE_BUILD
+      static constexpr uint32_t GLYPHS_BUDGET = 1024 * 1024;
+    #else
+      static constexpr uint32_t GLYPHS_BUDGET = 0;
+    #endif
+
+    std::mutex              mutex;
+    std::condition_variable released;   ///< Signaled at the end of a shrink
+
+    Usage    usages[(int) Consumer::COUNT];
+    Shrinker shrinkers[(int) Consumer::COUNT];
+    uint16_t users[(int) Consumer::COUNT];
+    bool     pending[(int) Consumer::COUNT];
+    bool     shrinking[(int) Consumer::COUNT];
+    uint32_t total, high_water, cap;
+
+    inline bool over_cap(uint32_t size) const { return (cap != 0) && ((total + size) > cap); }
+    inline bool over_budget(Consumer consumer, uint32_t size) const {
+      const Usage & usage = usages[(int) consumer];
+      return (usage.budget != 0) && ((usage.current + size) > usage.budget);
+    }
+
+    void       account(Consumer consumer, uint32_t size);
+    void     unaccount(Consumer consumer, uint32_t size);
+    uint32_t    shrink(Consumer consumer, Consumer caller);
+    uint32_t   relieve(uint32_t needed,   Consumer caller);
+
+  public:
+    MemoryBudget();
+
+    /**
+     * @brief Register the shrinkers of the application caches
+     */
+    void setup();
+
+    /**
+     * @brief Allocate memory for a consumer
+     *
+     * The caches are shrunk if required to stay within the memory cap or
+     * if the allocation fails.
+     *
+     * @param consumer The consumer of the memory
+     * @param size The number of bytes
+     * @return void * The memory or nullptr if not available
+     */
+    void * allocate(Consumer consumer, uint32_t size);
+
+    /**
+     * @brief Release memory obtained through allocate()
+     *
+     * @param consumer The consumer the memory was allocated for
+     * @param ptr The memory. Can be nullptr.
+     * @param size The size given to allocate()
+     */
+    void release(Consumer consumer, void * ptr, uint32_t size);
+
+    /**
+     * @brief Account for memory allocated by other means
+     */
+    void     add(Consumer consumer, uint32_t size);
+    void  remove(Consumer consumer, uint32_t size);
+
+    /**
+     * @brief Shrink the caches in priority order
+     *
+     * @param needed The number of bytes to be released
+     * @return uint32_t The number of bytes released immediately
+     */
+    inline uint32_t relieve(uint32_t needed) { return relieve(needed, Consumer::COUNT); }
+
+    /**
+     * @brief Declare the use of a consumer cache
+     *
+     * Waits for a shrink of the cache in progress. When the last user leaves,
+     * the shrink requests made in between are done.
+     */
+    void enter(Consumer consumer);
+    void leave(Consumer consumer);
+
+    class InUse
+    {
+      private:
+        Consumer consumer;
+      public:
+        InUse(Consumer c);
+       ~InUse();
+    };
+
+    inline void set_shrinker(Consumer consumer, Shrinker shrinker) {
+      std::scoped_lock guard(mutex);
+      shrinkers[(int) consumer] = shrinker;
+    }
+
+    inline void set_budget(Consumer consumer, uint32_t budget) {
+      std::scoped_lock guard(mutex);
+      usages[(int) consumer].budget = budget;
+    }
+
+    /**
+     * @brief Set the total memory cap
+     *
+     * @param bytes 0: No cap
+     */
+    inline void set_cap(uint32_t bytes) {
+      std::scoped_lock guard(mutex);
+      cap = bytes;
+    }
+
+    inline Usage get_usage(Consumer consumer) {
+      std::scoped_lock guard(mutex);
+      return usages[(int) consumer];
+    }
+
+    inline uint32_t get_total() {
+      std::scoped_lock guard(mutex);
+      return total;
+    }
+
+    static const char * get_consumer_name(Consumer consumer);
+
+    /**
+     * @brief Append the consumers usage table to a report
+     */
+    void get_report(std::string & out);
+};
+
+#if __MEMORY_BUDGET__
+  MemoryBudget memory_budget;
+#else
+  extern MemoryBudget memory_budget;
+#endif
+
+inline MemoryBudget::InUse::InUse(Consumer c) : consumer(c) { memory_budget.enter(consumer); }
+inline MemoryBudget::InUse::~InUse() { memory_budget.leave(consumer); }
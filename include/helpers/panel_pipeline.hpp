@@ -0,0 +1,97 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * class PanelPipeline - Asynchronous e-paper panel updates
+ *
+ * The screen is double-buffered: drawing is done in a back buffer while the
+ * panel is updated from a front buffer by a dedicated task. Before an update
+ * is submitted, the screen waits for the previous one to complete and copies
+ * the updated region from the back buffer to the front buffer. The layout of
+ * the next page can then proceed while the panel waveform is running.
+ *
+ * Every submitted update is identified by a fence. Callers wait on a fence
+ * only when they need the panel to show the update (before going to sleep,
+ * for instance).
+ *
+ * The pipeline doesn't know about the panel driver: the screen supplies the
+ * function executing an update. Until the pipeline is started, updates are
+ * executed synchronously.
+ */
+
+class PanelPipeline
+{
+  public:
+    typedef uint32_t Fence;
+
+    struct Request {
+      int8_t mode;    ///< Screen::UpdateMode value
+      Dim    dim;
+      Pos    pos;
+    };
+
+    typedef void (* Executor)(const Request & request);
+
+  private:
+    static constexpr char const * TAG = "PanelPipeline";
+
+    std::mutex              mutex;
+    std::condition_variable cond;
+    std::thread             thread;
+    Executor                executor;
+    Request                 request;
+    Fence                   submitted;  ///< Fence of the last submitted update
+    Fence                   completed;  ///< Fence of the last completed update
+    bool                    running;
+
+    void task();
+
+  public:
+    PanelPipeline() : executor(nullptr), submitted(0), completed(0), running(false) { }
+   ~PanelPipeline() { stop(); }
+
+    /**
+     * @brief Start the panel update task
+     *
+     * @param exec The function executing the panel updates
+     */
+    void start(Executor exec);
+
+    /**
+     * @brief Complete the pending update and stop the panel update task
+     */
+    void stop();
+
+    /**
+     * @brief Submit a panel update
+     *
+     * Waits for the previous update to complete. The region to update must
+     * be in the front buffer before calling this method.
+     *
+     * @param req The update to execute
+     * @return Fence The fence to wait on for the update to be completed
+     */
+    Fence submit(const Request & req);
+
+    /**
+     * @brief Wait for an update to be completed
+     */
+    void wait_for_fence(Fence fence);
+
+    /**
+     * @brief Check if an update has been completed
+     */
+    bool is_fence_reached(Fence fence);
+
+    Fence get_last_fence();
+
+    inline void wait_for_all() { wait_for_fence(get_last_fence()); }
+};
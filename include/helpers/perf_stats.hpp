@@ -0,0 +1,139 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include <atomic>
+#include <string>
+
+/**
+ * class PerfStats - Hot path instrumentation
+ *
+ * Accumulates the time spent in each stage of the e-book rendering
+ * pipeline, and some event counters. Timers are nested: when a stage is
+ * entered while another one is running on the same thread (a glyph being
+ * rasterized during the layout of a page), the enclosing stage is
+ * suspended. The sum of all stages is then the real time spent in the
+ * pipeline.
+ *
+ * Latencies (from a touch on the screen to the resulting input event
+ * being received by the application, for instance) are accumulated with
+ * their maximum.
+ *
+ * The words cache hits are reported with an estimate of the time they
+ * saved: the average time spent decoding and measuring a missed word.
+ *
+ * The report also shows the high-water marks of the memory pools.
+ *
+ * The timers and counters are only compiled in when PERF_STATS is set
+ * to 1. Otherwise, the PERF_SCOPE, PERF_COUNT and PERF_LATENCY macros 
+ * expand to nothing.
+ */
+
+class PerfStats
+{
+  public:
+    enum class Stage : uint8_t {
+      UNZIP, XML_PARSE, CSS, CSS_MATCH, LAYOUT, ADD_WORD, WORD_DECODE, GLYPH, BLIT, DRAW_GLYPH, SCREEN_UPDATE, PANEL_WAIT, COUNT
+    };
+    enum class Counter : uint8_t { 
+      GLYPH_CACHE_HIT, GLYPH_CACHE_MISS, WORD_CACHE_HIT, WORD_CACHE_MISS, PAGE_CACHE_HIT, PAGE_CACHE_MISS, 
+      TOUCH_INTERRUPT, TOUCH_READ, COUNT 
+    };
+    enum class Latency : uint8_t { INPUT_EVENT, COUNT };
+
+    class Scope
+    {
+      private:
+        Stage   stage;
+        Scope * parent;
+        int64_t start;
+
+      public:
+        Scope(Stage s);
+       ~Scope();
+
+        void suspend(int64_t now);
+        inline void resume(int64_t now) { start = now; }
+    };
+
+  private:
+    static constexpr char const * TAG = "PerfStats";
+
+    struct Accumulator {
+      std::atomic<uint64_t> micros;
+      std::atomic<uint32_t> count;
+    };
+
+    struct LatencyAccumulator {
+      std::atomic<uint64_t> micros;
+      std::atomic<uint32_t> count;
+      std::atomic<uint32_t> max;
+    };
+
+    Accumulator           accumulators[(int) Stage::COUNT];
+    std::atomic<uint32_t> counters[(int) Counter::COUNT];
+    LatencyAccumulator    latencies[(int) Latency::COUNT];
+
+    void add_pools_report(std::string & out);
+
+  public:
+    PerfStats() { reset(); }
+
+    static int64_t get_time_us();
+    static const char *   get_stage_name(Stage   stage  );
+    static const char * get_counter_name(Counter counter);
+    static const char * get_latency_name(Latency latency);
+
+    void reset();
+
+    /**
+     * @brief Format the current statistics
+     *
+     * @param out The text report is appended to this string
+     * @param wall_us If not 0, the elapsed time of the measured run. The
+     *                time not spent in any stage is then reported.
+     */
+    void get_report(std::string & out, int64_t wall_us = 0);
+
+    inline void add(Stage stage, int64_t micros) {
+      accumulators[(int) stage].micros += micros;
+    }
+    inline void count(Stage   stage  ) { accumulators[(int) stage].count++; }
+    inline void count(Counter counter) { counters[(int) counter]++;         }
+
+    inline void add(Latency latency, int64_t micros) {
+      LatencyAccumulator & acc = latencies[(int) latency];
+      acc.micros += micros;
+      acc.count++;
+      uint32_t max = acc.max;
+      while ((micros > max) && !acc.max.compare_exchange_weak(max, (uint32_t) micros)) { }
+    }
+
+    inline uint64_t get_micros(Stage   stage  ) const { return accumulators[(int) stage].micros; }
+    inline uint32_t  get_count(Stage   stage  ) const { return accumulators[(int) stage].count;  }
+    inline uint32_t  get_count(Counter counter) const { return counters[(int) counter];          }
+    inline uint64_t get_micros(Latency latency) const { return latencies[(int) latency].micros;  }
+    inline uint32_t  get_count(Latency latency) const { return latencies[(int) latency].count;   }
+    inline uint32_t    get_max(Latency latency) const { return latencies[(int) latency].max;     }
+};
+
+#if __PERF_STATS__
+  PerfStats perf_stats;
+#else
+  extern PerfStats perf_stats;
+#endif
+
+#if PERF_STATS
+  #define PERF_SCOPE_NAME2(line) perf_scope_##line
+  #define PERF_SCOPE_NAME(line)  PERF_SCOPE_NAME2(line)
+  #define PERF_SCOPE(stage)      PerfStats::Scope PERF_SCOPE_NAME(__LINE__)(PerfStats::Stage::stage)
+  #define PERF_COUNT(counter)    perf_stats.count(PerfStats::Counter::counter)
+  #define PERF_LATENCY(latency, micros) perf_stats.add(PerfStats::Latency::latency, micros)
+#else
+  #define PERF_SCOPE(stage)
+  #define PERF_COUNT(counter)
+  #define PERF_LATENCY(latency, micros)
+#endif
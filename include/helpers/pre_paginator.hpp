@@ -0,0 +1,100 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#if EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+/**
+ * class PrePaginator - Pages locations computed on a host for a device
+ *
+ * Command line tool available with the headless Linux build. The pages
+ * locations (.locs) and table of content (.toc) files of a library are
+ * computed for a device and written beside the books, to be copied with
+ * them on the device SD card. The layout sources are the ones of the
+ * device, its screen being emulated: identification, resolution and
+ * dimensions. The fonts and the configuration are the ones of the SD card
+ * image (MAIN_FOLDER), the formatting options being possibly overridden
+ * on the command line. The book parameters (.pars) beside a book are used
+ * as on the device. The package index (.pkg) and the parsed stylesheets
+ * (.cssb) are written as well when a book is opened: they don't depend on
+ * the device.
+ *
+ * The device loads these files as if it had computed them: the format
+ * parameters saved in them are its own. A book whose files are already
+ * loadable with the same format parameters is skipped, unless the -a
+ * option is used.
+ *
+ * With the -x option, the pages locations and search index of other font
+ * sizes, among the ones of the device options, are computed in the same
+ * pass (see PageLocs::Variant). The device changes to these font sizes
+ * without computing them. A book missing one of them is not skipped.
+ *
+ * The pages locations computation using global state, the books are
+ * processed in parallel by worker processes, one per book, up to the
+ * number of jobs requested (the number of processors by default).
+ *
+ * Usage: epub-inkplate -l [-d <device>] [-o <orientation>] [-s <font size>]
+ *                         [-f <font index>] [-x <size>[,<size>...]] [-j <jobs>] [-a]
+ *                         [<books folder | epub file>...]
+ *
+ * The devices are paper_s3 (the default), inkplate_6, inkplate_10 and
+ * inkplate_6plus. The orientation is 0 (left), 1 (right), 2 (bottom) or
+ * 3 (top). Without a books folder, the one of the SD card image is used.
+ */
+
+class PrePaginator
+{
+  private:
+    static constexpr char const * TAG = "PrePaginator";
+
+    struct Profile {
+      const char * name;
+      int8_t       ident;        ///< Screen::IDENT of the device
+      uint16_t     resolution;   ///< Pixels per inch
+      uint16_t     width;        ///< In the BOTTOM orientation
+      uint16_t     height;
+      bool         rotates;      ///< The dimensions follow the orientation
+    };
+
+    static const Profile PROFILES[];
+    static const uint8_t PROFILE_COUNT;
+
+    const Profile *          profile;
+    std::vector<std::string> options;  ///< Given to the workers
+    bool                     all;
+
+    static void add_books(const std::string & path, std::vector<std::string> & books);
+    static off_t  file_size(const std::string & filename);
+    static bool is_font_size(int8_t font_size);
+
+    bool   paginate(const std::string & filename);
+    int run_workers(const std::vector<std::string> & books, int jobs, const char * exe);
+
+  public:
+    PrePaginator() : profile(&PROFILES[0]), all(false) {}
+
+    /**
+     * @brief Run the tool
+     *
+     * The fonts, screen and page locations threads must have been setup.
+     * argv[1] is the -l option.
+     *
+     * @return int The process exit code
+     */
+    int run(int argc, char ** argv);
+};
+
+#if __PRE_PAGINATOR__
+  PrePaginator pre_paginator;
+#else
+  extern PrePaginator pre_paginator;
+#endif
+
+#endif
@@ -0,0 +1,51 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#if EPUB_INKPLATE_BUILD
+
+#include <esp_pthread.h>
+
+/**
+ * class PThreadConfig - Task configuration of the next std::thread
+ *
+ * The esp_pthread configuration applies to every std::thread later created
+ * by the calling task. It is set for the lifetime of this object and the
+ * configuration of the calling task is restored when it is destroyed, once
+ * the thread has been created:
+ *
+ *   PThreadConfig task_cfg("name", 6 * 1024, 5);
+ *   thread = std::thread(...);
+ */
+
+class PThreadConfig
+{
+  private:
+    esp_pthread_cfg_t previous;
+    bool              has_previous;
+
+  public:
+    PThreadConfig(const char * name, size_t stack_size, size_t prio) {
+      has_previous = esp_pthread_get_cfg(&previous) == ESP_OK;
+
+      esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+      cfg.thread_name = name;
+      cfg.stack_size  = stack_size;
+      cfg.prio        = prio;
+      cfg.inherit_cfg = true;
+      esp_pthread_set_cfg(&cfg);
+    }
+
+   ~PThreadConfig() {
+      if (!has_previous) previous = esp_pthread_get_default_config();
+      esp_pthread_set_cfg(&previous);
+    }
+
+    PThreadConfig(const PThreadConfig &) = delete;
+    PThreadConfig & operator=(const PThreadConfig &) = delete;
+};
+
+#endif
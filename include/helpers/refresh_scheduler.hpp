@@ -0,0 +1,104 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include "screen.hpp"
+
+#include <mutex>
+#include <vector>
+
+/**
+ * class RefreshScheduler - E-paper waveform selection
+ *
+ * Viewers tell what they are updating (the intent) and where (the region),
+ * and the scheduler selects the waveform used by the panel:
+ *
+ * - UI:    Fast monochrome (DU) for highlights, key presses, progress dots.
+ * - TEXT:  Grayscale without flashing (GL16) for pages of text.
+ * - IMAGE: Full grayscale clean (GC16) for images.
+ *
+ * Every fast update leaves some ghosting on the panel. The accumulated
+ * ghosting is tracked in a grid of cells covering the screen. When a region
+ * to be updated has accumulated too much of it, the update is done with GC16
+ * instead, cleaning only that region.
+ *
+ * On panels that don't support these waveforms (InkPlate), DU and GL16 are
+ * done through a partial update and GC16 through a full update.
+ */
+
+class RefreshScheduler
+{
+  public:
+    enum class Intent : uint8_t { UI, TEXT, IMAGE };
+
+    static constexpr uint8_t CELL_SIZE   = 60;  ///< Ghosting grid cells size in pixels
+    static constexpr uint8_t GHOST_LIMIT = 10;  ///< Ghosting level requiring a clean update
+    static constexpr uint8_t DU_GHOST    =  2;  ///< Ghosting left by a DU update
+    static constexpr uint8_t GL16_GHOST  =  1;  ///< Ghosting left by a GL16 update
+
+  private:
+    static constexpr char const * TAG = "RefreshScheduler";
+
+    std::mutex           mutex;
+    std::vector<uint8_t> ghosts;           ///< Ghosting level of every cell
+    uint16_t             columns, rows;
+    bool                 force_full;
+
+    void         check_grid();
+    uint8_t  get_max_ghost(uint16_t col_from, uint16_t col_to, uint16_t row_from, uint16_t row_to);
+    void       set_ghosts(uint16_t col_from, uint16_t col_to, uint16_t row_from, uint16_t row_to,
+                          Screen::UpdateMode mode, bool saturate);
+
+  public:
+    RefreshScheduler() : columns(0), rows(0), force_full(false) { }
+
+    /**
+     * @brief Select the waveform to be used
+     *
+     * The ghosting levels of the cells covered by the region are updated.
+     *
+     * @param intent What is being updated
+     * @param dim Region dimensions. Adjusted to the whole screen after force_full_update().
+     * @param pos Region position. Adjusted to the whole screen after force_full_update().
+     * @param no_full The update must not flash. A clean update will be done next time.
+     * @return Screen::UpdateMode The waveform to use
+     */
+    Screen::UpdateMode schedule(Intent intent, Dim & dim, Pos & pos, bool no_full = false);
+
+    /**
+     * @brief Update a region of the screen
+     *
+     * @param intent What is being updated
+     * @param dim Region dimensions
+     * @param pos Region position
+     * @param no_full The update must not flash. A clean update will be done next time.
+     * @return Screen::Fence The fence to wait on for the update to be shown
+     */
+    Screen::Fence update(Intent intent, Dim dim, Pos pos, bool no_full = false);
+
+    /**
+     * @brief Update the whole screen
+     */
+    inline Screen::Fence update(Intent intent, bool no_full = false) {
+      return update(intent, Dim(Screen::get_width(), Screen::get_height()), Pos(0, 0), no_full);
+    }
+
+    /**
+     * @brief The next update will clean the whole screen
+     */
+    void force_full_update();
+
+    /**
+     * @brief Get the ghosting level of the cell containing a position
+     */
+    uint8_t get_ghost(Pos pos);
+};
+
+#if __REFRESH_SCHEDULER__
+  RefreshScheduler refresh_scheduler;
+#else
+  extern RefreshScheduler refresh_scheduler;
+#endif
@@ -0,0 +1,88 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#if EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "helpers/perf_stats.hpp"
+
+#include <string>
+
+/**
+ * class RenderBench - Batch rendering benchmark
+ *
+ * Command line tool available with the headless Linux build. It opens
+ * an e-book, computes all pages locations, then renders the first pages
+ * through the BookViewer, saving each one of them as a PGM image.
+ * The time spent in each stage of the rendering pipeline is reported
+ * for both the pagination and the rendering passes.
+ *
+ * With the -r option, each page is laid out replaying its item from the
+ * start instead of resuming from the page layout checkpoint.
+ *
+ * With the -c option, the e-book content and pages caches are enabled.
+ * The pages are then rendered a second time, being retrieved from the
+ * pages cache, and saved as cached_NNNN.pgm.
+ *
+ * With the -q option, the e-book is searched once paginated, reporting
+ * the pages found and the query time.
+ *
+ * With the -m option, the memory used by the glyphs, images, items and
+ * table of content is capped to the given number of kilobytes (see the
+ * MemoryBudget class), to reproduce the behavior of a device low on memory.
+ *
+ * With the -x option, the pages locations of other font sizes are computed
+ * in the same pass (see PageLocs::Variant). The pass is compared with one
+ * computation per font size, the caches being warmed up first. The font
+ * size is then changed to each one of them, and back.
+ *
+ * With the -w option, words are laid out on pages in a loop, without
+ * any e-book, to measure the page layout speed in words per second.
+ *
+ * With the -g option, the glyphs of the IBMF fonts of the fonts folder
+ * are retrieved in a loop, to compare their retrieval cost: plain ASCII
+ * glyphs, Latin-1 and Latin Extended-A glyphs (most of them composed of a
+ * glyph and an accent), then from the glyphs cache, with one size and
+ * alternating between two sizes.
+ *
+ * Usage: epub-inkplate [-r] [-c] [-p] [-q <query>] [-m <kbytes>] [-x <size>[,<size>...]]
+ *                      <epub file> [<page count> [<output folder>]]
+ *        epub-inkplate -w [<word count>]
+ *        epub-inkplate -g [<font size>]
+ */
+
+class RenderBench
+{
+  private:
+    static constexpr char const * TAG = "RenderBench";
+
+    static constexpr int16_t DEFAULT_PAGE_COUNT =     10;
+    static constexpr int32_t DEFAULT_WORD_COUNT = 500000;
+    static constexpr int16_t DEFAULT_FONT_SIZE  =     12;
+    static constexpr int16_t GLYPH_ROUNDS       =    200;
+
+    void show_stats(const char * title, int64_t wall_us);
+    int  layout_words(int32_t word_count);
+    int  fetch_glyphs(int16_t font_size);
+
+  public:
+    /**
+     * @brief Run the benchmark
+     *
+     * The fonts, screen and page locations threads must have been setup.
+     *
+     * @return int The process exit code
+     */
+    int run(int argc, char ** argv);
+};
+
+#if __RENDER_BENCH__
+  RenderBench render_bench;
+#else
+  extern RenderBench render_bench;
+#endif
+
+#endif
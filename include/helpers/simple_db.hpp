@@ -82,7 +82,7 @@ class SimpleDB
     inline uint16_t             get_current_idx() { return current_record_idx;  }
     inline void    set_current_idx(int16_t index) { current_record_idx = index; }
     inline uint16_t            get_record_count() { return record_count;        }
-    inline uint16_t               get_file_size() { return file_size;           }
+    inline uint32_t               get_file_size() { return file_size;           }
     inline bool          is_some_record_deleted() { return some_record_deleted; }
     inline bool                      is_db_open() { return db_is_open;          }
 
@@ -98,6 +98,18 @@ class SimpleDB
      */
     bool add_record(void * record, int32_t size);
 
+    /**
+     * @brief Replace the current record.
+     * 
+     * The new record must be of the same size as the current one.
+     * 
+     * @param record 
+     * @param size 
+     * @return true Record has been replaced.
+     * @return false Size mismatch or potential file access issue.
+     */
+    bool replace_record(void * record, int32_t size);
+
     bool get_record(void * record, int32_t size);
 
     bool get_partial_record(void * record, int32_t size, int32_t offset);
@@ -7,6 +7,9 @@
 
 #include <forward_list>
 #include <mutex>
+#include <map>
+#include <string>
+#include <vector>
 
 #define MINIZ 1
 #define ZLIB  0
@@ -37,6 +40,7 @@ class Unzip
       uint32_t start_pos;       // in zip file
       uint32_t compressed_size; // in zip file
       uint32_t size;            // once decompressed
+      uint32_t crc;             // of the decompressed content, from the central directory
       uint32_t current_pos;
       uint16_t method;          // compress method (0 = not compressed, 8 = DEFLATE)
     };
@@ -56,20 +60,95 @@ class Unzip
              (((uint32_t)b[1]) << 8);
     }
 
-    uint16_t repeat;
-    uint16_t remains;
-    uint16_t current;
     bool     aborted;
 
     FILE * file; // Current File Descriptor
     bool zip_file_is_open;
 
-    #if ZLIB
-      z_stream zstr;
-    #endif
-    #if MINIZ
-      mz_stream zstr;
-    #endif
+    // ----- Stream decompression -----
+
+    /**
+     * @brief Inflate state of the current stream
+     * 
+     * The tinfl decompressor is driven directly (instead of through mz_inflate) such
+     * that its complete state, including the 32KB sliding window, can be saved as
+     * a checkpoint and restored later to resume decompression in the middle of a
+     * deflated entry. The structure is self-contained (no pointers).
+     */
+    struct InflateState {
+      tinfl_decompressor decomp;
+      tinfl_status       status;
+      uint32_t           dict_ofs;   // Next write position in dict
+      uint32_t           dict_avail; // Bytes in dict not yet returned to the caller
+      uint8_t            dict[TINFL_LZ_DICT_SIZE];
+    };
+
+    InflateState * state;
+    uint32_t       data_start;       // Position of the entry's data in the zip file
+    uint32_t       in_offset;        // Compressed bytes consumed by the decompressor
+    uint32_t       in_remaining;     // Compressed bytes not yet read from the zip file
+    uint32_t       out_offset;       // Decompressed bytes produced by the decompressor
+    const char   * in_ptr;
+    uint32_t       in_avail;
+
+    bool fill_buffer();
+    bool inflate_step();
+    bool stream_rewind();
+
+    // ----- Inflate checkpoints index -----
+    //
+    // Large deflated entries get a checkpoint every CHECKPOINT_INTERVAL bytes 
+    // of decompressed output (like zlib's zran example). Checkpoints are
+    // written to a sidecar file (.zidx) next to the ebook, as fixed size
+    // records: a CheckpointHeader followed by an InflateState. Only the 
+    // headers are kept in memory.
+
+    static constexpr int8_t   ZIDX_FILE_VERSION   = 1;
+    static constexpr uint32_t CHECKPOINT_INTERVAL = 128 * 1024;
+    static constexpr uint32_t INDEX_MIN_SIZE      = 256 * 1024;
+
+    #pragma pack(push, 1)
+      struct CheckpointHeader {
+        uint32_t entry_pos;   // start_pos of the entry in the zip file
+        uint32_t entry_crc;   // crc32 of the entry, to detect stale sidecar files
+        uint32_t in_offset;
+        uint32_t out_offset;
+      };
+    #pragma pack(pop)
+
+    struct Checkpoint {
+      uint32_t out_offset;
+      uint32_t in_offset;
+      uint32_t file_pos;      // Position of the InflateState record in the sidecar file
+    };
+    typedef std::vector<Checkpoint>           Checkpoints;
+    typedef std::map<uint32_t, Checkpoints> InflateIndex; // key is entry start_pos
+
+    InflateIndex  inflate_index;
+    std::string   index_filename;
+    FILE        * index_file;
+    bool          indexing;
+    uint32_t      next_checkpoint;
+
+    void load_inflate_index();
+    bool save_checkpoint();
+    bool restore_checkpoint(const Checkpoint & checkpoint);
+
+    /**
+     * @brief Retrieve a whole entry in one operation
+     * 
+     * The compressed data is read at once and decompressed with Inflate
+     * straight into the returned buffer, then checked against the entry
+     * CRC-32. Large entries are left to the stream decompression until their
+     * inflate index is complete.
+     * 
+     * @param filename The file inside the zip
+     * @param data The entry content, nullptr on error
+     * @param file_size The entry size
+     * @return true The entry was processed, successfully or not
+     * @return false The entry must be retrieved with the stream decompression
+     */
+    bool get_whole_file(const char * filename, char * & data, uint32_t & file_size);
 
   public:
     Unzip();
@@ -77,6 +156,17 @@ class Unzip
     void close_zip_file();
     
     int32_t get_file_size(const char * filename);
+
+    /**
+     * @brief Retrieve a file's central directory information
+     * 
+     * @param filename The file inside the zip
+     * @param size Decompressed size
+     * @param crc CRC-32 of the decompressed content
+     * @param method Compression method (0 = not compressed, 8 = DEFLATE)
+     * @return true The file is present in the zip
+     */
+    bool    get_file_info(const char * filename, uint32_t & size, uint32_t & crc, uint16_t & method);
     char  * get_file(const char * filename, uint32_t & file_size);
     bool    file_exists(const char * filename);
     bool    open_file(const char * filename);
@@ -87,6 +177,31 @@ class Unzip
       bool   get_stream_data(char * data, uint32_t & size);
       bool   stream_skip(uint32_t byte_count);
       void   close_stream_file();
+
+      /**
+       * @brief Move the current stream to a decompressed byte offset
+       * 
+       * For deflated entries, decompression resumes from the nearest inflate 
+       * checkpoint located before the offset, if any. The stream must have
+       * been opened with open_stream_file().
+       * 
+       * @param offset Byte offset in the decompressed entry
+       * @return true The stream is positioned at offset
+       * @return false Offset beyond the end of the entry or decompression error
+       */
+      bool   stream_seek(uint32_t offset);
+
+      inline uint32_t get_stream_pos() { 
+        return ((*current_fe)->method == 0) ? out_offset : out_offset - state->dict_avail; 
+      }
+
+      /**
+       * @brief Inflate checkpoints count for a file in the zip
+       * 
+       * @param filename The file inside the zip
+       * @return int16_t Checkpoints count, -1 if the file is not in the zip
+       */
+      int16_t get_checkpoint_count(const char * filename);
     #endif
 };
 
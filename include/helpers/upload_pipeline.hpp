@@ -0,0 +1,109 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include "helpers/zip_stream_scanner.hpp"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+/**
+ * class UploadPipeline - Overlapped network reception and storage writes
+ *
+ * The received file goes through a ring of BUFFER_COUNT buffers. The
+ * receiver fills a buffer from the network while a dedicated task writes
+ * the previous ones to storage and feeds them to an optional zip scanner.
+ * The receiver waits only when all buffers are waiting to be written.
+ *
+ * Buffers are allocated in PSRAM when available.
+ */
+
+class UploadPipeline
+{
+  public:
+    static constexpr uint8_t  BUFFER_COUNT =  4;
+    static constexpr uint32_t BUFFER_SIZE  = 32 * 1024;
+
+  private:
+    static constexpr char const * TAG = "UploadPipeline";
+
+    struct Buffer {
+      char   * data;
+      uint32_t size;
+    };
+
+    std::mutex              mutex;
+    std::condition_variable cond;
+    std::thread             thread;
+    Buffer                  buffers[BUFFER_COUNT];
+    uint8_t                 next_in;      ///< Next buffer to be filled by the receiver
+    uint8_t                 next_out;     ///< Next buffer to be written by the task
+    uint8_t                 queued;       ///< Buffers waiting to be written
+    FILE                  * file;
+    ZipStreamScanner      * scanner;
+    bool                    running;
+    bool                    failed;
+
+    uint32_t                byte_count;
+    int64_t                 start_us;
+    int64_t                 end_us;
+    int64_t                 write_us;     ///< Time spent writing to storage
+    int64_t                 stall_us;     ///< Time the receiver waited for a free buffer
+
+    void task();
+    void free_buffers();
+
+  public:
+    UploadPipeline();
+   ~UploadPipeline() { finish(); free_buffers(); }
+
+    /**
+     * @brief Start the storage writer task
+     *
+     * @param f The file to write to, open in write mode. Closed by the caller.
+     * @param s Scanner fed with the written data, may be nullptr
+     * @return false Unable to allocate the buffers
+     */
+    bool start(FILE * f, ZipStreamScanner * s = nullptr);
+
+    /**
+     * @brief Get a buffer to fill
+     *
+     * Waits for a buffer to be available.
+     *
+     * @return char * BUFFER_SIZE bytes, nullptr if a write failed
+     */
+    char * get_buffer();
+
+    /**
+     * @brief Queue the buffer obtained from get_buffer() to be written
+     *
+     * @param size Number of bytes put in the buffer
+     * @return false A write failed
+     */
+    bool put_buffer(uint32_t size);
+
+    /**
+     * @brief Write the queued buffers and stop the writer task
+     *
+     * @return true All the data has been written
+     */
+    bool finish();
+
+    inline uint32_t get_byte_count() const { return byte_count;         }
+    inline int64_t  get_elapsed_us() const { return end_us - start_us;  }
+    inline int64_t    get_write_us() const { return write_us;           }
+    inline int64_t    get_stall_us() const { return stall_us;           }
+
+    /**
+     * @brief Upload throughput, from start() to finish()
+     *
+     * @return uint32_t Bytes per second
+     */
+    uint32_t get_throughput() const;
+};
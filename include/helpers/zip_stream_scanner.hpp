@@ -0,0 +1,127 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include <string>
+#include <vector>
+
+/**
+ * class ZipStreamScanner - Zip file content retrieval while it is received
+ *
+ * The zip file is fed sequentially, in chunks of any size, as it is written
+ * to storage. The local file headers are followed to locate the entries:
+ * the ones selected by is_wanted() are kept in memory and delivered,
+ * decompressed, to entry_received(). The last TAIL_SIZE bytes are kept to
+ * retrieve the central directory once the end of the file has been received.
+ *
+ * Entries written with a data descriptor (the compressed size being unknown
+ * in the local file header) stop the sequential scan: only the central
+ * directory is retrieved in that case.
+ */
+
+class ZipStreamScanner
+{
+  public:
+    static constexpr uint32_t TAIL_SIZE        =  64 * 1024;
+    static constexpr uint32_t MAX_CAPTURE_SIZE = 256 * 1024;  ///< Largest compressed entry kept in memory
+    static constexpr uint32_t MAX_ENTRY_SIZE   = 4096 * 1024;  ///< Largest entry once decompressed
+
+    struct Entry {
+      std::string filename;
+      uint32_t    header_pos;      ///< Position of the local file header in the zip file
+      uint32_t    compressed_size;
+      uint32_t    size;            ///< Once decompressed
+      uint32_t    crc;
+      uint16_t    method;          ///< 0 = not compressed, 8 = DEFLATE
+    };
+    typedef std::vector<Entry> Entries;
+
+  private:
+    static constexpr char const * TAG = "ZipStreamScanner";
+
+    static constexpr uint32_t LOCAL_HEADER_SIG    = 0x04034b50;
+    static constexpr uint32_t CENTRAL_HEADER_SIG  = 0x02014b50;
+    static constexpr uint32_t END_OF_DIR_SIG      = 0x06054b50;
+    static constexpr uint8_t  LOCAL_HEADER_SIZE   = 30;
+    static constexpr uint8_t  CENTRAL_HEADER_SIZE = 46;
+    static constexpr uint8_t  END_OF_DIR_SIZE     = 22;
+
+    enum class State : uint8_t { HEADER, NAME, EXTRA, DATA, DONE };
+
+    State       state;
+    uint8_t     header[LOCAL_HEADER_SIZE];
+    uint32_t    header_fill;
+    std::string name;
+    Entry       entry;              ///< Entry being received
+    uint32_t    remaining;          ///< Bytes of the current part not yet received
+    char      * capture;            ///< Compressed content of a wanted entry
+    uint32_t    capture_fill;
+    bool        scanned;            ///< The local file headers have been followed up to the central directory
+
+    uint8_t   * tail;               ///< Ring of the last TAIL_SIZE bytes received
+    uint32_t    stream_pos;         ///< Bytes received so far
+    Entries     entries;
+    bool        central_dir_found;
+
+    static inline uint32_t getuint32(const uint8_t * b) {
+      return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t) b[3] << 24);
+    }
+    static inline uint16_t getuint16(const uint8_t * b) {
+      return b[0] | (b[1] << 8);
+    }
+
+    void   header_completed();
+    void    entry_completed();
+    bool          read_tail(uint32_t pos, uint8_t * data, uint32_t size);
+    char *       decompress(const char * data, uint32_t size, uint32_t out_size);
+
+  protected:
+    /**
+     * @brief Select the entries to be delivered to entry_received()
+     */
+    virtual bool is_wanted(const std::string & filename) { return false; }
+
+    /**
+     * @brief Decompressed content of a wanted entry
+     *
+     * @param filename The entry
+     * @param data The content, null terminated. To be freed by the callee.
+     * @param size The content size
+     */
+    virtual void entry_received(const std::string & filename, char * data, uint32_t size) { free(data); }
+
+  public:
+    ZipStreamScanner() : capture(nullptr), tail(nullptr) { reset(); }
+    virtual ~ZipStreamScanner() { reset(); }
+
+    /**
+     * @brief Prepare for a new zip file
+     *
+     * @return false Not enough memory
+     */
+    bool begin();
+
+    /**
+     * @brief Next chunk of the zip file
+     */
+    void feed(const uint8_t * data, uint32_t size);
+
+    /**
+     * @brief End of the zip file: retrieve the central directory
+     *
+     * @return true The central directory has been found
+     */
+    bool finish();
+
+    void reset();
+
+    inline bool                  is_scanned() const { return scanned;           }
+    inline bool        is_central_dir_found() const { return central_dir_found; }
+    inline const Entries &      get_entries() const { return entries;           }
+    inline uint32_t         get_stream_size() const { return stream_pos;        }
+
+    const Entry * find(const std::string & filename) const;
+};
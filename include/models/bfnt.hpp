@@ -0,0 +1,171 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include "models/font.hpp"
+#include "models/ttf2.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * class BFNT - Precompiled bitmap font
+ *
+ * Glyphs rasterized on a host from a TrueType/OpenType font, for a screen
+ * resolution and a list of font sizes (see the FontCompiler tool). Pixels are
+ * kept with 4 bits of gray, run-length encoded: each byte is a run of 1 to 16
+ * pixels, the count minus one in the high nibble, the gray value in the low one
+ * (0 is white).
+ *
+ * File layout (little endian):
+ *
+ *   Header
+ *   SizeInfo[size_count]
+ *   For each size: GlyphInfo[glyph_count] sorted by code, KernPair[kern_count]
+ *                  grouped by left glyph, then the glyphs bitmaps
+ *
+ * The tables of a size are read when the size is first used. A glyph bitmap
+ * is read from the file when it is not in the glyph cache. Nothing is rasterized.
+ *
+ * The source font is used, through FreeType, for the sizes that were not
+ * precompiled (computed by the CSS rules of a book). It is loaded only when
+ * such a size is requested.
+ */
+
+class BFNT : public Font
+{
+  public:
+    static constexpr uint8_t BFNT_FILE_VERSION = 1;
+
+    struct Header {
+      char     ident[4];          ///< "BFNT"
+      uint8_t  version;
+      uint8_t  size_count;
+      uint16_t resolution;        ///< Pixels per inch the glyphs were rasterized for
+    };
+
+    struct SizeInfo {
+      int16_t  size;              ///< In points
+      int16_t  line_height;
+      int16_t  descender;
+      uint16_t glyph_count;
+      uint16_t kern_count;
+      uint16_t filler;
+      uint32_t glyphs_offset;     ///< GlyphInfo table, followed by the KernPair table
+      uint32_t bitmaps_offset;
+    };
+
+    struct GlyphInfo {
+      uint32_t code;              ///< Unicode character
+      uint32_t bitmap_offset;     ///< From SizeInfo::bitmaps_offset
+      uint16_t bitmap_size;       ///< Run-length encoded bytes
+      uint16_t width;
+      uint16_t height;
+      int16_t  xoff;
+      int16_t  yoff;
+      int16_t  advance;
+      uint16_t kern_index;        ///< First pair where the glyph is the left one
+      uint16_t kern_count;
+    };
+
+    struct KernPair {
+      uint32_t next_code;
+      int16_t  kern;              ///< In pixels
+      int16_t  filler;
+    };
+
+    static_assert(sizeof(Header)    ==  8, "BFNT Header layout");
+    static_assert(sizeof(SizeInfo)  == 20, "BFNT SizeInfo layout");
+    static_assert(sizeof(GlyphInfo) == 24, "BFNT GlyphInfo layout");
+    static_assert(sizeof(KernPair)  ==  8, "BFNT KernPair layout");
+
+    /**
+     * @brief Precompiled font filename
+     *
+     * @param font_filename The TrueType/OpenType font filename.
+     * @param resolution The screen resolution in pixels per inch.
+     * @return std::string The font filename, its extension replaced with
+     *                     _<resolution>.bfnt
+     */
+    static std::string get_filename(const std::string & font_filename, uint16_t resolution);
+
+    /**
+     * @brief Decode a run-length encoded bitmap
+     *
+     * @param rle The encoded bitmap.
+     * @param size Its size in bytes.
+     * @param width, height The glyph dimensions.
+     * @param one_bit If true, the bitmap is converted to 1 bit per pixel (MSB first),
+     *                otherwise to 8 bits per pixel, as rendered by FreeType.
+     * @param out The resulting bitmap, (one_bit ? (width + 7) >> 3 : width) * height bytes.
+     * @return true The bitmap was complete.
+     */
+    static bool decode(const uint8_t * rle, uint16_t size,
+                       uint16_t width, uint16_t height,
+                       bool one_bit, uint8_t * out);
+
+    BFNT(const std::string & filename, const std::string & fallback_filename);
+   ~BFNT();
+
+    void clear_cache() override;
+
+    Glyph * adjust_ligature_and_kern(Glyph   * glyph,
+                                     uint16_t  glyph_size,
+                                     uint32_t  next_charcode,
+                                     int16_t & kern,
+                                     bool    & ignore_next);
+
+    /**
+     * @brief Face normal line height
+     *
+     * @return int32_t Normal line height of the face in pixels
+     */
+    int32_t get_line_height(int16_t glyph_size);
+
+    /**
+     * @brief Face descender height
+     *
+     * @return int32_t The face descender height in pixels related to
+     *                 the glyph size.
+     */
+    int32_t get_descender_height(int16_t glyph_size);
+
+  private:
+    static constexpr char const * TAG = "BFNT";
+
+    struct SizeTables {
+      std::vector<GlyphInfo> glyphs;
+      std::vector<KernPair>  kerns;
+    };
+
+    std::string                             filename;
+    std::string                             fallback_filename;
+    std::vector<SizeInfo>                   sizes;
+    std::unordered_map<int16_t, SizeTables> tables;   ///< Sizes used so far
+    std::vector<uint8_t>                    rle_buffer;
+    std::unique_ptr<TTF>                    fallback;
+    std::once_flag                          fallback_loaded;
+
+    // A single precompiled font file is kept open, for all fonts: the
+    // number of files opened at once being limited on the device.
+
+    static FILE       * file;
+    static const BFNT * file_owner;
+    static std::mutex   file_mutex;
+
+    const SizeInfo   * get_size_info(int16_t glyph_size) const;
+    const SizeTables * get_tables(int16_t glyph_size);
+    TTF              * get_fallback();
+    bool               read(uint32_t offset, void * buffer, uint32_t size);
+
+    bool set_font_face_from_memory(unsigned char * buffer, int32_t size) { return false; }
+
+    Glyph * get_glyph_internal(uint32_t charcode, int16_t glyph_size);
+};
@@ -9,6 +9,8 @@
 
 #include <vector>
 #include <map>
+#include <string>
+#include <unordered_map>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
@@ -22,6 +24,17 @@
  * methods to read the directory from a database file located in the same folder 
  * as the books themselves, refresh the list reading again all file content
  * not found in the database to retrieve meta-data.
+ *
+ * Beside the primary index (books sorted by title, the recently read ones
+ * first), secondary indexes by author and by title and author words are
+ * kept in memory. They are saved with the books list (filename, size,
+ * title and author of each book) in a file beside the database, allowing
+ * the next refresh to be done without reading the database records.
+ *
+ * The books presented are the ones of the current view: an order (title,
+ * author or recently read) and a query. A book is in the view when each
+ * word of the query begins a word of its title or author. All book indexes
+ * (idx) used by the methods of this class are indexes in the current view.
  */
 class BooksDir
 {
@@ -65,17 +78,40 @@ class BooksDir
     };
     #pragma pack(pop)
 
+    enum class Order : uint8_t { TITLE, AUTHOR, RECENT };
+
   private:
     static constexpr char const * TAG            = "BooksDir";
     static constexpr char const * BOOKS_DIR_FILE = MAIN_FOLDER "/books_dir.db";
     static constexpr char const * NEW_DIR_FILE   = MAIN_FOLDER "/new_dir.db";
+    static constexpr char const * INDEX_FILE     = MAIN_FOLDER "/books_dir.idx";
     static constexpr char const * APP_NAME       = "EPUB-INKPLATE";
 
+    static const uint16_t BOOKS_DIR_INDEX_VERSION = 1;
+
     SimpleDB db;                       ///< The SimpleDB database
 
     struct IndexInfo {
-      uint32_t id;
-      uint16_t db_index;
+      uint32_t    id;
+      uint16_t    db_index;
+      std::string author;
+    };
+
+    /**
+     * @brief A book, as saved in the index file
+     */
+    struct BookInfo {
+      uint16_t    db_index;
+      uint32_t    id;
+      int32_t     file_size;
+      std::string filename;
+      std::string title;
+      std::string author;
+    };
+
+    struct WordRef {
+      std::string word;                ///< Lower cased, without accents
+      uint16_t    db_index;
     };
 
     typedef std::map<std::string, IndexInfo> SortedIndex;  ///< Sorted map of book names and indexes.
@@ -83,8 +119,36 @@ class BooksDir
     EBookRecord book;                  ///< Book Record structure prepared to return to the caller
     int16_t current_book_idx;          ///< Current book index present in the book structure
 
+    // ----- Secondary indexes -----
+
+    std::vector<SortedIndex::const_iterator> books;        ///< The sorted_index entries, in order
+    std::unordered_map<uint32_t, uint16_t>   positions;    ///< Position in books of each book id
+    std::vector<int16_t>                     db_positions; ///< Position in books of each db index
+    std::vector<uint16_t>                    by_author;    ///< db indexes, by author then title
+    std::vector<WordRef>                     words;        ///< Title and author words, sorted
+
+    // ----- Current view -----
+
+    Order                 order;
+    std::string           query;
+    std::vector<uint16_t> view;         ///< Positions in books
+    std::vector<int16_t>  view_idx;     ///< View index of each position in books, -1 if not in view
+
+    void  set_cover(EBookRecord * the_book, Image * img);
+    void index_book(const EBookRecord * the_book, uint16_t db_index);
+    void index_book(const char * title, uint32_t id, const char * author, uint16_t db_index);
+
+    void build_positions();
+    void build_secondary_indexes();
+    void build_view();
+
+    bool load_index_file(std::vector<BookInfo> & infos);
+    bool save_index_file();
+
+    static void add_words(const std::string & text, uint16_t db_index, std::vector<WordRef> & refs);
+
   public:
-    BooksDir() : current_book_idx(-1) { }
+    BooksDir() : current_book_idx(-1), order(Order::TITLE) { }
    ~BooksDir() {
       sorted_index.clear();
       close_db(); 
@@ -95,7 +159,7 @@ class BooksDir
      * 
      * @return int16_t The number of ebooks present in the database
      */
-    inline int16_t get_book_count() const { return sorted_index.size(); }
+    inline int16_t get_book_count() const { return view.size(); }
 
     /**
      * @brief Get an ebook meta-data
@@ -112,28 +176,34 @@ class BooksDir
     bool                             get_book_index(uint32_t id,  uint16_t & idx);
     void                            set_track_order(uint32_t id,  int8_t     pos);
 
+    /**
+     * @brief Title and author of a book, retrieved without reading the database
+     */
+    bool get_title_author(uint16_t idx, std::string & title, std::string & author);
+
     int16_t get_sorted_idx(uint16_t db_idx) {
-      int i = 0;
-      for (auto entry : sorted_index) {
-        if (entry.second.db_index == db_idx) {
-          return i;
-        }
-        i++;
-      }
-      return -1;
+      return ((db_idx < db_positions.size()) && (db_positions[db_idx] != -1)) ?
+                view_idx[db_positions[db_idx]] : -1;
     }
 
     int16_t get_sorted_idx_from_id(uint32_t id) {
-      int i = 0;
-      for (auto entry : sorted_index) {
-        if (entry.second.id == id) {
-          return i;
-        }
-        i++;
-      }
-      return -1;
+      auto it = positions.find(id);
+      return (it == positions.end()) ? -1 : view_idx[it->second];
     }
 
+    /**
+     * @brief Select the books presented
+     *
+     * @param the_order The books order
+     * @param the_query Words, separated with spaces. Each one of them must
+     *                  begin a word of the title or the author of a book
+     *                  for it to be presented. All books when empty.
+     */
+    void set_view(Order the_order, const std::string & the_query);
+
+    inline Order               get_order() const { return order; }
+    inline const std::string & get_query() const { return query; }
+
     static const int16_t max_cover_width  = MAX_COVER_WIDTH;  ///< Bitmap width in pixels to present a book cover in the list
     static const int16_t max_cover_height = MAX_COVER_HEIGHT; ///< Bitmap height in pixels
 
@@ -172,6 +242,19 @@ class BooksDir
      */
     bool refresh(char * book_filename, int16_t & book_index, bool force_init = false);
 
+    /**
+     * @brief Add a book whose metadata have already been retrieved
+     * 
+     * Used when the metadata have been retrieved while the book was received by
+     * the Web server: only the cover image is read from the book file.
+     * 
+     * @param filename The book filename, no folder
+     * @param metadata The book metadata
+     * @return true  The book has been added to the database.
+     * @return false Some error happened. The book will be added by the next refresh.
+     */
+    bool add_book(const char * filename, const EPub::Metadata & metadata);
+
     /**
      * @brief Close the SimpleDB database
      * 
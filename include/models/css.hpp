@@ -21,8 +21,10 @@
 #include <iterator>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+#include <vector>
 
-#include "memory_pool.hpp"
+#include "helpers/arena.hpp"
 #include "dom.hpp"
 #include "fonts.hpp"
 
@@ -134,15 +136,22 @@ class CSS
     std::string folder_path;  // Path used for all other files access (relative)
     bool        ghost;        // True if this instance rules content came from other instances
     uint8_t     priority;
+    Arena       arena;        // All the rules are allocated from it. Released at once with the instance.
 
   public:
+    // The instance arena is a child of the scope arena: the book arena for the
+    // e-book stylesheets, the item arena for the ones defined in an item, the
+    // page render arena for the style attributes.
+
     CSS(const char * css_id, 
         const char * file_folder_path, 
         const char * buffer, 
         int32_t      size,
-        uint8_t      prio);
+        uint8_t      prio,
+        Arena      & scope);
 
-    CSS(const char * css_id) { 
+    CSS(const char * css_id, Arena & scope)
+      : arena("css", &scope), rules_map(*make<ArenaRulesMap>()) {
         id          = css_id;
         folder_path = "";
         ghost       = true;
@@ -153,9 +162,8 @@ class CSS
         DOM::Tag     tag,
         const char * buffer, 
         int32_t      size,
-        uint8_t      prio);
-
-   ~CSS();
+        uint8_t      prio,
+        Arena      & scope);
 
     const std::string &          get_id() const { return id;          }
     const std::string & get_folder_path() const { return folder_path; }
@@ -188,7 +196,7 @@ class CSS
     enum class     SelOp : uint8_t { NONE, DESCENDANT, CHILD, ADJACENT };
     enum class Qualifier : uint8_t { NONE, FIRST_CHILD                 };
 
-    typedef std::forward_list<std::string> ClassList;
+    typedef std::forward_list<ArenaString, ArenaAllocator<ArenaString>> ClassList;
 
     #pragma pack(push, 1)
       // The following is OK in a little endian context.
@@ -210,28 +218,25 @@ class CSS
       };
 
       struct SelectorNode {
-        std::string id;
+        ArenaString id;
         ClassList   class_list;
         Qualifier   qualifier;
         uint8_t     class_count, id_count;
         SelOp       op;
         DOM::Tag    tag;
-        SelectorNode() {
+        SelectorNode(Arena & arena) : id(arena), class_list(arena) {
           op          = SelOp::NONE;
           tag         = DOM::Tag::NONE;
           qualifier   = Qualifier::NONE;
           class_count = 0;
           id_count    = 0;
         }
-        ~SelectorNode() {
-          class_list.clear();
-        }
-        void add_class(std::string class_name) {
-          class_list.push_front(class_name);
+        void add_class(const char * class_name) {
+          class_list.emplace_front(class_name, class_list.get_allocator());
           class_count += 1;
         }
-        void add_id(const std::string & the_id) {
-          id = the_id;
+        void add_id(const char * the_id) {
+          id.assign(the_id);
           id_count += 1;
         }
         void set_tag(DOM::Tag the_tag) {
@@ -260,20 +265,14 @@ class CSS
         }
       };
 
-      typedef std::forward_list<SelectorNode *> SelectorNodeList;
+      typedef std::forward_list<SelectorNode *, ArenaAllocator<SelectorNode *>> SelectorNodeList;
 
       struct Selector {
         Specificity specificity;
         SelectorNodeList selector_node_list;
-        Selector() {
+        Selector(Arena & arena) : selector_node_list(arena) {
           specificity.value = 0;
         }
-        ~Selector() {
-          for (auto * selector_node : selector_node_list) {
-              selector_node_pool.deleteElement(selector_node);
-          }
-          selector_node_list.clear();
-        }
         void add_selector_node(SelectorNode * node) {
           selector_node_list.push_front(node);
         }
@@ -307,7 +306,7 @@ class CSS
 
       struct Value {
         float       num;
-        std::string str;
+        ArenaString str;
         ValueType   value_type;
         union {
           Display          display;
@@ -316,7 +315,7 @@ class CSS
           Fonts::FaceStyle face_style;
           VerticalAlign    vertical_align;
         } choice;
-        Value() {
+        Value(Arena & arena) : str(arena) {
           value_type = ValueType::NO_TYPE;
           num = 0.0;
         }
@@ -335,17 +334,12 @@ class CSS
         }
       };
 
-      typedef std::forward_list<Value *> Values;
+      typedef std::forward_list<Value *, ArenaAllocator<Value *>> Values;
 
       struct Property {
         PropertyId id;
         Values     values;
-        ~Property() {
-          for (auto * value : values) {
-            value_pool.deleteElement(value);
-          }
-          values.clear();
-        }
+        Property(Arena & arena) : values(arena) { }
         void add_value(Value * v) {
           values.push_front(v);
         }
@@ -381,31 +375,41 @@ class CSS
       }
     };
 
-    typedef std::list<Selector *>              Selectors;
-    typedef std::forward_list<Property *>      Properties;
-
-    // typedef std::list<Properties *>            PropertySuite;
-    typedef std::forward_list<Properties *>    PropertySuiteList;
+    typedef std::list<Selector *>                                      Selectors;
+    typedef std::forward_list<Property *, ArenaAllocator<Property *>>  Properties;
 
-    typedef std::multimap<Selector *, Properties *, rule_compare>  RulesMap;
+    typedef std::multimap<Selector *, Properties *, rule_compare>      RulesMap;
+    typedef std::multimap<Selector *, Properties *, rule_compare,
+                          ArenaAllocator<RulesMap::value_type>>        ArenaRulesMap;
 
-    RulesMap          rules_map;
-    PropertySuiteList suites;     // Linear list of suites to be deleted when the instance will be destroyed.
+    ArenaRulesMap & rules_map;  // In the instance arena, as all the rules content
 
-    static MemoryPool<Value>        value_pool;
-    static MemoryPool<Property>     property_pool;
-    static MemoryPool<Properties>   properties_pool;
-    static MemoryPool<SelectorNode> selector_node_pool;
-    static MemoryPool<Selector>     selector_pool;
+    template <class T> T * make() { return arena.make<T>(arena); }
 
     void match(DOM::Node * node, RulesMap & to_rules);
-    void  show(RulesMap & the_rules_map);
+
+    template <class Rules>
+    static void show(Rules & the_rules) {
+      #if DEBUGGING
+        std::cout << "------ Rules Map: -----" << std::endl;
+        for (auto & rule : the_rules) {
+          rule.first->show();
+          std::cout << " {" << std::endl;
+          for (auto * prop : *rule.second) {
+            prop->show();
+          }
+          std::cout << "}" << std::endl;
+        }
+        std::cout << "[END]" << std::endl;
+      #endif
+    }
 
     void add_rule(Selector * sel, Properties * props) { 
       rules_map.insert(std::pair<Selector *, Properties *>(sel, props)); 
     }
 
-    static const Values * get_values_from_rules(const RulesMap & rules, 
+    template <class Rules>
+    static const Values * get_values_from_rules(const Rules & rules,
                                                 PropertyId id) {
       Values * vals = nullptr;
       for (auto & rule : rules) {
@@ -436,6 +440,31 @@ class CSS
       #endif
     }
 
+    /**
+     * @brief Serialize the rules
+     * 
+     * The result holds no pointer: the property sets are saved first, then
+     * the selectors, each rule referring to its property set by index. The
+     * rules are saved in specificity order, such that the ones of the same
+     * specificity remain in the order of the css file.
+     * 
+     * @param data The serialized rules.
+     * @return true The rules have been serialized.
+     */
+    bool serialize(std::vector<uint8_t> & data) const;
+
+    /**
+     * @brief Rebuild the rules from their serialized form
+     * 
+     * To be used on an instance built with the ghost constructor, before any
+     * rule is added to it. The folder path and priority are also restored.
+     * 
+     * @param data The serialized rules, as produced by serialize().
+     * @param size The data size in bytes.
+     * @return true The rules have been rebuilt.
+     */
+    bool restore(const uint8_t * data, uint32_t size);
+
   private:
     bool match_simple_selector(DOM::Node & node, SelectorNode & simple_sel);
     bool        match_selector(DOM::Node * node, Selector     & sel       );
@@ -584,7 +584,7 @@ class CSSParser
     CSS::Value * term(bool & none, CSS::PropertyId id) {
       none = false;
       bool neg = false;
-      CSS::Value * v = css.value_pool.newElement();
+      CSS::Value * v = css.make<CSS::Value>();
       bool done = false;
       while (true) {
         if ((token == Token::PLUS) || (token == Token::MINUS)) {
@@ -668,7 +668,7 @@ class CSSParser
           }
           else if ((id == CSS::PropertyId::FONT_SIZE) && (v->value_type == CSS::ValueType::STR)) {
             v->value_type = CSS::ValueType::PT;
-            CSS::FontSizeMap::iterator it = css.font_size_map.find(v->str);
+            CSS::FontSizeMap::iterator it = css.font_size_map.find(v->str.c_str());
             if (it != css.font_size_map.end()) {
               v->num = it->second;
             }
@@ -707,13 +707,7 @@ class CSSParser
         break;
       }
       
-      if (done) {
-        return v;
-      }
-      else {
-        css.value_pool.deleteElement(v);
-        return nullptr;
-      }
+      return done ? v : nullptr;
     }
 
     bool expression(CSS::Property & prop) {
@@ -734,7 +728,7 @@ class CSSParser
     }
 
     CSS::Property * declaration() {
-      CSS::Property * prop = css.property_pool.newElement();
+      CSS::Property * prop = css.make<CSS::Property>();
       bool done = false;
       while (true) {
         // process IDENT property
@@ -753,9 +747,6 @@ class CSSParser
         return prop;
       }
       else {
-        for (auto * v : prop->values) css.value_pool.deleteElement(v);
-        prop->values.clear();
-        css.property_pool.deleteElement(prop);
         skip_block();
         return nullptr;
       }
@@ -793,8 +784,8 @@ class CSSParser
 
     bool font_face_statement() {
       CSS::Selectors      sels;
-      CSS::Selector     * sel = css.selector_pool.newElement();
-      CSS::SelectorNode * node = css.selector_node_pool.newElement();
+      CSS::Selector     * sel = css.make<CSS::Selector>();
+      CSS::SelectorNode * node = css.make<CSS::SelectorNode>();
       node->tag = DOM::Tag::FONT_FACE;
       sel->add_selector_node(node);
       sel->compute_specificity(css.get_priority());
@@ -866,13 +857,13 @@ class CSSParser
     bool sub_selector_node(CSS::SelectorNode & node) {
       for (;;) {
         if (token == Token::HASH) {
-          node.add_id(std::string(name));
+          node.add_id(name);
           next_token();
         }
         else if (token == Token::DOT) {
           next_token();
           if (token == Token::IDENT) {
-            node.add_class(std::string(ident));
+            node.add_class(ident);
             next_token();
           }
         }
@@ -891,7 +882,7 @@ class CSSParser
     }
 
     CSS::SelectorNode * selector_node() {
-      CSS::SelectorNode * node = css.selector_node_pool.newElement();
+      CSS::SelectorNode * node = css.make<CSS::SelectorNode>();
       bool done = false;
       while (true) {
         if (token == Token::IDENT) {
@@ -916,17 +907,11 @@ class CSSParser
         done = true;
         break;
       }
-      if (done) {
-        return node;
-      }
-      else {
-        css.selector_node_pool.deleteElement(node);
-        return nullptr;
-      }
+      return done ? node : nullptr;
     }
 
     CSS::Selector * selector() {
-      CSS::Selector     * sel = css.selector_pool.newElement();
+      CSS::Selector     * sel = css.make<CSS::Selector>();
       CSS::SelectorNode * node;
       bool done = false;
       while (true) {
@@ -960,24 +945,15 @@ class CSSParser
         done = done2;
         break;
       }
-      if (done) {
-        if (!sel->is_empty()) {
-          sel->compute_specificity(css.get_priority());
-          return sel;
-        }
-        else {
-          css.selector_pool.deleteElement(sel);
-          return nullptr;
-        }
-      }
-      else {
-        css.selector_pool.deleteElement(sel);
-        return nullptr;
+      if (done && !sel->is_empty()) {
+        sel->compute_specificity(css.get_priority());
+        return sel;
       }
+      return nullptr;
     }
 
     CSS::Properties * properties() {
-      CSS::Properties * props = css.properties_pool.newElement();
+      CSS::Properties * props = css.make<CSS::Properties>();
       CSS::Property   * property;
       while (token == Token::IDENT) {
         if (((property = declaration())) != nullptr) props->push_front(property);
@@ -985,18 +961,12 @@ class CSSParser
       return props;
     }
 
+    // The selectors and properties that are not kept stay in the arena up to
+    // the end of the CSS instance.
+
     bool add_rules(CSS::Selectors & sels, CSS::Properties * props) {
-      if (props->empty()) {
-        for (auto * sel : sels) {
-          for (auto * node : sel->selector_node_list) css.selector_node_pool.deleteElement(node);
-        }
-        css.properties_pool.deleteElement(props);
-        return false;
-      }
-      else {
-        for (auto * sel : sels) css.add_rule(sel, props);
-        css.suites.push_front(props);
-      }
+      if (props->empty()) return false;
+      for (auto * sel : sels) css.add_rule(sel, props);
       return true;
     }
     
@@ -1363,8 +1333,8 @@ class CSSParser
       CSS::Properties * props = properties();
 
       if (props != nullptr) {
-        CSS::Selector * sel = css.selector_pool.newElement();
-        CSS::SelectorNode * node = css.selector_node_pool.newElement();
+        CSS::Selector * sel = css.make<CSS::Selector>();
+        CSS::SelectorNode * node = css.make<CSS::SelectorNode>();
         node->set_tag(tag);
         sel->add_selector_node(node);
         sel->compute_specificity(css.get_priority());
@@ -12,7 +12,10 @@
 #include <sstream>
 #include <iterator>
 
-#include "memory_pool.hpp"
+#include "helpers/arena.hpp"
+
+// The DOM nodes are built in the arena of the page render. They are never
+// deleted one by one: the whole structure goes away with the arena.
 
 class DOM 
 {
@@ -38,19 +41,20 @@ class DOM
 
     struct Node;
 
-    typedef std::forward_list<std::string> ClassList;
-    typedef std::forward_list<Node *>      NodeList;
+    typedef std::forward_list<ArenaString, ArenaAllocator<ArenaString>> ClassList;
+    typedef std::forward_list<Node *,      ArenaAllocator<Node *>>      NodeList;
 
     struct Node {
       Node *      father;
       Node *      predecessor;
       NodeList    children;
       ClassList   class_list;
-      std::string id;
+      ArenaString id;
       Tag         tag;
       bool        first_child;
 
-      Node(Node * the_father, Tag the_tag) {
+      Node(Node * the_father, Tag the_tag, Arena & arena)
+        : children(arena), class_list(arena), id(arena) {
         father = the_father;
         tag    = the_tag;
         if (father != nullptr) {
@@ -61,17 +65,13 @@ class DOM
         else first_child = true;
       };
 
-      ~Node() {
-        for (auto * node : children) node_pool->deleteElement(node);
-        children.clear();
-      }
-
       Node * add_child(Tag the_tag) {
-        return node_pool->newElement(this, the_tag);
+        Arena & arena = children.get_allocator().get_arena();
+        return arena.make<Node>(this, the_tag, arena);
       }
 
-      Node * add_class(std::string the_class) {
-        class_list.push_front(the_class);
+      Node * add_class(const std::string & the_class) {
+        class_list.emplace_front(the_class.c_str(), class_list.get_allocator());
         return this;
       }
 
@@ -79,13 +79,13 @@ class DOM
         std::istringstream iss(the_classes);
         std::string item;
         while (std::getline(iss, item, ' ')) {
-          if (!item.empty()) class_list.push_front(item);
+          if (!item.empty()) add_class(item);
         }
         return this;
       }
 
       Node * add_id(const std::string & the_id) {
-        id = the_id;
+        id.assign(the_id.c_str());
         return this;
       }
 
@@ -118,13 +118,13 @@ class DOM
 
     Node * body;
 
-    DOM() {
-      if (node_pool == nullptr) node_pool = new MemoryPool<Node>;
-      body = node_pool->newElement(nullptr, Tag::BODY);
-    }
-
-    ~DOM() {
-      node_pool->deleteElement(body);
+    /**
+     * @brief Construct a new DOM
+     *
+     * @param item_arena The arena of the item being rendered, parent of the render arena
+     */
+    DOM(Arena & item_arena) : arena("render", &item_arena) {
+      body = arena.make<Node>(nullptr, Tag::BODY, arena);
     }
 
     void show() {
@@ -135,11 +135,14 @@ class DOM
       #endif
     }
 
-    static void delete_pool() {
-      delete node_pool;
-      node_pool = nullptr;
-    }
+    /**
+     * @brief The arena of the page render
+     *
+     * The formats and the style attributes CSS of the render are also allocated
+     * from it.
+     */
+    inline Arena & get_arena() { return arena; }
 
   private:
-    static MemoryPool<Node> * node_pool;
+    Arena arena;
 };
@@ -8,6 +8,7 @@
 #include "pugixml.hpp"
 
 #include "models/css.hpp"
+#include "helpers/arena.hpp"
 #include "models/book_params.hpp"
 #include "viewers/page.hpp"
 #include "models/image.hpp"
@@ -16,24 +17,42 @@
 #include <forward_list>
 #include <map>
 #include <mutex>
+#include <memory>
+#include <vector>
+#include <unordered_map>
 
 class EPub
 {
   public:
-    enum class       MediaType : uint8_t { XML, JPEG, PNG, GIF, BMP };
+    enum class       MediaType : uint8_t { XML, JPEG, PNG, GIF, BMP, NCX, OTHER };
     enum class ObfuscationType : uint8_t { NONE, ADOBE, IDPF, UNKNOWN };
-    typedef std::list<CSS *> CSSList;
+    typedef std::list<CSS *>                CSSList;
+    typedef std::shared_ptr<CSS>            CSSRef;
+    typedef std::vector<CSSRef>             CSSRefs;
+    typedef std::shared_ptr<const CSSRefs>  CSSCache;
     struct ItemInfo {
       std::string        file_path;
       int16_t            itemref_index;
       pugi::xml_document xml_doc;
       CSSList            css_cache;   ///< style attributes part of the current processed item are kept here. They will be destroyed when the item is no longer required.
-      CSSList            css_list;    ///< List of css sources for the current item file shown. Those are indexes inside css_cache.
+      CSSRefs            css_list;    ///< List of css sources for the current item file shown. They are shared with the book css cache and kept alive while the item uses them.
       CSS *              css;         ///< Ghost CSS created through merging css suites from css_list and css_cache.
       char *             data;
+      uint32_t           data_size;   ///< Accounted for in the memory budget
       MediaType          media_type;
+      mutable Arena      arena;       ///< Item scope, parent of the item CSS and page render arenas. Reset when the item is cleared.
+
+      ItemInfo() : itemref_index(-1), css(nullptr), data(nullptr), data_size(0), arena("item", &book_arena) {}
     };
 
+    /**
+     * @brief Book scope arena, parent of the items arenas and the e-book stylesheets arenas
+     *
+     * Static, for the item of the PageLocs instance to be one of its children,
+     * whatever the globals construction order.
+     */
+    static Arena book_arena;
+
     // This struct contains the current parameters that influence
     // the rendering of e-book pages. Its content is constructed from
     // both the e-book's specific parameters and default configuration options.
@@ -49,22 +68,62 @@ class EPub
     };
     #pragma pack(pop)
 
+    /**
+     * @brief Book metadata, as presented in the books list
+     */
+    struct Metadata {
+      std::string title;
+      std::string author;
+      std::string description;
+      std::string cover_filename;  ///< Cover image path inside the zip file, empty if none
+    };
+
     typedef uint8_t BinUUID[16];
     typedef uint8_t ShaUUID[20];
+
+    struct ManifestItem {
+      std::string href;         ///< As in the OPF file, relative to its folder
+      std::string properties;
+      MediaType   media_type;
+    };
+
+    /**
+     * @brief Index of the OPF package content
+     * 
+     * Built once when the book is opened: the manifest is hashed by id and
+     * the spine is a vector of manifest indexes, in reading order. It is
+     * saved in a sidecar file (.pkg) beside the book, such that reopening
+     * the book doesn't require the OPF file to be parsed. The sidecar is
+     * rebuilt when the OPF crc32 changes.
+     * 
+     * A published package is never modified, such that the pages location
+     * retriever can use it without any lock.
+     */
+    struct Package {
+      std::string unique_identifier;
+      std::string title;
+      std::string author;
+      std::string description;
+      std::string cover_filename;
+      std::vector<ManifestItem>                manifest;
+      std::vector<int16_t>                     spine;  ///< Manifest index of each itemref, -1 if not in the manifest
+      std::unordered_map<std::string, int16_t> ids;    ///< Manifest id -> manifest index
+      std::unordered_map<std::string, int16_t> hrefs;  ///< Manifest href -> first spine index referring to it
+    };
+    typedef std::shared_ptr<const Package> PackageSnapshot;
     
   private:
     static constexpr char const * TAG = "EPub";
 
     std::recursive_timed_mutex mutex;
 
-    pugi::xml_document opf;    ///< The OPF document description.
+    static constexpr int8_t PKG_FILE_VERSION = 1;
+
     pugi::xml_document encryption;
-    pugi::xml_node     current_itemref;
 
     BinUUID            bin_uuid;
     ShaUUID            sha_uuid;
 
-    char *             opf_data;
     char *             encryption_data;
     std::string        current_filename;
     std::string        opf_base_path;
@@ -73,21 +132,39 @@ class EPub
     BookParams       * book_params;
     BookFormatParams   book_format_params;
 
-    CSSList            css_cache;             ///< All css files in the ebook are maintained here.
+    CSSCache           css_cache;             ///< All css files in the ebook are maintained here. Only accessed through std::atomic_load/store.
+    PackageSnapshot    package;               ///< Only accessed through std::atomic_load/store.
+    std::mutex         css_mutex;             ///< Serializes the css cache and the fonts loaded from css changes
   
     bool               file_is_open;
     bool               encryption_present;
     bool               fonts_size_too_large;
     int32_t            fonts_size;
 
-    const char *             get_meta(const std::string    & name         );
-    bool                      get_opf(std::string          & filename     );
+    bool             retrieve_package(const std::string    & epub_filename,
+                                      const std::string    & opf_filename );
+    bool                build_package(const std::string    & opf_filename,
+                                      Package              & pkg          );
+    bool                 load_package(const std::string    & epub_filename,
+                                      uint32_t               opf_crc,
+                                      Package              & pkg          );
+    bool                 save_package(const std::string    & epub_filename,
+                                      uint32_t               opf_crc,
+                                      const Package        & pkg          );
     bool               check_mimetype();
     bool             get_opf_filename(std::string          & filename     );
     void      retrieve_fonts_from_css(CSS                  & css          );
     bool           get_encryption_xml();
+    bool                    load_item(const char           * href,
+                                      MediaType              media_type,
+                                      ItemInfo             & item         );
     void                         sha1(const std::string    & data         );
 
+    static const char *    find_cover(pugi::xml_node         package      );
+    static MediaType    media_type_of(const char           * media_type   );
+    static std::string         locate(const std::string    & base_path,
+                                      const char           * fname        );
+
   public:
     EPub();
    ~EPub();
@@ -95,6 +172,15 @@ class EPub
     void                 retrieve_css(ItemInfo             & item         );
     void                   load_fonts();
     void              clear_item_data(ItemInfo             & item         );
+
+    /**
+     * @brief Release the item shown by the book viewer
+     *
+     * Used as the memory budget shrinker of the items. The item is retrieved
+     * again when required.
+     */
+    void         release_current_item();
+
     void                  open_params(const std::string    & epub_filename);
     bool                    open_file(const std::string    & epub_filename);
     bool                   close_file();
@@ -102,8 +188,7 @@ class EPub
                                       bool                   load         );
     char*               retrieve_file(const char           * fname, 
                                       uint32_t             & size         );
-    bool                     get_item(pugi::xml_node         itemref, 
-                                      ItemInfo             & item         );
+    void                 release_file(char                 * data         );
     bool            get_item_at_index(int16_t                itemref_index);
     bool            get_item_at_index(int16_t                itemref_index,
                                       ItemInfo             & item         );
@@ -111,6 +196,9 @@ class EPub
     bool                     get_keys();
     std::string       filename_locate(const char           * fname        );
     int16_t            get_item_count();
+    int16_t         get_itemref_index(const std::string    & href         );
+    bool            get_manifest_item(const std::string    & id,
+                                      ManifestItem         & item         );
     void    update_book_format_params();
     ObfuscationType get_file_obfuscation(const char        * filename     );
     void                      decrypt(void                 * buffer, 
@@ -122,29 +210,64 @@ class EPub
     /**
      * @brief Retrieve cover's filename
      *
-     * Look inside the opf file to grab the cover filename. First search in the
-     * metadata. If not found, search in the manifest for an entry with type
-     * cover-image
+     * The cover filename is located when the package index is built. First
+     * search in the OPF metadata. If not found, search in the manifest for an
+     * entry with type cover-image
      *
      * @return char * filename, or nullptr if not found
      */
     const char* get_cover_filename();
 
-    inline const CSSList &                   get_css_cache() const { return css_cache;                       }
+    /**
+     * @brief Retrieve the OPF filename from a container.xml file content
+     *
+     * @param data The container.xml content. Modified by the XML parser.
+     * @param size Content size
+     * @param filename The OPF file path inside the zip file
+     * @return true The rootfile has been found
+     */
+    static bool get_rootfile(char * data, uint32_t size, std::string & filename);
+
+    /**
+     * @brief Retrieve the books list metadata from an OPF file content
+     *
+     * This is used when the book is not open through the EPub class, as
+     * when its content is received from the Web server.
+     *
+     * @param opf_data The OPF file content. Modified by the XML parser.
+     * @param size Content size
+     * @param opf_filename The OPF file path inside the zip file
+     * @param metadata The retrieved metadata
+     * @return true The OPF metadata has been found
+     */
+    static bool get_metadata(char * opf_data, uint32_t size, const std::string & opf_filename, Metadata & metadata);
+
+    /**
+     * @brief Delete the files kept beside a book
+     *
+     * The parameters, pages locations, table of content, search index, zip
+     * index, package and stylesheets files, as well as the cached items
+     * and the pages locations of other font sizes.
+     *
+     * @param epub_filename The book file path
+     */
+    static void remove_sidecars(const std::string & epub_filename);
+
+    inline CSSCache                          get_css_cache() const { return std::atomic_load(&css_cache);    }
     inline CSS *                      get_current_item_css() const { return current_item_info.css;           }
     inline const ItemInfo &          get_current_item_info() const { return current_item_info; }
     inline const std::string &  get_current_item_file_path() const { return current_item_info.file_path;     }
     inline int16_t                       get_itemref_index() const { return current_item_info.itemref_index; }
-    inline const char *                          get_title()       { return get_meta("dc:title");            }
-    inline const char *                         get_author()       { return get_meta("dc:creator");          }
-    inline const char *                    get_description()       { return get_meta("dc:description");      }
+    inline PackageSnapshot                     get_package() const { return std::atomic_load(&package);      }
+    inline const char *                          get_title()       { return file_is_open ? get_package()->title.c_str()       : nullptr; }
+    inline const char *                         get_author()       { return file_is_open ? get_package()->author.c_str()      : nullptr; }
+    inline const char *                    get_description()       { return file_is_open ? get_package()->description.c_str() : nullptr; }
     inline const pugi::xml_document &     get_current_item() const { return current_item_info.xml_doc;       }
     inline std::string                get_current_filename()       { return current_filename;                }
     inline bool                          filename_is_empty()       { return current_filename.empty();        }
     inline BookParams *                    get_book_params()       { return book_params;                     }
     inline BookFormatParams *       get_book_format_params()       { return &book_format_params;             }
     inline const std::string &           get_opf_base_path() const { return opf_base_path;                   }
-    inline const pugi::xml_document &              get_opf()       { return opf;                             }
     inline bool                      encryption_is_present() const { return encryption_present;              }
     inline const BinUUID &                    get_bin_uuid() const { return bin_uuid;                        }
   };
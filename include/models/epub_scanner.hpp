@@ -0,0 +1,46 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include "helpers/zip_stream_scanner.hpp"
+#include "models/epub.hpp"
+
+/**
+ * class EPubScanner - EPub metadata retrieval while the book is received
+ *
+ * Follows the container.xml file to the OPF file and retrieves the books
+ * list metadata from it, as the book content is streamed. The OPF file
+ * must follow container.xml in the zip file, as it is the case for books
+ * produced by the usual tools.
+ */
+
+class EPubScanner : public ZipStreamScanner
+{
+  private:
+    static constexpr char const * TAG            = "EPubScanner";
+    static constexpr char const * CONTAINER_FILE = "META-INF/container.xml";
+
+    std::string    opf_filename;
+    EPub::Metadata metadata;
+    bool           metadata_found;
+
+  protected:
+    bool      is_wanted(const std::string & filename);
+    void entry_received(const std::string & filename, char * data, uint32_t size);
+
+  public:
+    EPubScanner() : metadata_found(false) { }
+
+    bool begin();
+
+    /**
+     * @brief The book metadata have been retrieved and the zip file is complete
+     */
+    bool is_complete() const;
+
+    inline const EPub::Metadata &     get_metadata() const { return metadata;     }
+    inline const std::string &    get_opf_filename() const { return opf_filename; }
+};
@@ -10,9 +10,13 @@
 #include <unordered_map>
 #include <forward_list>
 #include <mutex>
+#include <string>
+#include <vector>
 
 class Font
 {
+  friend class PerfStats; ///< Memory pools usage report
+
   public:
     struct Glyph {
       Dim             dim;
@@ -22,6 +26,9 @@ class Font
       int16_t         line_height;
       int16_t         ligature_and_kern_pgm_index;
       unsigned char * buffer;
+      Font          * font;    ///< The font and the parameters used to get this glyph
+      uint32_t        code;
+      int16_t         size;
       void clear() {
         dim.height = dim.width = 0;
         xoff = yoff = 0;
@@ -31,6 +38,12 @@ class Font
       }
     };
     
+    struct WordGlyph {
+      Glyph * glyph;
+      int16_t kern;     ///< Glyph advance, kerning with the next glyph included
+    };
+    typedef std::vector<WordGlyph> WordGlyphs;
+
   private:
     static constexpr char const * TAG = "Font";
 
@@ -64,7 +77,47 @@ class Font
                               int16_t & kern,  
                               bool    & ignore_next);
 
-    void clear_cache();
+    /**
+     * @brief Get a glyph object from its font specific code
+     * 
+     * The code is the one kept in the glyph itself: no character translation
+     * is done. Used to rebuild a display list from its serialized form.
+     * 
+     * @param code Glyph code, as found in Glyph::code.
+     * @return Glyph The glyph, or nullptr if the font can't supply it.
+     */
+    Glyph * get_glyph_from_code(uint32_t code, int16_t glyph_size);
+
+    /**
+     * @brief Get the glyphs of a word from the words cache
+     * 
+     * Natural language text repeats a small vocabulary: the glyphs of a word,
+     * ligatures and kerning applied, are kept with the word in a cache per
+     * glyph size. The font mutex is taken once for the whole word.
+     * 
+     * @param key The word bytes, preceded by the text transform applied to them.
+     * @param glyph_size The glyph size.
+     * @param glyphs The word glyphs (out).
+     * @param width The word width (out).
+     * @return true The word was found in the cache.
+     */
+    bool get_word(const std::string & key, int16_t glyph_size, WordGlyphs & glyphs, int16_t & width);
+
+    /**
+     * @brief Add a word to the words cache
+     * 
+     * @param key The word bytes, preceded by the text transform applied to them.
+     * @param codes The word characters as unicode numbers, text transform applied.
+     * @param glyph_size The glyph size.
+     * @param glyphs The word glyphs (out).
+     * @return int16_t The word width.
+     */
+    int16_t add_word(const std::string           & key, 
+                     const std::vector<uint32_t> & codes, 
+                     int16_t                       glyph_size, 
+                     WordGlyphs                  & glyphs);
+
+    virtual void clear_cache();
 
     void get_size(const char * str, Dim * dim, int16_t glyph_size);
 
@@ -104,7 +157,17 @@ protected:
     typedef uint8_t                              BytePool[BYTE_POOL_SIZE];
     typedef std::forward_list<BytePool *>        BytePools;
     
+    static constexpr uint16_t WORDS_CACHE_SIZE = 2000; ///< Words kept for a size before they are cleared
+
+    struct Word {
+      WordGlyphs glyphs;
+      int16_t    width;
+    };
+    typedef std::unordered_map<std::string, Word> Words;
+    typedef std::unordered_map<int16_t, Words>    WordsCache;
+
     GlyphsCache        cache;
+    WordsCache         words_cache;
     int16_t            fonts_cache_index;
     int8_t             current_font_size;
     bool               ready;
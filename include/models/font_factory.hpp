@@ -8,17 +8,38 @@
 #include "models/font.hpp"
 #include "models/ttf2.hpp"
 #include "models/ibmf.hpp"
+#include "models/bfnt.hpp"
+#include "screen.hpp"
+
+#include <sys/stat.h>
 
 class FontFactory {
 
   public:
+    /**
+     * @brief Create a font from a file
+     * 
+     * A TrueType/OpenType font precompiled for the screen resolution (a .bfnt
+     * file beside it, see the FontCompiler tool) is used instead of the font
+     * itself, FreeType being then required only for the sizes not precompiled.
+     */
     static Font * 
     create(const std::string & filename) {
       std::string ext = filename.substr(filename.find_last_of(".") + 1);
 
       if (ext == "ibmf") return new IBMF(filename);
       else if ((ext == "ttf") || 
-               (ext == "otf")) return new TTF(filename);
+               (ext == "otf")) {
+        std::string bfnt_filename = BFNT::get_filename(filename, Screen::RESOLUTION);
+        struct stat file_stat;
+
+        if (stat(bfnt_filename.c_str(), &file_stat) != -1) {
+          BFNT * font = new BFNT(bfnt_filename, filename);
+          if (font->is_ready()) return font;
+          delete font;
+        }
+        return new TTF(filename);
+      }
 
       return nullptr;
     }
@@ -10,9 +10,12 @@
 
 #include <vector>
 #include <mutex>
+#include <memory>
 
 class Fonts
 {
+  friend class PerfStats; ///< Memory pools usage report
+
   private:
     static constexpr char const * TAG = "Fonts";
 
@@ -20,14 +23,36 @@ class Fonts
     Fonts();
    ~Fonts();
     
-    bool setup();
+    /**
+     * @brief Load the system fonts and the default font
+     * 
+     * @param font_index The user font to load as the default one. If -1, the
+     *                   configured default font is used. When resuming from deep
+     *                   sleep, this is the font of the book being read, such that
+     *                   it doesn't have to be replaced when the book is opened.
+     * @return true The fonts have been loaded
+     */
+    bool setup(int8_t font_index = -1);
 
     enum class FaceStyle : uint8_t { NORMAL = 0, BOLD, ITALIC, BOLD_ITALIC };
     struct FontEntry {
-      std::string name;
-      Font *      font;
-      FaceStyle   style;
+      std::string           name;
+      std::shared_ptr<Font> font;
+      FaceStyle             style;
     };
+    typedef std::vector<FontEntry>           FontCache;
+    typedef std::shared_ptr<const FontCache> Snapshot;
+
+    /**
+     * @brief Get the list of fonts currently loaded
+     * 
+     * A published list is never modified: adding, replacing or removing fonts
+     * publishes a new one. Holding a snapshot keeps its fonts alive, such that
+     * the pages location retriever uses them without taking any lock.
+     * 
+     * @return Snapshot The current fonts list.
+     */
+    inline Snapshot get_snapshot() const { return std::atomic_load(&font_cache); }
 
     /**
      * @brief Clear fonts loaded from a book
@@ -47,13 +72,14 @@ class Fonts
      *         it returns the pointer to the first font in the list.
      */
     Font * get(int16_t index) {
-      Font * f; 
-      if (index >= font_cache.size()) {
-        LOG_E("Fonts.get(): Wrong index: %d vs size: %u", index, font_cache.size());
-        f = font_cache.at(1).font;
+      Snapshot cache = get_snapshot();
+      Font *   f; 
+      if (index >= cache->size()) {
+        LOG_E("Fonts.get(): Wrong index: %d vs size: %u", index, cache->size());
+        f = cache->at(1).font.get();
       }
       else {
-        f = font_cache.at(index).font;
+        f = cache->at(index).font.get();
       }
       return f;
     };
@@ -68,6 +94,16 @@ class Fonts
      */
     int16_t get_index(const std::string & name, FaceStyle style);
 
+    /**
+     * @brief Get the name and style of a loaded font
+     * 
+     * @param font The font
+     * @param name Font name
+     * @param style Font style (bold, italic, normal)
+     * @return true The font is in the list
+     */
+    bool get_name_and_style(const Font * font, std::string & name, FaceStyle & style);
+
     /**
      * @brief Get Font name
      * 
@@ -77,12 +113,13 @@ class Fonts
      *         at index, returns the name of the first in the list.
      */
     const char * get_name(int16_t index) const {
-      if (index >= font_cache.size()) {
-        LOG_E("Fonts.get(): Wrong index: %d vs size: %u", index, font_cache.size());
-        return font_cache[1].name.c_str(); 
+      Snapshot cache = get_snapshot();
+      if (index >= cache->size()) {
+        LOG_E("Fonts.get(): Wrong index: %d vs size: %u", index, cache->size());
+        return (*cache)[1].name.c_str(); 
       }
       else {
-        return font_cache[index].name.c_str(); 
+        return (*cache)[index].name.c_str(); 
       }
     };
     
@@ -118,7 +155,7 @@ class Fonts
     FaceStyle adjust_font_style(FaceStyle style, FaceStyle font_style, FaceStyle font_weight) const;
 
     void check(int16_t index, FaceStyle style) const {
-      if (font_cache[index].style != style) {
+      if ((*get_snapshot())[index].style != style) {
         LOG_E("Hum... font_check failed");
       } 
     };
@@ -132,9 +169,12 @@ class Fonts
                  FaceStyle           style,
                  const std::string & filename);
   private:
-    typedef std::vector<FontEntry> FontCache;
-    FontCache font_cache;
-    std::mutex mutex;
+    Snapshot   font_cache;  ///< Only accessed through std::atomic_load/store
+    std::mutex mutex;       ///< Serializes the fonts list changes
+
+    inline void publish(FontCache && cache) {
+      std::atomic_store(&font_cache, Snapshot(std::make_shared<const FontCache>(std::move(cache))));
+    }
 
     uint8_t       font_count;
     char *        font_names[8];
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <memory>
+#include <vector>
 
 #include "global.hpp"
 #include "models/font.hpp"
@@ -484,6 +487,78 @@ static constexpr uint16_t set2_translation_latin_A[] = {
   /* 0x17F */ 0xFFFF   // ſ   ???
 };
 
+// Direct index from the Unicode characters U+0000 to U+017F (Basic Latin,
+// Latin-1 Supplement and Latin Extended-A) to their glyph code for the
+// char set 0: the main glyph in the least significant byte, the accent in
+// the next one (0xFF if none). Characters without glyph are mapped to
+// 0xFFFE, drawn as a space.
+
+static constexpr uint16_t IBMF_LATIN_INDEX_SIZE = 0x180;
+
+struct IBMFLatinIndex {
+  uint16_t glyph_codes[IBMF_LATIN_INDEX_SIZE];
+};
+
+static constexpr IBMFLatinIndex
+make_ibmf_latin_index()
+{
+  IBMFLatinIndex index{};
+
+  for (uint16_t code = 0; code < IBMF_LATIN_INDEX_SIZE; code++) {
+    uint16_t glyph_code = 0xFFFE;
+
+    if ((code > 0x20) && (code < 0x7F)) {
+      glyph_code = 0xFF00 | code;
+    }
+    else if ((code >= 0xA1) && (code <= 0xFF)) {
+      glyph_code = set2_translation_latin_1[code - 0xA1];
+    }
+    else if (code >= 0x100) {
+      glyph_code = set2_translation_latin_A[code - 0x100];
+    }
+
+    index.glyph_codes[code] = ((glyph_code & 0xFF) == 0xFF) ? 0xFFFE : glyph_code;
+  }
+
+  return index;
+}
+
+static constexpr IBMFLatinIndex ibmf_latin_index = make_ibmf_latin_index();
+
+// Decoding of the first nybble of a PK run count, for each dyn_f value
+// (0 to 13): the count itself (1 to dyn_f), the base of a count completed
+// by the next nybble (PK_RUN_TWO_NYBBLES), a large count (nybble 0), a
+// repeat count (14) or a row repeated once (15).
+
+static constexpr uint16_t PK_RUN_TWO_NYBBLES = 0x1000;
+static constexpr uint16_t PK_RUN_LARGE       = 0x2000;
+static constexpr uint16_t PK_RUN_REPEAT      = 0x4000;
+static constexpr uint16_t PK_RUN_REPEAT_ONCE = 0x8000;
+
+struct PKRunTable {
+  uint16_t entries[14][16];
+};
+
+static constexpr PKRunTable
+make_pk_run_table()
+{
+  PKRunTable table{};
+
+  for (uint16_t dyn_f = 0; dyn_f < 14; dyn_f++) {
+    for (uint16_t nyb = 0; nyb < 16; nyb++) {
+      table.entries[dyn_f][nyb] =
+        (nyb ==     0) ? PK_RUN_LARGE :
+        (nyb <= dyn_f) ? nyb :
+        (nyb <     14) ? (PK_RUN_TWO_NYBBLES | (((nyb - dyn_f - 1) << 4) + dyn_f + 1)) :
+        (nyb ==    14) ? PK_RUN_REPEAT : PK_RUN_REPEAT_ONCE;
+    }
+  }
+
+  return table;
+}
+
+static constexpr PKRunTable pk_run_table = make_pk_run_table();
+
 /**
  * @brief Access to a IBMF font.
  * 
@@ -589,41 +664,45 @@ class IBMFFont
     uint8_t     * current_font;
     uint8_t       current_point_size;
 
+    // The tables of a font size, built when the size is first used
+
+    struct FaceSize {
+      Header      * header;
+      LigKernStep * lig_kern_pgm;
+      FIX16       * kerns;
+      GlyphInfo   * glyph_info_table[MAX_GLYPH_COUNT];
+    };
+
+    std::vector<std::unique_ptr<FaceSize>> face_sizes;
+
     Header      * header;
-    GlyphInfo   * glyph_info_table[MAX_GLYPH_COUNT];
+    GlyphInfo  ** glyph_info_table;
     LigKernStep * lig_kern_pgm;
     FIX16       * kerns;
 
-    static constexpr uint8_t PK_REPEAT_COUNT =   14;
-    static constexpr uint8_t PK_REPEAT_ONCE  =   15;
+    static constexpr uint8_t PK_BITMAP = 14;  // dyn_f value of glyphs kept as a bitmap
 
     GlyphInfo * glyph_info;
     Font::Glyph glyph;
 
     Font  & font;
 
-    bool
-    getnext8(uint8_t & val)
-    {
-      if (memory_ptr >= memory_end) return false;  
-      val = *memory_ptr++;
-      return true;
-    }
-
-    uint8_t nybble_flipper = 0xf0U;
-    uint8_t nybble_byte;
+    const uint8_t      * pk_ptr;
+    const uint8_t      * pk_end;
+    bool                 pk_low_nybble;
+    std::vector<uint8_t> row_buffer;
 
     bool
     get_nybble(uint8_t & nyb)
     {
-      if (nybble_flipper == 0xf0U) {
-        if (!getnext8(nybble_byte)) return false;
-        nyb = nybble_byte >> 4;
+      if (pk_low_nybble) {
+        nyb = *pk_ptr++ & 0x0F;
       }
       else {
-        nyb = (nybble_byte & 0x0f);
+        if (pk_ptr >= pk_end) return false;
+        nyb = *pk_ptr >> 4;
       }
-      nybble_flipper ^= 0xffU;
+      pk_low_nybble = !pk_low_nybble;
       return true;
     }
 
@@ -659,17 +738,26 @@ class IBMFFont
     // end;
 
     bool
-    get_packed_number(uint32_t & val, const GlyphInfo & glyph)
+    get_packed_number(uint32_t & val, uint8_t dyn_f)
     {
-      uint8_t  nyb;
-      uint32_t i, j;
-
-      uint8_t dyn_f = glyph.glyph_metric.dyn_f;
+      uint8_t nyb;
 
       while (true) {
-        if (!get_nybble(nyb)) return false; 
-        i = nyb;
-        if (i == 0) {
+        if (!get_nybble(nyb)) return false;
+
+        uint16_t entry = pk_run_table.entries[dyn_f][nyb];
+
+        if (entry < PK_RUN_TWO_NYBBLES) {
+          val = entry;
+          return true;
+        }
+        else if (entry & PK_RUN_TWO_NYBBLES) {
+          if (!get_nybble(nyb)) return false;
+          val = (entry & ~PK_RUN_TWO_NYBBLES) + nyb;
+          return true;
+        }
+        else if (entry == PK_RUN_LARGE) {
+          uint32_t i = 0, j;
           do {
             if (!get_nybble(nyb)) return false;
             i++;
@@ -680,187 +768,118 @@ class IBMFFont
             j = (j << 4) + nyb;
           }
           val = j - 15 + ((13 - dyn_f) << 4) + dyn_f;
-          break;
-        }
-        else if (i <= dyn_f) {
-          val = i;
-          break;
+          return true;
         }
-        else if (i < PK_REPEAT_COUNT) {
-          if (!get_nybble(nyb)) return false;
-          val = ((i - dyn_f - 1) << 4) + nyb + dyn_f + 1;
-          break;
+        else if (entry == PK_RUN_REPEAT) {
+          if (!get_packed_number(repeat_count, dyn_f)) return false;
         }
-        else { 
-          // if (repeat_count != 0) {
-          //   std::cerr << "Spurious repeat_count iteration!" << std::endl;
-          //   return false;
-          // }
-          if (i == PK_REPEAT_COUNT) {
-            if (!get_packed_number(repeat_count, glyph)) return false;
-          }
-          else { // i == PK_REPEAT_ONCE
-            repeat_count = 1;
-          }
+        else { // PK_RUN_REPEAT_ONCE
+          repeat_count = 1;
         }
       }
-      return true;
     }
 
+    // Black pixels of a run, from column col of a row
+
+    static void
+    set_run(uint8_t * row, uint32_t col, uint32_t count, bool one_bit)
+    {
+      if (!one_bit) {
+        memset(row + col, 0xFF, count);
+        return;
+      }
+
+      uint32_t  last       = col + count - 1;
+      uint8_t * p          = row + (col >> 3);
+      uint8_t   first_mask = 0xFFU >> (col  & 7);
+      uint8_t   last_mask  = 0xFFU << (7 - (last & 7));
+
+      if ((col >> 3) == (last >> 3)) {
+        *p |= first_mask & last_mask;
+      }
+      else {
+        uint32_t bytes = (last >> 3) - (col >> 3) - 1;
+        *p++ |= first_mask;
+        memset(p, 0xFF, bytes);
+        p[bytes] |= last_mask;
+      }
+    }
+
+    // Each row is decoded in row_buffer, one run at a time, then added to the
+    // bitmap (the main glyph of a composed one is drawn over its accent) as many
+    // times as the row is repeated.
+
     bool
     retrieve_bitmap(GlyphInfo * glyph_info, uint8_t * bitmap, Dim dim, Pos offsets)
     {
+      bool     one_bit  = screen.get_pixel_resolution() == Screen::PixelResolution::ONE_BIT;
+      uint32_t row_size = one_bit ? ((dim.width + 7) >> 3) : dim.width;
+      uint32_t width    = glyph_info->bitmap_width;
+      uint32_t height   = glyph_info->bitmap_height;
+      uint8_t  dyn_f    = glyph_info->glyph_metric.dyn_f;
+
+      if (((offsets.x + width) > dim.width) || ((offsets.y + height) > dim.height)) {
+        std::cerr << "Glyph outside of its bitmap!" << std::endl;
+        return false;
+      }
+
       // point on the glyphs' bitmap definition
-      memory_ptr = ((uint8_t *)glyph_info) + sizeof(GlyphInfo);
-      uint8_t * rowp;
-
-      if (screen.get_pixel_resolution() == Screen::PixelResolution::ONE_BIT) {
-        uint32_t  row_size = (dim.width + 7) >> 3;
-        rowp = bitmap + (offsets.y * row_size);
-
-        if (glyph_info->glyph_metric.dyn_f == 14) {  // is a bitmap?
-          uint32_t  count = 8;
-          uint8_t   data;
-
-          for (uint32_t row = 0; 
-               row < glyph_info->bitmap_height; 
-               row++, rowp += row_size) {
-            for (uint32_t col = offsets.x; 
-                 col < glyph_info->bitmap_width + offsets.x; 
-                 col++) {
-              if (count >= 8) {
-                if (!getnext8(data)) {
-                  std::cerr << "Not enough bitmap data!" << std::endl;
-                  return false;
-                }
-                // std::cout << std::hex << +data << ' ';
-                count = 0;
-              }
-              if (data & (0x80U >> count)) rowp[col >> 3] |= (0x80U >> (col & 7));
-              count++;
-            }
-          }
-          // std::cout << std::endl;
-        }
-        else {
-          uint32_t count = 0;
-
-          repeat_count   = 0;
-          nybble_flipper = 0xf0U;
-
-          bool black = !(glyph_info->glyph_metric.first_is_black == 1);
-
-          for (uint32_t row = 0; 
-               row < glyph_info->bitmap_height; 
-               row++, rowp += row_size) {
-            for (uint32_t col = offsets.x; 
-                 col < glyph_info->bitmap_width + offsets.x; 
-                 col++) {
-              if (count == 0) {
-                if (!get_packed_number(count, *glyph_info)) {
-                  return false;
-                }
-                black = !black;
-                // if (black) {
-                //   std::cout << count << ' ';
-                // }
-                // else {
-                //   std::cout << '(' << count << ')' << ' ';
-                // }
-              }
-              if (black) rowp[col >> 3] |= (0x80U >> (col & 0x07));
-              count--;
-            }
+      pk_ptr        = ((uint8_t *)glyph_info) + sizeof(GlyphInfo);
+      pk_end        = pk_ptr + glyph_info->packet_length;
+      pk_low_nybble = false;
+      repeat_count  = 0;
 
-            // if (repeat_count != 0) std::cout << "Repeat count: " << repeat_count << std::endl;
-            while ((row < glyph_info->bitmap_height) && (repeat_count-- > 0)) {
-              bcopy(rowp, 
-                    rowp + row_size, 
-                    row_size);
-              row++;
-              rowp += row_size;
-            }
+      if ((pk_end > memory_end) || (dyn_f > PK_BITMAP)) return false;
 
-            repeat_count = 0;
-          }
-          // std::cout << std::endl;
-        }
-      }
-      else {
-        uint32_t  row_size = dim.width;
-        rowp = bitmap + (offsets.y * row_size);
-
-        repeat_count   = 0;
-        nybble_flipper = 0xf0U;
-
-        if (glyph_info->glyph_metric.dyn_f == 14) {  // is a bitmap?
-          uint32_t  count = 8;
-          uint8_t   data;
-
-          for (uint32_t row = 0; 
-               row < (glyph_info->bitmap_height); 
-               row++, rowp += row_size) {
-            for (uint32_t col = offsets.x; 
-                 col < (glyph_info->bitmap_width + offsets.x); 
-                 col++) {
-              if (count >= 8) {
-                if (!getnext8(data)) {
-                  std::cerr << "Not enough bitmap data!" << std::endl;
-                  return false;
-                }
-                // std::cout << std::hex << +data << ' ';
-                count = 0;
+      uint32_t first = one_bit ? (offsets.x >> 3)            : offsets.x;
+      uint32_t last  = one_bit ? ((offsets.x + width + 7) >> 3) : (offsets.x + width);
+
+      row_buffer.resize(row_size);
+
+      uint8_t * rowp  = bitmap + (offsets.y * row_size);
+      uint32_t  count = 0;
+      bool      black = !(glyph_info->glyph_metric.first_is_black == 1);
+      uint8_t   data  = 0;
+      uint8_t   bit   = 0;
+
+      for (uint32_t row = 0; row < height; ) {
+        memset(&row_buffer[first], 0, last - first);
+
+        if (dyn_f == PK_BITMAP) {
+          for (uint32_t col = 0; col < width; col++, bit = (bit + 1) & 7) {
+            if (bit == 0) {
+              if (pk_ptr >= pk_end) {
+                std::cerr << "Not enough bitmap data!" << std::endl;
+                return false;
               }
-              rowp[col] = (data & (0x80U >> count)) ? 0xFF : 0;
-              count++;
+              data = *pk_ptr++;
             }
+            if (data & (0x80U >> bit)) set_run(row_buffer.data(), offsets.x + col, 1, one_bit);
           }
-          // std::cout << std::endl;
         }
         else {
-          uint32_t count = 0;
-
-          repeat_count   = 0;
-          nybble_flipper = 0xf0U;
-
-          bool black = !(glyph_info->glyph_metric.first_is_black == 1);
-
-          for (uint32_t row = 0; 
-               row < (glyph_info->bitmap_height); 
-               row++, rowp += row_size) {
-            for (uint32_t col = offsets.x; 
-                 col < (glyph_info->bitmap_width + offsets.x); 
-                 col++) {
-              if (count == 0) {
-                if (!get_packed_number(count, *glyph_info)) {
-                  return false;
-                }
-                black = !black;
-                // if (black) {
-                //   std::cout << count << ' ';
-                // }
-                // else {
-                //   std::cout << '(' << count << ')' << ' ';
-                // }
-              }
-              if (black) rowp[col] = 0xFF;
-              count--;
+          for (uint32_t col = 0; col < width; ) {
+            if (count == 0) {
+              if (!get_packed_number(count, dyn_f)) return false;
+              black = !black;
+              continue;
             }
-
-            // if (repeat_count != 0) std::cout << "Repeat count: " << repeat_count << std::endl;
-            while ((row < dim.height) && (repeat_count-- > 0)) {
-              bcopy(rowp, 
-                    rowp + row_size, 
-                    row_size);
-              row++;
-              rowp += row_size;
-            }
-
-            repeat_count = 0;
+            uint32_t run = std::min(count, width - col);
+            if (black) set_run(row_buffer.data(), offsets.x + col, run, one_bit);
+            col   += run;
+            count -= run;
           }
-          // std::cout << std::endl;
         }
+
+        for (uint32_t copies = repeat_count + 1;
+             (copies > 0) && (row < height);
+             copies--, row++, rowp += row_size) {
+          for (uint32_t i = first; i < last; i++) rowp[i] |= row_buffer[i];
+        }
+
+        repeat_count = 0;
       }
+
       return true;
     }
 
@@ -872,35 +891,35 @@ class IBMFFont
       if (preamble->bits.version != IBMF_VERSION) return false;
       sizes = (uint8_t *) &memory[6 + (preamble->size_count * 4)];
       current_font = nullptr;
+      header       = nullptr;
+      face_sizes.resize(preamble->size_count);
 
       return true;
     }
 
     bool
-    load_data()
+    load_data(FaceSize & face_size)
     {
-      //for (uint8_t i = 0; i < MAX_GLYPH_COUNT; i++) glyph_data_table[i] = nullptr;
-      memset(glyph_info_table, 0, sizeof(glyph_info_table));
-
       memory_ptr = current_font;
 
-      header = (Header *) current_font;
+      face_size.header = (Header *) current_font;
 
       memory_ptr += sizeof(Header);
-      for (int i = 0; i < header->glyph_count; i++) {
+      for (int i = 0; i < face_size.header->glyph_count; i++) {
         glyph_info = (GlyphInfo *) memory_ptr;
-        glyph_info_table[glyph_info->char_code] = (GlyphInfo *) memory_ptr;
+        if (glyph_info->char_code >= MAX_GLYPH_COUNT) return false;
+        face_size.glyph_info_table[glyph_info->char_code] = (GlyphInfo *) memory_ptr;
         memory_ptr += sizeof(GlyphInfo) + glyph_info->packet_length;
         if (memory_ptr > memory_end) return false;
       }
 
-      lig_kern_pgm = (LigKernStep *) memory_ptr;
-      memory_ptr += sizeof(LigKernStep) * header->lig_kern_pgm_count;
+      face_size.lig_kern_pgm = (LigKernStep *) memory_ptr;
+      memory_ptr += sizeof(LigKernStep) * face_size.header->lig_kern_pgm_count;
       if (memory_ptr > memory_end) return false;
 
-      kerns = (FIX16 *) memory_ptr;
+      face_size.kerns = (FIX16 *) memory_ptr;
 
-      memory_ptr += sizeof(FIX16) * header->kern_count;
+      memory_ptr += sizeof(FIX16) * face_size.header->kern_count;
       if (memory_ptr > memory_end) return false;
 
       return true;
@@ -961,7 +980,8 @@ class IBMFFont
     inline int16_t                 get_descender_height() { return -(int16_t)header->descender_height; }
     inline LigKernStep        * get_lig_kern(uint8_t idx) { return &lig_kern_pgm[idx];                 }
     inline FIX16                      get_kern(uint8_t i) { return kerns[i];                           }
-    inline GlyphInfo * get_glyph_info(uint8_t glyph_code) { return glyph_info_table[glyph_code];       }
+    inline GlyphInfo * get_glyph_info(uint8_t glyph_code) { return (glyph_code < MAX_GLYPH_COUNT) ?
+                                                                    glyph_info_table[glyph_code] : nullptr; }
     inline uint8_t                         get_char_set() { return preamble->bits.char_set;            }
 
     /**
@@ -972,6 +992,8 @@ class IBMFFont
      * used to draw a single bitmap. This method translate some of the supported
      * unicode values to that combination. The least significant byte will contains 
      * the main glyph code and the next byte will contain the accent code. 
+     * Characters up to U+017F are taken from a direct index, the composed
+     * glyphs being kept in the glyphs cache of the font once drawn.
      * 
      * @param charcode The character code in unicode
      * @return The internal representation of a character
@@ -981,14 +1003,8 @@ class IBMFFont
       uint32_t glyph_code;
 
       if (preamble->bits.char_set == 0) {
-        if ((charcode > 0x20) && (charcode < 0x7F)) {
-          glyph_code = 0xFF00 | charcode;
-        }
-        else if ((charcode >= 0xA1) && (charcode <= 0xFF)) {
-          glyph_code = set2_translation_latin_1[charcode - 0xA1];
-        }
-        else if ((charcode >= 0x100) && (charcode <= 0x1FF)) {
-          glyph_code = set2_translation_latin_A[charcode - 0x100];
+        if (charcode < IBMF_LATIN_INDEX_SIZE) {
+          glyph_code = ibmf_latin_index.glyph_codes[charcode];
         }
         else {
           switch (charcode) {
@@ -1072,21 +1088,32 @@ class IBMFFont
         }
         else {
           // Horizontal adjustment
+          int16_t accent_x;
+
           if (glyph_code == 0x0C41) { // Ą 
-            offsets.x = glyph_info->bitmap_width - accent_info->bitmap_width;
+            accent_x = glyph_info->bitmap_width - accent_info->bitmap_width;
           }
           else if ((glyph_code == 0x0C61) || (glyph_code == 0x0C45)) { // ą or Ę
-            offsets.x = glyph_info->bitmap_width - accent_info->bitmap_width - ((((int32_t)glyph_info->bitmap_height) * header->slant_correction) >> 6);
+            accent_x = glyph_info->bitmap_width - accent_info->bitmap_width - ((((int32_t)glyph_info->bitmap_height) * header->slant_correction) >> 6);
           }
           else {
-            offsets.x = ((glyph_info->bitmap_width > accent_info->bitmap_width) ?
+            accent_x = ((glyph_info->bitmap_width > accent_info->bitmap_width) ?
                             ((glyph_info->bitmap_width - accent_info->bitmap_width) >> 1) : 0)
                         + ((accent_info->vertical_offset < 5) ? 
                              - (((header->x_height >> 6) * header->slant_correction) >> 6) :
                             ((((int32_t)glyph_info->bitmap_height) * header->slant_correction) >> 6))
                         /*- (accent_info->horizontal_offset - glyph_info->horizontal_offset)*/;
           }
-          if ((offsets.x == 0) && (glyph_info->bitmap_width < accent_info->bitmap_width))  {
+
+          // With slanted fonts, an accent below the main glyph may start at its left
+          if (accent_x < 0) {
+            added_left = -accent_x;
+            dim.width += added_left;
+            accent_x   = 0;
+          }
+          offsets.x = accent_x;
+
+          if ((offsets.x == 0) && (added_left == 0) && (glyph_info->bitmap_width < accent_info->bitmap_width))  {
             added_left = (accent_info->bitmap_width - glyph_info->bitmap_width) >> 1;
             dim.width = accent_info->bitmap_width;
           }
@@ -1155,9 +1182,23 @@ class IBMFFont
       uint8_t i = 0;
       while ((i < preamble->size_count) && (sizes[i] <= size)) i++;
       if (i > 0) i--;
-      current_font = memory + preamble->font_offsets[i];
+
+      if (face_sizes[i] == nullptr) {
+        std::unique_ptr<FaceSize> face_size = std::make_unique<FaceSize>();
+        current_font = memory + preamble->font_offsets[i];
+        if (!load_data(*face_size)) return false;
+        face_sizes[i] = std::move(face_size);
+      }
+
+      FaceSize & face_size = *face_sizes[i];
+
       current_point_size = sizes[i];
-      return load_data();
+      header             = face_size.header;
+      glyph_info_table   = face_size.glyph_info_table;
+      lig_kern_pgm       = face_size.lig_kern_pgm;
+      kerns              = face_size.kerns;
+
+      return true;
     }
 
     bool
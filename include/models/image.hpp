@@ -5,6 +5,8 @@
 #pragma once
 #include "global.hpp"
 
+#include "helpers/memory_budget.hpp"
+
 // Class Image
 //
 // This is a virtual class. It allows for the retrieval of
@@ -41,7 +43,8 @@ class Image
 
     inline void free_bitmap() { 
       if (image_data.bitmap != nullptr) {
-        free(image_data.bitmap); 
+        memory_budget.release(MemoryBudget::Consumer::IMAGES, image_data.bitmap,
+                              image_data.dim.width * image_data.dim.height);
         image_data.bitmap = nullptr;
       }
     }
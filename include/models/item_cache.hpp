@@ -0,0 +1,150 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include <cinttypes>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * class ItemCache - Decompressed items spill cache
+ *
+ * When enabled through the configuration, the items retrieved from an e-book
+ * (XHTML, CSS, NCX) are kept decompressed in a cache folder dedicated to the
+ * book, the first time they are inflated. Subsequent retrievals are done
+ * through a single large sequential read (memory-mapped on Linux).
+ *
+ * Every cached item is validated against the size and CRC-32 found in the
+ * zip central directory. The cache size of a book is limited, the least
+ * recently used items being removed first.
+ */
+
+class ItemCache
+{
+  private:
+    static constexpr char const * TAG = "ItemCache";
+
+    static constexpr int8_t   INDEX_FILE_VERSION = 1;
+    static constexpr uint32_t MIN_ITEM_SIZE      = 4 * 1024; ///< Smaller items are inflated faster than a file can be opened
+    #if EPUB_LINUX_BUILD
+      static constexpr uint32_t MAX_CACHE_SIZE   = 32 * 1024 * 1024;
+    #else
+      static constexpr uint32_t MAX_CACHE_SIZE   =  8 * 1024 * 1024;
+    #endif
+
+    #pragma pack(push, 1)
+      struct ItemHeader {
+        uint32_t size;          ///< Decompressed item size
+        uint32_t crc;         ///< As found in the zip central directory
+        uint16_t name_length;   ///< Item filename follows the header
+      };
+
+      struct IndexRecord {
+        uint32_t key;
+        uint32_t size;          ///< Cache file size
+      };
+    #pragma pack(pop)
+
+    typedef std::list<IndexRecord> Entries;  ///< Most recently used first
+
+    std::mutex  mutex;
+    std::string folder;
+    Entries     entries;
+    uint32_t    total_size;
+    bool        enabled;
+    bool        modified;
+
+    #if EPUB_LINUX_BUILD
+      struct Mapping {
+        void   * addr;
+        size_t   length;
+      };
+      typedef std::map<char *, Mapping> Mappings;
+      Mappings mappings;
+    #endif
+
+    static uint32_t                 hash(const std::string & str);
+    static void             clear_folder(const std::string & path);
+
+    inline std::string get_item_filename(uint32_t key) {
+      char name[16];
+      snprintf(name, 16, "/%08" PRIx32 ".itm", key);
+      return folder + name;
+    }
+
+    Entries::iterator find(uint32_t key);
+    bool        load_index();
+    bool        save_index();
+    void              drop(Entries::iterator it);
+    bool       check_entry(const std::string & filename, uint32_t & size, uint32_t & crc);
+
+  public:
+    ItemCache() :
+      total_size(0),
+      enabled(false),
+      modified(false)
+      { };
+
+    /**
+     * @brief Prepare the cache of a book
+     *
+     * Must be called once the zip file of the book has been opened.
+     *
+     * @param epub_filename The e-book filename
+     */
+    void open(const std::string & epub_filename);
+    void close();
+
+    /**
+     * @brief Retrieve an item from the cache
+     *
+     * @param filename The item filename in the zip file
+     * @param size The item size
+     * @return char * The item content, null terminated, or nullptr if not in the cache.
+     *                Must be freed with release().
+     */
+    char * get(const std::string & filename, uint32_t & size);
+
+    /**
+     * @brief Add a freshly decompressed item to the cache
+     *
+     * @param filename The item filename in the zip file
+     * @param data The item content
+     * @param size The item size
+     */
+    void put(const std::string & filename, const char * data, uint32_t size);
+
+    /**
+     * @brief Release the content of an item
+     *
+     * @param data The item content as returned by get() or by unzip.get_file()
+     */
+    void release(char * data);
+
+    /**
+     * @brief Get the cache folder of a book
+     *
+     * Also used to keep the pages cache of the book (see PageCache).
+     *
+     * @param epub_filename The e-book filename
+     */
+    static std::string get_book_folder(const std::string & epub_filename);
+
+    /**
+     * @brief Remove the cache folder of a book
+     *
+     * @param epub_filename The e-book filename
+     */
+    static void remove(const std::string & epub_filename);
+};
+
+#if __ITEM_CACHE__
+  ItemCache item_cache;
+#else
+  extern ItemCache item_cache;
+#endif
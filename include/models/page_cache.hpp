@@ -0,0 +1,122 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include "models/epub.hpp"
+#include "models/page_locs.hpp"
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * class PageCache - Rendered pages cache
+ *
+ * When the e-book content cache is enabled through the configuration, the
+ * display list of every page shown is kept in serialized form (see
+ * Page::serialize()) in a file located in the book cache folder. Showing the
+ * page again, in this session or a later one, doesn't require retrieving,
+ * parsing and laying out its item.
+ *
+ * The file holds a fixed size index followed by a data area used as a ring:
+ * when full, the oldest pages are overwritten. Every entry is validated
+ * through a CRC-32: adding a page only rewrites the header and its own
+ * entry, the entries of overwritten pages being detected when retrieved.
+ * The whole cache is invalidated when the book format parameters change, at
+ * the same time the pages location are recomputed.
+ */
+
+class PageCache
+{
+  private:
+    static constexpr char const * TAG = "PageCache";
+
+    static constexpr uint8_t  CACHE_FILE_VERSION = 1;
+    static constexpr uint16_t ENTRY_COUNT        = 1024;
+    #if EPUB_LINUX_BUILD
+      static constexpr uint32_t DATA_SIZE        = 8 * 1024 * 1024;
+    #else
+      static constexpr uint32_t DATA_SIZE        = 2 * 1024 * 1024;
+    #endif
+    static constexpr uint32_t MAX_PAGE_SIZE      = 64 * 1024;
+
+    #pragma pack(push, 1)
+      struct Header {
+        uint8_t                version;
+        EPub::BookFormatParams format_params;  ///< Parameters the pages were laid out with
+        uint32_t               write_pos;      ///< Next write position in the data area
+      };
+
+      struct Entry {
+        int16_t  itemref_index;                ///< -1 if the entry is free
+        int32_t  offset;
+        uint32_t position;                     ///< In the data area
+        uint32_t length;
+        uint32_t crc;
+        uint32_t seq;                          ///< Order in which pages were added
+      };
+    #pragma pack(pop)
+
+    static constexpr uint32_t DATA_START = sizeof(Header) + ENTRY_COUNT * sizeof(Entry);
+
+    std::mutex         mutex;
+    FILE             * file;
+    Header             header;
+    std::vector<Entry> entries;
+    uint32_t           seq;
+
+    bool load_index();
+    bool save_index();
+    bool save_entry(const Entry & entry);
+    void      reset();
+
+    Entry * find(const PageLocs::PageId & page_id);
+
+  public:
+    PageCache() : file(nullptr), seq(0) { }
+
+    /**
+     * @brief Prepare the pages cache of a book
+     *
+     * Must be called once the e-book content cache has been opened, its
+     * folder being used to keep the pages.
+     *
+     * @param epub_filename The e-book filename
+     */
+    void open(const std::string & epub_filename);
+    void close();
+
+    /**
+     * @brief Forget every page
+     *
+     * Called when the pages location are recomputed.
+     */
+    void clear();
+
+    /**
+     * @brief Retrieve a page display list
+     *
+     * @param page_id The page
+     * @param data The serialized display list
+     * @return true The page was found in the cache, laid out with the current format parameters.
+     */
+    bool get(const PageLocs::PageId & page_id, std::vector<uint8_t> & data);
+
+    /**
+     * @brief Add a page display list to the cache
+     *
+     * @param page_id The page
+     * @param data The serialized display list
+     */
+    void put(const PageLocs::PageId & page_id, const std::vector<uint8_t> & data);
+};
+
+#if __PAGE_CACHE__
+  PageCache page_cache;
+#else
+  extern PageCache page_cache;
+#endif
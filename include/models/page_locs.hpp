@@ -9,6 +9,8 @@
 #include <mutex>
 #include <map>
 #include <set>
+#include <list>
+#include <vector>
 
 #if EPUB_LINUX_BUILD
   #include <fcntl.h>
@@ -28,6 +30,8 @@
 
 #include "pugixml.hpp"
 
+class SearchIndex;
+
 /**
  * class PageLocs - Compute pages locations
  * 
@@ -35,6 +39,14 @@
  * required to get fast retrieval of a page when required by the user. Page
  * locations are saved on disk once computed. Any change of font, font size,
  * screen orientation (portrait <-> landscape) will trigger a recomputation.
+ *
+ * A layout checkpoint is kept with each page location. It allows the book viewer
+ * to start laying out a page close to its beginning instead of replaying the whole
+ * item from its start.
+ *
+ * The pages locations of other font sizes can be computed in the same pass
+ * (see set_variants()). Changing the font size to one of them then only
+ * requires to load its files.
  */
 
 class PageLocs
@@ -56,6 +68,7 @@ class PageLocs
     struct PageInfo {
       int32_t size;
       int16_t page_number;
+      HTMLInterpreter::Checkpoint checkpoint; ///< Where to resume the layout to show the page
       PageInfo(int32_t siz, int16_t pg_nbr) {
         size = siz;
         page_number = pg_nbr;
@@ -64,9 +77,34 @@ class PageLocs
     };
     typedef std::pair<const PageId, PageInfo> PagePair;
 
+    struct PageCompare {
+      bool operator() (const PageId & lhs, const PageId & rhs) const { 
+        if (lhs.itemref_index < rhs.itemref_index) return true;
+        if (lhs.itemref_index > rhs.itemref_index) return false;
+        return lhs.offset < rhs.offset; 
+      }
+    };
+    typedef std::map<PageId, PageInfo, PageCompare> PagesMap;
+
+    /**
+     * @brief Pages locations of another font size
+     *
+     * Computed along the pages locations of the book format parameters: every
+     * item is retrieved, parsed and its stylesheets prepared once, then laid out
+     * for each variant. A variant is saved beside the book with its search index
+     * when the computation is completed (see variant_filename()).
+     */
+    struct Variant {
+      EPub::BookFormatParams format_params;
+      Page                   page_out;
+      PagesMap               pages_map;
+      SearchIndex          * index;
+      Variant() : index(nullptr) {}
+    };
+
   private:
     static constexpr const char * TAG               = "PageLocs";
-    static constexpr const int8_t LOCS_FILE_VERSION = 3;
+    static constexpr const int8_t LOCS_FILE_VERSION = 4;
 
     Page page_out;
 
@@ -75,14 +113,6 @@ class PageLocs
 
     DOM * dom;
     
-    struct PageCompare {
-      bool operator() (const PageId & lhs, const PageId & rhs) const { 
-        if (lhs.itemref_index < rhs.itemref_index) return true;
-        if (lhs.itemref_index > rhs.itemref_index) return false;
-        return lhs.offset < rhs.offset; 
-      }
-    };
-    typedef std::map<PageId, PageInfo, PageCompare> PagesMap;
     typedef std::set<int16_t> ItemsSet;
 
     std::recursive_timed_mutex  mutex;
@@ -112,8 +142,22 @@ class PageLocs
     //bool           page_end(Page::Format & fmt);
     //bool  page_locs_recurse(pugi::xml_node node, Page::Format fmt, DOM::Node * dom_node);
 
+    std::vector<int8_t> variant_font_sizes;
+    std::list<Variant>  variants;           ///< Being computed
+    ItemsSet            deferred_items;     ///< Retrieved ASAP, their variants not laid out yet
+
     bool load(const std::string & epub_filename); ///< load pages location from .locs file
-    bool save(const std::string & epub_filename); ///< save pages location to .locs file
+    bool save(const std::string            & epub_filename,
+              const EPub::BookFormatParams & format_params,
+              const PagesMap               & map);  ///< save pages location to .locs file
+
+    static bool read_format_params(const std::string & epub_filename, EPub::BookFormatParams & format_params);
+
+    bool locate_pages(Page & page, const EPub::BookFormatParams & format_params, Variant * variant);
+    void        save_variant(Variant & variant);
+    void      clear_variants();
+    bool   switch_to_variant(int16_t count);
+    void     keep_as_variant();
 
   public:
 
@@ -123,14 +167,41 @@ class PageLocs
       item_count(0)
       { };
 
+    /**
+     * @brief What is laid out by build_page_locs()
+     *
+     * The variants of an item retrieved for the viewer (BOOK) are laid out
+     * once every other item is done (VARIANTS): the viewer only waits for the
+     * pages locations of the book format parameters.
+     */
+    enum class Pass : int8_t { ALL, BOOK, VARIANTS };
+
     void setup();
     void abort_threads();
-    bool build_page_locs(int16_t itemref_index);
+    bool build_page_locs(int16_t itemref_index, Pass pass = Pass::ALL);
+
+    /**
+     * @brief The next item whose variants were deferred
+     *
+     * Called by the state task once every item is done.
+     *
+     * @return int16_t The item index, -1 if none
+     */
+    int16_t next_deferred_item();
 
     const PageId * get_next_page_id(const PageId & page_id, int16_t count = 1);
     const PageId * get_prev_page_id(const PageId & page_id, int     count = 1);
     const PageId *      get_page_id(const PageId & page_id                   );
 
+    /**
+     * @brief The page of a page number
+     *
+     * @param page_nbr The page number, from 0
+     * @return const PageId* nullptr if the pages locations are not completed
+     *                       or if there is no such page
+     */
+    const PageId * get_page_id_at(int16_t page_nbr);
+
     uint16_t   get_current_itemref_index() { return item_info.itemref_index; }
     const EPub::ItemInfo & get_item_info() { return item_info;               }
     const PagesMap       & get_pages_map() { return pages_map;               }
@@ -147,6 +218,39 @@ class PageLocs
     }
 
     bool insert(PageId & id, PageInfo & info);
+    bool insert(Variant & variant, PageId & id, PageInfo & info);
+
+    /**
+     * @brief Font sizes to compute with the next pages locations
+     *
+     * Takes effect on the next computation. The font size of the book format
+     * parameters is ignored if present. Used by the PrePaginator: on the
+     * device, the completed pages locations are kept as the variant of their
+     * font size when it is changed.
+     *
+     * @param font_sizes The font sizes of the variants. Empty: no variant.
+     */
+    inline void set_variants(const std::vector<int8_t> & font_sizes) { variant_font_sizes = font_sizes; }
+    inline const std::vector<int8_t> & get_variants() const { return variant_font_sizes; }
+
+    /**
+     * @brief The book filename used for the files of a variant
+     *
+     * The files of the 12 points variant of "book.epub" are "book.12pt.locs"
+     * and "book.12pt.sidx".
+     *
+     * @param epub_filename The e-book filename
+     * @param font_size The variant font size
+     * @return std::string "book.12pt.epub"
+     */
+    static std::string variant_filename(const std::string & epub_filename, int8_t font_size);
+
+    /**
+     * @brief Delete the files of the variants of a book
+     *
+     * @param epub_filename The e-book filename
+     */
+    static void remove_variants(const std::string & epub_filename);
 
     inline void clear() { 
       std::scoped_lock guard(mutex);
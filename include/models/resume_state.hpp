@@ -0,0 +1,102 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include "models/epub.hpp"
+#include "models/page_locs.hpp"
+
+#include <string>
+
+/**
+ * class ResumeState - Reading state snapshot kept through deep sleep
+ *
+ * When the device enters deep sleep while a book is shown, a compact
+ * snapshot of the reading state is written: the book, the page shown, the
+ * format parameters used to paginate it and the signature (size and
+ * modification time) of the e-book, .locs and .toc files.
+ *
+ * At wake up, if the snapshot is valid and the files are unchanged, the
+ * application reopens the book at that page immediately. The books
+ * directory is then only read when it is really needed.
+ *
+ * On the ESP32, the snapshot is kept in the RTC slow memory: it is lost
+ * at power on. On Linux, it is kept in a file that is removed once read.
+ */
+
+class ResumeState
+{
+  public:
+    static constexpr uint8_t MAX_FILENAME_SIZE = 128;
+    static constexpr uint8_t MAX_TITLE_SIZE    =  96;
+
+    #pragma pack(push, 1)
+      struct FileSig {
+        int32_t size;           ///< -1 if the file doesn't exist
+        int64_t mtime;
+      };
+
+      struct Snapshot {
+        uint32_t               magic;
+        uint8_t                version;
+        uint32_t               book_id;        ///< As found in the books directory
+        int16_t                itemref_index;
+        int32_t                offset;
+        EPub::BookFormatParams format_params;
+        FileSig                book_sig;
+        FileSig                locs_sig;
+        FileSig                toc_sig;
+        char                   filename[MAX_FILENAME_SIZE]; ///< Full path of the e-book
+        char                   title[MAX_TITLE_SIZE];
+        uint32_t               checksum;       ///< Over all preceding fields
+      };
+    #pragma pack(pop)
+
+  private:
+    static constexpr char const * TAG = "ResumeState";
+
+    static constexpr uint32_t MAGIC   = 0x45505253; // "EPRS"
+    static constexpr uint8_t  VERSION = 1;
+
+    static uint32_t checksum(const Snapshot & snapshot);
+    static void     get_sig(const std::string & filename, FileSig & sig);
+    static bool   check_sig(const std::string & filename, const FileSig & sig);
+
+  public:
+    /**
+     * @brief Save the reading state before entering deep sleep
+     *
+     * @param book_id The book id in the books directory
+     * @param filename The e-book full path
+     * @param title The e-book title
+     * @param page_id The page being shown
+     * @param format_params The format parameters of the book
+     */
+    void save(uint32_t                       book_id,
+              const std::string            & filename,
+              const std::string            & title,
+              const PageLocs::PageId       & page_id,
+              const EPub::BookFormatParams & format_params);
+
+    /**
+     * @brief Retrieve the reading state saved before deep sleep
+     *
+     * The snapshot is consumed: it will not be retrieved again at the next
+     * boot, such that a book that can't be opened doesn't prevent the device
+     * from starting.
+     *
+     * @param snapshot The reading state
+     * @return true The snapshot is valid and the book files didn't change
+     */
+    bool retrieve(Snapshot & snapshot);
+
+    void clear();
+};
+
+#if __RESUME_STATE__
+  ResumeState resume_state;
+#else
+  extern ResumeState resume_state;
+#endif
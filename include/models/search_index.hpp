@@ -0,0 +1,181 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include "models/epub.hpp"
+#include "models/page_locs.hpp"
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * class SearchIndex - Full-text search within a book
+ *
+ * The inverted index of a book is built as a side output of the pages
+ * locations computation: each word laid out by the PageLocs interpreter is
+ * split in terms, attached to the page being located. Once all pages are
+ * located, the index is saved beside the .locs file, with the pages numbers,
+ * as a .sidx file:
+ *
+ *   - The version, the book format parameters and the page count, the index
+ *     being valid only with the pages locations computed with them.
+ *   - The terms directory: each term, in ascending order, preceded with its
+ *     size and followed with the position of its pages list.
+ *   - The pages lists: the count of pages, then the page numbers as increasing
+ *     deltas, all in variable length integers (7 bits per byte).
+ *
+ * A query loads the terms directory once for the book, then reads from the
+ * file the pages lists of its terms only.
+ *
+ * The terms are the runs of letters and digits of the words, lower cased,
+ * the accents of the Latin-1 letters being removed. Terms of a single letter
+ * are not indexed. A query term ending with '*' matches all the terms
+ * beginning with it. The pages found contain all terms of the query.
+ */
+
+class SearchIndex
+{
+  public:
+    static constexpr uint16_t MAX_RESULT_COUNT = 500;
+
+  private:
+    static constexpr char const * TAG = "SearchIndex";
+
+    static constexpr int8_t   SEARCH_FILE_VERSION =       1;
+    static constexpr uint8_t  MIN_TERM_SIZE       =       2;  ///< In bytes
+    static constexpr uint8_t  MAX_TERM_SIZE       =      32;  ///< In bytes, longer terms are truncated
+    static constexpr uint32_t MAX_POSTING_COUNT   = 1000000;  ///< Pages of terms, for a book
+    static constexpr uint16_t MAX_PAGE_COUNT      =   65535;
+
+    static const char LATIN1_FOLDING[64];
+
+    typedef std::vector<uint16_t>                     Postings;  ///< Pages, as serial numbers
+    typedef std::unordered_map<std::string, Postings> Terms;
+
+    std::mutex mutex;
+
+    // ----- Index construction -----
+
+    Terms                         terms;
+    std::vector<PageLocs::PageId> pages;          ///< Pages in the order located, some more than once
+    std::string                   term;           ///< Term being extracted from a word
+    uint32_t                      posting_count;
+    bool                          overflow;       ///< Too many pages or terms: the book is not indexed
+
+    // ----- Queries -----
+
+    std::string           loaded_filename;  ///< Book of the loaded directory
+    char                * directory;        ///< The terms directory, as in the file
+    uint32_t              directory_size;
+    std::vector<uint32_t> term_positions;   ///< In the directory, for each term
+    uint32_t              postings_pos;     ///< Position of the pages lists in the file
+    uint32_t              postings_size;
+
+    static uint32_t next_code(const uint8_t * & p, const uint8_t * end);
+    static bool     append_folded(std::string & term, uint32_t code);
+
+    static std::string filename_of(const std::string & epub_filename);
+
+    bool read_header(FILE * file,
+                     const EPub::BookFormatParams & params, int16_t page_count,
+                     uint32_t & term_count, uint32_t & dir_size, uint32_t & post_size);
+    bool load_directory(const std::string & epub_filename);
+    bool read_postings(FILE * file, uint32_t term_idx, std::vector<int16_t> & page_nbrs);
+    void term_pages(FILE * file, const std::string & term, bool prefix, std::vector<int16_t> & page_nbrs);
+    void free_directory();
+
+  public:
+    SearchIndex() : posting_count(0), overflow(false), directory(nullptr), directory_size(0) {}
+    ~SearchIndex() { free_directory(); }
+
+    /**
+     * @brief Split a word in terms
+     *
+     * @param word The word, UTF-8 encoded
+     * @param size The word size in bytes
+     * @param term Receives each term in turn
+     * @param f Called with each term
+     * @param min_size Shorter terms are skipped
+     */
+    template<typename F>
+    static void for_each_term(const char * word, int16_t size, std::string & term, F f,
+                              uint8_t min_size = MIN_TERM_SIZE) {
+      const uint8_t * p   = (const uint8_t *) word;
+      const uint8_t * end = p + size;
+
+      term.clear();
+      while (p < end) {
+        uint32_t code = next_code(p, end);
+        if ((code == 0xAD) || (code == 0x200C) || (code == 0x200D)) continue; // Soft hyphen and joiners
+        if (append_folded(term, code)) continue;
+        if (term.size() >= min_size) f(term);
+        term.clear();
+      }
+      if (term.size() >= min_size) f(term);
+    }
+
+    /**
+     * @brief Start a new index
+     *
+     * Called when the pages locations are about to be computed.
+     */
+    void clear();
+
+    /**
+     * @brief The page being located
+     *
+     * The next words are on this page.
+     */
+    void start_page(const PageLocs::PageId & page_id);
+
+    /**
+     * @brief A word has been put on the page being located
+     */
+    void add_word(const char * word, int16_t size);
+
+    /**
+     * @brief Save the index of a book
+     *
+     * Called once all pages have been located and numbered. The memory used
+     * to build the index is then released.
+     *
+     * @param epub_filename The book
+     * @param pages_map The pages, with their number
+     * @param params The format parameters of the pages locations
+     * @return true The index has been saved
+     */
+    bool save(const std::string            & epub_filename,
+              const PageLocs::PagesMap     & pages_map,
+              const EPub::BookFormatParams & params);
+
+    /**
+     * @brief Check that the index of a book is in line with its pages locations
+     */
+    bool is_available(const std::string            & epub_filename,
+                      const EPub::BookFormatParams & params,
+                      int16_t                        page_count);
+
+    /**
+     * @brief Retrieve the pages of a book containing all terms of a query
+     *
+     * The book must be the current one, its pages locations being completed.
+     *
+     * @param epub_filename The book
+     * @param query Words, separated with spaces
+     * @param page_nbrs The pages found, in ascending order, at most MAX_RESULT_COUNT
+     * @return false The index is not available
+     */
+    bool search(const std::string & epub_filename, const std::string & query, std::vector<int16_t> & page_nbrs);
+};
+
+#if __SEARCH_INDEX__
+  SearchIndex search_index;
+#else
+  extern SearchIndex search_index;
+#endif
@@ -0,0 +1,94 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#pragma once
+#include "global.hpp"
+
+#include "models/css.hpp"
+#include "helpers/arena.hpp"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * class StyleCache - Parsed stylesheets of a book
+ *
+ * The rules of the css files linked by the items of a book are kept in
+ * serialized form (see CSS::serialize()) in a sidecar file (.cssb) beside
+ * the book. The file is loaded with a single read when the book is opened:
+ * reopening or paginating the book again rebuilds the stylesheets, including
+ * their @font-face rules, without retrieving and parsing the css files.
+ *
+ * Every stylesheet is validated against the CRC-32 of its css file found in
+ * the zip central directory. The file is rewritten when a stylesheet is
+ * added to it, usually once or twice per book.
+ */
+
+class StyleCache
+{
+  private:
+    static constexpr char const * TAG = "StyleCache";
+
+    static constexpr uint8_t CACHE_FILE_VERSION = 1;
+
+    #pragma pack(push, 1)
+      struct EntryHeader {
+        uint32_t crc;           ///< As found in the zip central directory
+        uint32_t length;        ///< Serialized rules length
+        uint16_t name_length;   ///< The css filename follows the header, then the rules
+      };
+    #pragma pack(pop)
+
+    struct Entry {
+      uint32_t crc;
+      uint32_t position;        ///< Of the entry header in the data
+      uint32_t length;          ///< Of the whole entry
+    };
+    typedef std::map<std::string, Entry> Entries;
+
+    std::mutex           mutex;
+    std::string          filename;
+    std::vector<uint8_t> data;  ///< The file content
+    Entries              entries;
+
+    bool load_index();
+    bool       save();
+
+  public:
+    /**
+     * @brief Load the parsed stylesheets of a book
+     *
+     * @param epub_filename The e-book filename
+     */
+    void open(const std::string & epub_filename);
+    void close();
+
+    /**
+     * @brief Rebuild a stylesheet from the cache
+     *
+     * @param css_filename The css file path inside the zip file
+     * @param crc The css file CRC-32, from the zip central directory
+     * @param css_id The stylesheet identifier
+     * @param scope The arena scope of the stylesheet
+     * @return CSS * The stylesheet, nullptr if not in the cache or changed since it was saved.
+     */
+    CSS * get(const std::string & css_filename, uint32_t crc, const char * css_id, Arena & scope);
+
+    /**
+     * @brief Add a parsed stylesheet to the cache
+     *
+     * @param css_filename The css file path inside the zip file
+     * @param crc The css file CRC-32, from the zip central directory
+     * @param css The stylesheet, as parsed from the css file
+     */
+    void put(const std::string & css_filename, uint32_t crc, const CSS & css);
+};
+
+#if __STYLE_CACHE__
+  StyleCache style_cache;
+#else
+  extern StyleCache style_cache;
+#endif
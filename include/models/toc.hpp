@@ -14,6 +14,7 @@
 #include "models/page_locs.hpp"
 #include "helpers/char_pool.hpp"
 #include "helpers/simple_db.hpp"
+#include "helpers/memory_budget.hpp"
 
 #include <forward_list>
 #include <map>
@@ -34,7 +35,7 @@ class TOC
               some_ids(false) {}
    ~TOC() { 
       if (char_pool   != nullptr) delete char_pool;
-      if (char_buffer != nullptr) free(char_buffer); 
+      memory_budget.release(MemoryBudget::Consumer::TOC, char_buffer, char_buffer_size);
     };
 
     #pragma pack(push, 1)
@@ -48,6 +49,15 @@ class TOC
       }
     };
 
+    /// An entry as saved in the .toc file. The label is an offset in the
+    /// labels record, 32 bits wide whatever the platform, such that the
+    /// file computed on a host can be used on a device (see PrePaginator).
+    struct EntryFileRecord {
+      uint32_t           label_offset;
+      PageLocs::PageId   page_id;
+      uint8_t            level;
+    };
+
     struct VersionRecord {
       uint16_t version;
       char     app_name[32];
@@ -143,8 +153,6 @@ class TOC
     pugi::xml_document * ncx_opf;
     char               * ncx_data;
 
-    const pugi::xml_document * opf;
-
     volatile bool ready; // true if the table of content has been populated
     bool compacted;
     bool saved;
@@ -7,6 +7,7 @@
 
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #if EPUB_LINUX_BUILD
 #else
@@ -34,11 +35,18 @@ class BookViewer
   private:
     static constexpr char const * TAG = "BookViewer";
 
-    std::mutex        mutex;
-    int16_t           page_bottom;
-    PageLocs::PageId  current_page_id;
+    std::mutex           mutex;
+    int16_t              page_bottom;
+    PageLocs::PageId     current_page_id;
+    bool                 use_checkpoints;
+    bool                 use_page_cache;
+    std::vector<uint8_t> page_data;        ///< Serialized display list, reused from page to page
 
     void build_page_at(const PageLocs::PageId & page_id);
+    void complete_page(const PageLocs::PageId & page_id, 
+                       Page::Format           & fmt, 
+                       bool                     show_title, 
+                       int16_t                  title_baseline_offset);
 
     struct PageEnd {
       bool operator()(Page::Format & fmt) const {
@@ -48,12 +56,28 @@ class BookViewer
 
   public:
 
-    BookViewer() { }
+    BookViewer() : use_checkpoints(true), use_page_cache(true) { }
    ~BookViewer() { }
 
     void                     init() { current_page_id = PageLocs::PageId(-1, -1); }
     inline std::mutex & get_mutex() { return mutex; }
 
+    /**
+     * @brief Select how pages are laid out
+     * 
+     * @param use If true (the default), the layout starts from the checkpoint kept
+     *            with the page location. Otherwise, the item is replayed from its start.
+     */
+    inline void set_use_checkpoints(bool use) { use_checkpoints = use; }
+
+    /**
+     * @brief Select if the pages cache is used
+     * 
+     * @param use If true (the default), pages are retrieved from and added to
+     *            the pages cache, when enabled in the configuration.
+     */
+    inline void  set_use_page_cache(bool use) { use_page_cache = use; }
+
     /**
      * @brief Show a page on the display.
      * 
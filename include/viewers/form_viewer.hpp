@@ -852,7 +852,7 @@ class FormViewer
 
         ScreenBottom::show();
         
-        page.paint(false);
+        page.paint(false, false, false, RefreshScheduler::Intent::UI);
       }
       
       return completed;
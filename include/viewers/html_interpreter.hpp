@@ -21,6 +21,28 @@ using namespace pugi;
 
 class HTMLInterpreter
 {
+  public:
+    static constexpr uint8_t CHECKPOINT_MAX_DEPTH = 8;
+
+    /**
+     * @brief Layout checkpoint
+     * 
+     * A point in the traversal of an item, located before the beginning of a page,
+     * from which the interpreter can resume instead of replaying the item from its
+     * start: the path of child indexes from the <body> element down to a node, and the
+     * offset reached when that node is entered.
+     * 
+     * Nothing has been put on the page yet at that point. The formats and the DOM nodes
+     * of the ancestors, with their preceding siblings required by the CSS selectors, are
+     * rebuilt from the XML document while following the path.
+     */
+    struct Checkpoint {
+      int32_t  offset;                        ///< Offset when entering the node, -1 if none
+      uint8_t  depth;                         ///< Path length, 0 if none
+      uint16_t path[CHECKPOINT_MAX_DEPTH];    ///< Child index at each level, from <body>
+      Checkpoint() : offset(-1), depth(0), path{} {}
+    };
+
   protected:
     static constexpr char const * TAG = "HTMLInterpreter";
 
@@ -41,7 +63,14 @@ class HTMLInterpreter
     int16_t from_page, to_page;
     int16_t max_level;
 
-    static MemoryPool<Page::Format> fmt_pool;
+    Checkpoint last_mark;                     ///< Last node entered (LOCATION mode)
+    Checkpoint prev_mark;                     ///< Last node entered at a lower offset
+    Checkpoint seek_point;                    ///< Where to resume (DISPLAY mode)
+    bool       seeking;
+
+    uint16_t   current_path[CHECKPOINT_MAX_DEPTH];
+
+    MemoryPool<Page::Format> fmt_pool;     ///< Its blocks are in the page render arena
 
     // The page_end method is responsible of doing post-processing once
     // the end of a page has been detected (the page.is_full() method returns true or
@@ -49,6 +78,14 @@ class HTMLInterpreter
     // and the page location computation processes.
     virtual bool page_end(const Page::Format & fmt) = 0;
 
+    // Called for each word put on the page, in LOCATION mode only. Used by
+    // the page location computation to index the words of a book.
+    virtual void word_added(const char * word, int16_t count) {}
+
+    // Called each time a paragraph has been completed. The page location
+    // computation uses it as a cooperative yield point.
+    virtual void paragraph_ended() {}
+
   public:
     HTMLInterpreter(Page & the_page, DOM & the_dom, Page::ComputeMode the_comp_mode, const EPub::ItemInfo & the_item) 
       :           page(the_page), 
@@ -63,7 +100,9 @@ class HTMLInterpreter
         show_the_state(false), 
              from_page(-1), 
                to_page(-1),
-            max_level(0) {}
+            max_level(0),
+              seeking(false),
+             fmt_pool(Arena::pool_block, &the_dom.get_arena()) {}
 
     virtual ~HTMLInterpreter() {}
 
@@ -74,11 +113,35 @@ class HTMLInterpreter
       start_offset       = start;
       end_offset         = end;
       show_images        = show_imgs;
+      seeking            = false;
       page.set_compute_mode(Page::ComputeMode::MOVE);
     }
 
     bool build_pages_recurse(xml_node node, Page::Format & fmt, DOM::Node * dom_node, int16_t level);
 
+    /**
+     * @brief Resume from a layout checkpoint
+     * 
+     * To be called after set_limits(). The checkpoint must precede the start
+     * offset and its path must exist in the item.
+     * 
+     * @param checkpoint The checkpoint saved with the page location
+     * @param body The <body> node of the item
+     * @return true The next build_pages_recurse() call will seek to the checkpoint
+     */
+    bool set_checkpoint(const Checkpoint & checkpoint, xml_node body);
+
+    /**
+     * @brief Checkpoint of a page starting at the current offset
+     * 
+     * Only available in LOCATION mode. It is the last node entered at an offset lower
+     * than the current one: from there, nothing is put on the page until the current
+     * offset is reached.
+     */
+    inline const Checkpoint & get_checkpoint() const {
+      return (last_mark.offset < current_offset) ? last_mark : prev_mark;
+    }
+
     void check_for_completion() {
       if (current_offset != end_offset) {
         LOG_E("Current page offset and end of page offset differ: %d vs %d", 
@@ -154,6 +217,17 @@ class HTMLInterpreter
 
     inline bool at_end() { return current_offset >= end_offset; }
 
+    inline void mark_checkpoint(int16_t level, uint16_t index) {
+      if (level > CHECKPOINT_MAX_DEPTH) return;
+      current_path[level - 1] = index;
+      if (current_offset > last_mark.offset) prev_mark = last_mark;
+      last_mark.offset = current_offset;
+      last_mark.depth  = level;
+      memcpy(last_mark.path, current_path, level * sizeof(uint16_t));
+    }
+
+    void seek(xml_node & sub, uint16_t & index, DOM::Node * dom_node, int16_t level);
+
     inline Page::Format * duplicate_fmt(const Page::Format & fmt) {
       Page::Format * new_fmt = fmt_pool.allocate();
       *new_fmt = fmt;
@@ -2,60 +2,93 @@
 //
 // MIT License. Look at file licenses.txt for details.
 
-// Not ready yet... not sure it will be used in the future...
-#if 0
 #pragma once
 #include "global.hpp"
 
+#if INKPLATE_6PLUS || TOUCH_TRIAL
+
 #include "screen.hpp"
 #include "viewers/page.hpp"
 
+#include <string>
+#include <vector>
+
 /**
- * @brief Message presentation class
- * 
- * This class supply a screen keyboard to be used with a touch screen.
- * 
+ * @brief Screen keyboard presentation class
+ *
+ * This class supply a screen keyboard to be used with a touch screen. The
+ * screen presents, from top to bottom, a title, the text entered by the
+ * user, lines of results that the caller updates at each keystroke and
+ * the keyboard itself.
+ *
+ * The viewer doesn't wait for the user: the controller receiving the touch
+ * events retrieves the key or the line tapped and calls show() again.
  */
 class KeyboardViewer
 {
   private:
     static constexpr char const * TAG = "KeyboardViewer";
+
+    static const int16_t TITLE_FONT       =   1;
+    static const int16_t TITLE_FONT_SIZE  =  14;
+    static const int16_t TEXT_FONT_SIZE   =  12;
+    static const int16_t LINE_FONT_SIZE   =  10;
+    static const int16_t KEY_FONT_SIZE    =   9;
+
+    static const int16_t TITLE_YPOS       =  20;
+    static const int16_t TEXT_YPOS        =  70;
+    static const int16_t TEXT_HEIGHT      =  50;
+    static const int16_t FIRST_LINE_YPOS  = 140;
+    static const int16_t LINE_HEIGHT      =  36;
+    static const int16_t KEY_HEIGHT       =  60;
+    static const int16_t KEY_GAP          =   4;
+
+    static const uint8_t ROW_COUNT        =   4;
+    static const uint8_t MAX_KEY_COUNT    =  10; ///< Keys in the longest row
+
+    // \b == 'backspace', ' ' == 'space', \r == 'done'
+
+    static constexpr char const * rows[ROW_COUNT] = {
+      "1234567890", "qwertyuiop", "asdfghjkl\b", "zxcvbnm \r"
+    };
+
     Page::Format fmt;
-    
-    enum class KBType : int8_t { ALFA, ALFA_SHIFTED, NUMBERS, SPECIAL };
-
-    KBType         current_kb_type;
-    uint16_t       width;
-    const uint16_t HEIGHT = 240;
-
-    static constexpr char const * alfa_line_1_low = "qwertyuiop" ;
-    static constexpr char const * alfa_line_2_low = "asdfghjkl"  ;
-    static constexpr char const * alfa_line_3_low = "\1zxcvbnm\b"; // \1 == 'shift', \b == 'backspace'
-    static constexpr char const * alfa_line_4     = "\2 \r"      ; // \2 == '123', ' ' == 'space', \r == 'return'
-
-    static constexpr char const * alfa_line_1_upp = "QWERTYUIOP" ;
-    static constexpr char const * alfa_line_2_upp = "ASDFGHJKL"  ;
-    static constexpr char const * alfa_line_3_upp = "\1ZXCVBNM\b"; // \1 == 'shift', \b == 'backspace'
-
-    static constexpr char const * num_line_1      = "1234567890" ;
-    static constexpr char const * num_line_2      = "-/:;()$&@\"";
-    static constexpr char const * num_line_3      = "\3.,?!'\b"  ; // \3 == '#+=', \b == 'backspace'
-    static constexpr char const * num_line_4      = "\4 \r"      ; // \4 == 'ABC', 
-
-    static constexpr char const * special_line_1  = "[]{}#%^*+=" ;
-    static constexpr char const * special_line_2  = "_\\|~<>`/\"@";
-    static constexpr char const * special_line_3  = "\2.,?!'";
-    static constexpr char const * special_line_4  = "\4 \r";     ; // \4 == 'ABC', ' ' == 'space', \4 == 'return'
-
-    void show_kb(KBType kb_type);
-    void show_char(char           ch, uint16_t & x, uint16_t y);
-    void show_line(const char * line, uint16_t & x, uint16_t y);
+    Dim          key_dim;
+    int16_t      keyboard_ypos;
+    uint8_t      line_count;     ///< Result lines that fit between the text and the keyboard
+
+    void compute_layout();
+    Pos  key_pos(uint8_t row, uint8_t col);
+    void show_key(char ch, Pos pos);
+
   public:
-    KeyboardViewer() : current_kb_type(KBType::ALFA) {};
+    KeyboardViewer() : line_count(0) {}
+
+    /**
+     * @brief Show the keyboard screen
+     *
+     * @param title The title, at the top of the screen
+     * @param text  The text entered so far
+     * @param lines The result lines. Only the first get_line_count() are shown.
+     */
+    void show(const std::string & title, const std::string & text, const std::vector<std::string> & lines);
 
-    typedef void (* UpdateHandler)(char ch);
-    bool get_alfanum(char * str, uint16_t len, UpdateHandler handler);
-    bool get_num(int32_t & val);
+    /**
+     * @brief Retrieve the key at a screen location
+     *
+     * @return char The key character ('\b' for backspace, '\r' when done), 0 if none.
+     */
+    char get_key_at(uint16_t x, uint16_t y);
+
+    /**
+     * @brief Retrieve the result line at a screen location
+     *
+     * @return int16_t The line index, -1 if none.
+     */
+    int16_t get_line_at(uint16_t x, uint16_t y);
+
+    inline bool    is_title_at(uint16_t x, uint16_t y) { return y < TEXT_YPOS; }
+    inline uint8_t get_line_count() { compute_layout(); return line_count; }
 };
 
 #if __KEYBOARD_VIEWER__
@@ -64,4 +97,4 @@ class KeyboardViewer
   extern KeyboardViewer keyboard_viewer;
 #endif
 
-#endif
\ No newline at end of file
+#endif
@@ -6,12 +6,12 @@
 #include "global.hpp"
 
 #include <string>
-#include <forward_list>
+#include <vector>
 
 #include "models/image.hpp"
 #include "models/fonts.hpp"
 #include "models/css.hpp"
-#include "memory_pool.hpp"
+#include "helpers/refresh_scheduler.hpp"
 
 #include "pugixml.hpp"
 
@@ -27,6 +27,8 @@
  */
 class Page
 {
+  friend class PerfStats; ///< Memory pools usage report
+
   public:
     static const uint16_t HORIZONTAL_CENTER = 9999;
 
@@ -91,7 +93,14 @@ class Page
       DisplayListCommand command;      ///< Command
     };
 
-    typedef std::forward_list<DisplayListEntry *> DisplayList;
+    /**
+     * @brief Display list
+     * 
+     * Entries are kept contiguous, in painting order. The buffers are reused from
+     * page to page: once they have grown to the size of a full page, laying out
+     * words doesn't require any more memory allocation.
+     */
+    typedef std::vector<DisplayListEntry> DisplayList;
 
     /**
      * @brief Book Compute Mode
@@ -104,11 +113,15 @@ class Page
      */
     ComputeMode compute_mode;
 
-    MemoryPool <DisplayListEntry> display_list_entry_pool;
+    int8_t normal_font_size;             ///< The book format parameters font size when 0
 
     DisplayList display_list;            ///< The list of artefacts and their position to put on screen
     DisplayList line_list;               ///< Line preparation for paragraphs
 
+    std::string           word_key;      ///< add_word() words cache key, kept to reuse its buffer
+    std::vector<uint32_t> word_codes;    ///< add_word() decoded characters
+    Font::WordGlyphs      word_glyphs;   ///< add_word() glyphs retrieved from the font
+
     bool screen_is_full;                 ///< True if screen no more space to add characters
 
     Pos     pos;                         ///< Current drawing Screen position
@@ -119,15 +132,30 @@ class Page
     float   line_height_factor;
     int16_t para_indent, top_margin;
 
-    // Entries of a line list are eventually migrated to the display_list. 
-    // So the don't need to be erased.  
-    inline void clear_line_list() { line_list.clear(); }
+    inline DisplayListEntry * new_entry(DisplayList & list) {
+      list.emplace_back();
+      return &list.back();
+    }
+
+    static void release_images(DisplayList & list);
 
-    void clear_display_list();
-    void           add_line(const Format & fmt, bool justifyable);
+    inline void  clear_line_list() { release_images(line_list);    line_list.clear();    }
+    inline void clear_display_list() { release_images(display_list); display_list.clear(); }
+
+    /**
+     * @brief Move the first entries of the line list to the display list
+     * 
+     * @param fmt Formatting parameters.
+     * @param justifyable True if the line can be justified.
+     * @param count The number of entries in the line list that are part of the line.
+     *              The following entries are kept in the line list for the next line.
+     */
+    void           add_line(const Format & fmt, bool justifyable, uint16_t count);
+    inline void    add_line(const Format & fmt, bool justifyable) { add_line(fmt, justifyable, line_list.size()); }
     void  add_glyph_to_line(Font::Glyph * glyph, const Format & fmt, Font & font, bool is_space);
     void  add_image_to_line(Image & image, int16_t advance, const Format & fmt);
     int32_t      to_unicode(const char *str, CSS::TextTransform transform, bool first, const char **str2) const;
+    void        decode_word(const char * word, int16_t length, CSS::TextTransform transform);
 
   public:
 
@@ -200,13 +228,15 @@ class Page
     /**
      * @brief Add a UTF-8 word to the paragraph.
      *
-     * @param word The word to be added to the paragraph.
+     * @param word The word to be added to the paragraph. It doesn't have to be null terminated.
+     * @param length The word length in bytes.
      * @param fmt Formatting parameters.
      * @return true The word has been added to the paragraph.
      * @return false There is not enough space to add the word on page.
      */
 
-    bool add_word(const char * word, const Format & fmt);
+    bool add_word(const char * word, int16_t length, const Format & fmt);
+    inline bool add_word(const char * word, const Format & fmt) { return add_word(word, strlen(word), fmt); }
 
     /**
      * @brief Add a UTF-8 character to the paragraph.
@@ -267,13 +297,42 @@ class Page
      * @brief Paint the display list to the screen.
      * 
      * The screen is first erased and the painting process is done using 
-     * the content of the display list.
+     * the content of the display list. If the screen is not erased, only
+     * the region covered by the display list is updated on the panel.
      * 
      * @param clear_screen Screen contain is erased before painting.
      * @param no_full      Bypass partial update count control. Use with great caution!
      * @param do_it        Do the painting irrelevant of the compute mode
+     * @param intent       What is being updated, to select the panel waveform. TEXT
+     *                     is changed to IMAGE if the display list contains images.
      */
-    void paint(bool clear_screen = true, bool no_full = false, bool do_it = false);
+    void paint(bool                     clear_screen = true, 
+               bool                     no_full      = false, 
+               bool                     do_it        = false,
+               RefreshScheduler::Intent intent       = RefreshScheduler::Intent::TEXT);
+
+    /**
+     * @brief Serialize the display list
+     * 
+     * Glyphs are identified by their font name and style, size and code, such
+     * that the result remains valid from one session to the next. Space glyphs
+     * are not kept as they paint nothing. Pages showing images are not serialized.
+     * 
+     * @param data The serialized display list.
+     * @return true The display list has been serialized.
+     */
+    bool serialize(std::vector<uint8_t> & data) const;
+
+    /**
+     * @brief Rebuild the display list from its serialized form
+     * 
+     * Glyphs are retrieved from the fonts caches, being rasterized if required.
+     * 
+     * @param data The serialized display list, as produced by serialize().
+     * @param size The data size in bytes.
+     * @return true The display list has been rebuilt. If false, the display list is left empty.
+     */
+    bool restore(const uint8_t * data, uint32_t size);
 
     void show_fmt(const Format & fmt, const char * spaces) const {
       #if DEBUGGING
@@ -330,6 +389,17 @@ class Page
 
     inline void                 set_compute_mode(ComputeMode mode) { compute_mode = mode; }
 
+    /**
+     * @brief Lay out the page for another font size
+     *
+     * Used to compute the pages locations of other font sizes in the same
+     * pass (see PageLocs::Variant).
+     *
+     * @param size The normal font size. 0: as found in the book format parameters.
+     */
+    inline void            set_normal_font_size(int8_t size) { normal_font_size = size;   }
+    int8_t                     get_normal_font_size() const;
+
     inline ComputeMode          get_compute_mode() const { return compute_mode;           }
     inline int16_t                   paint_width() const { return max_x - min_x;          }
     inline bool                          is_full() const { return screen_is_full;         }
@@ -343,7 +413,8 @@ class Page
     int16_t       get_point_value(const CSS::Value & value, const Format & fmt, int16_t ref);
     float        get_factor_value(const CSS::Value & value, const Format & fmt, float ref);
     void            adjust_format(DOM::Node * dom_current_node, Format & fmt, CSS * element_css, CSS * item_css);
-    void adjust_format_from_rules(Format & fmt, const CSS::RulesMap & rules);
+    template <class Rules>
+    void adjust_format_from_rules(Format & fmt, const Rules & rules);
 
     inline void reset_font_index(Format & fmt, Fonts::FaceStyle style) {
       if (style != fmt.font_style) {
@@ -48,8 +48,12 @@ class MemoryPool
       typedef MemoryPool<U> other;
     };
 
+    /* Blocks provider. The pool doesn't release the blocks it gets from it. */
+    typedef void* (*BlockAllocator)(void* context, size_t size);
+
     /* Member functions */
     MemoryPool() noexcept;
+    MemoryPool(BlockAllocator allocator, void* context) noexcept;
     MemoryPool(const MemoryPool& memoryPool) noexcept;
     MemoryPool(MemoryPool&& memoryPool) noexcept;
     template <class U> MemoryPool(const MemoryPool<U>& memoryPool) noexcept;
@@ -74,6 +78,15 @@ class MemoryPool
     template <class... Args> pointer newElement(Args&&... args);
     void deleteElement(pointer p);
 
+    /* Usage statistics (elements count), only maintained when PERF_STATS is set */
+#if PERF_STATS
+    size_type inUse()     const noexcept { return inUse_;     }
+    size_type highWater() const noexcept { return highWater_; }
+#else
+    size_type inUse()     const noexcept { return 0; }
+    size_type highWater() const noexcept { return 0; }
+#endif
+
   private:
     union Slot_ {
       value_type element;
@@ -88,6 +101,12 @@ class MemoryPool
     slot_pointer_ currentSlot_;
     slot_pointer_ lastSlot_;
     slot_pointer_ freeSlots_;
+#if PERF_STATS
+    size_type inUse_;
+    size_type highWater_;
+#endif
+    BlockAllocator blockAllocator_;
+    void* blockContext_;
 
     size_type padPointer(data_pointer_ p, size_type align) const noexcept;
     void allocateBlock();
@@ -37,6 +37,21 @@ noexcept
   currentSlot_ = nullptr;
   lastSlot_ = nullptr;
   freeSlots_ = nullptr;
+#if PERF_STATS
+  inUse_ = 0;
+  highWater_ = 0;
+#endif
+  blockAllocator_ = nullptr;
+  blockContext_ = nullptr;
+}
+
+template <typename T, size_t BlockSize>
+MemoryPool<T, BlockSize>::MemoryPool(BlockAllocator allocator, void* context)
+noexcept :
+MemoryPool()
+{
+  blockAllocator_ = allocator;
+  blockContext_ = context;
 }
 
 template <typename T, size_t BlockSize>
@@ -54,6 +69,12 @@ noexcept
   currentSlot_ = memoryPool.currentSlot_;
   lastSlot_ = memoryPool.lastSlot_;
   freeSlots_ = memoryPool.freeSlots;
+#if PERF_STATS
+  inUse_ = memoryPool.inUse_;
+  highWater_ = memoryPool.highWater_;
+#endif
+  blockAllocator_ = memoryPool.blockAllocator_;
+  blockContext_ = memoryPool.blockContext_;
 }
 
 template <typename T, size_t BlockSize>
@@ -74,6 +95,12 @@ noexcept
     currentSlot_ = memoryPool.currentSlot_;
     lastSlot_ = memoryPool.lastSlot_;
     freeSlots_ = memoryPool.freeSlots;
+#if PERF_STATS
+    inUse_ = memoryPool.inUse_;
+    highWater_ = memoryPool.highWater_;
+#endif
+    std::swap(blockAllocator_, memoryPool.blockAllocator_);
+    std::swap(blockContext_, memoryPool.blockContext_);
   }
   return *this;
 }
@@ -82,6 +109,7 @@ template <typename T, size_t BlockSize>
 MemoryPool<T, BlockSize>::~MemoryPool()
 noexcept
 {
+  if (blockAllocator_ != nullptr) return;
   slot_pointer_ curr = currentBlock_;
   while (curr != nullptr) {
     slot_pointer_ prev = curr->next;
@@ -112,7 +140,9 @@ MemoryPool<T, BlockSize>::allocateBlock()
 {
   // Allocate space for the new block and store a pointer to the previous one
   data_pointer_ newBlock = reinterpret_cast<data_pointer_>
-                           (operator new(BlockSize));
+                           ((blockAllocator_ != nullptr) ?
+                            blockAllocator_(blockContext_, BlockSize) :
+                            operator new(BlockSize));
   reinterpret_cast<slot_pointer_>(newBlock)->next = currentBlock_;
   currentBlock_ = reinterpret_cast<slot_pointer_>(newBlock);
   // Pad block body to staisfy the alignment requirements for elements
@@ -127,6 +157,9 @@ template <typename T, size_t BlockSize>
 inline typename MemoryPool<T, BlockSize>::pointer
 MemoryPool<T, BlockSize>::allocate(size_type n, const_pointer hint)
 {
+#if PERF_STATS
+  if (++inUse_ > highWater_) highWater_ = inUse_;
+#endif
   if (freeSlots_ != nullptr) {
     pointer result = reinterpret_cast<pointer>(freeSlots_);
     freeSlots_ = freeSlots_->next;
@@ -146,6 +179,9 @@ MemoryPool<T, BlockSize>::deallocate(pointer p, size_type n)
   if (p != nullptr) {
     reinterpret_cast<slot_pointer_>(p)->next = freeSlots_;
     freeSlots_ = reinterpret_cast<slot_pointer_>(p);
+#if PERF_STATS
+    inUse_--;
+#endif
   }
 }
 
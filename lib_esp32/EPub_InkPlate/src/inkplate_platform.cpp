@@ -5,6 +5,7 @@
 #include <cstdio>
 
 #include "logging.hpp"
+#include "screen.hpp"
 
 #include "esp_err.h"
 #include "esp_vfs_fat.h"
@@ -70,6 +71,8 @@ bool InkPlatePlatform::setup(bool sd_card_init)
 bool InkPlatePlatform::light_sleep(uint32_t minutes_to_sleep, gpio_num_t gpio_num, int level)
 {
   // TODO: Implement proper light sleep with GPIO + timer wake.
+  // The panel must have completed the pending update first.
+  screen.wait_for_updates();
   (void)minutes_to_sleep;
   (void)gpio_num;
   (void)level;
@@ -80,7 +83,9 @@ bool InkPlatePlatform::light_sleep(uint32_t minutes_to_sleep, gpio_num_t gpio_nu
 void InkPlatePlatform::deep_sleep(gpio_num_t gpio_num, int level)
 {
   // TODO: Implement proper deep sleep configuration. For now,
-  // just log and return so we can keep debugging.
+  // just log and return so we can keep debugging. The panel must have
+  // completed the pending update first.
+  screen.wait_for_updates();
   (void)gpio_num;
   (void)level;
   LOG_I("Paper S3 deep_sleep stub; not sleeping (gpio=%d, level=%d)", (int)gpio_num, level);
@@ -29,6 +29,7 @@ class Screen : NonCopyable
 
     enum class Orientation     : int8_t { LEFT, RIGHT, BOTTOM, TOP };
     enum class PixelResolution : int8_t { ONE_BIT, THREE_BITS };
+    enum class UpdateMode      : int8_t { DU, GL16, GC16 };
 
     void          draw_bitmap(const unsigned char * bitmap_data, Dim dim, Pos pos);
     void           draw_glyph(const unsigned char * bitmap_data, Dim dim, Pos pos, uint16_t pitch);
@@ -39,6 +40,27 @@ class Screen : NonCopyable
     void clear();
     void update(bool no_full = false);
 
+    typedef uint32_t Fence;
+
+    /**
+     * @brief Update a region of the display with a given waveform
+     * 
+     * The waveform is selected by the RefreshScheduler. Drawing is done in a
+     * back buffer: the region is copied to the epdiy frame buffer once the 
+     * previous update is completed, and the panel is updated by the panel 
+     * task. This method returns without waiting for the panel.
+     * 
+     * @param mode The waveform
+     * @param dim Region dimensions
+     * @param pos Region position
+     * @return Fence The fence to wait on for the update to be shown
+     */
+    Fence update(UpdateMode mode, Dim dim, Pos pos);
+
+    void   wait_for_fence(Fence fence);
+    bool is_fence_reached(Fence fence);
+    void wait_for_updates();
+
   private:
     static constexpr char const * TAG = "Screen";
     
@@ -87,6 +109,7 @@ class Screen : NonCopyable
     #endif
     enum class Orientation     : int8_t { LEFT, RIGHT, BOTTOM, TOP };
     enum class PixelResolution : int8_t { ONE_BIT, THREE_BITS };
+    enum class UpdateMode      : int8_t { DU, GL16, GC16 };
 
     void          draw_bitmap(const unsigned char * bitmap_data, Dim dim, Pos pos);
     void           draw_glyph(const unsigned char * bitmap_data, Dim dim, Pos pos, uint16_t pitch);
@@ -129,6 +152,31 @@ class Screen : NonCopyable
       }
     }
 
+    typedef uint32_t Fence;
+
+    /**
+     * @brief Update the display with a given waveform
+     * 
+     * The panel driver doesn't support regions nor waveform selection: 
+     * GC16 is done as a full update and the others as a partial update
+     * (one bit per pixel only). The update is synchronous: the returned 
+     * fence is always reached.
+     */
+    inline Fence update(UpdateMode mode, Dim dim, Pos pos) {
+      if (pixel_resolution == PixelResolution::ONE_BIT) {
+        if (mode == UpdateMode::GC16) e_ink.update(*frame_buffer_1bit);
+        else                          e_ink.partial_update(*frame_buffer_1bit);
+      }
+      else {
+        e_ink.update(*frame_buffer_3bit);
+      }
+      return 0;
+    }
+
+    inline void   wait_for_fence(Fence fence) { }
+    inline bool is_fence_reached(Fence fence) { return true; }
+    inline void wait_for_updates()            { }
+
   private:
     static constexpr char const * TAG = "Screen";
     static const uint8_t          LUT1BIT[8];
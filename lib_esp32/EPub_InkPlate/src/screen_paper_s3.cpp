@@ -3,6 +3,13 @@
 
 #if defined(BOARD_TYPE_PAPER_S3)
 
+#include "alloc.hpp"
+#include "helpers/panel_pipeline.hpp"
+
+#include <cstring>
+
+#include "esp_pm.h"
+
 extern "C" {
   #include <epdiy.h>
   #include <epd_highlevel.h>
@@ -24,7 +31,11 @@ extern "C" {
 
 static EpdiyHighlevelState s_hl;
 static bool s_epd_initialized = false;
-static uint8_t *s_framebuffer = nullptr;
+static uint8_t *s_framebuffer = nullptr;  // epdiy front buffer, read by the panel task
+static uint8_t *s_back_buffer = nullptr;  // Drawing is done here
+static PanelPipeline s_pipeline;
+static esp_pm_lock_handle_t s_pm_lock = nullptr;  // No light sleep during panel updates
+static const uint32_t FRAME_BUFFER_SIZE = EPD_WIDTH / 2 * EPD_HEIGHT;
 static bool s_force_full = true;
 static int16_t s_partial_count = 0;
 static const int16_t PARTIAL_COUNT_ALLOWED = 10;
@@ -38,33 +49,116 @@ uint16_t Screen::height = EPD_HEIGHT;
 void Screen::clear()
 {
   if (!s_epd_initialized) return;
-  epd_hl_set_all_white(&s_hl);
+  memset(s_back_buffer, 0xFF, FRAME_BUFFER_SIZE);
 }
 
 void Screen::update(bool no_full)
 {
   if (!s_epd_initialized) return;
 
+  UpdateMode mode;
+
   if (s_force_full) {
-    epd_hl_update_screen(&s_hl, MODE_GC16, s_temperature);
+    mode = UpdateMode::GC16;
     s_force_full = false;
     s_partial_count = PARTIAL_COUNT_ALLOWED;
-    return;
   }
-
-  if (no_full) {
-    epd_hl_update_screen(&s_hl, MODE_GL16, s_temperature);
+  else if (no_full) {
+    mode = UpdateMode::GL16;
     s_partial_count = 0;
-    return;
   }
-
-  if (s_partial_count <= 0) {
-    epd_hl_update_screen(&s_hl, MODE_GC16, s_temperature);
+  else if (s_partial_count <= 0) {
+    mode = UpdateMode::GC16;
     s_partial_count = PARTIAL_COUNT_ALLOWED;
   } else {
-    epd_hl_update_screen(&s_hl, MODE_GL16, s_temperature);
+    mode = UpdateMode::GL16;
     s_partial_count--;
   }
+
+  update(mode, Dim(width, height), Pos(0, 0));
+}
+
+// Executed by the panel task, from the epdiy front buffer.
+
+static void execute_update(const PanelPipeline::Request & req)
+{
+  Screen::UpdateMode mode = (Screen::UpdateMode) req.mode;
+
+  EpdDrawMode epd_mode = (mode == Screen::UpdateMode::DU  ) ? MODE_DU   :
+                         (mode == Screen::UpdateMode::GL16) ? MODE_GL16 : MODE_GC16;
+
+  if (s_pm_lock != nullptr) esp_pm_lock_acquire(s_pm_lock);
+
+  if ((req.dim.width >= Screen::get_width()) && (req.dim.height >= Screen::get_height())) {
+    epd_hl_update_screen(&s_hl, epd_mode, s_temperature);
+  }
+  else {
+    // The area is in logical (rotated) coordinates: epdiy applies the
+    // rotation set at init time.
+    EpdRect area = {
+      .x      = req.pos.x,
+      .y      = req.pos.y,
+      .width  = req.dim.width,
+      .height = req.dim.height
+    };
+    epd_hl_update_area(&s_hl, epd_mode, s_temperature, area);
+  }
+
+  if (s_pm_lock != nullptr) esp_pm_lock_release(s_pm_lock);
+}
+
+// Copy a logical region from the back buffer to the epdiy front buffer.
+// Logical (x, y) is physical (y, EPD_HEIGHT - 1 - x): the logical columns
+// are the physical rows.
+
+static void copy_to_front(Dim dim, Pos pos)
+{
+  uint16_t x_max = pos.x + dim.width;
+  uint16_t y_max = pos.y + dim.height;
+  if (x_max > EPD_HEIGHT) x_max = EPD_HEIGHT;
+  if (y_max > EPD_WIDTH ) y_max = EPD_WIDTH;
+  if ((x_max <= pos.x) || (y_max <= pos.y)) return;
+
+  if ((pos.x == 0) && (pos.y == 0) && (x_max == EPD_HEIGHT) && (y_max == EPD_WIDTH)) {
+    memcpy(s_framebuffer, s_back_buffer, FRAME_BUFFER_SIZE);
+    return;
+  }
+
+  const uint32_t from = pos.y >> 1;
+  const uint32_t size = ((y_max + 1) >> 1) - from;
+
+  for (uint16_t row = EPD_HEIGHT - x_max; row < EPD_HEIGHT - pos.x; ++row) {
+    const uint32_t offset = row * (EPD_WIDTH / 2) + from;
+    memcpy(&s_framebuffer[offset], &s_back_buffer[offset], size);
+  }
+}
+
+Screen::Fence Screen::update(UpdateMode mode, Dim dim, Pos pos)
+{
+  if (!s_epd_initialized) return s_pipeline.get_last_fence();
+
+  // The front buffer is being read by the panel until the previous
+  // update is completed.
+
+  s_pipeline.wait_for_all();
+  copy_to_front(dim, pos);
+
+  return s_pipeline.submit({ .mode = (int8_t) mode, .dim = dim, .pos = pos });
+}
+
+void Screen::wait_for_fence(Fence fence)
+{
+  s_pipeline.wait_for_fence(fence);
+}
+
+bool Screen::is_fence_reached(Fence fence)
+{
+  return s_pipeline.is_fence_reached(fence);
+}
+
+void Screen::wait_for_updates()
+{
+  s_pipeline.wait_for_all();
 }
 
 void Screen::force_full_update()
@@ -90,6 +184,13 @@ void Screen::setup(PixelResolution resolution, Orientation orientation)
     epd_hl_set_all_white(&s_hl);
     s_framebuffer = epd_hl_get_framebuffer(&s_hl);
 
+    s_back_buffer = (uint8_t *) allocate(FRAME_BUFFER_SIZE);
+    if (s_back_buffer == nullptr) {
+      LOG_E("Unable to allocate the back buffer.");
+      return;
+    }
+    memset(s_back_buffer, 0xFF, FRAME_BUFFER_SIZE);
+
     epd_poweron();
     // Ensure any previous image on the panel is fully cleared on first
     // boot so we start from a clean white screen.
@@ -97,6 +198,13 @@ void Screen::setup(PixelResolution resolution, Orientation orientation)
     s_epd_initialized = true;
     s_force_full = false;
     s_partial_count = PARTIAL_COUNT_ALLOWED;
+
+    // Fails when power management is not enabled: no lock is then needed.
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "panel", &s_pm_lock) != ESP_OK) {
+      s_pm_lock = nullptr;
+    }
+
+    s_pipeline.start(execute_update);
   }
 
   // On Paper S3 we always drive the panel in grayscale (4-bit via epdiy).
@@ -153,9 +261,9 @@ static inline uint8_t gray3_to_nibble(uint8_t v)
 
 static inline void set_pixel_nibble_physical(uint16_t x, uint16_t y, uint8_t nibble)
 {
-  // Write a 4-bpp pixel directly into the epdiy framebuffer.
+  // Write a 4-bpp pixel into the back buffer.
   // x: 0..EPD_WIDTH-1 (960), y: 0..EPD_HEIGHT-1 (540)
-  uint8_t * buf_ptr = &s_framebuffer[y * (EPD_WIDTH / 2) + (x >> 1)];
+  uint8_t * buf_ptr = &s_back_buffer[y * (EPD_WIDTH / 2) + (x >> 1)];
   if (x & 1) {
     *buf_ptr = (uint8_t)((*buf_ptr & 0x0F) | ((nibble & 0x0F) << 4));
   } else {
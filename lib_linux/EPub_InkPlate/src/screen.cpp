@@ -7,6 +7,8 @@
 // As all GTK related code is located in this module, we also implement
 // some part of the event manager code here...
 
+#if !EPUB_HEADLESS
+
 #define __SCREEN__ 1
 #include "screen.hpp"
 
@@ -302,6 +304,17 @@ Screen::update(bool no_full)
   gtk_image_set_from_pixbuf(GTK_IMAGE(image_data.image), gtk_image_get_pixbuf(image_data.image));
 }
 
+// The GTK window is updated synchronously: the returned fence is always reached.
+
+Screen::Fence
+Screen::update(UpdateMode mode, Dim dim, Pos pos)
+{
+  record_update(mode, dim, pos);
+  update();
+
+  return pipeline.get_last_fence();
+}
+
 extern void exit_app();
 
 static void 
@@ -415,3 +428,5 @@ Screen::set_orientation(Orientation orient)
     height = 600;
   }
 }
+
+#endif
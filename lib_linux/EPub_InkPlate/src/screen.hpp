@@ -6,8 +6,15 @@
 #include "global.hpp"
 
 #include "non_copyable.hpp"
+#include "helpers/panel_pipeline.hpp"
 
-#include <gtk/gtk.h>
+#include <vector>
+
+#if EPUB_HEADLESS
+  #include <string>
+#else
+  #include <gtk/gtk.h>
+#endif
 
 /**
  * @brief Low level logical Screen display
@@ -16,6 +23,11 @@
  * on the display. Under Linux, it generate a GTK window. On a InkPlate6
  * it is using the EInk display driver. 
  * 
+ * When EPUB_HEADLESS is set, the Linux version paints in an 8 bits
+ * per pixel in-memory frame buffer and no window is created. The frame
+ * buffer can be saved as a PGM image. The e-paper panel is simulated
+ * with a second buffer, updated by the panel task as on the Paper S3.
+ * 
  * This is a singleton. It cannot be instanciated elsewhere. It is not 
  * instanciated in the heap. This is reinforced by the C++ construction
  * below. It also cannot be copied through the NonCopyable derivation.
@@ -24,13 +36,34 @@
 class Screen : NonCopyable
 {
   public:
-    static constexpr int8_t   IDENT       =   99;
-    static constexpr uint16_t RESOLUTION  =  166;  ///< Pixels per inch
-    static constexpr uint8_t  BLACK_COLOR = 0x00;
-    static constexpr uint8_t  WHITE_COLOR = 0xFF;
+    #if EPUB_HEADLESS
+      static int8_t             IDENT;             ///< The emulated device, see set_profile()
+      static uint16_t           RESOLUTION;        ///< Pixels per inch
+    #else
+      static constexpr int8_t   IDENT       =   99;
+      static constexpr uint16_t RESOLUTION  =  166;  ///< Pixels per inch
+    #endif
+    static constexpr uint8_t    BLACK_COLOR = 0x00;
+    static constexpr uint8_t    WHITE_COLOR = 0xFF;
     
     enum class Orientation     : int8_t { LEFT, RIGHT, BOTTOM };
     enum class PixelResolution : int8_t { ONE_BIT, THREE_BITS };
+    enum class UpdateMode      : int8_t { DU, GL16, GC16 };
+
+    /**
+     * @brief Simulated e-paper panel update
+     * 
+     * The duration is modeled from rough Paper S3 (ED047TC2) figures: the 
+     * full screen duration of the waveform, reduced with the number of panel
+     * lines covered by the region (the panel lines are the screen columns,
+     * the panel being rotated). There is a fixed cost, even for small regions.
+     */
+    struct PanelUpdate {
+      UpdateMode mode;
+      Dim        dim;
+      Pos        pos;
+      uint16_t   duration;       ///< Modeled duration in milliseconds
+    };
 
     void           draw_bitmap(const unsigned char * bitmap_data, Dim dim, Pos pos);
     void            draw_glyph(const unsigned char * bitmap_data, Dim dim, Pos pos, uint16_t pitch);
@@ -39,6 +72,22 @@ class Screen : NonCopyable
     void       colorize_region(Dim dim, Pos pos, uint8_t color);
     void                 clear();
     void                update(bool no_full = false); // Parameter only used by the InkPlate version
+
+    typedef PanelPipeline::Fence Fence;
+
+    /**
+     * @brief Update a region of the display with a given waveform
+     * 
+     * The update is recorded in the simulated panel updates list. In headless
+     * mode, the region is copied to the panel buffer once the previous update
+     * is completed, and the panel task does the update.
+     * 
+     * @param mode The waveform, selected by the RefreshScheduler
+     * @param dim Region dimensions
+     * @param pos Region position
+     * @return Fence The fence to wait on for the update to be shown
+     */
+    Fence               update(UpdateMode mode, Dim dim, Pos pos);
     void                  test();
 
   private:
@@ -52,14 +101,43 @@ class Screen : NonCopyable
     static uint16_t width;
     static uint16_t height;
 
-    struct ImageData {
-      GtkImage * image;
-      int rows, cols, stride;
-    };
+    #if EPUB_HEADLESS
+      struct ImageData {
+        uint8_t * pixels;
+        int rows, cols, stride;
+      };
+    #else
+      struct ImageData {
+        GtkImage * image;
+        int rows, cols, stride;
+      };
+    #endif
 
     ImageData       image_data;
     PixelResolution pixel_resolution;
     Orientation     orientation;
+    PanelPipeline   pipeline;
+
+    #if EPUB_HEADLESS
+      uint8_t * panel_pixels;               ///< Simulated panel content (front buffer)
+      uint32_t  frame_size;                 ///< Pixels allocated for each buffer
+      bool      panel_timing;               ///< Panel updates last their modeled duration
+
+      static uint16_t panel_width;          ///< In the BOTTOM orientation
+      static uint16_t panel_height;
+      static bool     panel_rotates;
+
+      static void execute_update(const PanelPipeline::Request & request);
+    #endif
+
+    static constexpr uint16_t MAX_PANEL_UPDATES = 256;
+
+    std::vector<PanelUpdate> panel_updates;  ///< Most recent last
+
+    inline void record_update(UpdateMode mode, Dim dim, Pos pos) {
+      if (panel_updates.size() >= MAX_PANEL_UPDATES) panel_updates.erase(panel_updates.begin());
+      panel_updates.push_back({ mode, dim, pos, get_modeled_duration(mode, dim) });
+    }
 
     enum class Corner : uint8_t { TOP_LEFT, TOP_RIGHT, LOWER_LEFT, LOWER_RIGHT };
     void draw_arc(uint16_t x_mid,  uint16_t y_mid,  uint8_t radius, Corner corner, uint8_t color);
@@ -71,14 +149,65 @@ class Screen : NonCopyable
     void                   set_pixel_resolution(PixelResolution resolution, bool force = false);
     void                        set_orientation(Orientation orient);
     inline PixelResolution get_pixel_resolution() { return pixel_resolution; }
-    GtkImage *                        get_image() { return image_data.image; }
+    #if EPUB_HEADLESS
+      inline const uint8_t *   get_frame_buffer() { return image_data.pixels; }
+      inline const uint8_t *   get_panel_buffer() { return panel_pixels;      }
+
+      /**
+       * @brief Simulate the panel updates duration
+       * 
+       * @param timing If true, the panel task waits for the modeled duration of every update
+       */
+      inline void             set_panel_timing(bool timing) { panel_timing = timing; }
+
+      /**
+       * @brief Emulate the screen of a device
+       * 
+       * The pages locations computed afterward are the ones of the device,
+       * its identification being part of the book format parameters. Takes
+       * effect at the next set_orientation() call.
+       * 
+       * @param ident The device Screen::IDENT
+       * @param resolution The device pixels per inch
+       * @param width The panel width, in the BOTTOM orientation
+       * @param height The panel height, in the BOTTOM orientation
+       * @param rotates False if the dimensions don't follow the orientation
+       */
+      static void                   set_profile(int8_t ident, uint16_t resolution, 
+                                                uint16_t width, uint16_t height, bool rotates);
+
+      /**
+       * @brief Save the frame buffer content
+       * 
+       * @param filename The PGM (binary graymap) file to create
+       * @return true The image has been saved
+       */
+      bool                             save_pgm(const std::string & filename);
+    #else
+      GtkImage *                      get_image() { return image_data.image; }
+    #endif
     void                          to_user_coord(uint16_t & x, uint16_t & y) {}
     inline void               force_full_update() { }
 
+    inline void                  wait_for_fence(Fence fence) { pipeline.wait_for_fence(fence);          }
+    inline bool                is_fence_reached(Fence fence) { return pipeline.is_fence_reached(fence); }
+    inline void                wait_for_updates()            { pipeline.wait_for_all();                 }
+
+    inline const std::vector<PanelUpdate> & get_panel_updates() const { return panel_updates; }
+    inline void                           clear_panel_updates()       { panel_updates.clear(); }
+
+    static uint16_t get_modeled_duration(UpdateMode mode, Dim dim) {
+      uint16_t full = (mode == UpdateMode::DU  ) ? 260 :
+                      (mode == UpdateMode::GL16) ? 450 : 780;
+      uint16_t w    = (dim.width > width) ? width : dim.width;
+      return (full + (3 * full * w) / width) / 4;
+    }
+
     inline static uint16_t get_width() { return width; }
     inline static uint16_t get_height() { return height; }
     
-    #if TOUCH_TRIAL
+    #if EPUB_HEADLESS
+    #elif TOUCH_TRIAL
       GtkWidget
         * window,
         * image_box;
@@ -0,0 +1,392 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+// In-memory frame buffer emulation of the InkPlate screen
+//
+// Used to run the application on a host without a display. Pixels are
+// kept as 8 bits gray levels, the same way the GTK version shows them.
+
+#if EPUB_HEADLESS
+
+#define __SCREEN__ 1
+#include "screen.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+Screen Screen::singleton;
+
+uint16_t Screen::width;
+uint16_t Screen::height;
+
+int8_t   Screen::IDENT         =   99;
+uint16_t Screen::RESOLUTION    =  166;
+uint16_t Screen::panel_width   =  800;
+uint16_t Screen::panel_height  =  600;
+bool     Screen::panel_rotates = true;
+
+const uint8_t Screen::LUT1BIT[8] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+inline void
+setpixel(uint8_t * a, int row, int col, int stride, uint8_t color)
+{
+  a[row * stride + col] = color;
+}
+
+void
+Screen::draw_bitmap(
+  const unsigned char * bitmap_data,
+  Dim                   dim,
+  Pos                   pos)
+{
+  if (bitmap_data == nullptr) return;
+
+  uint8_t * g = image_data.pixels;
+
+  if (pos.x > width) pos.x = 0;
+  if (pos.y > height) pos.y = 0;
+
+  int16_t x_max = pos.x + dim.width;
+  int16_t y_max = pos.y + dim.height;
+
+  if (y_max > height) y_max = height;
+  if (x_max > width ) x_max = width;
+
+  if (pixel_resolution == PixelResolution::ONE_BIT) {
+    std::vector<int16_t> err(dim.width + 2, 0);
+    int16_t error;
+
+    for (int j = pos.y, q = 0; j < y_max; j++, q++) {
+      for (int i = pos.x, p = q * dim.width, k = 0; i < (x_max - 1); i++, p++, k++) {
+        int32_t v = bitmap_data[p] + err[k + 1];
+        if (v > 128) {
+          error = (v - 255);
+          setpixel(g, j, i, image_data.stride, 255);
+        }
+        else {
+          error = v;
+          setpixel(g, j, i, image_data.stride, 0);
+        }
+        if (k != 0) {
+          err[k - 1] += error / 8;
+        }
+        err[k]     += 3 * error / 8;
+        err[k + 1]  =     error / 8;
+        err[k + 2] += 3 * error / 8;
+      }
+    }
+  }
+  else {
+    for (int j = pos.y, q = 0; j < y_max; j++, q++) {
+      memcpy(&g[j * image_data.stride + pos.x], &bitmap_data[q * dim.width], x_max - pos.x);
+    }
+  }
+}
+
+void
+Screen::draw_rectangle(
+  Dim      dim,
+  Pos      pos,
+  uint8_t  color)
+{
+  uint8_t * g = image_data.pixels;
+
+  int16_t x_max = pos.x + dim.width;
+  int16_t y_max = pos.y + dim.height;
+
+  if (y_max > height) y_max = height;
+  if (x_max > width ) x_max = width;
+
+  for (int i = pos.x; i < x_max; i++) {
+    setpixel(g, pos.y, i, image_data.stride, color);
+    setpixel(g, y_max - 1, i, image_data.stride, color);
+  }
+  for (int j = pos.y; j < y_max; j++) {
+    setpixel(g, j, pos.x, image_data.stride, color);
+    setpixel(g, j, x_max - 1, image_data.stride, color);
+  }
+}
+
+void
+Screen::draw_arc(uint16_t x_mid,  uint16_t y_mid,  uint8_t radius, Corner corner, uint8_t color)
+{
+  int16_t f     =  1 - radius;
+  int16_t ddF_x =           1;
+  int16_t ddF_y = -2 * radius;
+  int16_t x     =           0;
+  int16_t y     =      radius;
+
+  uint8_t * g = image_data.pixels;
+
+  while( x < y ) {
+    if(f >= 0) {
+      y--;
+      ddF_y += 2;
+      f     += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+
+    switch (corner) {
+      case Corner::TOP_LEFT:
+        setpixel(g, y_mid - y, x_mid - x, image_data.stride, color);
+        setpixel(g, y_mid - x, x_mid - y, image_data.stride, color);
+        break;
+
+      case Corner::TOP_RIGHT:
+        setpixel(g, y_mid - y, x_mid + x, image_data.stride, color);
+        setpixel(g, y_mid - x, x_mid + y, image_data.stride, color);
+        break;
+
+      case Corner::LOWER_LEFT:
+        setpixel(g, y_mid + y, x_mid - x, image_data.stride, color);
+        setpixel(g, y_mid + x, x_mid - y, image_data.stride, color);
+        break;
+
+      case Corner::LOWER_RIGHT:
+        setpixel(g, y_mid + y, x_mid + x, image_data.stride, color);
+        setpixel(g, y_mid + x, x_mid + y, image_data.stride, color);
+        break;
+    }
+  }
+}
+
+void
+Screen::draw_round_rectangle(
+  Dim      dim,
+  Pos      pos,
+  uint8_t  color)
+{
+  uint8_t * g = image_data.pixels;
+
+  int16_t x_max = pos.x + dim.width;
+  int16_t y_max = pos.y + dim.height;
+
+  if (y_max > height) y_max = height;
+  if (x_max > width ) x_max = width;
+
+  for (int i = pos.x + 10; i < x_max - 10; i++) {
+    setpixel(g, pos.y, i, image_data.stride, color);
+    setpixel(g, y_max - 1, i, image_data.stride, color);
+  }
+  for (int j = pos.y + 10; j < y_max - 10; j++) {
+    setpixel(g, j, pos.x, image_data.stride, color);
+    setpixel(g, j, x_max - 1, image_data.stride, color);
+  }
+
+  draw_arc(pos.x + 10,             pos.y + 10,              10, Corner::TOP_LEFT,    color);
+  draw_arc(pos.x + dim.width - 11, pos.y + 10,              10, Corner::TOP_RIGHT,   color);
+  draw_arc(pos.x + 10,             pos.y + dim.height - 11, 10, Corner::LOWER_LEFT,  color);
+  draw_arc(pos.x + dim.width - 11, pos.y + dim.height - 11, 10, Corner::LOWER_RIGHT, color);
+}
+
+void
+Screen::colorize_region(
+  Dim      dim,
+  Pos      pos,
+  uint8_t  color)
+{
+  uint8_t * g = image_data.pixels;
+
+  int16_t x_max = pos.x + dim.width;
+  int16_t y_max = pos.y + dim.height;
+
+  if (y_max > height) y_max = height;
+  if (x_max > width ) x_max = width;
+
+  for (int j = pos.y; j < y_max; j++) {
+    memset(&g[j * image_data.stride + pos.x], color, x_max - pos.x);
+  }
+}
+
+void
+Screen::draw_glyph(
+  const unsigned char * bitmap_data,
+  Dim                   dim,
+  Pos                   pos,
+  uint16_t              pitch)
+{
+  uint8_t * g = image_data.pixels;
+
+  int x_max = pos.x + dim.width;
+  int y_max = pos.y + dim.height;
+
+  if (y_max > height) y_max = height;
+  if (x_max > width ) x_max = width;
+
+  if (pixel_resolution == PixelResolution::ONE_BIT) {
+    for (int j = pos.y, q = 0; j < y_max; j++, q++) {
+      for (int i = pos.x, p = (q * pitch) << 3; i < x_max; i++, p++) {
+        uint8_t v = bitmap_data[p >> 3] & LUT1BIT[p & 7];
+        if (v) setpixel(g, j, i, image_data.stride, 0);
+      }
+    }
+  }
+  else {
+    for (int j = pos.y, q = 0; j < y_max; j++, q++) {
+      for (int i = pos.x, p = q * pitch; i < x_max; i++, p++) {
+        uint8_t v = (255 - bitmap_data[p]) & 0xE0;
+        if (v != 0xE0) setpixel(g, j, i, image_data.stride, v);
+      }
+    }
+  }
+}
+
+void
+Screen::clear()
+{
+  memset(image_data.pixels, WHITE_COLOR, image_data.rows * image_data.stride);
+}
+
+void
+Screen::test()
+{
+  static int N = 0;
+
+  clear();
+
+  for (int r = 0; r < image_data.rows; r++)
+    for (int c = 0; c < image_data.cols; c++)
+      if ((r + N) / 20 % 2 && (c + N) / 20 % 2)
+        setpixel(image_data.pixels, r, c, image_data.stride, 0);
+
+  N = (N + 1) % 100;
+
+  update();
+}
+
+void
+Screen::update(bool no_full)
+{
+  // Nothing to show...
+}
+
+// Executed by the panel task. The panel buffer already contains the
+// region to update.
+
+void
+Screen::execute_update(const PanelPipeline::Request & req)
+{
+  if (screen.panel_timing) {
+    usleep(get_modeled_duration((UpdateMode) req.mode, req.dim) * 1000);
+  }
+}
+
+Screen::Fence
+Screen::update(UpdateMode mode, Dim dim, Pos pos)
+{
+  record_update(mode, dim, pos);
+
+  int16_t x_max = pos.x + dim.width;
+  int16_t y_max = pos.y + dim.height;
+
+  if (y_max > height) y_max = height;
+  if (x_max > width ) x_max = width;
+
+  // The panel buffer is in use until the previous update is completed
+
+  pipeline.wait_for_all();
+
+  if ((panel_pixels != nullptr) && (x_max > pos.x)) {
+    for (int j = pos.y; j < y_max; j++) {
+      memcpy(&panel_pixels[j * image_data.stride + pos.x], 
+             &image_data.pixels[j * image_data.stride + pos.x], 
+             x_max - pos.x);
+    }
+  }
+
+  return pipeline.submit({ .mode = (int8_t) mode, .dim = dim, .pos = pos });
+}
+
+bool
+Screen::save_pgm(const std::string & filename)
+{
+  FILE * f = fopen(filename.c_str(), "wb");
+  if (f == nullptr) {
+    LOG_E("Unable to create %s", filename.c_str());
+    return false;
+  }
+
+  fprintf(f, "P5\n%d %d\n255\n", image_data.cols, image_data.rows);
+
+  bool res = true;
+  for (int r = 0; r < image_data.rows; r++) {
+    if (fwrite(&image_data.pixels[r * image_data.stride], image_data.cols, 1, f) != 1) {
+      res = false;
+      break;
+    }
+  }
+
+  fclose(f);
+  return res;
+}
+
+void
+Screen::setup(PixelResolution resolution, Orientation orientation)
+{
+  set_orientation(orientation);
+  set_pixel_resolution(resolution, true);
+
+  pipeline.start(execute_update);
+}
+
+void
+Screen::set_pixel_resolution(PixelResolution resolution, bool force)
+{
+  if (force || (pixel_resolution != resolution)) {
+    pixel_resolution = resolution;
+  }
+}
+
+void
+Screen::set_profile(int8_t ident, uint16_t resolution, uint16_t width, uint16_t height, bool rotates)
+{
+  IDENT         = ident;
+  RESOLUTION    = resolution;
+  panel_width   = width;
+  panel_height  = height;
+  panel_rotates = rotates;
+}
+
+void
+Screen::set_orientation(Orientation orient)
+{
+  pipeline.wait_for_all();
+
+  orientation = orient;
+  if (panel_rotates && ((orientation == Orientation::LEFT) || (orientation == Orientation::RIGHT))) {
+    width  = panel_height;
+    height = panel_width;
+  }
+  else {
+    width  = panel_width;
+    height = panel_height;
+  }
+
+  // Both orientations use the same amount of pixels. The buffers are
+  // reallocated only when the profile requires more pixels.
+
+  if ((uint32_t) width * height > frame_size) {
+    free(image_data.pixels);
+    free(panel_pixels);
+    frame_size        = (uint32_t) width * height;
+    image_data.pixels = (uint8_t *) malloc(frame_size);
+    panel_pixels      = (uint8_t *) malloc(frame_size);
+    if ((image_data.pixels == nullptr) || (panel_pixels == nullptr)) {
+      LOG_E("Unable to allocate the frame buffers.");
+      return;
+    }
+    memset(panel_pixels, WHITE_COLOR, frame_size);
+  }
+
+  image_data.rows   = height;
+  image_data.cols   = width;
+  image_data.stride = width;
+
+  clear();
+}
+
+#endif
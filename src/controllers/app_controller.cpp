@@ -10,7 +10,9 @@
 #include "controllers/book_param_controller.hpp"
 #include "controllers/option_controller.hpp"
 #include "controllers/toc_controller.hpp"
+#include "controllers/search_controller.hpp"
 #include "controllers/event_mgr.hpp"
+#include "helpers/memory_budget.hpp"
 
 #if INKPLATE_6PLUS
   #include "controllers/back_lit.hpp"
@@ -28,10 +30,10 @@ AppController::AppController() :
 }
 
 void
-AppController::start()
+AppController::start(Ctrl first_ctrl)
 {
-  current_ctrl = Ctrl::NONE;
-  next_ctrl    = Ctrl::DIR;
+  current_ctrl = (first_ctrl == Ctrl::DIR) ? Ctrl::NONE : Ctrl::DIR;
+  next_ctrl    = first_ctrl;
 
   #if EPUB_LINUX_BUILD
     launch();
@@ -52,8 +54,13 @@ AppController::set_controller(Ctrl new_ctrl)
   next_ctrl = new_ctrl;
 }
 
+// The viewers keep glyphs pointers in their page while an event is
+// processed: the glyphs caches can only be shrunk in between.
+
 void AppController::launch()
 {
+  MemoryBudget::InUse in_use(MemoryBudget::Consumer::GLYPHS);
+
   #if EPUB_LINUX_BUILD
     if (next_ctrl == Ctrl::NONE) return;
   #endif
@@ -69,6 +76,7 @@ void AppController::launch()
       case Ctrl::PARAM:  book_param_controller.leave(); break;
       case Ctrl::OPTION:     option_controller.leave(); break;
       case Ctrl::TOC:           toc_controller.leave(); break;
+      case Ctrl::SEARCH:     search_controller.leave(); break;
       case Ctrl::NONE:
       case Ctrl::LAST:                                  break;
     }
@@ -91,6 +99,7 @@ void AppController::launch()
       case Ctrl::PARAM:  book_param_controller.enter(); break;
       case Ctrl::OPTION:     option_controller.enter(); break;
       case Ctrl::TOC:           toc_controller.enter(); break;
+      case Ctrl::SEARCH:     search_controller.enter(); break;
       case Ctrl::NONE:
       case Ctrl::LAST:                                  break;
     }
@@ -100,6 +109,8 @@ void AppController::launch()
 void 
 AppController::input_event(const EventMgr::Event & event)
 {
+  MemoryBudget::InUse in_use(MemoryBudget::Consumer::GLYPHS);
+
   if (next_ctrl != Ctrl::NONE) launch();
 
   #if INKPLATE_6PLUS
@@ -119,6 +130,7 @@ AppController::input_event(const EventMgr::Event & event)
     case Ctrl::PARAM:  book_param_controller.input_event(event); break;
     case Ctrl::OPTION:     option_controller.input_event(event); break;
     case Ctrl::TOC:           toc_controller.input_event(event); break;
+    case Ctrl::SEARCH:     search_controller.input_event(event); break;
     case Ctrl::NONE:
     case Ctrl::LAST:                                             break;
   }
@@ -140,6 +152,7 @@ AppController::going_to_deep_sleep()
     case Ctrl::PARAM:  book_param_controller.leave(true); break;
     case Ctrl::OPTION:     option_controller.leave(true); break;
     case Ctrl::TOC:           toc_controller.leave(true); break;
+    case Ctrl::SEARCH:     search_controller.leave(true); break;
     case Ctrl::NONE:
     case Ctrl::LAST:                                      break;
   }
@@ -46,12 +46,15 @@ bool
 BookController::open_book_file(
   const std::string & book_title, 
   const std::string & book_filename, 
-  const PageLocs::PageId & page_id)
+  const PageLocs::PageId & page_id,
+  bool show_loading_msg)
 {
   LOG_D("===> open_book_file()...");
 
-  msg_viewer.show(MsgViewer::MsgType::BOOK, false, false, "Loading a book",
-     "The book \" %s \" is loading. Please wait.", book_title.c_str());
+  if (show_loading_msg) {
+    msg_viewer.show(MsgViewer::MsgType::BOOK, false, false, "Loading a book",
+       "The book \" %s \" is loading. Please wait.", book_title.c_str());
+  }
 
   bool new_document = book_filename != epub.get_current_filename();
 
@@ -9,6 +9,7 @@
 #include "controllers/common_actions.hpp"
 #include "controllers/books_dir_controller.hpp"
 #include "controllers/book_controller.hpp"
+#include "controllers/search_controller.hpp"
 #include "models/books_dir.hpp"
 #include "models/epub.hpp"
 #include "models/config.hpp"
@@ -18,6 +19,10 @@
 #include "viewers/form_viewer.hpp"
 #include "viewers/msg_viewer.hpp"
 
+#if INKPLATE_6PLUS || TOUCH_TRIAL
+  #include "viewers/keyboard_viewer.hpp"
+#endif
+
 #if EPUB_INKPLATE_BUILD && !BOARD_TYPE_PAPER_S3
   #include "esp_system.h"
   #include "eink.hpp"
@@ -26,6 +31,7 @@
 #endif
 
 #include <sys/stat.h>
+#include <unistd.h>
 
 static int8_t show_images;
 static int8_t font_size;
@@ -38,6 +44,10 @@ static int8_t old_show_images;
 static int8_t old_use_fonts_in_book;
 static int8_t old_font;
 
+#if INKPLATE_6PLUS || TOUCH_TRIAL
+  static std::string search_query;
+#endif
+
 #if INKPLATE_6PLUS || TOUCH_TRIAL
   static constexpr int8_t BOOK_PARAMS_FORM_SIZE = 5;
 #else
@@ -161,6 +171,21 @@ delete_book()
   book_param_controller.set_delete_current_book();
 }
 
+#if INKPLATE_6PLUS || TOUCH_TRIAL
+  static void
+  show_search()
+  {
+    keyboard_viewer.show("Search in the e-book", search_query, {});
+  }
+
+  static void
+  search_in_book()
+  {
+    show_search();
+    book_param_controller.set_searching();
+  }
+#endif
+
 static void 
 toc_ctrl()
 {
@@ -197,9 +222,12 @@ power_off()
 // IMPORTANT!!
 // The first (menu[0]) and the last menu entry (the one before END_MENU) MUST ALWAYS BE VISIBLE!!!
 
-static MenuViewer::MenuEntry menu[10] = {
+static MenuViewer::MenuEntry menu[] = {
   { MenuViewer::Icon::RETURN,      "Return to the e-books reader",         CommonActions::return_to_last, true , true },
   { MenuViewer::Icon::TOC,         "Table of Content",                     toc_ctrl                     , false, true },
+  #if INKPLATE_6PLUS || TOUCH_TRIAL
+    { MenuViewer::Icon::BOOK,      "Search in book",                       search_in_book               , true , true },
+  #endif
   { MenuViewer::Icon::BOOK_LIST,   "E-Books list",                         books_list                   , true , true },
   { MenuViewer::Icon::FONT_PARAMS, "Current e-book parameters",            book_parameters              , true , true },
   { MenuViewer::Icon::REVERT,      "Revert e-book parameters to "
@@ -223,8 +251,47 @@ BookParamController::enter()
   menu[1].visible = toc.is_ready() && !toc.is_empty();
   menu_viewer.show(menu);
   book_params_form_is_shown = false;
+  searching                 = false;
 }
 
+#if INKPLATE_6PLUS || TOUCH_TRIAL
+  // The pages found are presented by the search controller once the query
+  // is done. A tap on the title goes back to the menu.
+
+  void
+  BookParamController::search_input_event(const EventMgr::Event & event)
+  {
+    if (event.kind != EventMgr::EventKind::TAP) return;
+
+    char ch = keyboard_viewer.get_key_at(event.x, event.y);
+
+    if (ch == '\r') {
+      if (search_query.empty()) return;
+      searching = false;
+      if (!search_controller.search(search_query)) {
+        menu_viewer.show(menu);
+        msg_viewer.show(MsgViewer::MsgType::INFO, false, false,
+                        "Search unavailable",
+                        "The e-book search index is built with its pages locations. "
+                        "Please retry once they are completed.");
+      }
+    }
+    else if (ch != 0) {
+      if (ch != '\b') {
+        search_query += ch;
+      }
+      else if (!search_query.empty()) {
+        search_query.pop_back();
+      }
+      show_search();
+    }
+    else if (keyboard_viewer.is_title_at(event.x, event.y)) {
+      searching = false;
+      menu_viewer.show(menu);
+    }
+  }
+#endif
+
 void 
 BookParamController::leave(bool going_to_deep_sleep)
 {
@@ -279,28 +346,7 @@ BookParamController::input_event(const EventMgr::Event & event)
           epub.close_file();
           unlink(filepath.c_str());
 
-          int16_t pos = filepath.find_last_of('.');
-
-          filepath.replace(pos, 5, ".pars");
-
-          if (stat(filepath.c_str(), &file_stat) != -1) {
-            LOG_I("Deleting file : %s", filepath.c_str());
-            unlink(filepath.c_str());
-          }
-
-          filepath.replace(pos, 5, ".locs");
-
-          if (stat(filepath.c_str(), &file_stat) != -1) {
-            LOG_I("Deleting file : %s", filepath.c_str());
-            unlink(filepath.c_str());
-          }
-
-          filepath.replace(pos, 5, ".toc");
-
-          if (stat(filepath.c_str(), &file_stat) != -1) {
-            LOG_I("Deleting file : %s", filepath.c_str());
-            unlink(filepath.c_str());
-          }
+          EPub::remove_sidecars(filepath);
 
           int16_t dummy;
           books_dir.refresh(nullptr, dummy, false);
@@ -315,6 +361,11 @@ BookParamController::input_event(const EventMgr::Event & event)
       delete_current_book = false;
     }
   }
+  #if INKPLATE_6PLUS || TOUCH_TRIAL
+    else if (searching) {
+      search_input_event(event);
+    }
+  #endif
   #if EPUB_INKPLATE_BUILD
     else if (wait_for_key_after_wifi) {
       msg_viewer.show(MsgViewer::MsgType::INFO, 
@@ -10,10 +10,13 @@
 #include "models/books_dir.hpp"
 #include "models/config.hpp"
 #include "models/nvs_mgr.hpp"
+#include "models/resume_state.hpp"
 #include "viewers/book_viewer.hpp"
 #include "viewers/linear_books_dir_viewer.hpp"
 #include "viewers/matrix_books_dir_viewer.hpp"
+#include "viewers/keyboard_viewer.hpp"
 #include "screen.hpp"
+#include "helpers/refresh_scheduler.hpp"
 
 #if EPUB_INKPLATE_BUILD
   #include "models/nvs_mgr.hpp"
@@ -120,6 +123,65 @@ BooksDirController::setup()
 
     delete [] book_fname;
   #endif
+
+  library_loaded = true;
+}
+
+bool
+BooksDirController::resume(const ResumeState::Snapshot & snapshot)
+{
+  current_book_index         = -1;
+  last_read_book_index       = -1;
+  book_page_id.itemref_index = snapshot.itemref_index;
+  book_page_id.offset        = snapshot.offset;
+  book_was_shown             = false;
+  resumed_book_id            = snapshot.book_id;
+  library_loaded             = false;
+
+  // On Linux, the filename is relative to the books folder, as in last_book.txt
+
+  book_filename = snapshot.filename;
+  if (book_filename.rfind(BOOKS_FOLDER "/", 0) == 0) {
+    book_filename.erase(0, sizeof(BOOKS_FOLDER));
+  }
+
+  if (book_controller.open_book_file(snapshot.title, snapshot.filename, book_page_id, false)) {
+    return true;
+  }
+
+  LOG_E("Unable to resume with book %s", snapshot.filename);
+  return false;
+}
+
+void
+BooksDirController::load_library()
+{
+  // The book being read was reopened at wake up. The directory is now read,
+  // retrieving the index of that book. As the book has been shown,
+  // it must not be reopened when entering the directory.
+
+  if (library_loaded) return;
+
+  PageLocs::PageId page_id = book_page_id;
+
+  setup();
+
+  book_page_id   = page_id;
+  book_was_shown = false;
+}
+
+void
+BooksDirController::save_resume_state(uint32_t book_id, const PageLocs::PageId & page_id)
+{
+  if (epub.filename_is_empty()) return;
+
+  const char * title = epub.get_title();
+
+  resume_state.save(book_id,
+                    epub.get_current_filename(),
+                    (title == nullptr) ? "" : title,
+                    page_id,
+                    *epub.get_book_format_params());
 }
 
 void
@@ -130,13 +192,20 @@ BooksDirController::save_last_book(const PageLocs::PageId & page_id, bool going_
   // set the "WAS_SHOWN" boolean to true, such that when the device will
   // be booting, it will display the last book at the last page shown.
 
+  // Going to deep sleep right after a resume doesn't require the
+  // books directory: the book id is known from the snapshot.
+
+  if (!going_to_deep_sleep) load_library();
+
   book_page_id = page_id;
 
   #if EPUB_INKPLATE_BUILD
 
-    uint32_t book_id;
+    uint32_t book_id = resumed_book_id;
+    bool     found   = !library_loaded ||
+                       ((current_book_index != -1) && books_dir.get_book_id(current_book_index, book_id));
 
-    if ((current_book_index != -1) && books_dir.get_book_id(current_book_index, book_id)) {
+    if (found) {
 
       NVSMgr::NVSData nvs_data = {
         .offset        = page_id.offset,
@@ -148,8 +217,11 @@ BooksDirController::save_last_book(const PageLocs::PageId & page_id, bool going_
       if (!nvs_mgr.save_location(book_id, nvs_data)) {
         LOG_E("Unable to save current ebook location");
       }
-      last_read_book_index = 
-      current_book_index   = books_dir.get_sorted_idx_from_id(book_id);
+      if (library_loaded) {
+        last_read_book_index = 
+        current_book_index   = books_dir.get_sorted_idx_from_id(book_id);
+      }
+      if (going_to_deep_sleep) save_resume_state(book_id, page_id);
     }
 
   #else
@@ -164,6 +236,7 @@ BooksDirController::save_last_book(const PageLocs::PageId & page_id, bool going_
       );
       fclose(f);
     } 
+    if (going_to_deep_sleep) save_resume_state(0, page_id);
   #endif  
 }
 
@@ -205,9 +278,18 @@ BooksDirController::enter()
   books_dir_viewer = (viewer_id == LINEAR_VIEWER) ? (BooksDirViewer *) &linear_books_dir_viewer : 
                                         (BooksDirViewer *) &matrix_books_dir_viewer;
 
+  load_library();
+
   books_dir_viewer->setup();
-  screen.force_full_update();
+  refresh_scheduler.force_full_update();
   
+  #if INKPLATE_6PLUS || TOUCH_TRIAL
+    if (searching) {
+      show_search();
+      return;
+    }
+  #endif
+
   if (book_was_shown && (last_read_book_index != -1)) {
     show_last_book();
   }
@@ -224,13 +306,130 @@ BooksDirController::leave(bool going_to_deep_sleep)
 }
 
 #if INKPLATE_6PLUS || TOUCH_TRIAL
-  void 
-  BooksDirController::input_event(const EventMgr::Event & event)
+  void
+  BooksDirController::open_book(int16_t idx)
   {
     static std::string book_fname;
     static std::string book_title;
 
-    const BooksDir::EBookRecord * book;
+    const BooksDir::EBookRecord * book = books_dir.get_book_data(idx);
+
+    if (book != nullptr) {
+      current_book_index = last_read_book_index = idx;
+      book_fname    = BOOKS_FOLDER "/";
+      book_fname   += book->filename;
+      book_title    = book->title;
+      book_filename = book->filename;
+      
+      PageLocs::PageId page_id = { 0, 0 };
+
+      #if EPUB_INKPLATE_BUILD
+        NVSMgr::NVSData nvs_data;
+        if (nvs_mgr.get_location(book->id, nvs_data)) {
+          page_id = { nvs_data.itemref_index, nvs_data.offset };
+        }
+      #endif
+      
+      if (book_controller.open_book_file(book_title, book_fname, page_id)) {
+        app_controller.set_controller(AppController::Ctrl::BOOK);
+      }
+    }
+  }
+
+  void
+  BooksDirController::change_view(BooksDir::Order order, const std::string & query)
+  {
+    // The books indexes are in the current view. They are retrieved
+    // in the new one through the books id.
+
+    uint32_t current_id, last_read_id;
+    bool     current_found   = (current_book_index   >= 0) && books_dir.get_book_id(current_book_index,   current_id  );
+    bool     last_read_found = (last_read_book_index >= 0) && books_dir.get_book_id(last_read_book_index, last_read_id);
+
+    books_dir.set_view(order, query);
+
+    current_book_index   = current_found   ? books_dir.get_sorted_idx_from_id(current_id  ) : -1;
+    last_read_book_index = last_read_found ? books_dir.get_sorted_idx_from_id(last_read_id) : -1;
+  }
+
+  void
+  BooksDirController::start_search()
+  {
+    searching = true;
+  }
+
+  void
+  BooksDirController::show_search()
+  {
+    std::vector<std::string> lines;
+    std::string              title, author;
+
+    uint8_t count = keyboard_viewer.get_line_count();
+
+    for (int16_t idx = 0; (idx < books_dir.get_book_count()) && (idx < count); idx++) {
+      if (!books_dir.get_title_author(idx, title, author)) break;
+      if (!author.empty()) {
+        title += " - ";
+        title += author;
+      }
+      lines.push_back(title);
+    }
+
+    const char * order = (books_dir.get_order() == BooksDir::Order::AUTHOR) ? "by Author" :
+                         (books_dir.get_order() == BooksDir::Order::RECENT) ? "Recently Read" : "by Title";
+
+    keyboard_viewer.show(std::string("E-Books ") + order + " (" + std::to_string(books_dir.get_book_count()) + ")",
+                         books_dir.get_query(),
+                         lines);
+  }
+
+  void
+  BooksDirController::search_input_event(const EventMgr::Event & event)
+  {
+    if (event.kind != EventMgr::EventKind::TAP) return;
+
+    std::string query = books_dir.get_query();
+    char        ch    = keyboard_viewer.get_key_at(event.x, event.y);
+    int16_t     idx;
+
+    if (ch == '\r') {
+      searching = false;
+      books_dir_viewer->setup();
+      refresh_scheduler.force_full_update();
+      current_book_index = books_dir_viewer->show_page_and_highlight((current_book_index == -1) ? 0 : current_book_index);
+    }
+    else if (ch != 0) {
+      if (ch != '\b') {
+        query += ch;
+      }
+      else if (!query.empty()) {
+        query.pop_back();
+      }
+      change_view(books_dir.get_order(), query);
+      show_search();
+    }
+    else if ((idx = keyboard_viewer.get_line_at(event.x, event.y)) != -1) {
+      if (idx < books_dir.get_book_count()) {
+        searching = false;
+        open_book(idx);
+      }
+    }
+    else if (keyboard_viewer.is_title_at(event.x, event.y)) {
+      BooksDir::Order order = (books_dir.get_order() == BooksDir::Order::TITLE ) ? BooksDir::Order::AUTHOR :
+                              (books_dir.get_order() == BooksDir::Order::AUTHOR) ? BooksDir::Order::RECENT :
+                                                                                   BooksDir::Order::TITLE;
+      change_view(order, query);
+      show_search();
+    }
+  }
+
+  void 
+  BooksDirController::input_event(const EventMgr::Event & event)
+  {
+    if (searching) {
+      search_input_event(event);
+      return;
+    }
 
     switch (event.kind) {
       case EventMgr::EventKind::SWIPE_RIGHT:
@@ -245,27 +444,7 @@ BooksDirController::leave(bool going_to_deep_sleep)
         if ((viewer_id == MATRIX_VIEWER) || (event.x < (Screen::get_width() / 3))) {
           current_book_index = books_dir_viewer->get_index_at(event.x, event.y);
           if ((current_book_index >= 0) && (current_book_index < books_dir.get_book_count())) {
-            book = books_dir.get_book_data(current_book_index);
-            if (book != nullptr) {
-              last_read_book_index = current_book_index;
-              book_fname    = BOOKS_FOLDER "/";
-              book_fname   += book->filename;
-              book_title    = book->title;
-              book_filename = book->filename;
-              
-              PageLocs::PageId page_id = { 0, 0 };
-
-              #if EPUB_INKPLATE_BUILD
-                NVSMgr::NVSData nvs_data;
-                if (nvs_mgr.get_location(book->id, nvs_data)) {
-                  page_id = { nvs_data.itemref_index, nvs_data.offset };
-                }
-              #endif
-              
-              if (book_controller.open_book_file(book_title, book_fname, page_id)) {
-                app_controller.set_controller(AppController::Ctrl::BOOK);
-              }
-            }
+            open_book(current_book_index);
           }
           else {
             current_book_index = -1;
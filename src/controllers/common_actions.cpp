@@ -11,6 +11,7 @@
 #include "controllers/event_mgr.hpp"
 #include "viewers/msg_viewer.hpp"
 #include "viewers/menu_viewer.hpp"
+#include "helpers/refresh_scheduler.hpp"
 #include "models/books_dir.hpp"
 
 #if EPUB_INKPLATE_BUILD
@@ -63,7 +64,7 @@ CommonActions::power_it_off()
 
   app_controller.going_to_deep_sleep();
   #if EPUB_INKPLATE_BUILD
-    screen.force_full_update();
+    refresh_scheduler.force_full_update();
     msg_viewer.show(MsgViewer::MsgType::INFO, false, true, "Power OFF",
       "Entering Deep Sleep mode. " MSG);
     ESP::delay(1000);
@@ -22,6 +22,7 @@
   #include "wire.hpp"
   #include "inkplate_platform.hpp"
   #include "viewers/msg_viewer.hpp"
+  #include "helpers/refresh_scheduler.hpp"
   #include "esp.hpp"
 
   #if EXTENDED_CASE
@@ -310,7 +311,7 @@
             app_controller.going_to_deep_sleep();
             
             LOG_D("Timed out on Light Sleep. Going now to Deep Sleep");
-            screen.force_full_update();
+            refresh_scheduler.force_full_update();
             msg_viewer.show(
               MsgViewer::MsgType::INFO, 
               false, true, 
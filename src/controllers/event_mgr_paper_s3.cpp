@@ -1,6 +1,6 @@
-// Paper S3 EventMgr stub implementation
-// Provides a minimal, no-input EventMgr so the EPUB app can run
-// on BOARD_TYPE_PAPER_S3 without Inkplate-specific key handling.
+// Paper S3 EventMgr implementation
+// Touch input from the GT911 controller, interrupt driven. The gestures
+// are recognized by the GestureClassifier.
 
 #include "global.hpp"
 
@@ -14,8 +14,18 @@
   #include "freertos/FreeRTOS.h"
   #include "freertos/task.h"
   #include "freertos/queue.h"
+  #include "driver/gpio.h"
   #include "driver/i2c.h"
   #include "esp_log.h"
+  #include "esp_sleep.h"
+  #include "esp_timer.h"
+  #if CONFIG_PM_ENABLE
+    #include "esp_pm.h"
+  #endif
+
+  #include "controllers/gesture_classifier.hpp"
+  #include "controllers/gt911.hpp"
+  #include "helpers/perf_stats.hpp"
 #endif
 
 EventMgr event_mgr;
@@ -26,12 +36,23 @@ static constexpr char const * TAG = "EventMgrPaperS3";
 
 static const gpio_num_t PAPERS3_GT911_SDA_GPIO = GPIO_NUM_41;
 static const gpio_num_t PAPERS3_GT911_SCL_GPIO = GPIO_NUM_42;
+static const gpio_num_t PAPERS3_GT911_INT_GPIO = GPIO_NUM_48;
 static const i2c_port_t PAPERS3_GT911_I2C_PORT = I2C_NUM_0;
 
 static uint8_t gt911_addr = 0x14;
 static bool    gt911_ok   = false;
 
-static QueueHandle_t input_event_queue = nullptr;
+// Input events are queued with the time of the touch sample that completed
+// them, to measure the input to event latency.
+
+struct QueuedEvent {
+  EventMgr::Event event;
+  int64_t         input_us;
+};
+
+static QueueHandle_t    input_event_queue = nullptr;
+static TaskHandle_t     touch_task_handle = nullptr;
+static volatile int64_t touch_irq_us      = 0;
 
 static esp_err_t gt911_write_reg(uint8_t addr, uint16_t reg, const uint8_t * data, size_t len)
 {
@@ -84,146 +105,92 @@ static esp_err_t gt911_read_reg(uint8_t addr, uint16_t reg, uint8_t * data, size
   return ret;
 }
 
-static bool gt911_read_point(uint16_t * x, uint16_t * y)
-{
-  if (!gt911_ok || (x == nullptr) || (y == nullptr)) return false;
-
-  uint8_t status = 0;
-  if (gt911_read_reg(gt911_addr, 0x814E, &status, 1) != ESP_OK) return false;
-
-  if ((status & 0x80) == 0) return false;
+// The GT911 pulls its INT line low when a new touch buffer is ready. The
+// interrupt is level triggered, as required to wake the device from light
+// sleep: it stays disabled until the touch buffer has been read.
 
-  uint8_t points = status & 0x0F;
-  if (points == 0) {
-    uint8_t zero = 0;
-    gt911_write_reg(gt911_addr, 0x814E, &zero, 1);
-    return false;
-  }
+static void IRAM_ATTR gt911_isr_handler(void * arg)
+{
+  gpio_intr_disable(PAPERS3_GT911_INT_GPIO);
+  touch_irq_us = esp_timer_get_time();
 
-  uint8_t data[4] = { 0 };
-  if (gt911_read_reg(gt911_addr, 0x8150, data, sizeof(data)) != ESP_OK) return false;
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(touch_task_handle, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
 
-  *x = (uint16_t)((data[1] << 8) | data[0]);
-  *y = (uint16_t)((data[3] << 8) | data[2]);
+static inline uint32_t now_ms()
+{
+  return esp_timer_get_time() / 1000;
+}
 
-  uint8_t zero = 0;
-  gt911_write_reg(gt911_addr, 0x814E, &zero, 1);
+static void send_event(const EventMgr::Event & event, int64_t input_us)
+{
+  QueuedEvent queued = { event, input_us };
 
-  return true;
+  if (input_event_queue != nullptr) {
+    xQueueSend(input_event_queue, &queued, 0);
+  }
 }
 
 static void touch_task(void * param)
 {
   (void)param;
 
-  // Simple gesture state machine inspired by Inkplate-6PLUS touch handling.
-  // We interpret GT911 samples as a single-finger stream and classify each
-  // interaction as a TAP, horizontal SWIPE_LEFT / SWIPE_RIGHT, or HOLD /
-  // RELEASE. Coordinates are reported in the logical Screen space.
+  // The task sleeps until the GT911 signals a touch. While a gesture is in
+  // progress, it also wakes up at the gesture deadline (hold detection
+  // when the finger doesn't move). The whole touch buffer is read in a
+  // single I2C burst.
 
-  constexpr uint16_t swipe_threshold          = 100; // pixels in GT911 space
-  constexpr uint16_t longpress_move_threshold =  30; // max motion during hold
-  constexpr uint32_t longpress_ms             = 600; // press duration
-
-  bool       touch_active = false;
-  bool       hold_sent    = false;
-  uint16_t   start_x      = 0;
-  uint16_t   start_y      = 0;
-  uint16_t   current_x    = 0;
-  uint16_t   current_y    = 0;
-  TickType_t start_tick   = 0;
+  GestureClassifier         classifier;
+  GestureClassifier::Sample sample;
+  EventMgr::Event           event;
+  uint8_t                   buffer[GT911::BUFFER_SIZE];
 
   while (true) {
-    uint16_t x = 0;
-    uint16_t y = 0;
-
-    bool has_touch = gt911_read_point(&x, &y);
-
-    if (has_touch) {
-      if (!touch_active) {
-        // First contact
-        touch_active = true;
-        hold_sent    = false;
-        start_tick   = xTaskGetTickCount();
-        start_x      = current_x = x;
-        start_y      = current_y = y;
-      }
-      else {
-        // Update current finger position while it moves.
-        current_x = x;
-        current_y = y;
+    TickType_t timeout = portMAX_DELAY;
+    if (classifier.is_active()) {
+      int32_t delay = (int32_t)(classifier.get_deadline() - now_ms());
+      timeout = (delay > 0) ? (pdMS_TO_TICKS(delay) + 1) : 0;
+    }
+
+    if (ulTaskNotifyTake(pdTRUE, timeout) == 0) {
+      if (classifier.check_timeouts(now_ms(), event)) {
+        send_event(event, esp_timer_get_time());
       }
+      continue;
+    }
 
-      // Detect a long press while the finger is still down.
-      if (touch_active && !hold_sent) {
-        TickType_t now   = xTaskGetTickCount();
-        uint32_t   dt_ms = (now - start_tick) * portTICK_PERIOD_MS;
+    int64_t irq_us = touch_irq_us;
+    bool    ready  = false;
 
-        int dx = (int)current_x - (int)start_x;
-        int dy = (int)current_y - (int)start_y;
-        if (dx < 0) dx = -dx;
-        if (dy < 0) dy = -dy;
+    PERF_COUNT(TOUCH_INTERRUPT);
 
-        if ((dt_ms >= longpress_ms) &&
-            (dx <= (int)longpress_move_threshold) &&
-            (dy <= (int)longpress_move_threshold)) {
+    // Only the reads giving touch data are counted: the difference with the
+    // interrupts count shows the spurious interrupts.
 
-          EventMgr::Event ev;
-          ev.kind = EventMgr::EventKind::HOLD;
-          ev.x    = start_x;
-          ev.y    = start_y;
-          ev.dist = 0;
+    if (gt911_read_reg(gt911_addr, GT911::STATUS_REG, buffer, sizeof(buffer)) == ESP_OK) {
+      if (GT911::decode(buffer, irq_us / 1000, sample)) {
+        ready = true;
+        PERF_COUNT(TOUCH_READ);
 
-          if (input_event_queue != nullptr) {
-            xQueueSend(input_event_queue, &ev, 0);
-          }
+        uint8_t zero = 0;
+        gt911_write_reg(gt911_addr, GT911::STATUS_REG, &zero, 1);
 
-          hold_sent = true;
-        }
-      }
-    }
-    else {
-      if (touch_active) {
-        // Touch has just ended – classify the gesture.
-        touch_active = false;
-
-        EventMgr::Event ev;
-        ev.x    = start_x;
-        ev.y    = start_y;
-        ev.dist = 0;
-        ev.kind = EventMgr::EventKind::NONE;
-
-        TickType_t end_tick = xTaskGetTickCount();
-        uint32_t   dt_ms    = (end_tick - start_tick) * portTICK_PERIOD_MS;
-
-        int dx    = (int)current_x - (int)start_x;
-        int dy    = (int)start_y   - (int)current_y; // positive when moving up
-        int abs_dx = dx >= 0 ? dx : -dx;
-        int abs_dy = dy >= 0 ? dy : -dy;
-
-        (void)dt_ms; // dt_ms currently unused but kept for potential tuning.
-
-        if (hold_sent) {
-          // End of a long-press sequence.
-          ev.kind = EventMgr::EventKind::RELEASE;
-        }
-        else if ((abs_dx > abs_dy) && (abs_dx > (int)swipe_threshold)) {
-          // Horizontal swipe for page-level navigation.
-          ev.kind = (dx > 0) ? EventMgr::EventKind::SWIPE_RIGHT
-                             : EventMgr::EventKind::SWIPE_LEFT;
-        }
-        else {
-          // Short interaction: treat as a TAP.
-          ev.kind = EventMgr::EventKind::TAP;
-        }
-
-        if ((ev.kind != EventMgr::EventKind::NONE) && (input_event_queue != nullptr)) {
-          xQueueSend(input_event_queue, &ev, 0);
-        }
+        // Same format as the traces replayed by the gesture classifier tests
+        LOG_D("GT911 %u %u %u %u %u %u",
+              (unsigned) sample.time_ms, sample.count,
+              sample.points[0].x, sample.points[0].y,
+              sample.points[1].x, sample.points[1].y);
+
+        if (classifier.add_sample(sample, event)) send_event(event, irq_us);
       }
     }
 
-    vTaskDelay(pdMS_TO_TICKS(50));
+    // Don't spin on the interrupt if the INT line is still low
+    if (!ready) vTaskDelay(1);
+
+    gpio_intr_enable(PAPERS3_GT911_INT_GPIO);
   }
 }
 
@@ -233,7 +200,7 @@ bool EventMgr::setup()
 {
 #if EPUB_INKPLATE_BUILD
   if (input_event_queue == nullptr) {
-    input_event_queue = xQueueCreate(10, sizeof(Event));
+    input_event_queue = xQueueCreate(10, sizeof(QueuedEvent));
   }
 
   i2c_config_t conf = {};
@@ -255,12 +222,12 @@ bool EventMgr::setup()
     }
     else {
       uint8_t buf = 0;
-      if (gt911_read_reg(0x14, 0x8140, &buf, 1) == ESP_OK) {
+      if (gt911_read_reg(0x14, GT911::PRODUCT_ID_REG, &buf, 1) == ESP_OK) {
         gt911_addr = 0x14;
         gt911_ok   = true;
         ESP_LOGI(TAG, "GT911 detected at 0x14");
       }
-      else if (gt911_read_reg(0x5D, 0x8140, &buf, 1) == ESP_OK) {
+      else if (gt911_read_reg(0x5D, GT911::PRODUCT_ID_REG, &buf, 1) == ESP_OK) {
         gt911_addr = 0x5D;
         gt911_ok   = true;
         ESP_LOGI(TAG, "GT911 detected at 0x5D");
@@ -271,8 +238,43 @@ bool EventMgr::setup()
     }
   }
 
-  TaskHandle_t handle = nullptr;
-  xTaskCreatePinnedToCore(touch_task, "papers3_touch", 4096, nullptr, 5, &handle, 1);
+  if (gt911_ok) {
+    gpio_config_t io_conf = {};
+    io_conf.pin_bit_mask = 1ULL << PAPERS3_GT911_INT_GPIO;
+    io_conf.mode         = GPIO_MODE_INPUT;
+    io_conf.pull_up_en   = GPIO_PULLUP_ENABLE;
+    io_conf.intr_type    = GPIO_INTR_LOW_LEVEL;
+    gpio_config(&io_conf);
+
+    // The task must exist before the interrupt handler is installed
+
+    xTaskCreatePinnedToCore(touch_task, "papers3_touch", 4096, nullptr, 5, &touch_task_handle, 1);
+
+    err = gpio_install_isr_service(0);
+    if ((err != ESP_OK) && (err != ESP_ERR_INVALID_STATE)) {
+      ESP_LOGE(TAG, "gpio_install_isr_service failed: %d", (int)err);
+    }
+    gpio_isr_handler_add(PAPERS3_GT911_INT_GPIO, gt911_isr_handler, nullptr);
+
+    // A touch wakes the device from light sleep. With nothing to do while
+    // the screen is not touched, the idle task can enter automatic light
+    // sleep.
+
+    gpio_wakeup_enable(PAPERS3_GT911_INT_GPIO, GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+
+    #if CONFIG_PM_ENABLE
+      esp_pm_config_t pm_config = {
+        .max_freq_mhz       = 240,
+        .min_freq_mhz       =  80,
+        .light_sleep_enable = true
+      };
+      err = esp_pm_configure(&pm_config);
+      if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_pm_configure failed: %d", (int)err);
+      }
+    #endif
+  }
 #endif
 
   return true;
@@ -305,7 +307,12 @@ const EventMgr::Event & EventMgr::get_event()
     return event;
   }
 
-  if (!xQueueReceive(input_event_queue, &event, portMAX_DELAY)) {
+  QueuedEvent queued;
+  if (xQueueReceive(input_event_queue, &queued, portMAX_DELAY)) {
+    event = queued.event;
+    PERF_LATENCY(INPUT_EVENT, esp_timer_get_time() - queued.input_us);
+  }
+  else {
     event.kind = EventKind::NONE;
   }
 #endif
@@ -0,0 +1,201 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#if INKPLATE_6PLUS || TOUCH_TRIAL
+
+#include "controllers/gesture_classifier.hpp"
+
+#include <cmath>
+#include <cstdlib>
+
+static inline uint16_t
+distance(int32_t dx, int32_t dy)
+{
+  return sqrt(dx * dx + dy * dy);
+}
+
+void
+GestureClassifier::reset()
+{
+  state         = State::IDLE;
+  history_count = 0;
+  history_next  = 0;
+  max_move      = 0;
+  pinch_dist    = 0;
+  last_time_ms  = 0;
+  velocity      = 0;
+}
+
+void
+GestureClassifier::track(const Sample & sample)
+{
+  Track & t = history[history_next];
+
+  t.time_ms = sample.time_ms;
+  t.x       = sample.points[0].x;
+  t.y       = sample.points[0].y;
+
+  history_next = (history_next + 1) % HISTORY_SIZE;
+  if (history_count < HISTORY_SIZE) history_count++;
+
+  uint16_t move = distance(t.x - start.x, t.y - start.y);
+  if (move > max_move) max_move = move;
+}
+
+void
+GestureClassifier::compute_velocity()
+{
+  velocity = 0;
+  if (history_count < 2) return;
+
+  // From the oldest position in the velocity window (at least the one
+  // preceding the last position) to the last position.
+
+  const Track & last = history[(history_next + HISTORY_SIZE - 1) % HISTORY_SIZE];
+  const Track * ref  = &history[(history_next + HISTORY_SIZE - 2) % HISTORY_SIZE];
+
+  for (uint8_t i = 3; i <= history_count; i++) {
+    const Track & t = history[(history_next + HISTORY_SIZE - i) % HISTORY_SIZE];
+    if ((last.time_ms - t.time_ms) > VELOCITY_WINDOW) break;
+    ref = &t;
+  }
+
+  uint32_t dt = last.time_ms - ref->time_ms;
+  if (dt > 0) velocity = ((int32_t) last.x - ref->x) * 1000 / (int32_t) dt;
+}
+
+bool
+GestureClassifier::release(uint32_t time_ms, EventMgr::Event & event)
+{
+  State previous = state;
+  state = State::IDLE;
+
+  event = {
+    .kind = EventMgr::EventKind::NONE,
+    .x    = start.x,
+    .y    = start.y,
+    .dist = 0
+  };
+
+  if ((previous == State::HOLDING) || (previous == State::PINCHING)) {
+    event.kind = EventMgr::EventKind::RELEASE;
+    return true;
+  }
+  if (previous != State::TOUCHING) return false;
+
+  const Track & last = history[(history_next + HISTORY_SIZE - 1) % HISTORY_SIZE];
+
+  int32_t  dx     = (int32_t) last.x - start.x;
+  int32_t  dy     = (int32_t) last.y - start.y;
+  uint16_t abs_dx = abs(dx);
+  uint16_t abs_dy = abs(dy);
+
+  compute_velocity();
+
+  if ((abs_dx > abs_dy) &&
+      ((abs_dx >= SWIPE_DISTANCE) ||
+       ((abs_dx >= FLICK_DISTANCE) && (abs(velocity) >= FLICK_VELOCITY)))) {
+    event.kind = (dx > 0) ? EventMgr::EventKind::SWIPE_RIGHT : EventMgr::EventKind::SWIPE_LEFT;
+    event.dist = abs_dx;
+  }
+  else {
+    event.kind = EventMgr::EventKind::TAP;
+  }
+
+  return true;
+}
+
+bool
+GestureClassifier::pinch(const Sample & sample, EventMgr::Event & event)
+{
+  const Point & p0 = sample.points[0];
+  const Point & p1 = sample.points[1];
+
+  uint16_t dist = distance((int32_t) p1.x - p0.x, (int32_t) p1.y - p0.y);
+  uint16_t x    = (p0.x + p1.x) >> 1;
+  uint16_t y    = (p0.y + p1.y) >> 1;
+
+  if (state != State::PINCHING) {
+    state      = State::PINCHING;
+    pinch_dist = dist;
+    start      = { sample.time_ms, x, y };
+    return false;
+  }
+
+  int32_t diff = (int32_t) dist - pinch_dist;
+  if (abs(diff) < PINCH_STEP) return false;
+
+  event = {
+    .kind = (diff > 0) ? EventMgr::EventKind::PINCH_ENLARGE : EventMgr::EventKind::PINCH_REDUCE,
+    .x    = x,
+    .y    = y,
+    .dist = (uint16_t) abs(diff)
+  };
+  pinch_dist = dist;
+
+  return true;
+}
+
+bool
+GestureClassifier::add_sample(const Sample & sample, EventMgr::Event & event)
+{
+  if (sample.count == 0) return release(sample.time_ms, event);
+
+  last_time_ms = sample.time_ms;
+
+  if (sample.count >= 2) return pinch(sample, event);
+
+  if (state == State::IDLE) {
+    state         = State::TOUCHING;
+    start         = { sample.time_ms, sample.points[0].x, sample.points[0].y };
+    history_count = 0;
+    history_next  = 0;
+    max_move      = 0;
+    velocity      = 0;
+    track(sample);
+    return false;
+  }
+
+  // After a pinch, the fingers are lifted one after the other
+
+  if (state == State::PINCHING) return false;
+
+  track(sample);
+
+  return (state == State::TOUCHING) && check_timeouts(sample.time_ms, event);
+}
+
+bool
+GestureClassifier::check_timeouts(uint32_t time_ms, EventMgr::Event & event)
+{
+  if (state == State::IDLE) return false;
+
+  if ((time_ms - last_time_ms) >= RELEASE_TIMEOUT) return release(time_ms, event);
+
+  if ((state == State::TOUCHING) &&
+      (max_move <= HOLD_MOVE) &&
+      ((time_ms - start.time_ms) >= HOLD_TIME)) {
+    state = State::HOLDING;
+    event = {
+      .kind = EventMgr::EventKind::HOLD,
+      .x    = start.x,
+      .y    = start.y,
+      .dist = 0
+    };
+    return true;
+  }
+
+  return false;
+}
+
+uint32_t
+GestureClassifier::get_deadline() const
+{
+  if ((state == State::TOUCHING) && (max_move <= HOLD_MOVE)) {
+    return start.time_ms + HOLD_TIME;
+  }
+  return last_time_ms + RELEASE_TIMEOUT;
+}
+
+#endif
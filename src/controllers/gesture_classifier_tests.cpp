@@ -0,0 +1,245 @@
+#if TESTING && EPUB_LINUX_BUILD && TOUCH_TRIAL
+
+#include "gtest/gtest.h"
+#include "controllers/gesture_classifier.hpp"
+#include "controllers/gt911.hpp"
+#include "helpers/perf_stats.hpp"
+
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+// Traces use the format of the GT911 debug log of the Paper S3 touch task:
+// one line per touch buffer, "<time ms> <count> <x0> <y0> <x1> <y1>".
+
+struct TraceEntry {
+  uint32_t time_ms;
+  uint8_t  count;
+  uint16_t x[2], y[2];
+};
+
+static std::vector<TraceEntry>
+parse_trace(const char * trace)
+{
+  std::vector<TraceEntry> entries;
+  std::istringstream      lines(trace);
+  std::string             line;
+
+  while (std::getline(lines, line)) {
+    TraceEntry e = { 0, 0, { 0, 0 }, { 0, 0 } };
+    unsigned   t, c, x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    if (sscanf(line.c_str(), "%u %u %u %u %u %u", &t, &c, &x0, &y0, &x1, &y1) >= 2) {
+      e = { t, (uint8_t) c, { (uint16_t) x0, (uint16_t) x1 }, { (uint16_t) y0, (uint16_t) y1 } };
+      entries.push_back(e);
+    }
+  }
+  return entries;
+}
+
+// A finger moving in a straight line, one touch buffer every step ms,
+// followed by the release.
+
+static std::string
+line_trace(uint32_t time_ms, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint32_t duration, uint32_t step)
+{
+  std::string trace;
+  char        line[48];
+
+  for (uint32_t t = 0; t <= duration; t += step) {
+    snprintf(line, 48, "%u 1 %d %d\n",
+             time_ms + t,
+             x0 + ((int32_t) x1 - x0) * (int32_t) t / (int32_t) duration,
+             y0 + ((int32_t) y1 - y0) * (int32_t) t / (int32_t) duration);
+    trace += line;
+  }
+  snprintf(line, 48, "%u 0\n", time_ms + duration + step);
+  return trace + line;
+}
+
+// Register map of the controller, as seen from the I2C bus
+
+class SimulatedGT911
+{
+  private:
+    uint8_t registers[GT911::BUFFER_SIZE];  // From STATUS_REG
+
+  public:
+    SimulatedGT911() { memset(registers, 0, sizeof(registers)); }
+
+    // New touch buffer: the INT line would be pulled low
+    void signal(const TraceEntry & e) {
+      memset(registers, 0, sizeof(registers));
+      registers[0] = GT911::BUFFER_READY | e.count;
+      for (uint8_t i = 0; (i < e.count) && (i < 2); i++) {
+        uint8_t * p = &registers[1 + i * GT911::POINT_SIZE];
+        p[0] = i;
+        p[1] = e.x[i] & 0xFF; p[2] = e.x[i] >> 8;
+        p[3] = e.y[i] & 0xFF; p[4] = e.y[i] >> 8;
+      }
+    }
+
+    bool read_reg(uint16_t reg, uint8_t * data, size_t len) {
+      if ((reg < GT911::STATUS_REG) || ((reg - GT911::STATUS_REG + len) > sizeof(registers))) return false;
+      memcpy(data, &registers[reg - GT911::STATUS_REG], len);
+      return true;
+    }
+
+    void write_reg(uint16_t reg, uint8_t value) {
+      if ((reg >= GT911::STATUS_REG) && ((size_t) (reg - GT911::STATUS_REG) < sizeof(registers))) {
+        registers[reg - GT911::STATUS_REG] = value;
+      }
+    }
+};
+
+// Replays a trace the way the touch task does: one burst read per
+// interrupt, and a wake up at the classifier deadline between interrupts.
+
+static std::vector<EventMgr::Event>
+replay(const char * trace, GestureClassifier & classifier)
+{
+  std::vector<EventMgr::Event> events;
+  SimulatedGT911               gt911;
+  GestureClassifier::Sample    sample;
+  EventMgr::Event              event;
+  uint8_t                      buffer[GT911::BUFFER_SIZE];
+
+  for (auto & entry : parse_trace(trace)) {
+    while (classifier.is_active() && ((int32_t)(classifier.get_deadline() - entry.time_ms) < 0)) {
+      if (classifier.check_timeouts(classifier.get_deadline(), event)) events.push_back(event);
+    }
+
+    gt911.signal(entry);
+    EXPECT_TRUE(gt911.read_reg(GT911::STATUS_REG, buffer, sizeof(buffer)));
+    if (GT911::decode(buffer, entry.time_ms, sample)) {
+      gt911.write_reg(GT911::STATUS_REG, 0);
+      if (classifier.add_sample(sample, event)) events.push_back(event);
+    }
+  }
+
+  return events;
+}
+
+TEST(GestureClassifierTest, decode_touch_buffer) {
+  SimulatedGT911            gt911;
+  GestureClassifier::Sample sample;
+  uint8_t                   buffer[GT911::BUFFER_SIZE];
+
+  gt911.signal({ 10, 2, { 300, 1020 }, { 400, 500 } });
+  ASSERT_TRUE(gt911.read_reg(GT911::STATUS_REG, buffer, sizeof(buffer)));
+  ASSERT_TRUE(GT911::decode(buffer, 10, sample));
+  EXPECT_EQ(sample.count, 2);
+  EXPECT_EQ(sample.points[0].x,  300);
+  EXPECT_EQ(sample.points[0].y,  400);
+  EXPECT_EQ(sample.points[1].id,   1);
+  EXPECT_EQ(sample.points[1].x, 1020);
+  EXPECT_EQ(sample.points[1].y,  500);
+
+  // Once read, the buffer is released and not ready anymore
+
+  gt911.write_reg(GT911::STATUS_REG, 0);
+  ASSERT_TRUE(gt911.read_reg(GT911::STATUS_REG, buffer, sizeof(buffer)));
+  EXPECT_FALSE(GT911::decode(buffer, 20, sample));
+}
+
+TEST(GestureClassifierTest, tap) {
+  GestureClassifier classifier;
+
+  auto events = replay("1000 1 300 400\n"
+                       "1012 1 301 401\n"
+                       "1024 1 302 401\n"
+                       "1036 0\n", classifier);
+
+  ASSERT_EQ(events.size(), 1);
+  EXPECT_EQ(events[0].kind, EventMgr::EventKind::TAP);
+  EXPECT_EQ(events[0].x, 300);
+  EXPECT_EQ(events[0].y, 400);
+  EXPECT_FALSE(classifier.is_active());
+}
+
+TEST(GestureClassifierTest, slow_swipe) {
+  GestureClassifier classifier;
+
+  auto events = replay(line_trace(2000, 400, 500, 250, 510, 500, 12).c_str(), classifier);
+
+  ASSERT_EQ(events.size(), 1);
+  EXPECT_EQ(events[0].kind, EventMgr::EventKind::SWIPE_LEFT);
+  EXPECT_EQ(events[0].x, 400);
+  EXPECT_GE(events[0].dist, 145);
+}
+
+TEST(GestureClassifierTest, quick_short_swipe) {
+  GestureClassifier classifier;
+
+  // 60 pixels in 60 ms: too short for a swipe unless it is quick
+
+  auto events = replay(line_trace(3000, 200, 500, 260, 500, 60, 12).c_str(), classifier);
+
+  ASSERT_EQ(events.size(), 1);
+  EXPECT_EQ(events[0].kind, EventMgr::EventKind::SWIPE_RIGHT);
+  EXPECT_GE(classifier.get_velocity(), GestureClassifier::FLICK_VELOCITY);
+
+  events = replay(line_trace(4000, 200, 500, 260, 500, 500, 12).c_str(), classifier);
+
+  ASSERT_EQ(events.size(), 1);
+  EXPECT_EQ(events[0].kind, EventMgr::EventKind::TAP);
+  EXPECT_LT(classifier.get_velocity(), GestureClassifier::FLICK_VELOCITY);
+}
+
+TEST(GestureClassifierTest, hold_then_release) {
+  GestureClassifier classifier;
+
+  auto events = replay(line_trace(5000, 300, 300, 310, 305, 900, 12).c_str(), classifier);
+
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_EQ(events[0].kind, EventMgr::EventKind::HOLD);
+  EXPECT_EQ(events[0].x, 300);
+  EXPECT_EQ(events[1].kind, EventMgr::EventKind::RELEASE);
+}
+
+TEST(GestureClassifierTest, hold_without_samples) {
+  GestureClassifier classifier;
+
+  // A still finger doesn't generate touch buffers: the hold is detected at
+  // the classifier deadline.
+
+  auto events = replay("6000 1 100 700\n"
+                       "6012 1 100 700\n"
+                       "7500 0\n", classifier);
+
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_EQ(events[0].kind, EventMgr::EventKind::HOLD);
+  EXPECT_EQ(events[1].kind, EventMgr::EventKind::RELEASE);
+}
+
+TEST(GestureClassifierTest, pinch) {
+  GestureClassifier classifier;
+
+  auto events = replay("8000 2 400 500 500 500\n"
+                       "8012 2 397 500 503 500\n"
+                       "8024 2 385 500 515 500\n"
+                       "8036 2 370 500 530 500\n"
+                       "8048 1 370 500\n"
+                       "8060 0\n", classifier);
+
+  ASSERT_EQ(events.size(), 3);
+  EXPECT_EQ(events[0].kind, EventMgr::EventKind::PINCH_ENLARGE);
+  EXPECT_EQ(events[0].dist, 30);
+  EXPECT_EQ(events[0].x, 450);
+  EXPECT_EQ(events[1].kind, EventMgr::EventKind::PINCH_ENLARGE);
+  EXPECT_EQ(events[2].kind, EventMgr::EventKind::RELEASE);
+}
+
+TEST(GestureClassifierTest, input_latency_stats) {
+  perf_stats.reset();
+
+  perf_stats.add(PerfStats::Latency::INPUT_EVENT, 2000);
+  perf_stats.add(PerfStats::Latency::INPUT_EVENT, 6000);
+
+  EXPECT_EQ(perf_stats.get_count (PerfStats::Latency::INPUT_EVENT),    2);
+  EXPECT_EQ(perf_stats.get_micros(PerfStats::Latency::INPUT_EVENT), 8000);
+  EXPECT_EQ(perf_stats.get_max   (PerfStats::Latency::INPUT_EVENT), 6000);
+
+  perf_stats.reset();
+}
+
+#endif
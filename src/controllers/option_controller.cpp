@@ -33,6 +33,7 @@ static int8_t show_images;
 static int8_t font_size;
 static int8_t use_fonts_in_books;
 static int8_t default_font;
+static int8_t item_cache;
 static int8_t show_title;
 static int8_t dir_view;
 static int8_t done;
@@ -88,15 +89,16 @@ static FormEntry main_params_form_entries[MAIN_FORM_SIZE] = {
  };
 
 #if INKPLATE_6PLUS || TOUCH_TRIAL
-  static constexpr int8_t FONT_FORM_SIZE = 5;
+  static constexpr int8_t FONT_FORM_SIZE = 6;
 #else
-  static constexpr int8_t FONT_FORM_SIZE = 4;
+  static constexpr int8_t FONT_FORM_SIZE = 5;
 #endif
 static FormEntry font_params_form_entries[FONT_FORM_SIZE] = {
   { .caption = "Default Font Size (*):",      .u = { .ch = { .value = &font_size,          .choice_count = 4, .choices = FormChoiceField::font_size_choices } }, .entry_type = FormEntryType::HORIZONTAL },
   { .caption = "Use Fonts in E-books (*):",   .u = { .ch = { .value = &use_fonts_in_books, .choice_count = 2, .choices = FormChoiceField::yes_no_choices    } }, .entry_type = FormEntryType::HORIZONTAL },
   { .caption = "Default Font (*):",           .u = { .ch = { .value = &default_font,       .choice_count = 8, .choices = FormChoiceField::font_choices      } }, .entry_type = FormEntryType::VERTICAL   },
   { .caption = "Show Images in E-books (*):", .u = { .ch = { .value = &show_images,        .choice_count = 2, .choices = FormChoiceField::yes_no_choices    } }, .entry_type = FormEntryType::HORIZONTAL },
+  { .caption = "Cache E-books Content :",     .u = { .ch = { .value = &item_cache,         .choice_count = 2, .choices = FormChoiceField::yes_no_choices    } }, .entry_type = FormEntryType::HORIZONTAL },
   #if INKPLATE_6PLUS || TOUCH_TRIAL
     { .caption = " DONE ",                    .u = { .ch = { .value = &done,               .choice_count = 0, .choices = nullptr                            } }, .entry_type = FormEntryType::DONE       }
   #endif
@@ -139,7 +141,7 @@ main_parameters()
   config.get(Config::Ident::TIMEOUT,          &timeout               );
 
   #if DATE_TIME_RTC
-    int8_t show_heap, show_rtc;
+    int8_t show_heap = 0, show_rtc = 0;
     config.get(Config::Ident::SHOW_RTC,       &show_rtc              );
     config.get(Config::Ident::SHOW_HEAP,      &show_heap             );
 
@@ -171,6 +173,7 @@ default_parameters()
   config.get(Config::Ident::FONT_SIZE,          &font_size         );
   config.get(Config::Ident::USE_FONTS_IN_BOOKS, &use_fonts_in_books);
   config.get(Config::Ident::DEFAULT_FONT,       &default_font      );
+  config.get(Config::Ident::ITEM_CACHE,         &item_cache        );
   
   old_show_images        = show_images;
   old_use_fonts_in_books = use_fonts_in_books;
@@ -315,6 +318,15 @@ init_nvs()
   }
 #endif
 
+#if INKPLATE_6PLUS || TOUCH_TRIAL
+  static void
+  search_books_dir()
+  {
+    books_dir_controller.start_search();
+    app_controller.set_controller(AppController::Ctrl::DIR);
+  }
+#endif
+
 #if EPUB_LINUX_BUILD && DEBUGGING
   void
   debugging()
@@ -336,6 +348,9 @@ static MenuViewer::MenuEntry menu[] = {
   { MenuViewer::Icon::FONT_PARAMS,   "Default e-books parameters",           default_parameters               , true,  true  },
   { MenuViewer::Icon::WIFI,          "WiFi Access to the e-books folder",    wifi_mode                        , true,  true  },
   { MenuViewer::Icon::REFRESH,       "Refresh the e-books list",             CommonActions::refresh_books_dir , true,  true  },
+  #if INKPLATE_6PLUS || TOUCH_TRIAL
+    { MenuViewer::Icon::BOOK_LIST,   "Search the e-books list",              search_books_dir                 , true,  true  },
+  #endif
   #if !(INKPLATE_6PLUS || MENU_6PLUS)
     { MenuViewer::Icon::CLR_HISTORY, "Clear e-books' read history",          init_nvs                         , true,  true  },
     #if DATE_TIME_RTC
@@ -482,6 +497,7 @@ OptionController::input_event(const EventMgr::Event & event)
         config.put(Config::Ident::FONT_SIZE,          font_size         );
         config.put(Config::Ident::DEFAULT_FONT,       default_font      );
         config.put(Config::Ident::USE_FONTS_IN_BOOKS, use_fonts_in_books);
+        config.put(Config::Ident::ITEM_CACHE,         item_cache        );
         config.save();
 
         if ((old_show_images        != show_images       ) ||
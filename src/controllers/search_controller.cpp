@@ -0,0 +1,128 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __SEARCH_CONTROLLER__ 1
+#include "controllers/search_controller.hpp"
+
+#include "controllers/app_controller.hpp"
+#include "controllers/book_controller.hpp"
+#include "models/epub.hpp"
+#include "models/page_locs.hpp"
+#include "models/search_index.hpp"
+
+bool
+SearchController::search(const std::string & the_query)
+{
+  if (page_locs.get_page_count() == -1) return false;
+
+  query = the_query;
+  if (!search_index.search(epub.get_current_filename(), query, page_nbrs)) return false;
+
+  current_entry_index = 0;
+  app_controller.set_controller(AppController::Ctrl::SEARCH);
+
+  return true;
+}
+
+void 
+SearchController::enter()
+{
+  search_viewer.setup(query, page_nbrs);
+  current_entry_index = search_viewer.show_page_and_highlight(current_entry_index);
+}
+
+// Shows the page of the selected entry in the book viewer
+
+static void
+show_entry(int16_t entry_index)
+{
+  const PageLocs::PageId * page_id = page_locs.get_page_id_at(search_viewer.get_page_nbr(entry_index));
+
+  if (page_id != nullptr) book_controller.set_current_page_id(*page_id);
+  app_controller.set_controller(AppController::Ctrl::BOOK);
+}
+
+#if INKPLATE_6PLUS || TOUCH_TRIAL
+  void 
+  SearchController::input_event(const EventMgr::Event & event)
+  {
+    switch (event.kind) {
+      case EventMgr::EventKind::SWIPE_RIGHT:
+        current_entry_index = search_viewer.prev_page();   
+        break;
+
+      case EventMgr::EventKind::SWIPE_LEFT:
+        current_entry_index = search_viewer.next_page();   
+        break;
+
+      case EventMgr::EventKind::TAP:
+        current_entry_index = search_viewer.get_index_at(event.x, event.y);
+        if ((current_entry_index >= 0) && (current_entry_index < search_viewer.get_entry_count())) {
+          show_entry(current_entry_index);
+        }
+        else {
+          app_controller.set_controller(AppController::Ctrl::BOOK);
+        }
+        break;
+
+      case EventMgr::EventKind::RELEASE:
+        search_viewer.clear_highlight();
+        break;
+
+      default:
+        break;
+    }
+  }
+#else
+  void 
+  SearchController::input_event(const EventMgr::Event & event)
+  {
+    switch (event.kind) {
+      #if EXTENDED_CASE
+        case EventMgr::EventKind::PREV:
+      #else
+        case EventMgr::EventKind::DBL_PREV:
+      #endif
+        current_entry_index = search_viewer.prev_column();   
+        break;
+
+      #if EXTENDED_CASE
+        case EventMgr::EventKind::NEXT:
+      #else
+        case EventMgr::EventKind::DBL_NEXT:
+      #endif
+        current_entry_index = search_viewer.next_column();
+        break;
+
+      #if EXTENDED_CASE
+        case EventMgr::EventKind::DBL_PREV:
+      #else
+        case EventMgr::EventKind::PREV:
+      #endif
+        current_entry_index = search_viewer.prev_item();
+        break;
+
+      #if EXTENDED_CASE
+        case EventMgr::EventKind::DBL_NEXT:
+      #else
+        case EventMgr::EventKind::NEXT:
+      #endif
+        current_entry_index = search_viewer.next_item();
+        break;
+
+      case EventMgr::EventKind::SELECT:
+        if ((current_entry_index >= 0) && (current_entry_index < search_viewer.get_entry_count())) {
+          show_entry(current_entry_index);
+        }
+        break;
+
+      case EventMgr::EventKind::DBL_SELECT:
+        app_controller.set_controller(AppController::Ctrl::BOOK);
+        break;
+        
+      case EventMgr::EventKind::NONE:
+        break;
+    }
+  }
+#endif
@@ -507,7 +507,21 @@ const char * EventMgr::event_str[8] = { "NONE",        "TAP",           "HOLD",
   }
 #endif
 
-#if EPUB_LINUX_BUILD
+#if EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+  // No input device. The application is driven by the caller.
+
+  void EventMgr::loop()
+  {
+  }
+
+  void
+  EventMgr::set_orientation(Screen::Orientation orient)
+  {
+    // Nothing to do...
+  }
+
+#elif EPUB_LINUX_BUILD
 
   #include <gtk/gtk.h>
 
@@ -706,7 +720,7 @@ const char * EventMgr::event_str[8] = { "NONE",        "TAP",           "HOLD",
             
             LOG_D("Timed out on Light Sleep. Going now to Deep Sleep");
             
-            screen.force_full_update();
+            refresh_scheduler.force_full_update();
             msg_viewer.show(
               MsgViewer::MsgType::INFO, 
               false, true, 
@@ -728,11 +742,12 @@ bool
 EventMgr::setup()
 {
   #if EPUB_LINUX_BUILD
-
-    g_signal_connect(G_OBJECT (screen.image_box),
-                     "event",
-                     G_CALLBACK (mouse_event_callback),
-                     screen.get_image());
+    #if !EPUB_HEADLESS
+      g_signal_connect(G_OBJECT (screen.image_box),
+                       "event",
+                       G_CALLBACK (mouse_event_callback),
+                       screen.get_image());
+    #endif
   #else
     
     retrieve_calibration_values();
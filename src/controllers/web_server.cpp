@@ -11,6 +11,11 @@
 #include "viewers/msg_viewer.hpp"
 #include "models/config.hpp"
 #include "models/page_locs.hpp"
+#include "models/epub.hpp"
+#include "models/books_dir.hpp"
+#include "models/epub_scanner.hpp"
+#include "helpers/perf_stats.hpp"
+#include "helpers/upload_pipeline.hpp"
 
 #include <stdio.h>
 #include <sys/param.h>
@@ -45,6 +50,8 @@ struct FileServerData {
 
 static FileServerData * server_data = nullptr;
 
+static std::string last_upload;  ///< Report of the last upload, shown above the files list
+
 // Redirects incoming GET request for /index.html 
 
 static esp_err_t 
@@ -69,6 +76,20 @@ favicon_get_handler(httpd_req_t *req)
   return ESP_OK;
 }
 
+#if PERF_STATS
+  // Respond with the performance statistics gathered since the last reset.
+
+  static esp_err_t 
+  stats_get_handler(httpd_req_t *req)
+  {
+    std::string report;
+    perf_stats.get_report(report);
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_sendstr(req, report.c_str());
+    return ESP_OK;
+  }
+#endif
+
 /* Send HTTP response with a run-time generated html consisting of
  * a list of all files and folders under the requested path.
  * In case of SPIFFS this returns empty list when path is any
@@ -155,6 +176,12 @@ http_resp_dir_html(httpd_req_t *req, const char * dirpath)
 
   httpd_resp_send_chunk(req, (const char *) upload_script_start, upload_script_size);
 
+  if (!last_upload.empty()) {
+    httpd_resp_sendstr_chunk(req, "<p>");
+    httpd_resp_sendstr_chunk(req, last_upload.c_str());
+    httpd_resp_sendstr_chunk(req, "</p>");
+  }
+
   httpd_resp_sendstr_chunk(req,
     "<table class=\"fixed list\" id=\"sorted\" next_sort=\"asc\">"
     "<colgroup><col width=\"70%\"/><col width=\"8%\"/><col width=\"14%\"/><col width=\"8%\"/></colgroup>"
@@ -340,6 +367,22 @@ download_handler(httpd_req_t * req)
   return ESP_OK;
 }
 
+static std::string
+html_escape(const char * str)
+{
+  std::string res;
+
+  for (; *str; str++) {
+    switch (*str) {
+      case '<': res.append("&lt;" ); break;
+      case '>': res.append("&gt;" ); break;
+      case '&': res.append("&amp;"); break;
+      default:  res.push_back(*str);
+    }
+  }
+  return res;
+}
+
 // ----- upload_handler() -----
 
 static esp_err_t 
@@ -385,9 +428,30 @@ upload_handler(httpd_req_t * req)
 
   LOG_I("Receiving file : %s...", filename.c_str());
 
-  /* Retrieve the pointer to scratch buffer for temporary storage */
-  char *buf = ((FileServerData *) req->user_ctx)->scratch;
-  int received;
+  // The pipeline buffers are written as a whole: no stdio buffering
+
+  setvbuf(fd, nullptr, _IONBF, 0);
+
+  // The SD card writes and the book scanning are done by the pipeline
+  // task while the next buffer is received.
+
+  UploadPipeline * pipeline = new UploadPipeline;
+  EPubScanner    * scanner  = new EPubScanner;
+
+  if (!scanner->begin() || !pipeline->start(fd, scanner)) {
+    delete pipeline;
+    delete scanner;
+    fclose(fd);
+    unlink(filepath.c_str());
+
+    LOG_E("Not enough memory for the upload buffers");
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Not enough memory");
+    return ESP_FAIL;
+  }
+
+  int  received;
+  bool received_ok = true;
+  bool written_ok  = true;
 
   /* Content length of the request gives
     * the size of the file being uploaded */
@@ -395,36 +459,89 @@ upload_handler(httpd_req_t * req)
 
   while (remaining > 0) {
 
-    LOG_I("Remaining size : %d", remaining);
-    if ((received = httpd_req_recv(req, buf, MIN(remaining, SCRATCH_BUFSIZE))) <= 0) {
-      if (received == HTTPD_SOCK_ERR_TIMEOUT) {
-        continue;
+    char * buf = pipeline->get_buffer();
+    if (buf == nullptr) { written_ok = false; break; }
+
+    uint32_t size = 0;
+    while ((size < UploadPipeline::BUFFER_SIZE) && (remaining > 0)) {
+      if ((received = httpd_req_recv(req, buf + size, MIN(remaining, UploadPipeline::BUFFER_SIZE - size))) <= 0) {
+        if (received == HTTPD_SOCK_ERR_TIMEOUT) {
+          continue;
+        }
+        received_ok = false;
+        break;
       }
+      size      += received;
+      remaining -= received;
+    }
 
-      fclose(fd);
-      unlink(filepath.c_str());
+    if (!received_ok) break;
 
+    LOG_D("Remaining size : %d", remaining);
+    if (!pipeline->put_buffer(size)) { written_ok = false; break; }
+  }
+
+  written_ok = pipeline->finish() && written_ok;
+  fclose(fd);
+
+  if (!received_ok || !written_ok) {
+    delete pipeline;
+    delete scanner;
+    unlink(filepath.c_str());
+
+    if (!received_ok) {
       LOG_E("File reception failed!");
       httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to receive file");
-      return ESP_FAIL;
     }
-
-    /* Write buffer content to file on storage */
-    if (received && (received != fwrite(buf, 1, received, fd))) {
+    else {
       /* Couldn't write everything to file!
         * Storage may be full? */
-      fclose(fd);
-      unlink(filepath.c_str());
-
       LOG_E("File write failed!");
       httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to write file to storage");
-      return ESP_FAIL;
     }
+    return ESP_FAIL;
+  }
+
+  uint32_t throughput = pipeline->get_throughput();
+  int32_t  elapsed_ms = pipeline->get_elapsed_us() / 1000;
+  int32_t  write_pct  = (elapsed_ms > 0) ? pipeline->get_write_us() / 10 / elapsed_ms : 0;
+
+  LOG_I("File reception complete: %u bytes in %d ms, %u bytes/s, %d%% writing", 
+        pipeline->get_byte_count(), elapsed_ms, throughput, write_pct);
+
+  // The library record is added from the metadata retrieved while the
+  // book was received. Books in sub-folders are not part of the library.
 
-    remaining -= received;
+  const char * book_filename = filename.c_str() + 1;
+  bool         added         = false;
+
+  if (scanner->finish() && 
+      scanner->is_complete() &&
+      (strchr(book_filename, '/') == nullptr) &&
+      (filename.size() > 5) &&
+      (strcasecmp(&filename[filename.size() - 5], ".epub") == 0)) {
+    added = books_dir.add_book(book_filename, scanner->get_metadata());
+  }
+
+  char line[160];
+  snprintf(line, 160, "Last upload: %u KB in %d.%d s (%u KB/s, SD card writes %d%% of the time). ",
+           (pipeline->get_byte_count() + 1023) / 1024, 
+           elapsed_ms / 1000, (elapsed_ms % 1000) / 100,
+           throughput / 1024, write_pct);
+
+  last_upload = html_escape(book_filename);
+  last_upload.append(". ").append(line);
+  if (added) {
+    last_upload.append("Added to the library as <i>")
+               .append(html_escape(scanner->get_metadata().title.c_str()))
+               .append("</i>.");
+  }
+  else {
+    last_upload.append("The library will be updated on restart.");
   }
-  fclose(fd);
-  LOG_I("File reception complete");
+
+  delete pipeline;
+  delete scanner;
 
   /* Redirect onto root to see the updated file list */
   httpd_resp_set_status(req, "303 See Other");
@@ -463,28 +580,8 @@ delete_handler(httpd_req_t * req)
   LOG_I("Deleting file : %s", filepath.c_str());
   unlink(filepath.c_str());
 
-  int pos = filepath.size() - 5;
-  if (filepath.substr(pos).compare(".epub") == 0) {
-    filepath.replace(pos, 5, ".pars");
-
-    if (stat(filepath.c_str(), &file_stat) != -1) {
-      LOG_I("Deleting file : %s", filepath.c_str());
-      unlink(filepath.c_str());
-    }
-
-    filepath.replace(pos, 5, ".locs");
-
-    if (stat(filepath.c_str(), &file_stat) != -1) {
-      LOG_I("Deleting file : %s", filepath.c_str());
-      unlink(filepath.c_str());
-    }
-
-    filepath.replace(pos, 5, ".toc");
-
-    if (stat(filepath.c_str(), &file_stat) != -1) {
-      LOG_I("Deleting file : %s", filepath.c_str());
-      unlink(filepath.c_str());
-    }
+  if ((filepath.size() > 5) && (filepath.compare(filepath.size() - 5, 5, ".epub") == 0)) {
+    EPub::remove_sidecars(filepath);
   }
 
   /* Redirect onto root to see the updated file list */
@@ -528,6 +625,17 @@ http_server_start()
     return ESP_FAIL;
   }
 
+  #if PERF_STATS
+    httpd_uri_t stats = {
+      .uri       = "/stats",   // Must be registered before the catch-all download handler
+      .method    = HTTP_GET,
+      .handler   = stats_get_handler,
+      .user_ctx  = server_data
+    };
+
+    httpd_register_uri_handler(server, &stats);
+  #endif
+
   httpd_uri_t file_download = {
     .uri       = "/*",  // Match all URIs of type /path/to/file
     .method    = HTTP_GET,
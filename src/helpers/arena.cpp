@@ -0,0 +1,156 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#include "helpers/arena.hpp"
+#include "helpers/memory_budget.hpp"
+
+Arena::~Arena()
+{
+  reset();
+}
+
+Arena::Chunk *
+Arena::heap_chunk(uint32_t size)
+{
+  Chunk * chunk = (Chunk *) memory_budget.allocate(MemoryBudget::Consumer::ARENAS, size);
+  if (chunk != nullptr) chunk->size = size;
+  return chunk;
+}
+
+void
+Arena::free_chunks(ChunkList & list)
+{
+  while (list.first != nullptr) {
+    Chunk * chunk = list.pop();
+    memory_budget.release(MemoryBudget::Consumer::ARENAS, chunk, chunk->size);
+  }
+}
+
+// The parent arena or the heap are reached without holding the mutex: the
+// memory budget may shrink caches that give back chunks to this arena.
+
+Arena::Chunk *
+Arena::get_chunk()
+{
+  Chunk * chunk = nullptr;
+
+  { std::scoped_lock guard(mutex);
+    if (spare_chunks.first != nullptr) chunk = spare_chunks.pop();
+  }
+
+  if (chunk == nullptr) {
+    if (parent != nullptr) {
+      chunk = parent->lend_chunk();
+    }
+    else if ((chunk = heap_chunk(CHUNK_SIZE)) != nullptr) {
+      std::scoped_lock guard(mutex);
+      from_heap++;
+    }
+  }
+
+  return chunk;
+}
+
+Arena::Chunk *
+Arena::lend_chunk()
+{
+  Chunk * chunk = get_chunk();
+
+  if (chunk != nullptr) {
+    std::scoped_lock guard(mutex);
+    lent++;
+    update_high_water();
+  }
+
+  return chunk;
+}
+
+void
+Arena::take_back(ChunkList & list)
+{
+  std::scoped_lock guard(mutex);
+
+  lent -= list.count;
+  spare_chunks.splice(list);
+}
+
+void *
+Arena::allocate(size_t size, size_t align)
+{
+  uintptr_t ptr = ((uintptr_t) current + align - 1) & ~(uintptr_t) (align - 1);
+
+  if ((current == nullptr) || ((ptr + size) > (uintptr_t) end)) {
+
+    if ((sizeof(Chunk) + size + align) > CHUNK_SIZE) {
+      Chunk * chunk = heap_chunk(sizeof(Chunk) + size + align);
+      if (chunk == nullptr) return nullptr;
+
+      { std::scoped_lock guard(mutex);
+        large_chunks.push(chunk);
+        update_high_water();
+      }
+      bytes += size;
+
+      return (void *) (((uintptr_t) (chunk + 1) + align - 1) & ~(uintptr_t) (align - 1));
+    }
+
+    Chunk * chunk = get_chunk();
+    if (chunk == nullptr) return nullptr;
+
+    { std::scoped_lock guard(mutex);
+      chunks.push(chunk);
+      update_high_water();
+    }
+
+    current = (char *) (chunk + 1);
+    end     = ((char *) chunk) + chunk->size;
+    ptr     = ((uintptr_t) current + align - 1) & ~(uintptr_t) (align - 1);
+  }
+
+  current = (char *) (ptr + size);
+  bytes  += size;
+
+  return (void *) ptr;
+}
+
+void
+Arena::reset()
+{
+  ChunkList list, large;
+
+  { std::scoped_lock guard(mutex);
+
+    list  = chunks;
+    large = large_chunks;
+    list.splice(spare_chunks);
+    chunks.clear();
+    large_chunks.clear();
+    resets++;
+  }
+
+  current = end = nullptr;
+  bytes   = 0;
+
+  free_chunks(large);
+
+  if (parent != nullptr) parent->take_back(list);
+  else free_chunks(list);
+}
+
+Arena::Stats
+Arena::get_stats()
+{
+  std::scoped_lock guard(mutex);
+
+  return {
+    .chunks     = chunks.count,
+    .large      = large_chunks.count,
+    .spare      = spare_chunks.count,
+    .lent       = lent,
+    .high_water = high_water,
+    .bytes      = bytes,
+    .from_heap  = from_heap,
+    .resets     = resets
+  };
+}
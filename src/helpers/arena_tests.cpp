@@ -0,0 +1,126 @@
+#if TESTING && EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "gtest/gtest.h"
+#include "helpers/arena.hpp"
+#include "helpers/memory_budget.hpp"
+#include "models/epub.hpp"
+#include "models/page_locs.hpp"
+#include "viewers/book_viewer.hpp"
+
+#include <forward_list>
+#include <malloc.h>
+#include <unistd.h>
+
+typedef MemoryBudget::Consumer Consumer;
+
+TEST(ArenaTest, chunks_recycled_by_scope) {
+  uint32_t heap_start = memory_budget.get_usage(Consumer::ARENAS).current;
+
+  Arena book("book");
+  Arena item("item", &book);
+
+  // Two page renders in a row: the second one reuses the chunks of the first
+
+  for (int render_nbr = 0; render_nbr < 2; render_nbr++) {
+    Arena render("render", &item);
+
+    std::forward_list<ArenaString, ArenaAllocator<ArenaString>> words(render);
+    for (int i = 0; i < 1000; i++) {
+      words.emplace_front("a word longer than the small strings buffer", words.get_allocator());
+    }
+    EXPECT_EQ(words.front(), "a word longer than the small strings buffer");
+    EXPECT_GT(render.get_stats().chunks, 10u);
+
+    void * large = render.allocate(3 * Arena::CHUNK_SIZE);
+    ASSERT_TRUE(large != nullptr);
+    memset(large, 0, 3 * Arena::CHUNK_SIZE);
+    EXPECT_EQ(render.get_stats().large, 1u);
+
+    // The list is abandoned with its arena
+  }
+
+  Arena::Stats book_stats = book.get_stats();
+  Arena::Stats item_stats = item.get_stats();
+
+  EXPECT_EQ(item_stats.lent,  0u);
+  EXPECT_GT(item_stats.spare, 10u);
+  EXPECT_EQ(book_stats.lent,  item_stats.spare);
+  EXPECT_EQ(book_stats.from_heap, item_stats.spare);
+
+  // Back to the book, then to the heap
+
+  item.reset();
+  EXPECT_EQ(book.get_stats().lent,  0u);
+  EXPECT_EQ(book.get_stats().spare, item_stats.spare);
+
+  book.reset();
+  EXPECT_EQ(book.get_stats().spare, 0u);
+  EXPECT_EQ(memory_budget.get_usage(Consumer::ARENAS).current, heap_start);
+}
+
+// Books are opened, paginated, shown and closed again and again. Everything
+// taken by the arenas must be back to the heap when a book is closed, and the
+// arenas must not need more chunks from one cycle to the next: the CSS rules,
+// DOM nodes and formats of every book leave whole chunks behind them.
+
+static void
+read_book(const char * filename)
+{
+  ASSERT_TRUE(epub.open_file(filename));
+
+  page_locs.check_for_format_changes(epub.get_item_count(), 0, true);
+  while (page_locs.get_page_count() == -1) usleep(1000);
+
+  book_viewer.init();
+
+  const PageLocs::PageId * page_id = page_locs.get_page_id(PageLocs::PageId(0, 0));
+  for (int16_t i = 0; (page_id != nullptr) && (i < 20); i++) {
+    PageLocs::PageId id = *page_id;
+    book_viewer.show_page(id);
+    page_id = page_locs.get_next_page_id(id);
+  }
+
+  epub.close_file();
+}
+
+TEST(ArenaTest, books_open_close_soak) {
+  static constexpr int CYCLES = 6;
+
+  const char * books[2] = {
+    BOOKS_FOLDER "/Austen, Jane - Pride and Prejudice.epub",
+    BOOKS_FOLDER "/Austen, Jane - Orgueil et préjugés.epub"
+  };
+
+  uint32_t first_high_water = 0;
+
+  printf("cycle  heap in use  heap free  free blocks  arena chunks high-water\n");
+
+  for (int cycle = 0; cycle < CYCLES; cycle++) {
+    for (auto * book : books) read_book(book);
+
+    // The page locations thread keeps the stylesheets of its last item
+
+    Arena::Stats stats = EPub::book_arena.get_stats();
+
+    EXPECT_LT(memory_budget.get_usage(Consumer::ARENAS).current, 16 * Arena::CHUNK_SIZE);
+    EXPECT_EQ(stats.spare, 0u);
+
+    // The high-water mark is reached by the first cycle. A chunk kept by a
+    // closed book would raise it in the next ones.
+
+    if (cycle == 0) first_high_water = stats.high_water;
+    EXPECT_EQ(stats.high_water, first_high_water);
+
+    // The heap also keeps the fonts and the caches loaded by the first
+    // cycle. Its numbers depend on the C library: they are reported, not
+    // checked.
+
+    malloc_trim(0);
+    struct mallinfo2 info = mallinfo2();
+
+    printf("%5d %12zu %10zu %12zu %13u\n",
+           cycle, info.uordblks, info.fordblks, info.ordblks, stats.high_water);
+  }
+}
+
+#endif
@@ -0,0 +1,318 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __FONT_COMPILER__ 1
+#include "helpers/font_compiler.hpp"
+
+#if EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "helpers/perf_stats.hpp"
+#include "viewers/form_viewer.hpp"
+#include "screen.hpp"
+#include "pugixml.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <getopt.h>
+#include <sys/stat.h>
+
+using namespace pugi;
+
+// The TrueType/OpenType fonts of the fonts_list.xml file, both groups
+
+void
+FontCompiler::add_fonts(std::vector<std::string> & fonts)
+{
+  xml_document doc;
+
+  if (doc.load_file(MAIN_FOLDER "/fonts_list.xml").status != status_ok) {
+    LOG_E("Unable to read fonts definition file fonts_list.xml.");
+    return;
+  }
+
+  for (auto group : doc.child("fonts").children("group")) {
+    for (auto font : group.children("font")) {
+      for (auto face : font.children()) {
+        std::string filename = face.attribute("filename").value();
+        std::string ext      = filename.substr(filename.find_last_of('.') + 1);
+
+        if ((ext != "ttf") && (ext != "otf")) continue;
+
+        filename = std::string(FONTS_FOLDER "/").append(filename);
+        if (std::find(fonts.begin(), fonts.end(), filename) == fonts.end()) fonts.push_back(filename);
+      }
+    }
+  }
+}
+
+// Gray levels reduced to 4 bits, in runs of up to 16 pixels
+
+void
+FontCompiler::encode(const FT_Bitmap & bitmap, std::vector<uint8_t> & out)
+{
+  uint8_t value = 0;
+  uint8_t count = 0;
+
+  for (uint32_t row = 0; row < bitmap.rows; row++) {
+    const uint8_t * line = bitmap.buffer + (row * bitmap.pitch);
+
+    for (uint32_t col = 0; col < bitmap.width; col++) {
+      uint8_t v;
+
+      if (bitmap.pixel_mode == FT_PIXEL_MODE_MONO) {
+        v = (line[col >> 3] & (0x80 >> (col & 7))) ? 15 : 0;
+      }
+      else {
+        v = ((line[col] * 15) + 127) / 255;
+      }
+
+      if ((count > 0) && ((v != value) || (count == 16))) {
+        out.push_back(((count - 1) << 4) | value);
+        count = 0;
+      }
+      value = v;
+      count++;
+    }
+  }
+
+  if (count > 0) out.push_back(((count - 1) << 4) | value);
+}
+
+bool
+FontCompiler::compile(const std::string & font_filename, const std::string & bfnt_filename)
+{
+  FT_Face face;
+
+  if (FT_New_Face(library, font_filename.c_str(), 0, &face) != 0) {
+    LOG_E("Unable to load font %s", font_filename.c_str());
+    return false;
+  }
+
+  // The characters of the face, in code order
+
+  std::vector<std::pair<uint32_t, FT_UInt>> chars;
+
+  FT_UInt  index;
+  FT_ULong code = FT_Get_First_Char(face, &index);
+
+  while (index != 0) {
+    chars.push_back({ code, index });
+    code = FT_Get_Next_Char(face, code, &index);
+  }
+  std::sort(chars.begin(), chars.end());
+  if (chars.size() > 0xFFFF) chars.resize(0xFFFF);
+
+  struct SizeData {
+    std::vector<BFNT::GlyphInfo> glyphs;
+    std::vector<BFNT::KernPair>  kerns;
+    std::vector<uint8_t>         bitmaps;
+  };
+
+  std::vector<BFNT::SizeInfo> size_infos;
+  std::vector<SizeData>       size_data(sizes.size());
+  uint32_t                    offset = sizeof(BFNT::Header) + (sizes.size() * sizeof(BFNT::SizeInfo));
+
+  for (uint8_t i = 0; i < sizes.size(); i++) {
+    SizeData             & data = size_data[i];
+    std::vector<FT_UInt>   indexes;
+
+    // Same parameters as the TTF class
+
+    if (FT_Set_Char_Size(face, 0, sizes[i] * 64, resolution, resolution) != 0) {
+      LOG_E("Unable to set font size %d for %s", sizes[i], font_filename.c_str());
+      FT_Done_Face(face);
+      return false;
+    }
+
+    for (auto & ch : chars) {
+      if (FT_Load_Glyph(face, ch.second, FT_LOAD_DEFAULT) != 0) continue;
+
+      FT_GlyphSlot slot = face->glyph;
+
+      if ((slot->format != FT_GLYPH_FORMAT_BITMAP) &&
+          (FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL) != 0)) continue;
+
+      BFNT::GlyphInfo info;
+
+      memset(&info, 0, sizeof(info));
+      info.code          =  ch.first;
+      info.bitmap_offset =  data.bitmaps.size();
+      info.width         =  slot->bitmap.width;
+      info.height        =  slot->bitmap.rows;
+      info.xoff          =  slot->bitmap_left;
+      info.yoff          = -slot->bitmap_top;
+      info.advance       =  slot->advance.x >> 6;
+
+      encode(slot->bitmap, data.bitmaps);
+      if ((data.bitmaps.size() - info.bitmap_offset) > 0xFFFF) {
+        LOG_E("Glyph %u too large at size %d, skipped", (unsigned) ch.first, sizes[i]);
+        data.bitmaps.resize(info.bitmap_offset);
+        continue;
+      }
+      info.bitmap_size   = data.bitmaps.size() - info.bitmap_offset;
+
+      data.glyphs.push_back(info);
+      indexes.push_back(ch.second);
+    }
+
+    // Kerning pairs, grouped by left glyph and sorted by right character
+
+    if (FT_HAS_KERNING(face)) {
+      for (uint16_t left = 0; left < data.glyphs.size(); left++) {
+        data.glyphs[left].kern_index = data.kerns.size();
+        for (uint16_t right = 0; right < data.glyphs.size(); right++) {
+          FT_Vector delta;
+          if ((FT_Get_Kerning(face, indexes[left], indexes[right], FT_KERNING_DEFAULT, &delta) == 0) &&
+              ((delta.x >> 6) != 0) &&
+              (data.kerns.size() < 0xFFFF)) {
+            data.kerns.push_back({ .next_code = data.glyphs[right].code,
+                                   .kern      = (int16_t) (delta.x >> 6),
+                                   .filler    = 0 });
+          }
+        }
+        data.glyphs[left].kern_count = data.kerns.size() - data.glyphs[left].kern_index;
+      }
+    }
+
+    BFNT::SizeInfo size_info;
+
+    memset(&size_info, 0, sizeof(size_info));
+    size_info.size           = sizes[i];
+    size_info.line_height    = face->size->metrics.height    >> 6;
+    size_info.descender      = face->size->metrics.descender >> 6;
+    size_info.glyph_count    = data.glyphs.size();
+    size_info.kern_count     = data.kerns.size();
+    size_info.glyphs_offset  = offset;
+    size_info.bitmaps_offset = offset +
+                               (data.glyphs.size() * sizeof(BFNT::GlyphInfo)) +
+                               (data.kerns.size()  * sizeof(BFNT::KernPair ));
+
+    offset = size_info.bitmaps_offset + data.bitmaps.size();
+
+    size_infos.push_back(size_info);
+  }
+
+  FT_Done_Face(face);
+
+  std::ofstream file(bfnt_filename, std::ios::out | std::ios::binary);
+
+  if (!file.is_open()) {
+    LOG_E("Unable to create %s", bfnt_filename.c_str());
+    return false;
+  }
+
+  BFNT::Header header;
+
+  memcpy(header.ident, "BFNT", 4);
+  header.version    = BFNT::BFNT_FILE_VERSION;
+  header.size_count = sizes.size();
+  header.resolution = resolution;
+
+  file.write((char *) &header, sizeof(header));
+  file.write((char *) size_infos.data(), size_infos.size() * sizeof(BFNT::SizeInfo));
+
+  for (auto & data : size_data) {
+    file.write((char *) data.glyphs.data(),  data.glyphs.size() * sizeof(BFNT::GlyphInfo));
+    file.write((char *) data.kerns.data(),   data.kerns.size()  * sizeof(BFNT::KernPair ));
+    file.write((char *) data.bitmaps.data(), data.bitmaps.size());
+  }
+
+  bool ok = !file.fail();
+  file.close();
+
+  if (!ok) {
+    LOG_E("Unable to write %s", bfnt_filename.c_str());
+    remove(bfnt_filename.c_str());
+    return false;
+  }
+
+  printf("%s: %d characters, %d kerning pairs, %u bytes\n",
+         bfnt_filename.c_str(),
+         (int) chars.size(),
+         (int) (size_data.empty() ? 0 : size_data[0].kerns.size()),
+         offset);
+
+  return true;
+}
+
+int
+FontCompiler::run(int argc, char ** argv)
+{
+  bool usage = false;
+  int  opt;
+
+  resolution = Screen::RESOLUTION;
+
+  optind = 2;
+  while ((opt = getopt(argc, argv, "r:s:o:")) != -1) {
+    switch (opt) {
+      case 'r':
+        resolution = atoi(optarg);
+        usage      = usage || (resolution < 50);
+        break;
+      case 's':
+        for (char * size = strtok(optarg, ","); size != nullptr; size = strtok(nullptr, ",")) {
+          sizes.push_back(atoi(size));
+          usage = usage || (sizes.back() < 1) || (sizes.size() > 255);
+        }
+        break;
+      case 'o':
+        folder = optarg;
+        break;
+      default:
+        usage = true;
+        break;
+    }
+  }
+
+  if (usage) {
+    fprintf(stderr, "Usage: %s -b [-r <resolution>] [-s <size>[,<size>...]] [-o <folder>]\n"
+                    "          [<font file>...]\n", argv[0]);
+    return 1;
+  }
+
+  if (sizes.empty()) {
+    for (auto & choice : FormChoiceField::font_size_choices) sizes.push_back(choice.value);
+  }
+
+  std::vector<std::string> fonts;
+  if (optind == argc) add_fonts(fonts);
+  for (int i = optind; i < argc; i++) fonts.push_back(argv[i]);
+
+  if (fonts.empty()) {
+    LOG_E("No font found");
+    return 1;
+  }
+
+  if (FT_Init_FreeType(&library) != 0) {
+    LOG_E("An error occurred during FreeType library initialization.");
+    return 1;
+  }
+
+  int64_t start    = PerfStats::get_time_us();
+  int     failures = 0;
+
+  for (auto & font : fonts) {
+    std::string bfnt_filename = BFNT::get_filename(font, resolution);
+    if (!folder.empty()) {
+      size_t pos    = bfnt_filename.find_last_of('/');
+      bfnt_filename = folder + "/" + bfnt_filename.substr((pos == std::string::npos) ? 0 : (pos + 1));
+    }
+    if (!compile(font, bfnt_filename)) failures++;
+  }
+
+  FT_Done_FreeType(library);
+  library = nullptr;
+
+  printf("\n%d fonts at %d dpi, %d failed, %.1f s\n",
+         (int) fonts.size(), resolution, failures,
+         (PerfStats::get_time_us() - start) / 1000000.0);
+
+  return (failures == 0) ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#if TESTING && EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "gtest/gtest.h"
+#include "helpers/font_compiler.hpp"
+#include "models/font_factory.hpp"
+#include "screen.hpp"
+
+#include <cstdlib>
+#include <memory>
+
+static constexpr char const * FONT_COMPILER_FOLDER = "/tmp/epub_font_compiler_tests";
+static constexpr char const * FONT_NAME            = "CrimsonPro-Medium";
+
+TEST(FontCompilerTest, glyphs_same_as_rasterized) {
+  std::string folder    = FONT_COMPILER_FOLDER;
+  std::string font_file = folder + "/" + FONT_NAME + ".otf";
+  std::string cmd       = "rm -rf " + folder + " && mkdir -p " + folder +
+                          " && cp " FONTS_FOLDER "/" + FONT_NAME + ".otf " + folder;
+  ASSERT_EQ(system(cmd.c_str()), 0);
+
+  char         sizes[] = "10,12";    // Modified by the options parsing
+  const char * argv[]  = { "epub-inkplate", "-b", "-s", sizes, font_file.c_str() };
+  FontCompiler font_compiler;
+
+  EXPECT_EQ(font_compiler.run(5, (char **) argv), 0);
+
+  // The precompiled font is used when present
+
+  std::unique_ptr<Font> compiled(FontFactory::create(font_file));
+  std::unique_ptr<Font> ttf(new TTF(font_file));
+
+  ASSERT_TRUE(compiled != nullptr);
+  ASSERT_TRUE(compiled->is_ready());
+  EXPECT_NE(dynamic_cast<BFNT *>(compiled.get()), nullptr);
+
+  bool gray = screen.get_pixel_resolution() != Screen::PixelResolution::ONE_BIT;
+
+  EXPECT_EQ(compiled->get_line_height(12),      ttf->get_line_height(12));
+  EXPECT_EQ(compiled->get_descender_height(12), ttf->get_descender_height(12));
+
+  for (uint32_t code : std::initializer_list<uint32_t>{ 'H', 'a', 'g', 'W', 0xE9 }) {
+    Font::Glyph * g1 = compiled->get_glyph(code, 12);
+    Font::Glyph * g2 = ttf->get_glyph(code, 12);
+
+    ASSERT_TRUE((g1 != nullptr) && (g2 != nullptr));
+    EXPECT_EQ(g1->advance,    g2->advance   );
+    EXPECT_EQ(g1->dim.width,  g2->dim.width );
+    EXPECT_EQ(g1->dim.height, g2->dim.height);
+    EXPECT_EQ(g1->xoff,       g2->xoff      );
+    EXPECT_EQ(g1->yoff,       g2->yoff      );
+    EXPECT_EQ(g1->font,       compiled.get());
+
+    if (gray) {
+      int max_diff = 0;
+      for (int i = 0; i < g1->dim.width * g1->dim.height; i++) {
+        max_diff = std::max(max_diff, abs(g1->buffer[i] - g2->buffer[i]));
+      }
+      EXPECT_LE(max_diff, 9) << "code " << code;
+    }
+  }
+
+  // A size not precompiled is rasterized from the font itself
+
+  Font::Glyph * g1 = compiled->get_glyph('a', 13);
+  Font::Glyph * g2 = ttf->get_glyph('a', 13);
+
+  ASSERT_TRUE((g1 != nullptr) && (g2 != nullptr));
+  EXPECT_EQ(g1->advance, g2->advance);
+  EXPECT_EQ(g1->font,    compiled.get());
+  EXPECT_EQ(compiled->get_line_height(13), ttf->get_line_height(13));
+}
+
+#endif
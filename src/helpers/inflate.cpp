@@ -0,0 +1,590 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#include "helpers/inflate.hpp"
+#include "alloc.hpp"
+
+#include <cstring>
+
+// The bit buffer and the match copies rely on little-endian unaligned loads
+// through memcpy (x86, ESP32).
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Inflate requires a little-endian target");
+
+// ----- Decode tables -----
+//
+// A table entry is 32 bits:
+//
+//   bits  0..7  : input bits consumed by the entry: the code, followed by
+//                 its extra bits for a length or a distance
+//   bits  8..11 : code length, or index bits of the sub-table (SUBTABLE).
+//                 In the symbol entries below: the extra bits count.
+//   bits 12..15 : kind of entry
+//   bits 16..31 : literal (LITERAL), two literals (LITERALS), base value of
+//                 the length or distance (BASE), position of the sub-table
+//                 (SUBTABLE), or precode symbol (LITERAL)
+
+enum EntryKind : uint32_t { LITERAL, LITERALS, BASE, END_OF_BLOCK, SUBTABLE, INVALID };
+
+static constexpr uint32_t
+entry(uint32_t kind, uint32_t value, uint32_t extra = 0, uint32_t bits = 0)
+{
+  return (value << 16) | (kind << 12) | (extra << 8) | bits;
+}
+
+static inline uint32_t entry_kind(uint32_t e)  { return (e >> 12) & 0x0F; }
+static inline uint32_t entry_code(uint32_t e)  { return (e >>  8) & 0x0F; }
+static inline uint32_t entry_bits(uint32_t e)  { return e & 0xFF;         }
+
+// Table entry of a symbol with a code of len bits
+
+static inline uint32_t
+code_entry(uint32_t sym_entry, uint32_t len)
+{
+  return (sym_entry & 0xFFFFF000) | (len << 8) | (len + entry_code(sym_entry));
+}
+
+static constexpr uint8_t LITLEN_TABLE_BITS  = 11;
+static constexpr uint8_t DIST_TABLE_BITS    =  8;
+static constexpr uint8_t PRECODE_TABLE_BITS =  7;
+
+// Room for the main table and the sub-tables of any valid code, as given by
+// zlib's enough utility (288 and 32 symbols, codes up to 15 bits)
+
+static constexpr uint32_t LITLEN_TABLE_SIZE  = 2342;
+static constexpr uint32_t DIST_TABLE_SIZE    =  402;
+static constexpr uint32_t PRECODE_TABLE_SIZE = 1 << PRECODE_TABLE_BITS;
+
+static constexpr uint16_t LITLEN_SYMBOLS  = 288;
+static constexpr uint16_t DIST_SYMBOLS    =  32;
+static constexpr uint16_t PRECODE_SYMBOLS =  19;
+static constexpr uint8_t  MAX_CODE_LENGTH =  15;
+
+static constexpr uint16_t LENGTH_BASE[29] = {
+    3,   4,   5,   6,   7,   8,   9,  10,  11,  13,  15,  17,  19,  23, 27,
+   31,  35,  43,  51,  59,  67,  83,  99, 115, 131, 163, 195, 227, 258
+};
+static constexpr uint8_t LENGTH_EXTRA[29] = {
+    0,   0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,   2,   2,  2,
+    2,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   0
+};
+static constexpr uint16_t DIST_BASE[30] = {
+     1,    2,    3,    4,    5,    7,    9,   13,    17,    25,    33,    49,    65,    97,   129,
+   193,  257,  385,  513,  769, 1025, 1537, 2049,  3073,  4097,  6145,  8193, 12289, 16385, 24577
+};
+static constexpr uint8_t DIST_EXTRA[30] = {
+     0,    0,    0,    0,    1,    1,    2,    2,     3,     3,     4,     4,     5,     5,     6,
+     6,    7,    7,    8,    8,    9,    9,   10,    10,    11,    11,    12,    12,    13,    13
+};
+
+static constexpr uint8_t PRECODE_ORDER[PRECODE_SYMBOLS] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Entries of the symbols, before the code length is added
+
+template <uint16_t N>
+struct SymbolEntries { uint32_t e[N]; };
+
+static constexpr SymbolEntries<LITLEN_SYMBOLS>
+litlen_entries()
+{
+  SymbolEntries<LITLEN_SYMBOLS> entries{};
+  for (uint16_t sym = 0; sym < LITLEN_SYMBOLS; sym++) {
+    entries.e[sym] = (sym <  256) ? entry(LITERAL, sym) :
+                     (sym == 256) ? entry(END_OF_BLOCK, 0) :
+                     (sym <  286) ? entry(BASE, LENGTH_BASE[sym - 257], LENGTH_EXTRA[sym - 257]) :
+                                    entry(INVALID, 0);
+  }
+  return entries;
+}
+
+static constexpr SymbolEntries<DIST_SYMBOLS>
+dist_entries()
+{
+  SymbolEntries<DIST_SYMBOLS> entries{};
+  for (uint16_t sym = 0; sym < DIST_SYMBOLS; sym++) {
+    entries.e[sym] = (sym < 30) ? entry(BASE, DIST_BASE[sym], DIST_EXTRA[sym]) : entry(INVALID, 0);
+  }
+  return entries;
+}
+
+static constexpr SymbolEntries<PRECODE_SYMBOLS>
+precode_entries()
+{
+  SymbolEntries<PRECODE_SYMBOLS> entries{};
+  for (uint16_t sym = 0; sym < PRECODE_SYMBOLS; sym++) entries.e[sym] = entry(LITERAL, sym);
+  return entries;
+}
+
+static constexpr SymbolEntries<LITLEN_SYMBOLS>  LITLEN_ENTRIES  = litlen_entries();
+static constexpr SymbolEntries<DIST_SYMBOLS>    DIST_ENTRIES    = dist_entries();
+static constexpr SymbolEntries<PRECODE_SYMBOLS> PRECODE_ENTRIES = precode_entries();
+
+struct Tables {
+  uint32_t litlen[LITLEN_TABLE_SIZE];
+  uint32_t dist[DIST_TABLE_SIZE];
+  uint32_t precode[PRECODE_TABLE_SIZE];
+  uint8_t  lens[LITLEN_SYMBOLS + DIST_SYMBOLS];
+};
+
+// Build the decode table of a canonical Huffman code from its code lengths.
+// DEFLATE codes are sent least significant bit first: a table is indexed by
+// the next input bits, that is the bit-reversed codes, incremented as such.
+// Codes longer than the table bits continue in a sub-table, sized for the
+// codes sharing the same first table bits (as zlib does). Incomplete codes
+// are accepted, their missing codes decoding as INVALID.
+
+static bool
+build_table(uint32_t * table, uint32_t table_size, uint8_t table_bits,
+            const uint8_t * lens, uint16_t sym_count, const uint32_t * sym_entries)
+{
+  uint16_t count[MAX_CODE_LENGTH + 1] = { 0 };
+  uint16_t offset[MAX_CODE_LENGTH + 2];
+  uint16_t sorted[LITLEN_SYMBOLS];
+
+  for (uint16_t sym = 0; sym < sym_count; sym++) count[lens[sym]]++;
+  count[0] = 0;
+
+  int32_t left = 1;
+  for (uint8_t len = 1; len <= MAX_CODE_LENGTH; len++) {
+    left = (left << 1) - count[len];
+    if (left < 0) return false; // Over-subscribed
+  }
+
+  offset[1] = 0;
+  for (uint8_t len = 1; len <= MAX_CODE_LENGTH; len++) offset[len + 1] = offset[len] + count[len];
+  for (uint16_t sym = 0; sym < sym_count; sym++) {
+    if (lens[sym] != 0) sorted[offset[lens[sym]]++] = sym;
+  }
+
+  uint8_t max_len = MAX_CODE_LENGTH;
+  while ((max_len > 0) && (count[max_len] == 0)) max_len--;
+
+  // All the entries of a complete code are overwritten below
+
+  const uint32_t main_size = 1 << table_bits;
+  if (left != 0) {
+    for (uint32_t i = 0; i < main_size; i++) table[i] = entry(INVALID, 0);
+  }
+
+  uint32_t next_free  = main_size;
+  uint32_t sub_prefix = UINT32_MAX;
+  uint32_t sub_start  = 0;
+  uint8_t  sub_bits   = 0;
+  uint32_t reversed   = 0;
+  uint16_t idx        = 0;
+
+  for (uint8_t len = 1; len <= max_len; len++) {
+    for (uint16_t n = count[len]; n > 0; n--) {
+      uint16_t sym = sorted[idx++];
+
+      if (len <= table_bits) {
+        uint32_t e = code_entry(sym_entries[sym], len);
+        for (uint32_t i = reversed; i < main_size; i += (1 << len)) table[i] = e;
+      }
+      else {
+        uint32_t prefix = reversed & (main_size - 1);
+
+        if (prefix != sub_prefix) {
+
+          // Sub-table large enough for the remaining codes with this prefix
+
+          sub_bits = len - table_bits;
+          int32_t room = 1 << sub_bits;
+          while ((sub_bits + table_bits) < max_len) {
+            room -= count[sub_bits + table_bits];
+            if (room <= 0) break;
+            sub_bits++;
+            room <<= 1;
+          }
+
+          sub_start = next_free;
+          next_free += 1 << sub_bits;
+          if (next_free > table_size) return false;
+
+          for (uint32_t i = sub_start; i < next_free; i++) table[i] = entry(INVALID, 0);
+          table[prefix] = entry(SUBTABLE, sub_start, sub_bits, table_bits);
+          sub_prefix    = prefix;
+        }
+
+        uint8_t  sub_len = len - table_bits;
+        uint32_t e       = code_entry(sym_entries[sym], sub_len);
+        for (uint32_t i = reversed >> table_bits; i < (1U << sub_bits); i += (1 << sub_len)) {
+          table[sub_start + i] = e;
+        }
+      }
+
+      count[len]--;
+
+      uint32_t bit = 1 << (len - 1);
+      while (reversed & bit) bit >>= 1;
+      reversed = (reversed & (bit - 1)) | bit;
+    }
+  }
+
+  return true;
+}
+
+// Literal/length main table entries for which the following code is also a
+// literal, fitting in the remaining index bits, are replaced with entries
+// decoding both literals at once. The entries are scanned downward: the
+// entry of the second literal (at a lower index) is then still a single
+// literal entry when it is read. No branch: the outcome is unpredictable.
+//
+// The scan costs about as much as decoding a few KB: it is only done for
+// large outputs, and skipped when the literal codes are too long to be
+// paired, as in the blocks where matches dominate.
+
+static constexpr uint32_t PAIRING_MIN_OUTPUT = 32 * 1024;
+
+static void
+pair_literals(uint32_t * table, const uint8_t * lens)
+{
+  uint8_t shortest = MAX_CODE_LENGTH;
+  for (uint16_t sym = 0; sym < 256; sym++) {
+    if ((lens[sym] != 0) && (lens[sym] < shortest)) shortest = lens[sym];
+  }
+  if ((shortest * 2) > LITLEN_TABLE_BITS) return;
+
+  for (int32_t i = (1 << LITLEN_TABLE_BITS) - 1; i >= 0; i--) {
+    uint32_t e   = table[i];
+    uint32_t len = entry_bits(e);
+    uint32_t e2  = table[i >> len];
+
+    bool pair = (entry_kind(e) == LITERAL) & (entry_kind(e2) == LITERAL) &
+                ((len + entry_bits(e2)) <= LITLEN_TABLE_BITS);
+
+    uint32_t paired = entry(LITERALS, (e >> 16) | ((e2 >> 16) << 8), 0, len + entry_bits(e2));
+    table[i] = pair ? paired : e;
+  }
+}
+
+static bool
+build_fixed_tables(Tables & t)
+{
+  memset(&t.lens[  0], 8, 144);
+  memset(&t.lens[144], 9, 112);
+  memset(&t.lens[256], 7,  24);
+  memset(&t.lens[280], 8,   8);
+  memset(&t.lens[LITLEN_SYMBOLS], 5, DIST_SYMBOLS);
+
+  if (!build_table(t.litlen, LITLEN_TABLE_SIZE, LITLEN_TABLE_BITS,
+                   t.lens, LITLEN_SYMBOLS, LITLEN_ENTRIES.e)) return false;
+  pair_literals(t.litlen, t.lens);
+
+  return build_table(t.dist, DIST_TABLE_SIZE, DIST_TABLE_BITS,
+                     &t.lens[LITLEN_SYMBOLS], DIST_SYMBOLS, DIST_ENTRIES.e);
+}
+
+// ----- Decoder -----
+
+static bool
+decode(Tables & t, const uint8_t * in, uint32_t in_size, uint8_t * out, uint32_t out_size)
+{
+  const uint8_t *       in_next  = in;
+  const uint8_t * const in_end   = in + in_size;
+  uint8_t *             out_next = out;
+  uint8_t * const       out_end  = out + out_size;
+
+  uint64_t bitbuf   = 0;
+  uint32_t bitsleft = 0;   // Valid bits in bitbuf. Bits above them may hold input not yet counted.
+  uint32_t overread = 0;   // Zero bytes supplied past the end of the input
+
+  // At least 56 valid bits after a refill. The fast path loads 8 bytes and
+  // only advances past the whole bytes taken in.
+
+  auto refill = [&]() {
+    if ((in_end - in_next) >= 8) {
+      uint64_t word;
+      memcpy(&word, in_next, 8);
+      bitbuf   |= word << bitsleft;
+      in_next  += (63 - bitsleft) >> 3;
+      bitsleft |= 56;
+    }
+    else {
+      while (bitsleft <= 56) {
+        if (in_next < in_end) bitbuf |= (uint64_t) *in_next++ << bitsleft;
+        else overread++;
+        bitsleft += 8;
+      }
+    }
+  };
+
+  auto bits = [&](uint32_t count) -> uint32_t { return bitbuf & ((1ULL << count) - 1); };
+  auto drop = [&](uint32_t count) { bitbuf >>= count; bitsleft -= count; };
+
+  bool last         = false;
+  bool fixed_tables = false;
+
+  while (!last) {
+    refill();
+    last = bits(1); drop(1);
+    uint32_t type = bits(2); drop(2);
+
+    if (type == 0) {
+
+      // Stored block: back to the first byte not consumed
+
+      drop(bitsleft & 7);
+      if (overread > (bitsleft >> 3)) return false;
+      in_next -= (bitsleft >> 3) - overread;
+      bitbuf   = 0;
+      bitsleft = 0;
+      overread = 0;
+
+      if ((in_end - in_next) < 4) return false;
+      uint32_t len  = in_next[0] | (in_next[1] << 8);
+      uint32_t nlen = in_next[2] | (in_next[3] << 8);
+      in_next += 4;
+
+      if ((len != (~nlen & 0xFFFF)) ||
+          (len > (uint32_t) (in_end - in_next)) ||
+          (len > (uint32_t) (out_end - out_next))) return false;
+
+      memcpy(out_next, in_next, len);
+      in_next  += len;
+      out_next += len;
+      continue;
+    }
+    else if (type == 1) {
+      if (!fixed_tables) {
+        if (!build_fixed_tables(t)) return false;
+        fixed_tables = true;
+      }
+    }
+    else if (type == 2) {
+      uint32_t hlit  = bits(5) + 257; drop(5);
+      uint32_t hdist = bits(5) +   1; drop(5);
+      uint32_t hclen = bits(4) +   4; drop(4);
+      if ((hlit > 286) || (hdist > 30)) return false;
+
+      uint8_t precode_lens[PRECODE_SYMBOLS] = { 0 };
+      for (uint32_t i = 0; i < hclen; i++) {
+        refill();
+        precode_lens[PRECODE_ORDER[i]] = bits(3); drop(3);
+      }
+      if (!build_table(t.precode, PRECODE_TABLE_SIZE, PRECODE_TABLE_BITS,
+                       precode_lens, PRECODE_SYMBOLS, PRECODE_ENTRIES.e)) return false;
+
+      // Literal/length and distance code lengths, as one sequence
+
+      uint32_t count = hlit + hdist;
+      uint32_t i     = 0;
+      while (i < count) {
+        refill();
+        uint32_t e = t.precode[bits(PRECODE_TABLE_BITS)];
+        if (entry_kind(e) == INVALID) return false;
+        drop(entry_bits(e));
+
+        uint32_t sym = e >> 16;
+        if (sym < 16) {
+          t.lens[i++] = sym;
+          continue;
+        }
+
+        uint8_t  value  = 0;
+        uint32_t repeat;
+        if (sym == 16) {
+          if (i == 0) return false;
+          value  = t.lens[i - 1];
+          repeat =  3 + bits(2); drop(2);
+        }
+        else if (sym == 17) {
+          repeat =  3 + bits(3); drop(3);
+        }
+        else {
+          repeat = 11 + bits(7); drop(7);
+        }
+        if ((i + repeat) > count) return false;
+        memset(&t.lens[i], value, repeat);
+        i += repeat;
+      }
+
+      if (t.lens[256] == 0) return false; // No end of block code
+
+      // The distance lengths are moved after all the literal/length ones
+
+      memmove(&t.lens[LITLEN_SYMBOLS], &t.lens[hlit], hdist);
+      memset(&t.lens[hlit], 0, LITLEN_SYMBOLS - hlit);
+      memset(&t.lens[LITLEN_SYMBOLS + hdist], 0, DIST_SYMBOLS - hdist);
+
+      if (!build_table(t.litlen, LITLEN_TABLE_SIZE, LITLEN_TABLE_BITS,
+                       t.lens, LITLEN_SYMBOLS, LITLEN_ENTRIES.e) ||
+          !build_table(t.dist, DIST_TABLE_SIZE, DIST_TABLE_BITS,
+                       &t.lens[LITLEN_SYMBOLS], DIST_SYMBOLS, DIST_ENTRIES.e)) return false;
+      if ((out_end - out_next) >= PAIRING_MIN_OUTPUT) pair_literals(t.litlen, t.lens);
+      fixed_tables = false;
+    }
+    else {
+      return false;
+    }
+
+    // Huffman coded symbols. A refill gives enough bits for the longest
+    // length code, its extra bits, and the longest distance code with its
+    // extra bits (15 + 5 + 15 + 13 = 48). The next literal/length entry is
+    // looked up before the refill, that only adds bits above the ones in use.
+
+    refill();
+    uint32_t e = t.litlen[bits(LITLEN_TABLE_BITS)];
+
+    while (true) {
+      if (entry_kind(e) == SUBTABLE) {
+        drop(LITLEN_TABLE_BITS);
+        e = t.litlen[(e >> 16) + bits(entry_code(e))];
+      }
+
+      // A length code and its extra bits are consumed at once
+
+      uint64_t saved = bitbuf;
+      drop(entry_bits(e));
+
+      uint32_t kind = entry_kind(e);
+
+      if (kind <= LITERALS) {
+
+        // Both bytes are written, the second one is overwritten by the
+        // next symbol for a single literal
+
+        if ((out_end - out_next) >= 2) {
+          uint16_t literals = e >> 16;
+          memcpy(out_next, &literals, 2);
+          out_next += kind + 1;
+        }
+        else if ((kind == LITERAL) && (out_next < out_end)) {
+          *out_next++ = e >> 16;
+        }
+        else {
+          return false;
+        }
+
+        uint32_t next = t.litlen[bits(LITLEN_TABLE_BITS)];
+        refill();
+        e = next;
+        continue;
+      }
+      if (kind == END_OF_BLOCK) break;
+      if (kind != BASE) return false;
+
+      uint32_t length = (e >> 16) + ((saved & ((1ULL << entry_bits(e)) - 1)) >> entry_code(e));
+
+      e = t.dist[bits(DIST_TABLE_BITS)];
+      if (entry_kind(e) == SUBTABLE) {
+        drop(DIST_TABLE_BITS);
+        e = t.dist[(e >> 16) + bits(entry_code(e))];
+      }
+      if (entry_kind(e) != BASE) return false;
+
+      saved = bitbuf;
+      drop(entry_bits(e));
+      uint32_t distance = (e >> 16) + ((saved & ((1ULL << entry_bits(e)) - 1)) >> entry_code(e));
+
+      if ((distance > (uint32_t) (out_next - out)) ||
+          (length   > (uint32_t) (out_end - out_next))) return false;
+
+      const uint8_t * src = out_next - distance;
+      uint8_t *       end = out_next + length;
+
+      if ((distance >= 8) && ((out_end - end) >= 16)) {
+
+        // Most matches are short: two words are copied without testing the
+        // length. Up to 15 bytes past the match may be written, to be
+        // overwritten by the following symbols.
+
+        uint64_t word;
+        memcpy(&word, src,     8); memcpy(out_next,     &word, 8);
+        memcpy(&word, src + 8, 8); memcpy(out_next + 8, &word, 8);
+
+        if (length > 16) {
+          src      += 16;
+          out_next += 16;
+          do {
+            memcpy(&word, src, 8);
+            memcpy(out_next, &word, 8);
+            src      += 8;
+            out_next += 8;
+          } while (out_next < end);
+        }
+        out_next = end;
+      }
+      else if (distance == 1) {
+        memset(out_next, *src, length);
+        out_next = end;
+      }
+      else {
+        while (out_next < end) *out_next++ = *src++;
+      }
+
+      refill();
+      e = t.litlen[bits(LITLEN_TABLE_BITS)];
+    }
+
+    if ((overread << 3) > bitsleft) return false; // Truncated input
+  }
+
+  return out_next == out_end;
+}
+
+bool
+Inflate::decompress(const uint8_t * in, uint32_t in_size, uint8_t * out, uint32_t out_size)
+{
+  Tables * tables = (Tables *) allocate(sizeof(Tables));
+  if (tables == nullptr) {
+    LOG_E("Unable to allocate decode tables.");
+    return false;
+  }
+
+  bool res = decode(*tables, in, in_size, out, out_size);
+
+  free(tables);
+  return res;
+}
+
+// ----- CRC-32 -----
+
+struct CRC32Tables { uint32_t t[8][256]; };
+
+static constexpr CRC32Tables
+crc32_tables()
+{
+  CRC32Tables tables{};
+
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+    tables.t[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; i++) {
+    for (int s = 1; s < 8; s++) {
+      tables.t[s][i] = (tables.t[s - 1][i] >> 8) ^ tables.t[0][tables.t[s - 1][i] & 0xFF];
+    }
+  }
+
+  return tables;
+}
+
+static constexpr CRC32Tables CRC32_TABLES = crc32_tables();
+
+uint32_t
+Inflate::update_crc32(uint32_t crc, const uint8_t * data, size_t size)
+{
+  const uint32_t (* t)[256] = CRC32_TABLES.t;
+
+  crc = ~crc;
+
+  while (size >= 8) {
+    uint32_t lo, hi;
+    memcpy(&lo, data,     4);
+    memcpy(&hi, data + 4, 4);
+    lo ^= crc;
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    data += 8;
+    size -= 8;
+  }
+
+  while (size-- > 0) crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+
+  return ~crc;
+}
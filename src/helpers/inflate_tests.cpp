@@ -0,0 +1,390 @@
+#if TESTING && EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "gtest/gtest.h"
+#include "helpers/inflate.hpp"
+#include "helpers/unzip.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::vector<uint8_t>
+sample_text(uint32_t size)
+{
+  static const char * words[] = {
+    "lorem ", "ipsum ", "dolor ", "sit ", "amet, ", "consectetur ", "adipiscing ", "elit. ",
+    "<p>", "</p>\n", "<em>", "</em> ", "sed ", "do ", "eiusmod ", "tempor "
+  };
+
+  std::mt19937 rng(4321);
+  std::string  text;
+  while (text.size() < size) text += words[rng() & 15];
+
+  return std::vector<uint8_t>(text.begin(), text.begin() + size);
+}
+
+// Fixed Huffman codes encoder, with greedy matches found through a hash of
+// the next 3 bytes
+
+static constexpr uint16_t LENGTH_BASE[29] = {
+    3,   4,   5,   6,   7,   8,   9,  10,  11,  13,  15,  17,  19,  23, 27,
+   31,  35,  43,  51,  59,  67,  83,  99, 115, 131, 163, 195, 227, 258
+};
+static constexpr uint16_t DIST_BASE[30] = {
+     1,    2,    3,    4,    5,    7,    9,   13,    17,    25,    33,    49,    65,    97,   129,
+   193,  257,  385,  513,  769, 1025, 1537, 2049,  3073,  4097,  6145,  8193, 12289, 16385, 24577
+};
+
+struct BitWriter {
+  std::vector<uint8_t> out;
+  uint64_t acc   = 0;
+  int      count = 0;
+
+  void put(uint32_t value, int bits) {
+    acc   |= (uint64_t) value << count;
+    count += bits;
+    while (count >= 8) { out.push_back(acc); acc >>= 8; count -= 8; }
+  }
+  void put_code(uint32_t code, int len) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < len; i++) reversed |= ((code >> i) & 1) << (len - 1 - i);
+    put(reversed, len);
+  }
+  void put_litlen(uint32_t sym) {
+    if      (sym < 144) put_code(0x30  +  sym,        8);
+    else if (sym < 256) put_code(0x190 + (sym - 144), 9);
+    else if (sym < 280) put_code(         sym - 256,  7);
+    else                put_code(0xC0  + (sym - 280), 8);
+  }
+  void flush() { if (count > 0) put(0, 8 - count); }
+};
+
+static void
+put_match(BitWriter & w, uint32_t length, uint32_t distance)
+{
+  int l = 28;
+  while (LENGTH_BASE[l] > length) l--;
+  w.put_litlen(257 + l);
+  if ((l >= 8) && (l < 28)) w.put(length - LENGTH_BASE[l], (l - 4) >> 2);
+
+  int d = 29;
+  while (DIST_BASE[d] > distance) d--;
+  w.put_code(d, 5);
+  if (d >= 4) w.put(distance - DIST_BASE[d], (d - 2) >> 1);
+}
+
+static std::vector<uint8_t>
+fixed_deflate(const std::vector<uint8_t> & data)
+{
+  BitWriter w;
+  std::vector<int32_t> head(1 << 15, -1);
+
+  w.put(1, 1); // Last block
+  w.put(1, 2); // Fixed Huffman codes
+
+  uint32_t i = 0;
+  while (i < data.size()) {
+    uint32_t length = 0;
+    uint32_t distance = 0;
+
+    if ((i + 3) <= data.size()) {
+      uint32_t h = ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & 0x7FFF;
+      int32_t candidate = head[h];
+      head[h] = i;
+      if ((candidate >= 0) && ((i - candidate) <= 32768)) {
+        while ((length < 258) && ((i + length) < data.size()) &&
+               (data[candidate + length] == data[i + length])) length++;
+        distance = i - candidate;
+      }
+    }
+
+    if (length >= 3) {
+      put_match(w, length, distance);
+      i += length;
+    }
+    else {
+      w.put_litlen(data[i++]);
+    }
+  }
+
+  w.put_litlen(256);
+  w.flush();
+  return w.out;
+}
+
+static std::vector<uint8_t>
+stored_deflate(const std::vector<uint8_t> & data)
+{
+  std::vector<uint8_t> out;
+  uint32_t pos = 0;
+
+  do {
+    uint32_t len = std::min<uint32_t>(data.size() - pos, 65535);
+    out.push_back((pos + len) == data.size());
+    out.push_back(len & 0xFF);  out.push_back(len >> 8);
+    out.push_back(~len & 0xFF); out.push_back((~len >> 8) & 0xFF);
+    out.insert(out.end(), data.begin() + pos, data.begin() + pos + len);
+    pos += len;
+  } while (pos < data.size());
+
+  return out;
+}
+
+// A truncated stream or a too small output buffer must be rejected
+
+static void
+check_decompress(const std::vector<uint8_t> & comp, const std::vector<uint8_t> & data)
+{
+  std::vector<uint8_t> out(data.size());
+  EXPECT_TRUE(Inflate::decompress(comp.data(), comp.size(), out.data(), out.size()));
+  EXPECT_TRUE(out == data);
+
+  EXPECT_FALSE(Inflate::decompress(comp.data(), comp.size() / 2, out.data(), out.size()));
+  EXPECT_FALSE(Inflate::decompress(comp.data(), comp.size(), out.data(), out.size() - 1));
+}
+
+TEST(InflateTest, fixed_blocks) {
+  std::vector<uint8_t> text = sample_text(300 * 1024);
+  std::vector<uint8_t> comp = fixed_deflate(text);
+
+  EXPECT_LT(comp.size(), text.size() / 2);
+  check_decompress(comp, text);
+
+  // Overlapping matches of all the short distances
+
+  std::vector<uint8_t> data;
+  for (int period = 1; period <= 9; period++) {
+    for (int i = 0; i < 20000; i++) data.push_back('a' + (i % period));
+  }
+  check_decompress(fixed_deflate(data), data);
+}
+
+TEST(InflateTest, stored_blocks) {
+  std::mt19937 rng(99);
+  std::vector<uint8_t> random(200 * 1024);
+  for (auto & b : random) b = rng();
+
+  check_decompress(stored_deflate(random), random);
+}
+
+TEST(InflateTest, invalid_streams) {
+  uint8_t out[16];
+
+  const uint8_t reserved_type[4] = { 0x07, 0, 0, 0 };
+  EXPECT_FALSE(Inflate::decompress(reserved_type, sizeof(reserved_type), out, sizeof(out)));
+
+  const uint8_t bad_stored_length[9] = { 0x01, 4, 0, 4, 0, 'a', 'b', 'c', 'd' };
+  EXPECT_FALSE(Inflate::decompress(bad_stored_length, sizeof(bad_stored_length), out, 4));
+
+  // Distance beyond the start of the output
+
+  BitWriter w;
+  w.put(1, 1); w.put(1, 2);
+  w.put_litlen('a');
+  put_match(w, 3, 2);
+  w.put_litlen(256);
+  w.flush();
+  EXPECT_FALSE(Inflate::decompress(w.out.data(), w.out.size(), out, 4));
+}
+
+// Dynamic Huffman codes blocks come from the zip command line tool. The
+// entries are retrieved at once by get_file() and checked against their
+// CRC-32.
+
+static constexpr char const * ZIP_FOLDER = "/tmp/epub_inflate_tests";
+static constexpr char const * ZIP_FILE   = "/tmp/epub_inflate_tests/test.zip";
+
+static bool
+build_zip(const std::vector<uint8_t> & text, const std::vector<uint8_t> & stored)
+{
+  std::string cmd = std::string("rm -rf ") + ZIP_FOLDER + " && mkdir -p " + ZIP_FOLDER;
+  if (system(cmd.c_str()) != 0) return false;
+
+  FILE * f = fopen((std::string(ZIP_FOLDER) + "/text.xhtml").c_str(), "wb");
+  if (f == nullptr) return false;
+  fwrite(text.data(), 1, text.size(), f);
+  fclose(f);
+
+  f = fopen((std::string(ZIP_FOLDER) + "/stored.xhtml").c_str(), "wb");
+  if (f == nullptr) return false;
+  fwrite(stored.data(), 1, stored.size(), f);
+  fclose(f);
+
+  cmd = std::string("cd ") + ZIP_FOLDER + " && zip -q -X -9 test.zip text.xhtml && zip -q -X -0 test.zip stored.xhtml";
+  return system(cmd.c_str()) == 0;
+}
+
+TEST(InflateTest, zip_entries_checked) {
+  std::vector<uint8_t> text   = sample_text(200 * 1024);
+  std::vector<uint8_t> stored = sample_text(1000);
+  ASSERT_TRUE(build_zip(text, stored));
+
+  ASSERT_TRUE(unzip.open_zip_file(ZIP_FILE));
+
+  uint32_t size;
+  char * data = unzip.get_file("text.xhtml", size);
+  ASSERT_TRUE(data != nullptr);
+  EXPECT_EQ(size, text.size());
+  EXPECT_EQ(memcmp(data, text.data(), size), 0);
+  EXPECT_EQ(data[size], 0);
+  free(data);
+
+  data = unzip.get_file("stored.xhtml", size);
+  ASSERT_TRUE(data != nullptr);
+  EXPECT_EQ(memcmp(data, stored.data(), size), 0);
+  free(data);
+
+  unzip.close_zip_file();
+
+  // A modified byte in the stored entry is caught by its CRC-32
+
+  std::vector<uint8_t> zip;
+  FILE * f = fopen(ZIP_FILE, "r+b");
+  ASSERT_TRUE(f != nullptr);
+  int c;
+  while ((c = fgetc(f)) != EOF) zip.push_back(c);
+
+  auto pos = std::search(zip.begin(), zip.end(), stored.begin(), stored.end());
+  ASSERT_TRUE(pos != zip.end());
+  fseek(f, (pos - zip.begin()) + 500, SEEK_SET);
+  fputc(stored[500] ^ 1, f);
+  fclose(f);
+
+  ASSERT_TRUE(unzip.open_zip_file(ZIP_FILE));
+  EXPECT_TRUE(unzip.get_file("stored.xhtml", size) == nullptr);
+  unzip.close_zip_file();
+}
+
+TEST(InflateTest, crc32_same_as_miniz) {
+  std::vector<uint8_t> data = sample_text(64 * 1024);
+
+  for (uint32_t start = 0; start < 8; start++) {
+    for (uint32_t size = 0; size < 100; size++) {
+      EXPECT_EQ(Inflate::update_crc32(0, &data[start], size), mz_crc32(MZ_CRC32_INIT, &data[start], size));
+    }
+  }
+
+  uint32_t crc = Inflate::update_crc32(0, data.data(), 1001);
+  crc = Inflate::update_crc32(crc, &data[1001], data.size() - 1001);
+  EXPECT_EQ(crc, mz_crc32(MZ_CRC32_INIT, data.data(), data.size()));
+}
+
+// Every entry of real books, retrieved with the stream methods (as get_file()
+// did before) and at once by get_file(). Printed as:
+//
+// [ BENCH    ] <book>: <entries> entries, <MB>: stream <MB/s>, whole <MB/s>
+
+static std::vector<std::string>
+zip_entries(const char * zip_filename)
+{
+  std::vector<std::string> names;
+  std::string cmd = std::string("unzip -Z1 \"") + zip_filename + "\"";
+
+  FILE * pipe = popen(cmd.c_str(), "r");
+  if (pipe == nullptr) return names;
+
+  char line[512];
+  while (fgets(line, sizeof(line), pipe) != nullptr) {
+    std::string name(line);
+    while (!name.empty() && ((name.back() == '\n') || (name.back() == '\r'))) name.pop_back();
+    if (!name.empty() && (name.back() != '/')) names.push_back(name);
+  }
+
+  pclose(pipe);
+  return names;
+}
+
+static char *
+stream_file(const char * filename, uint32_t & file_size)
+{
+  if (!unzip.open_stream_file(filename, file_size)) return nullptr;
+
+  char *   data  = (char *) malloc(file_size + 1);
+  uint32_t total = 0;
+
+  while (total < file_size) {
+    uint32_t size = file_size - total;
+    if (!unzip.get_stream_data(data + total, size) || (size == 0)) break;
+    total += size;
+  }
+
+  unzip.close_stream_file();
+
+  if (total != file_size) {
+    free(data);
+    return nullptr;
+  }
+  return data;
+}
+
+TEST(InflateTest, benchmark_book_entries) {
+  typedef std::chrono::duration<double, std::milli> Millis;
+
+  const char * books[2] = {
+    BOOKS_FOLDER "/Austen, Jane - Pride and Prejudice.epub",
+    BOOKS_FOLDER "/Austen, Jane - Orgueil et préjugés.epub"
+  };
+
+  double stream_total = 0, whole_total = 0, crc_total = 0, mz_crc_total = 0;
+
+  for (auto * book : books) {
+    std::vector<std::string> names = zip_entries(book);
+    ASSERT_FALSE(names.empty());
+    ASSERT_TRUE(unzip.open_zip_file(book));
+
+    uint64_t bytes  = 0;
+    double   stream = 0, whole = 0;
+
+    for (auto & name : names) {
+      uint32_t stream_size, whole_size;
+
+      auto start = std::chrono::steady_clock::now();
+      char * stream_data = stream_file(name.c_str(), stream_size);
+      auto middle = std::chrono::steady_clock::now();
+      char * whole_data = unzip.get_file(name.c_str(), whole_size);
+      auto end = std::chrono::steady_clock::now();
+
+      ASSERT_TRUE((stream_data != nullptr) && (whole_data != nullptr)) << name;
+      ASSERT_EQ(stream_size, whole_size) << name;
+      EXPECT_EQ(memcmp(stream_data, whole_data, whole_size), 0) << name;
+
+      stream += Millis(middle - start).count();
+      whole  += Millis(end - middle).count();
+      bytes  += whole_size;
+
+      start = std::chrono::steady_clock::now();
+      volatile uint32_t crc = Inflate::update_crc32(0, (const uint8_t *) whole_data, whole_size);
+      middle = std::chrono::steady_clock::now();
+      crc = mz_crc32(MZ_CRC32_INIT, (const uint8_t *) whole_data, whole_size);
+      end = std::chrono::steady_clock::now();
+      (void) crc;
+
+      crc_total    += Millis(middle - start).count();
+      mz_crc_total += Millis(end - middle).count();
+
+      free(stream_data);
+      free(whole_data);
+    }
+
+    unzip.close_zip_file();
+
+    double mb = bytes / (1024.0 * 1024.0);
+    printf("[ BENCH    ] %s: %d entries, %.2f MB: stream %.1f MB/s, whole %.1f MB/s\n",
+           book + strlen(BOOKS_FOLDER) + 1, (int) names.size(), mb,
+           mb * 1000.0 / stream, mb * 1000.0 / whole);
+
+    stream_total += stream;
+    whole_total  += whole;
+  }
+
+  // Both totals vary with the host load: the test does not compare them.
+
+  printf("[ BENCH    ] All entries: stream %.2f ms, whole %.2f ms\n", stream_total, whole_total);
+  printf("[ BENCH    ] CRC-32: %.2f ms, mz_crc32: %.2f ms\n", crc_total, mz_crc_total);
+}
+
+#endif
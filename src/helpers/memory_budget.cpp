@@ -0,0 +1,235 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __MEMORY_BUDGET__ 1
+#include "helpers/memory_budget.hpp"
+
+#include "models/epub.hpp"
+#include "models/fonts.hpp"
+#include "alloc.hpp"
+
+#include <cstdio>
+
+MemoryBudget::MemoryBudget() : total(0), high_water(0), cap(0)
+{
+  for (int i = 0; i < (int) Consumer::COUNT; i++) {
+    usages[i]    = { 0, 0, 0, 0, 0 };
+    users[i]     = 0;
+    pending[i]   = false;
+    shrinking[i] = false;
+  }
+}
+
+// There is no decoded images cache: the images bitmaps are accounted for,
+// but no shrinker is registered for them.
+
+void
+MemoryBudget::setup()
+{
+  set_budget(Consumer::GLYPHS, GLYPHS_BUDGET);
+
+  set_shrinker(Consumer::GLYPHS, []() { fonts.clear_glyph_caches(); });
+  set_shrinker(Consumer::ITEMS,  []() { epub.release_current_item(); });
+}
+
+const char *
+MemoryBudget::get_consumer_name(Consumer consumer)
+{
+  switch (consumer) {
+    case Consumer::GLYPHS: return "glyphs";
+    case Consumer::IMAGES: return "images";
+    case Consumer::ITEMS:  return "items";
+    case Consumer::TOC:    return "toc";
+    case Consumer::ARENAS: return "arenas";
+    case Consumer::OTHER:  return "other";
+    default:               return "?";
+  }
+}
+
+void
+MemoryBudget::account(Consumer consumer, uint32_t size)
+{
+  Usage & usage = usages[(int) consumer];
+
+  usage.current += size;
+  if (usage.current > usage.high_water) usage.high_water = usage.current;
+
+  total += size;
+  if (total > high_water) high_water = total;
+}
+
+void
+MemoryBudget::unaccount(Consumer consumer, uint32_t size)
+{
+  Usage & usage = usages[(int) consumer];
+
+  if (size > usage.current) {
+    LOG_E("More %s memory released than allocated.", get_consumer_name(consumer));
+    size = usage.current;
+  }
+  usage.current -= size;
+  total         -= size;
+}
+
+void
+MemoryBudget::add(Consumer consumer, uint32_t size)
+{
+  std::scoped_lock guard(mutex);
+  account(consumer, size);
+}
+
+void
+MemoryBudget::remove(Consumer consumer, uint32_t size)
+{
+  std::scoped_lock guard(mutex);
+  unaccount(consumer, size);
+}
+
+// The shrinker is called without the mutex being held: it releases its
+// memory through release() or remove().
+
+uint32_t
+MemoryBudget::shrink(Consumer consumer, Consumer caller)
+{
+  int      idx = (int) consumer;
+  Shrinker shrinker;
+  uint32_t before;
+
+  { std::scoped_lock guard(mutex);
+
+    if (!shrinkers[idx]) return 0;
+    if ((consumer == caller) || (users[idx] > 0) || shrinking[idx]) {
+      pending[idx] = true;
+      return 0;
+    }
+    shrinking[idx] = true;
+    pending[idx]   = false;
+    shrinker       = shrinkers[idx];
+    before         = usages[idx].current;
+  }
+
+  LOG_D("Shrinking %s, %u bytes in use.", get_consumer_name(consumer), before);
+  shrinker();
+
+  uint32_t freed;
+
+  { std::scoped_lock guard(mutex);
+
+    shrinking[idx] = false;
+    usages[idx].shrinks++;
+    freed = (before > usages[idx].current) ? (before - usages[idx].current) : 0;
+  }
+  released.notify_all();
+
+  return freed;
+}
+
+uint32_t
+MemoryBudget::relieve(uint32_t needed, Consumer caller)
+{
+  uint32_t freed = 0;
+
+  for (int i = 0; (i < (int) Consumer::COUNT) && (freed < needed); i++) {
+    freed += shrink((Consumer) i, caller);
+  }
+
+  return freed;
+}
+
+void *
+MemoryBudget::allocate(Consumer consumer, uint32_t size)
+{
+  bool over_all;
+
+  { std::scoped_lock guard(mutex);
+
+    if (over_budget(consumer, size) && shrinkers[(int) consumer]) pending[(int) consumer] = true;
+    over_all = over_cap(size);
+  }
+
+  if (over_all) relieve(size, consumer);
+
+  // The memory is accounted for before being allocated, for the cap to be
+  // respected by concurrent allocations.
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    bool reserved = false;
+
+    { std::scoped_lock guard(mutex);
+      if (!over_cap(size)) {
+        account(consumer, size);
+        reserved = true;
+      }
+    }
+
+    if (reserved) {
+      void * ptr = ::allocate(size);
+      if (ptr != nullptr) return ptr;
+      remove(consumer, size);
+    }
+
+    if ((attempt > 0) || (relieve(size, consumer) == 0)) break;
+  }
+
+  { std::scoped_lock guard(mutex);
+    usages[(int) consumer].failures++;
+  }
+  LOG_E("Unable to allocate %u bytes for %s.", size, get_consumer_name(consumer));
+
+  return nullptr;
+}
+
+void
+MemoryBudget::release(Consumer consumer, void * ptr, uint32_t size)
+{
+  if (ptr == nullptr) return;
+
+  free(ptr);
+  remove(consumer, size);
+}
+
+void
+MemoryBudget::enter(Consumer consumer)
+{
+  int idx = (int) consumer;
+
+  std::unique_lock lock(mutex);
+  released.wait(lock, [this, idx]() { return !shrinking[idx]; });
+  users[idx]++;
+}
+
+void
+MemoryBudget::leave(Consumer consumer)
+{
+  int idx = (int) consumer;
+
+  { std::scoped_lock guard(mutex);
+    if ((--users[idx] > 0) || !pending[idx]) return;
+  }
+
+  shrink(consumer, Consumer::COUNT);
+}
+
+void
+MemoryBudget::get_report(std::string & out)
+{
+  char line[80];
+
+  std::scoped_lock guard(mutex);
+
+  snprintf(line, 80, "  %-10s %10s %10s %10s %8s %8s\n",
+           "memory", "bytes", "high-water", "budget", "shrinks", "failures");
+  out += line;
+
+  for (int i = 0; i < (int) Consumer::COUNT; i++) {
+    const Usage & usage = usages[i];
+    snprintf(line, 80, "  %-10s %10u %10u %10u %8u %8u\n",
+             get_consumer_name((Consumer) i),
+             usage.current, usage.high_water, usage.budget, usage.shrinks, usage.failures);
+    out += line;
+  }
+
+  snprintf(line, 80, "  %-10s %10u %10u %10u\n", "total", total, high_water, cap);
+  out += line;
+}
@@ -0,0 +1,117 @@
+#if TESTING && EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "gtest/gtest.h"
+#include "helpers/memory_budget.hpp"
+#include "models/fonts.hpp"
+
+#include <vector>
+
+typedef MemoryBudget::Consumer Consumer;
+
+// A cache of blocks released by its shrinker
+
+struct TestCache {
+  MemoryBudget        & budget;
+  Consumer              consumer;
+  std::vector<void *>   blocks;
+  uint32_t              block_size;
+
+  TestCache(MemoryBudget & b, Consumer c, uint32_t size) : budget(b), consumer(c), block_size(size) {
+    budget.set_shrinker(consumer, [this]() { clear(); });
+  }
+ ~TestCache() { clear(); }
+
+  bool add() {
+    void * block = budget.allocate(consumer, block_size);
+    if (block != nullptr) blocks.push_back(block);
+    return block != nullptr;
+  }
+
+  void clear() {
+    for (void * block : blocks) budget.release(consumer, block, block_size);
+    blocks.clear();
+  }
+};
+
+TEST(MemoryBudgetTest, shrink_in_priority_order) {
+  MemoryBudget budget;
+  TestCache    glyphs(budget, Consumer::GLYPHS, 1000);
+  TestCache    items( budget, Consumer::ITEMS,  1000);
+  TestCache    toc(   budget, Consumer::TOC,    1000);
+
+  budget.set_cap(10000);
+
+  for (int i = 0; i < 4; i++) ASSERT_TRUE(glyphs.add());
+  for (int i = 0; i < 4; i++) ASSERT_TRUE(items.add());
+  EXPECT_EQ(budget.get_total(), 8000u);
+
+  // The glyphs are released first, the items are kept
+
+  ASSERT_TRUE(toc.add());
+  ASSERT_TRUE(toc.add());
+  ASSERT_TRUE(toc.add());
+  EXPECT_EQ(budget.get_usage(Consumer::GLYPHS).current,       0u);
+  EXPECT_EQ(budget.get_usage(Consumer::GLYPHS).high_water, 4000u);
+  EXPECT_EQ(budget.get_usage(Consumer::GLYPHS).shrinks,       1u);
+  EXPECT_EQ(budget.get_usage(Consumer::ITEMS ).current,    4000u);
+  EXPECT_EQ(budget.get_total(), 7000u);
+
+  // Then the items. A consumer is not shrunk for its own allocations.
+
+  int count = 3;
+  while (toc.add()) count++;
+  EXPECT_EQ(count, 10);
+  EXPECT_EQ(budget.get_usage(Consumer::ITEMS).current,      0u);
+  EXPECT_EQ(budget.get_usage(Consumer::TOC  ).current,  10000u);
+  EXPECT_EQ(budget.get_usage(Consumer::TOC  ).failures,     1u);
+
+  toc.clear();
+  EXPECT_EQ(budget.get_total(), 0u);
+}
+
+TEST(MemoryBudgetTest, shrink_deferred_while_in_use) {
+  MemoryBudget budget;
+  TestCache    glyphs(budget, Consumer::GLYPHS, 1000);
+  TestCache    images(budget, Consumer::IMAGES, 1000);
+
+  budget.set_cap(4000);
+  budget.set_budget(Consumer::GLYPHS, 2000);
+
+  budget.enter(Consumer::GLYPHS);
+
+  // Over its budget: the glyphs cache is shrunk when the last user leaves
+
+  for (int i = 0; i < 3; i++) ASSERT_TRUE(glyphs.add());
+  EXPECT_EQ(glyphs.blocks.size(), 3u);
+
+  ASSERT_TRUE(images.add());
+  EXPECT_FALSE(images.add());
+  EXPECT_EQ(budget.get_usage(Consumer::GLYPHS).shrinks, 0u);
+
+  budget.enter(Consumer::GLYPHS);
+  budget.leave(Consumer::GLYPHS);
+  EXPECT_EQ(glyphs.blocks.size(), 3u);
+
+  budget.leave(Consumer::GLYPHS);
+  EXPECT_TRUE(glyphs.blocks.empty());
+  EXPECT_EQ(budget.get_usage(Consumer::GLYPHS).shrinks, 1u);
+
+  EXPECT_TRUE(images.add());
+}
+
+TEST(MemoryBudgetTest, fonts_glyphs_released) {
+  Font * font = fonts.get(1);   // System font
+  ASSERT_TRUE(font != nullptr);
+
+  ASSERT_TRUE(font->get_glyph('a', 12) != nullptr);
+  EXPECT_GT(memory_budget.get_usage(Consumer::GLYPHS).current, 0u);
+
+  memory_budget.relieve(1);
+  EXPECT_EQ(memory_budget.get_usage(Consumer::GLYPHS).current, 0u);
+
+  Font::Glyph * glyph = font->get_glyph('a', 12);
+  ASSERT_TRUE(glyph != nullptr);
+  EXPECT_GT(glyph->dim.width, 0);
+}
+
+#endif
@@ -0,0 +1,113 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#include "helpers/panel_pipeline.hpp"
+#include "helpers/perf_stats.hpp"
+#include "helpers/pthread_config.hpp"
+
+void
+PanelPipeline::task()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+    cond.wait(lock, [this] { return (completed != submitted) || !running; });
+    if (completed == submitted) break; // Stopped, nothing pending
+
+    Request req   = request;
+    Fence   fence = submitted;
+
+    // The panel update is done without the lock: the next page is laid out
+    // in the back buffer meanwhile.
+
+    lock.unlock();
+    executor(req);
+    lock.lock();
+
+    completed = fence;
+    cond.notify_all();
+  }
+}
+
+void
+PanelPipeline::start(Executor exec)
+{
+  std::scoped_lock guard(mutex);
+
+  executor = exec;
+  if (running) return;
+
+  #if EPUB_INKPLATE_BUILD
+    PThreadConfig task_cfg("panelTask", 8 * 1024, configMAX_PRIORITIES - 2);
+  #endif
+
+  running = true;
+  thread  = std::thread(&PanelPipeline::task, this);
+}
+
+void
+PanelPipeline::stop()
+{
+  {
+    std::scoped_lock guard(mutex);
+    if (!running) return;
+    running = false;
+  }
+
+  cond.notify_all();
+  if (thread.joinable()) thread.join();
+}
+
+PanelPipeline::Fence
+PanelPipeline::submit(const Request & req)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (!running) {
+    Fence fence = ++submitted;
+    lock.unlock();
+    if (executor != nullptr) executor(req);
+    lock.lock();
+    completed = fence;
+    return fence;
+  }
+
+  if (completed != submitted) {
+    PERF_SCOPE(PANEL_WAIT);
+    cond.wait(lock, [this] { return completed == submitted; });
+  }
+
+  request = req;
+  Fence fence = ++submitted;
+  cond.notify_all();
+
+  return fence;
+}
+
+void
+PanelPipeline::wait_for_fence(Fence fence)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if ((int32_t)(completed - fence) < 0) {
+    PERF_SCOPE(PANEL_WAIT);
+    cond.wait(lock, [this, fence] { return (int32_t)(completed - fence) >= 0; });
+  }
+}
+
+bool
+PanelPipeline::is_fence_reached(Fence fence)
+{
+  std::scoped_lock guard(mutex);
+
+  return (int32_t)(completed - fence) >= 0;
+}
+
+PanelPipeline::Fence
+PanelPipeline::get_last_fence()
+{
+  std::scoped_lock guard(mutex);
+
+  return submitted;
+}
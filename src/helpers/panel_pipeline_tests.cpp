@@ -0,0 +1,104 @@
+#if TESTING && EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "gtest/gtest.h"
+#include "helpers/panel_pipeline.hpp"
+#include "screen.hpp"
+
+#include <atomic>
+#include <unistd.h>
+
+static std::atomic<int>  executed;
+static std::atomic<bool> released;
+
+static void
+slow_update(const PanelPipeline::Request &)
+{
+  usleep(50000);
+  executed++;
+}
+
+// The update doesn't complete before the test releases it (or after 2 seconds,
+// for the test to fail instead of hanging if submit() waits for it).
+
+static void
+held_update(const PanelPipeline::Request &)
+{
+  for (int i = 0; !released && (i < 2000); i++) usleep(1000);
+  executed++;
+}
+
+TEST(PanelPipelineTest, submit_does_not_wait_for_the_panel) {
+  PanelPipeline pipeline;
+  pipeline.start(held_update);
+  executed = 0;
+  released = false;
+
+  PanelPipeline::Fence fence = pipeline.submit({ 0, Dim(10, 10), Pos(0, 0) });
+  EXPECT_EQ(executed, 0);
+  EXPECT_FALSE(pipeline.is_fence_reached(fence));
+
+  released = true;
+  pipeline.wait_for_fence(fence);
+  EXPECT_TRUE(pipeline.is_fence_reached(fence));
+  EXPECT_EQ(executed, 1);
+}
+
+TEST(PanelPipelineTest, fences_are_reached_in_order) {
+  PanelPipeline pipeline;
+  pipeline.start(slow_update);
+  executed = 0;
+
+  PanelPipeline::Fence first  = pipeline.submit({ 0, Dim(10, 10), Pos(0, 0) });
+  PanelPipeline::Fence second = pipeline.submit({ 0, Dim(10, 10), Pos(0, 0) });
+  EXPECT_GT(second, first);
+
+  // The second update can only be submitted once the first one is completed
+
+  EXPECT_TRUE(pipeline.is_fence_reached(first));
+  pipeline.wait_for_all();
+  EXPECT_TRUE(pipeline.is_fence_reached(second));
+  EXPECT_EQ(executed, 2);
+}
+
+TEST(PanelPipelineTest, updates_are_synchronous_when_not_started) {
+  PanelPipeline pipeline;
+  executed = 0;
+
+  PanelPipeline::Fence fence = pipeline.submit({ 0, Dim(10, 10), Pos(0, 0) });
+  EXPECT_TRUE(pipeline.is_fence_reached(fence));
+  EXPECT_EQ(executed, 0);
+}
+
+// The next page is drawn in the back buffer while the panel is updated from
+// the front buffer.
+
+TEST(PanelPipelineTest, drawing_does_not_alter_the_panel) {
+  Dim     dim(Screen::get_width(), Screen::get_height());
+  Pos     pos(0, 0);
+  int32_t size = dim.width * dim.height;
+
+  screen.set_panel_timing(true);
+
+  screen.clear();
+  screen.colorize_region(Dim(100, 100), Pos(10, 10), Screen::BLACK_COLOR);
+  Screen::Fence fence = screen.update(Screen::UpdateMode::GL16, dim, pos);
+
+  std::vector<uint8_t> shown(screen.get_frame_buffer(), screen.get_frame_buffer() + size);
+
+  screen.clear();
+  EXPECT_FALSE(screen.is_fence_reached(fence));
+
+  screen.wait_for_fence(fence);
+  EXPECT_EQ(memcmp(shown.data(), screen.get_panel_buffer(), size), 0);
+
+  // Only the updated region is sent to the panel
+
+  screen.update(Screen::UpdateMode::DU, Dim(50, 50), Pos(10, 10));
+  screen.wait_for_updates();
+  EXPECT_EQ(screen.get_panel_buffer()[ 20 * dim.width +  20], Screen::WHITE_COLOR);
+  EXPECT_EQ(screen.get_panel_buffer()[100 * dim.width + 100], Screen::BLACK_COLOR);
+
+  screen.set_panel_timing(false);
+}
+
+#endif
@@ -0,0 +1,218 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __PERF_STATS__ 1
+#include "helpers/perf_stats.hpp"
+#include "helpers/memory_budget.hpp"
+
+#include "models/epub.hpp"
+#include "models/fonts.hpp"
+#include "viewers/page.hpp"
+
+#include <cstdio>
+
+#if EPUB_LINUX_BUILD
+  #include <chrono>
+#else
+  #include "esp_timer.h"
+#endif
+
+static thread_local PerfStats::Scope * current_scope = nullptr;
+
+PerfStats::Scope::Scope(Stage s) : stage(s), parent(current_scope)
+{
+  start = get_time_us();
+  if (parent != nullptr) parent->suspend(start);
+  current_scope = this;
+}
+
+PerfStats::Scope::~Scope()
+{
+  int64_t now = get_time_us();
+
+  perf_stats.add(stage, now - start);
+  perf_stats.count(stage);
+
+  current_scope = parent;
+  if (parent != nullptr) parent->resume(now);
+}
+
+void
+PerfStats::Scope::suspend(int64_t now)
+{
+  perf_stats.add(stage, now - start);
+}
+
+int64_t
+PerfStats::get_time_us()
+{
+  #if EPUB_LINUX_BUILD
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+  #else
+    return esp_timer_get_time();
+  #endif
+}
+
+const char *
+PerfStats::get_stage_name(Stage stage)
+{
+  static const char * names[(int) Stage::COUNT] = {
+    "unzip", "xml parse", "css", "css match", "layout",
+    "add word", "word decode", "glyph", "blit", "draw glyph", "update", "panel wait"
+  };
+
+  return (stage < Stage::COUNT) ? names[(int) stage] : "?";
+}
+
+const char *
+PerfStats::get_counter_name(Counter counter)
+{
+  static const char * names[(int) Counter::COUNT] = {
+    "glyph cache hits", "glyph cache misses", "word cache hits", "word cache misses",
+    "page cache hits", "page cache misses",
+    "touch interrupts", "touch reads"
+  };
+
+  return (counter < Counter::COUNT) ? names[(int) counter] : "?";
+}
+
+const char *
+PerfStats::get_latency_name(Latency latency)
+{
+  static const char * names[(int) Latency::COUNT] = {
+    "input to event"
+  };
+
+  return (latency < Latency::COUNT) ? names[(int) latency] : "?";
+}
+
+void
+PerfStats::reset()
+{
+  for (auto & acc : accumulators) {
+    acc.micros = 0;
+    acc.count  = 0;
+  }
+  for (auto & counter : counters) counter = 0;
+  for (auto & acc : latencies) {
+    acc.micros = 0;
+    acc.count  = 0;
+    acc.max    = 0;
+  }
+}
+
+void
+PerfStats::add_pools_report(std::string & out)
+{
+  char line[80];
+
+  snprintf(line, 80, "  %-16s %10s %12s %10s\n", "pool", "high-water", "bytes", "in use");
+  out += line;
+
+  // The CSS rules, the DOM nodes and the formats are allocated in arenas
+  // whose chunks all come from the book arena (in chunks count).
+
+  Arena::Stats arena_stats = EPub::book_arena.get_stats();
+
+  snprintf(line, 80, "  %-16s %10u %12u %10u\n", "arena chunks",
+           arena_stats.high_water,
+           arena_stats.high_water * Arena::CHUNK_SIZE,
+           arena_stats.chunks + arena_stats.large + arena_stats.spare + arena_stats.lent);
+  out += line;
+
+  // The display list buffer is never shrunk: its capacity is its high-water mark.
+
+  snprintf(line, 80, "  %-16s %10u %12u %10u\n", "display list",
+           (unsigned) page.display_list.capacity(),
+           (unsigned) (page.display_list.capacity() * sizeof(Page::DisplayListEntry)),
+           (unsigned) page.display_list.size());
+  out += line;
+
+  // Glyphs are kept in each font instance. Their bitmaps are allocated
+  // in byte pools that are only released when the font glyph cache is cleared.
+
+  Fonts::Snapshot fonts_in_use = fonts.get_snapshot();
+
+  uint32_t glyphs_high = 0, glyphs_in_use = 0, bitmaps = 0;
+  for (auto & entry : *fonts_in_use) {
+    if (entry.font == nullptr) continue;
+    glyphs_high   += entry.font->bitmap_glyph_pool.highWater();
+    glyphs_in_use += entry.font->bitmap_glyph_pool.inUse();
+    for (auto * pool : entry.font->byte_pools) if (pool != nullptr) bitmaps += Font::BYTE_POOL_SIZE;
+  }
+
+  snprintf(line, 80, "  %-16s %10u %12u %10u\n", "glyphs",
+           glyphs_high, (unsigned) (glyphs_high * sizeof(Font::Glyph)), glyphs_in_use);
+  out += line;
+  snprintf(line, 80, "  %-16s %10s %12u\n", "glyph bitmaps", "", bitmaps);
+  out += line;
+}
+
+void
+PerfStats::get_report(std::string & out, int64_t wall_us)
+{
+  char    line[80];
+  int64_t total = 0;
+
+  for (auto & acc : accumulators) total += acc.micros;
+
+  snprintf(line, 80, "  %-16s %10s %12s %7s\n", "stage", "calls", "ms", "%");
+  out += line;
+
+  for (int i = 0; i < (int) Stage::COUNT; i++) {
+    Stage    stage  = (Stage) i;
+    uint64_t micros = get_micros(stage);
+    snprintf(line, 80, "  %-16s %10u %12.1f %6.1f%%\n",
+             get_stage_name(stage),
+             get_count(stage),
+             micros / 1000.0,
+             (total == 0) ? 0.0 : (micros * 100.0) / total);
+    out += line;
+  }
+
+  if (wall_us > 0) {
+    snprintf(line, 80, "  %-16s %10s %12.1f\n", "other", "", (wall_us - total) / 1000.0);
+    out += line;
+  }
+
+  out += '\n';
+  for (int i = 0; i < (int) Counter::COUNT; i++) {
+    snprintf(line, 80, "  %-27s %10u\n", get_counter_name((Counter) i), get_count((Counter) i));
+    out += line;
+  }
+
+  uint32_t word_hits   = get_count(Counter::WORD_CACHE_HIT);
+  uint32_t word_misses = get_count(Counter::WORD_CACHE_MISS);
+  if ((word_hits + word_misses) > 0) {
+    snprintf(line, 80, "  %-27s %9.1f%%\n", "word cache hit rate", 
+             (word_hits * 100.0) / (word_hits + word_misses));
+    out += line;
+  }
+  if (word_misses > 0) {
+    snprintf(line, 80, "  %-27s %10.1f\n", "word cache saved (est. ms)", 
+             (word_hits * get_micros(Stage::WORD_DECODE)) / (word_misses * 1000.0));
+    out += line;
+  }
+
+  out += '\n';
+  snprintf(line, 80, "  %-16s %10s %12s %10s\n", "latency", "count", "avg ms", "max ms");
+  out += line;
+  for (int i = 0; i < (int) Latency::COUNT; i++) {
+    Latency  latency = (Latency) i;
+    uint32_t count   = get_count(latency);
+    snprintf(line, 80, "  %-16s %10u %12.1f %10.1f\n",
+             get_latency_name(latency),
+             count,
+             (count == 0) ? 0.0 : get_micros(latency) / (count * 1000.0),
+             get_max(latency) / 1000.0);
+    out += line;
+  }
+
+  out += '\n';
+  add_pools_report(out);
+
+  out += '\n';
+  memory_budget.get_report(out);
+}
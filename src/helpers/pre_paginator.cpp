@@ -0,0 +1,284 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __PRE_PAGINATOR__ 1
+#include "helpers/pre_paginator.hpp"
+
+#if EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "helpers/perf_stats.hpp"
+#include "models/config.hpp"
+#include "models/epub.hpp"
+#include "models/fonts.hpp"
+#include "models/page_locs.hpp"
+#include "viewers/form_viewer.hpp"
+#include "screen.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <getopt.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char ** environ;
+
+// Same values as the Screen class of each device (lib_esp32)
+
+const PrePaginator::Profile PrePaginator::PROFILES[] = {
+  { "paper_s3",       4, 212,  540, 960, false },
+  { "inkplate_6",     1, 166,  800, 600, true  },
+  { "inkplate_10",    2, 150, 1200, 825, true  },
+  { "inkplate_6plus", 3, 212, 1024, 758, true  }
+};
+
+const uint8_t PrePaginator::PROFILE_COUNT = sizeof(PROFILES) / sizeof(PROFILES[0]);
+
+// The e-books of a folder, or the e-book itself
+
+void
+PrePaginator::add_books(const std::string & path, std::vector<std::string> & books)
+{
+  struct stat file_stat;
+
+  if (stat(path.c_str(), &file_stat) != 0) {
+    LOG_E("Unable to find %s", path.c_str());
+    return;
+  }
+
+  if (!S_ISDIR(file_stat.st_mode)) {
+    books.push_back(path);
+    return;
+  }
+
+  DIR * dp = opendir(path.c_str());
+  if (dp == nullptr) return;
+
+  struct dirent * de;
+  while ((de = readdir(dp))) {
+    int16_t size = strlen(de->d_name);
+    if ((size > 5) && (de->d_name[0] != '.') &&
+        (strcasecmp(&de->d_name[size - 5], ".epub") == 0)) {
+      books.push_back(path + "/" + de->d_name);
+    }
+  }
+
+  closedir(dp);
+}
+
+// The device only offers the font sizes of its options
+
+bool
+PrePaginator::is_font_size(int8_t font_size)
+{
+  for (auto & choice : FormChoiceField::font_size_choices) {
+    if (choice.value == font_size) return true;
+  }
+  return false;
+}
+
+off_t
+PrePaginator::file_size(const std::string & filename)
+{
+  struct stat file_stat;
+  return (stat(filename.c_str(), &file_stat) == 0) ? file_stat.st_size : 0;
+}
+
+bool
+PrePaginator::paginate(const std::string & filename)
+{
+  int64_t start = PerfStats::get_time_us();
+
+  if (!epub.open_file(filename)) {
+    printf("%s: unable to open\n", filename.c_str());
+    return false;
+  }
+
+  // As when the book is opened on the device: the pages locations are
+  // loaded, and computed if the files are missing or for other format
+  // parameters.
+
+  bool force = all;
+
+  for (int8_t font_size : page_locs.get_variants()) {
+    if (font_size == epub.get_book_format_params()->font_size) continue;
+    std::string variant = PageLocs::variant_filename(filename, font_size);
+    if (file_size(variant.substr(0, variant.find_last_of('.')) + ".locs") == 0) force = true;
+  }
+
+  if (force) page_locs.check_for_format_changes(epub.get_item_count(), 0, true);
+  else       page_locs.start_new_document(epub.get_item_count(), 0);
+
+  bool computed = page_locs.get_page_count() == -1;
+  while (page_locs.get_page_count() == -1) usleep(1000);
+
+  if (computed) {
+    printf("%s: %d pages, %.1f ms\n",
+           filename.c_str(),
+           page_locs.get_page_count(),
+           (PerfStats::get_time_us() - start) / 1000.0);
+  }
+  else {
+    printf("%s: up to date, %d pages\n", filename.c_str(), page_locs.get_page_count());
+  }
+  fflush(stdout);
+
+  epub.close_file();
+
+  return true;
+}
+
+int
+PrePaginator::run_workers(const std::vector<std::string> & books, int jobs, const char * exe)
+{
+  uint16_t next     = 0;
+  int      running  = 0;
+  int      failures = 0;
+
+  while ((next < books.size()) || (running > 0)) {
+    if ((next < books.size()) && (running < jobs)) {
+      std::vector<char *> args;
+
+      args.push_back((char *) exe);
+      args.push_back((char *) "-l");
+      for (auto & option : options) args.push_back((char *) option.c_str());
+      args.push_back((char *) "-j");
+      args.push_back((char *) "1");
+      args.push_back((char *) books[next].c_str());
+      args.push_back(nullptr);
+
+      pid_t pid;
+      if (posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, args.data(), environ) == 0) {
+        running++;
+      }
+      else {
+        LOG_E("Unable to start a worker for %s", books[next].c_str());
+        failures++;
+      }
+      next++;
+    }
+    else {
+      int status;
+      if (wait(&status) <= 0) break;
+      running--;
+      if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) failures++;
+    }
+  }
+
+  return failures;
+}
+
+int
+PrePaginator::run(int argc, char ** argv)
+{
+  int    jobs        = sysconf(_SC_NPROCESSORS_ONLN);
+  int8_t orientation = -1;
+  int8_t font_size   = -1;
+  int8_t font        = -1;
+  bool   usage       = false;
+  int    opt;
+
+  std::vector<int8_t> variant_sizes;
+
+  optind = 2;
+  while ((opt = getopt(argc, argv, "d:o:s:f:x:j:a")) != -1) {
+    switch (opt) {
+      case 'd':
+        profile = nullptr;
+        for (uint8_t i = 0; i < PROFILE_COUNT; i++) {
+          if (strcmp(optarg, PROFILES[i].name) == 0) profile = &PROFILES[i];
+        }
+        usage = usage || (profile == nullptr);
+        break;
+      case 'o': orientation = atoi(optarg); usage = usage || (orientation < 0) || (orientation > 3); break;
+      case 's': font_size   = atoi(optarg); usage = usage || !is_font_size(font_size); break;
+      case 'f': font        = atoi(optarg); usage = usage || (font        < 0); break;
+      case 'x': {
+          std::string sizes = optarg;
+          for (char * size = strtok(&sizes[0], ","); size != nullptr; size = strtok(nullptr, ",")) {
+            variant_sizes.push_back(atoi(size));
+            usage = usage || !is_font_size(variant_sizes.back());
+          }
+        }
+        break;
+      case 'j': jobs        = atoi(optarg); usage = usage || (jobs        < 1); break;
+      case 'a': all         = true;                                           break;
+      default:  usage       = true;                                           break;
+    }
+    if (opt != 'j') {
+      options.push_back(std::string("-") + (char) opt);
+      if (opt != 'a') options.push_back(optarg);
+    }
+  }
+
+  if (usage) {
+    fprintf(stderr, "Usage: %s -l [-d <device>] [-o <orientation>] [-s <font size>] [-f <font index>]\n"
+                    "          [-x <size>[,<size>...]] [-j <jobs>] [-a] [<books folder | epub file>...]\n"
+                    "  devices: paper_s3, inkplate_6, inkplate_10, inkplate_6plus\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<std::string> books;
+  if (optind == argc) add_books(BOOKS_FOLDER, books);
+  for (int i = optind; i < argc; i++) add_books(argv[i], books);
+
+  if (books.empty()) {
+    LOG_E("No e-book found");
+    return 1;
+  }
+
+  int64_t start    = PerfStats::get_time_us();
+  int     failures = 0;
+
+  if ((jobs > 1) && (books.size() > 1)) {
+
+    // Largest books first: they are not left alone at the end
+
+    std::sort(books.begin(), books.end(), [](const std::string & a, const std::string & b) {
+      return file_size(a) > file_size(b);
+    });
+
+    failures = run_workers(books, jobs, argv[0]);
+  }
+  else {
+
+    // The device screen and its configuration, the fonts being selected
+    // with its resolution
+
+    Screen::set_profile(profile->ident, profile->resolution, profile->width, profile->height, profile->rotates);
+
+    if (orientation != -1) config.put(Config::Ident::ORIENTATION,  orientation);
+    if (font_size   != -1) config.put(Config::Ident::FONT_SIZE,    font_size  );
+    if (font        != -1) config.put(Config::Ident::DEFAULT_FONT, font       );
+
+    page_locs.set_variants(variant_sizes);
+
+    Screen::Orientation orient = Screen::Orientation::RIGHT;
+    config.get(Config::Ident::ORIENTATION, (int8_t *) &orient);
+    screen.set_orientation(orient);
+
+    if (!fonts.setup()) {
+      LOG_E("Unable to load the fonts");
+      return 1;
+    }
+
+    for (auto & book : books) {
+      if (!paginate(book)) failures++;
+    }
+  }
+
+  if (books.size() > 1) {
+    printf("\n%d books for %s, %d failed, %.1f s\n",
+           (int) books.size(), profile->name, failures,
+           (PerfStats::get_time_us() - start) / 1000000.0);
+  }
+
+  return (failures == 0) ? 0 : 1;
+}
+
+#endif
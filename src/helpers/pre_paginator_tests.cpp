@@ -0,0 +1,137 @@
+#if TESTING && EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "gtest/gtest.h"
+#include "helpers/pre_paginator.hpp"
+#include "models/config.hpp"
+#include "models/epub.hpp"
+#include "models/fonts.hpp"
+#include "models/page_locs.hpp"
+#include "screen.hpp"
+
+#include <fstream>
+#include <sys/stat.h>
+
+static constexpr char const * PRE_PAGINATOR_FOLDER = "/tmp/epub_pre_paginator_tests";
+static constexpr char const * BOOK_NAME            = "Austen, Jane - Pride and Prejudice";
+
+// Back to the screen of the Linux build
+
+static void
+restore_screen()
+{
+  Screen::Orientation orientation = Screen::Orientation::RIGHT;
+
+  Screen::set_profile(99, 166, 800, 600, true);
+  config.get(Config::Ident::ORIENTATION, (int8_t *) &orientation);
+  screen.set_orientation(orientation);
+  fonts.setup();
+}
+
+TEST(PrePaginatorTest, files_loaded_as_on_the_device) {
+  std::string folder = PRE_PAGINATOR_FOLDER;
+  std::string book   = folder + "/" + BOOK_NAME + ".epub";
+  std::string cmd    = "rm -rf " + folder + " && mkdir -p " + folder +
+                       " && cp '" BOOKS_FOLDER "/" + BOOK_NAME + ".epub' " + folder;
+  ASSERT_EQ(system(cmd.c_str()), 0);
+
+  const char * argv[] = { "epub-inkplate", "-l", "-d", "inkplate_6", "-j", "1", PRE_PAGINATOR_FOLDER };
+  PrePaginator pre_paginator;
+
+  EXPECT_EQ(pre_paginator.run(7, (char **) argv), 0);
+
+  // The format parameters are the ones of the Inkplate 6
+
+  std::ifstream locs(folder + "/" + BOOK_NAME + ".locs", std::ios::binary);
+  char          header[2];
+  ASSERT_TRUE(locs.read(header, 2).good());
+  EXPECT_EQ(header[1], 1);
+  locs.close();
+
+  // Opened on the device, the book pages locations are loaded, not computed
+
+  ASSERT_TRUE(epub.open_file(book));
+  EXPECT_EQ(epub.get_book_format_params()->ident, 1);
+  page_locs.start_new_document(epub.get_item_count(), 0);
+  EXPECT_GT(page_locs.get_page_count(), 0);
+  while (page_locs.get_page_count() == -1) usleep(1000);
+  epub.close_file();
+
+  restore_screen();
+}
+
+TEST(PrePaginatorTest, font_size_variants_loaded_without_computation) {
+  std::string folder = PRE_PAGINATOR_FOLDER;
+  std::string book   = folder + "/" + BOOK_NAME + ".epub";
+  std::string cmd    = "rm -rf " + folder + " && mkdir -p " + folder +
+                       " && cp '" BOOKS_FOLDER "/" + BOOK_NAME + ".epub' " + folder;
+  ASSERT_EQ(system(cmd.c_str()), 0);
+
+  char sizes[] = "8,15";
+  const char * argv[] = { "epub-inkplate", "-l", "-d", "inkplate_6", "-s", "12", "-x", sizes, "-j", "1", PRE_PAGINATOR_FOLDER };
+  PrePaginator pre_paginator;
+
+  EXPECT_EQ(pre_paginator.run(11, (char **) argv), 0);
+  page_locs.set_variants({});
+
+  struct stat file_stat;
+  std::string base = folder + "/" + BOOK_NAME;
+  EXPECT_EQ(stat((base + ".8pt.locs" ).c_str(), &file_stat), 0);
+  EXPECT_EQ(stat((base + ".15pt.sidx").c_str(), &file_stat), 0);
+
+  ASSERT_TRUE(epub.open_file(book));
+  page_locs.start_new_document(epub.get_item_count(), 0);
+  while (page_locs.get_page_count() == -1) usleep(1000);
+  int16_t page_count = page_locs.get_page_count();
+
+  // The 15 points pages locations are loaded at once, the 12 points ones
+  // becoming a variant
+
+  epub.get_book_format_params()->font_size = 15;
+  page_locs.check_for_format_changes(epub.get_item_count(), 0);
+  EXPECT_GT(page_locs.get_page_count(), page_count);
+  EXPECT_NE(stat((base + ".15pt.locs").c_str(), &file_stat), 0);
+  EXPECT_EQ(stat((base + ".12pt.locs").c_str(), &file_stat), 0);
+
+  epub.get_book_format_params()->font_size = 12;
+  page_locs.check_for_format_changes(epub.get_item_count(), 0);
+  EXPECT_EQ(page_locs.get_page_count(), page_count);
+
+  // Without a variant, the pages locations are computed again. The 12 points
+  // ones being completed, they are kept as a variant.
+
+  epub.get_book_format_params()->font_size = 10;
+  page_locs.check_for_format_changes(epub.get_item_count(), 0);
+  EXPECT_EQ(stat((base + ".12pt.locs").c_str(), &file_stat), 0);
+  while (page_locs.get_page_count() == -1) usleep(1000);
+
+  epub.get_book_format_params()->font_size = 8;
+  page_locs.check_for_format_changes(epub.get_item_count(), 0);
+  int16_t page_count_8 = page_locs.get_page_count();
+  EXPECT_LT(page_count_8, page_count);
+
+  epub.get_book_format_params()->font_size = 12;
+  page_locs.check_for_format_changes(epub.get_item_count(), 0);
+  EXPECT_EQ(page_locs.get_page_count(), page_count);
+
+  // The variants of the last item, retrieved for the viewer, are laid out
+  // once the other items are done
+
+  page_locs.set_variants({ 8 });
+  page_locs.check_for_format_changes(epub.get_item_count(), 0, true);
+  page_locs.get_page_id(PageLocs::PageId(epub.get_item_count() - 1, 0));
+  while (page_locs.get_page_count() == -1) usleep(1000);
+  page_locs.set_variants({});
+
+  epub.get_book_format_params()->font_size = 8;
+  page_locs.check_for_format_changes(epub.get_item_count(), 0);
+  EXPECT_EQ(page_locs.get_page_count(), page_count_8);
+
+  epub.close_file();
+
+  PageLocs::remove_variants(book);
+  EXPECT_NE(stat((base + ".8pt.locs").c_str(), &file_stat), 0);
+
+  restore_screen();
+}
+
+#endif
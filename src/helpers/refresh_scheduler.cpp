@@ -0,0 +1,129 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __REFRESH_SCHEDULER__ 1
+#include "helpers/refresh_scheduler.hpp"
+
+void
+RefreshScheduler::check_grid()
+{
+  // The screen size may change with its orientation
+
+  uint16_t cols = (Screen::get_width()  + CELL_SIZE - 1) / CELL_SIZE;
+  uint16_t rws  = (Screen::get_height() + CELL_SIZE - 1) / CELL_SIZE;
+
+  if ((cols != columns) || (rws != rows)) {
+    columns = cols;
+    rows    = rws;
+    ghosts.assign(columns * rows, 0);
+  }
+}
+
+uint8_t
+RefreshScheduler::get_max_ghost(uint16_t col_from, uint16_t col_to, uint16_t row_from, uint16_t row_to)
+{
+  uint8_t max = 0;
+
+  for (uint16_t row = row_from; row <= row_to; row++) {
+    for (uint16_t col = col_from; col <= col_to; col++) {
+      if (ghosts[row * columns + col] > max) max = ghosts[row * columns + col];
+    }
+  }
+  return max;
+}
+
+void
+RefreshScheduler::set_ghosts(uint16_t col_from, uint16_t col_to, uint16_t row_from, uint16_t row_to,
+                             Screen::UpdateMode mode, bool saturate)
+{
+  for (uint16_t row = row_from; row <= row_to; row++) {
+    for (uint16_t col = col_from; col <= col_to; col++) {
+      uint8_t & ghost = ghosts[row * columns + col];
+      if (saturate) {
+        ghost = GHOST_LIMIT;
+      }
+      else if (mode == Screen::UpdateMode::GC16) {
+        ghost = 0;
+      }
+      else {
+        ghost += (mode == Screen::UpdateMode::DU) ? DU_GHOST : GL16_GHOST;
+        if (ghost > GHOST_LIMIT) ghost = GHOST_LIMIT;
+      }
+    }
+  }
+}
+
+Screen::UpdateMode
+RefreshScheduler::schedule(Intent intent, Dim & dim, Pos & pos, bool no_full)
+{
+  std::scoped_lock guard(mutex);
+
+  check_grid();
+
+  if (force_full && !no_full) {
+    force_full = false;
+    dim        = Dim(Screen::get_width(), Screen::get_height());
+    pos        = Pos(0, 0);
+    ghosts.assign(columns * rows, 0);
+    return Screen::UpdateMode::GC16;
+  }
+
+  if (pos.x >= Screen::get_width() ) pos.x = Screen::get_width()  - 1;
+  if (pos.y >= Screen::get_height()) pos.y = Screen::get_height() - 1;
+  if ((pos.x + dim.width ) > Screen::get_width() ) dim.width  = Screen::get_width()  - pos.x;
+  if ((pos.y + dim.height) > Screen::get_height()) dim.height = Screen::get_height() - pos.y;
+  if (dim.width  == 0) dim.width  = 1;
+  if (dim.height == 0) dim.height = 1;
+
+  uint16_t col_from =  pos.x                    / CELL_SIZE;
+  uint16_t col_to   = (pos.x + dim.width  - 1)  / CELL_SIZE;
+  uint16_t row_from =  pos.y                    / CELL_SIZE;
+  uint16_t row_to   = (pos.y + dim.height - 1)  / CELL_SIZE;
+
+  Screen::UpdateMode mode;
+
+  if (intent == Intent::IMAGE) {
+    mode = no_full ? Screen::UpdateMode::GL16 : Screen::UpdateMode::GC16;
+  }
+  else {
+    mode = (intent == Intent::UI) ? Screen::UpdateMode::DU : Screen::UpdateMode::GL16;
+    if (!no_full && (get_max_ghost(col_from, col_to, row_from, row_to) >= GHOST_LIMIT)) {
+      mode = Screen::UpdateMode::GC16;
+    }
+  }
+
+  set_ghosts(col_from, col_to, row_from, row_to, mode, no_full);
+
+  return mode;
+}
+
+Screen::Fence
+RefreshScheduler::update(Intent intent, Dim dim, Pos pos, bool no_full)
+{
+  Screen::UpdateMode mode = schedule(intent, dim, pos, no_full);
+
+  return screen.update(mode, dim, pos);
+}
+
+void
+RefreshScheduler::force_full_update()
+{
+  std::scoped_lock guard(mutex);
+
+  force_full = true;
+  screen.force_full_update();
+}
+
+uint8_t
+RefreshScheduler::get_ghost(Pos pos)
+{
+  std::scoped_lock guard(mutex);
+
+  check_grid();
+
+  uint16_t col = pos.x / CELL_SIZE;
+  uint16_t row = pos.y / CELL_SIZE;
+
+  return ((col < columns) && (row < rows)) ? ghosts[row * columns + col] : 0;
+}
@@ -0,0 +1,115 @@
+#if TESTING && EPUB_LINUX_BUILD
+
+#include "gtest/gtest.h"
+#include "helpers/refresh_scheduler.hpp"
+#include "screen.hpp"
+
+// The scheduler decisions are checked through the simulated panel of the
+// Linux screen, that records every update with its modeled duration.
+
+static const Screen::PanelUpdate &
+update(RefreshScheduler & scheduler, RefreshScheduler::Intent intent, Dim dim, Pos pos, bool no_full = false)
+{
+  Screen::UpdateMode mode = scheduler.schedule(intent, dim, pos, no_full);
+  screen.update(mode, dim, pos);
+  return screen.get_panel_updates().back();
+}
+
+static const Screen::PanelUpdate &
+update_all(RefreshScheduler & scheduler, RefreshScheduler::Intent intent, bool no_full = false)
+{
+  return update(scheduler, intent, Dim(Screen::get_width(), Screen::get_height()), Pos(0, 0), no_full);
+}
+
+TEST(RefreshSchedulerTest, intent_selects_waveform) {
+  RefreshScheduler scheduler;
+  screen.clear_panel_updates();
+
+  const Screen::PanelUpdate & ui = update(scheduler, RefreshScheduler::Intent::UI, Dim(100, 30), Pos(20, 40));
+  EXPECT_EQ(ui.mode, Screen::UpdateMode::DU);
+  EXPECT_EQ(ui.pos.x, 20);
+  EXPECT_EQ(ui.pos.y, 40);
+  EXPECT_EQ(ui.dim.width, 100);
+  EXPECT_EQ(ui.dim.height, 30);
+
+  EXPECT_EQ(update_all(scheduler, RefreshScheduler::Intent::TEXT ).mode, Screen::UpdateMode::GL16);
+  EXPECT_EQ(update_all(scheduler, RefreshScheduler::Intent::IMAGE).mode, Screen::UpdateMode::GC16);
+
+  EXPECT_EQ(screen.get_panel_updates().size(), 3);
+}
+
+TEST(RefreshSchedulerTest, text_pages_are_cleaned_periodically) {
+  RefreshScheduler scheduler;
+  screen.clear_panel_updates();
+
+  for (int i = 0; i < RefreshScheduler::GHOST_LIMIT; i++) {
+    EXPECT_EQ(update_all(scheduler, RefreshScheduler::Intent::TEXT).mode, Screen::UpdateMode::GL16);
+  }
+  EXPECT_EQ(update_all(scheduler, RefreshScheduler::Intent::TEXT).mode, Screen::UpdateMode::GC16);
+  EXPECT_EQ(update_all(scheduler, RefreshScheduler::Intent::TEXT).mode, Screen::UpdateMode::GL16);
+}
+
+TEST(RefreshSchedulerTest, ghosting_is_tracked_per_region) {
+  RefreshScheduler scheduler;
+  screen.clear_panel_updates();
+
+  Dim menu_dim(80, 40);
+  Pos menu_pos(10, 10);
+  Pos text_pos(10, Screen::get_height() - 100);
+
+  // Menu highlights accumulate ghosting in their own region only
+
+  int count = 0;
+  while (update(scheduler, RefreshScheduler::Intent::UI, menu_dim, menu_pos).mode == Screen::UpdateMode::DU) {
+    ASSERT_LT(++count, 100);
+  }
+  EXPECT_EQ(count, RefreshScheduler::GHOST_LIMIT / RefreshScheduler::DU_GHOST);
+
+  const Screen::PanelUpdate & clean = screen.get_panel_updates().back();
+  EXPECT_EQ(clean.pos.x, menu_pos.x);
+  EXPECT_EQ(clean.dim.width, menu_dim.width);
+  EXPECT_EQ(scheduler.get_ghost(menu_pos), 0);
+
+  EXPECT_EQ(update(scheduler, RefreshScheduler::Intent::TEXT, Dim(200, 40), text_pos).mode,
+            Screen::UpdateMode::GL16);
+  EXPECT_EQ(scheduler.get_ghost(text_pos), RefreshScheduler::GL16_GHOST);
+}
+
+TEST(RefreshSchedulerTest, no_full_defers_the_clean_update) {
+  RefreshScheduler scheduler;
+  screen.clear_panel_updates();
+
+  EXPECT_EQ(update_all(scheduler, RefreshScheduler::Intent::TEXT, true).mode, Screen::UpdateMode::GL16);
+  EXPECT_EQ(update_all(scheduler, RefreshScheduler::Intent::TEXT      ).mode, Screen::UpdateMode::GC16);
+}
+
+TEST(RefreshSchedulerTest, forced_full_update_covers_the_screen) {
+  RefreshScheduler scheduler;
+  screen.clear_panel_updates();
+
+  update(scheduler, RefreshScheduler::Intent::UI, Dim(50, 50), Pos(0, 0));
+  scheduler.force_full_update();
+
+  const Screen::PanelUpdate & full = update(scheduler, RefreshScheduler::Intent::UI, Dim(50, 50), Pos(100, 100));
+  EXPECT_EQ(full.mode, Screen::UpdateMode::GC16);
+  EXPECT_EQ(full.pos.x, 0);
+  EXPECT_EQ(full.pos.y, 0);
+  EXPECT_EQ(full.dim.width, Screen::get_width());
+  EXPECT_EQ(full.dim.height, Screen::get_height());
+  EXPECT_EQ(scheduler.get_ghost(Pos(0, 0)), 0);
+}
+
+TEST(RefreshSchedulerTest, modeled_durations) {
+  Dim full(Screen::get_width(), Screen::get_height());
+  Dim small(40, 40);
+
+  EXPECT_LT(Screen::get_modeled_duration(Screen::UpdateMode::DU,   full),
+            Screen::get_modeled_duration(Screen::UpdateMode::GL16, full));
+  EXPECT_LT(Screen::get_modeled_duration(Screen::UpdateMode::GL16, full),
+            Screen::get_modeled_duration(Screen::UpdateMode::GC16, full));
+  EXPECT_LT(Screen::get_modeled_duration(Screen::UpdateMode::GC16, small),
+            Screen::get_modeled_duration(Screen::UpdateMode::GC16, full));
+  EXPECT_GT(Screen::get_modeled_duration(Screen::UpdateMode::DU,   small), 0);
+}
+
+#endif
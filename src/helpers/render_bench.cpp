@@ -0,0 +1,399 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __RENDER_BENCH__ 1
+#include "helpers/render_bench.hpp"
+
+#if EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "helpers/memory_budget.hpp"
+#include "models/config.hpp"
+#include "models/epub.hpp"
+#include "models/ibmf.hpp"
+#include "models/page_locs.hpp"
+#include "models/search_index.hpp"
+#include "viewers/book_viewer.hpp"
+#include "viewers/page.hpp"
+#include "screen.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+void
+RenderBench::show_stats(const char * title, int64_t wall_us)
+{
+  std::string report;
+  perf_stats.get_report(report, wall_us);
+
+  printf("\n%s: %.1f ms\n%s", title, wall_us / 1000.0, report.c_str());
+}
+
+static const char * BENCH_TEXT =
+  "It is a truth universally acknowledged, that a single man in possession "
+  "of a good fortune, must be in want of a wife. However little known the "
+  "feelings or views of such a man may be on his first entering a "
+  "neighbourhood, this truth is so well fixed in the minds of the "
+  "surrounding families, that he is considered the rightful property of "
+  "some one or other of their daughters. \u201CMy dear Mr. Bennet,\u201D said "
+  "his lady to him one day, \u201Chave you heard that Netherfield Park is let "
+  "at last?\u201D";
+
+int
+RenderBench::layout_words(int32_t word_count)
+{
+  Page::Format fmt = {
+    .line_height_factor = 0.95,
+    .font_index         =   3,
+    .font_size          =  12,
+    .indent             =  20,
+    .margin_left        =   0,
+    .margin_right       =   0,
+    .margin_top         =   0,
+    .margin_bottom      =   0,
+    .screen_left        =  10,
+    .screen_right       =  10,
+    .screen_top         =  10,
+    .screen_bottom      =  30,
+    .width              =   0,
+    .height             =   0,
+    .vertical_align     =   0,
+    .trim               = true,
+    .pre                = false,
+    .font_style         = Fonts::FaceStyle::NORMAL,
+    .align              = CSS::Align::JUSTIFY,
+    .text_transform     = CSS::TextTransform::NONE,
+    .display            = CSS::Display::INLINE
+  };
+
+  page.set_compute_mode(Page::ComputeMode::DISPLAY);
+  page.start(fmt);
+  page.new_paragraph(fmt);
+
+  int32_t count = 0;
+  int16_t pages = 1;
+
+  // A first pass fills the glyph caches and the display list buffers
+
+  for (int pass = 0; pass < 2; pass++) {
+    int64_t start = PerfStats::get_time_us();
+    count = 0;
+
+    while (count < word_count) {
+      const char * str = BENCH_TEXT;
+      while (*str && (count < word_count)) {
+        if (*str == ' ') {
+          if (!page.add_char(" ", fmt)) {
+            page.start(fmt);
+            page.new_paragraph(fmt, true);
+            pages++;
+          }
+          str++;
+        }
+        else {
+          const char * w = str;
+          while (uint8_t(*str) > ' ') str++;
+          if (!page.add_word(w, str - w, fmt)) {
+            page.start(fmt);
+            page.new_paragraph(fmt, true);
+            page.add_word(w, str - w, fmt);
+            pages++;
+          }
+          count++;
+        }
+      }
+    }
+
+    int64_t duration = PerfStats::get_time_us() - start;
+    if (pass == 1) {
+      printf("\nWord layout: %d words, %d pages, %.1f ms, %.0f words/s\n",
+             count, pages, duration / 1000.0,
+             (duration == 0) ? 0.0 : (count * 1000000.0) / duration);
+    }
+    pages = 1;
+  }
+
+  page.start(fmt);
+
+  return 0;
+}
+
+int
+RenderBench::fetch_glyphs(int16_t font_size)
+{
+  std::vector<std::string> filenames;
+
+  DIR * dp = opendir(FONTS_FOLDER);
+  if (dp == nullptr) {
+    LOG_E("Unable to open folder %s", FONTS_FOLDER);
+    return 1;
+  }
+
+  struct dirent * de;
+  while ((de = readdir(dp))) {
+    int16_t size = strlen(de->d_name);
+    if ((size > 5) && (strcasecmp(&de->d_name[size - 5], ".ibmf") == 0)) {
+      filenames.push_back(de->d_name);
+    }
+  }
+  closedir(dp);
+
+  std::sort(filenames.begin(), filenames.end());
+
+  std::vector<uint32_t> ascii;
+  std::vector<uint32_t> latin;
+
+  for (uint32_t code = 0x21; code < 0x7F;  code++) ascii.push_back(code);
+  for (uint32_t code = 0xC0; code < 0x180; code++) latin.push_back(code);
+
+  int16_t heading_size = (font_size * 3) / 2;
+
+  printf("\nGlyph fetch at %d pt (mixed with %d pt), %d rounds, us per glyph\n\n",
+         font_size, heading_size, GLYPH_ROUNDS);
+  printf("%-30s %8s %8s %8s %8s\n", "Font", "ASCII", "Latin", "Cached", "Mixed");
+
+  for (auto & filename : filenames) {
+    IBMF font(std::string(FONTS_FOLDER "/") + filename);
+
+    if (!font.is_ready()) {
+      LOG_E("Unable to load font %s", filename.c_str());
+      continue;
+    }
+
+    // Time per glyph, the glyphs cache being cleared before each round if required
+
+    auto fetch = [&font](const std::vector<uint32_t> & codes,
+                         int16_t size, int16_t other_size, bool clear) -> double {
+      int64_t start = PerfStats::get_time_us();
+      for (int16_t round = 0; round < GLYPH_ROUNDS; round++) {
+        if (clear) font.clear_cache();
+        for (uint32_t code : codes) {
+          font.get_glyph(code, size);
+          if (other_size != size) font.get_glyph(code, other_size);
+        }
+      }
+      return (PerfStats::get_time_us() - start) /
+             (double) (GLYPH_ROUNDS * codes.size() * ((other_size != size) ? 2 : 1));
+    };
+
+    double ascii_us  = fetch(ascii, font_size, font_size, true);
+    double latin_us  = fetch(latin, font_size, font_size, true);
+    double cached_us = fetch(latin, font_size, font_size, false);
+
+    fetch(latin, heading_size, heading_size, false);
+    double mixed_us  = fetch(latin, font_size, heading_size, false);
+
+    printf("%-30s %8.2f %8.2f %8.3f %8.3f\n",
+           filename.c_str(), ascii_us, latin_us, cached_us, mixed_us);
+  }
+
+  return 0;
+}
+
+int
+RenderBench::run(int argc, char ** argv)
+{
+  if ((argc >= 2) && (strcmp(argv[1], "-w") == 0)) {
+    return layout_words((argc > 2) ? atoi(argv[2]) : DEFAULT_WORD_COUNT);
+  }
+
+  if ((argc >= 2) && (strcmp(argv[1], "-g") == 0)) {
+    return fetch_glyphs((argc > 2) ? atoi(argv[2]) : DEFAULT_FONT_SIZE);
+  }
+
+  bool                replay = false;
+  bool                cached = false;
+  bool                timing = false;
+  const char *        query  = nullptr;
+  std::vector<int8_t> variant_sizes;
+
+  while ((argc >= 2) && ((strcmp(argv[1], "-r") == 0) || 
+                         (strcmp(argv[1], "-c") == 0) || 
+                         (strcmp(argv[1], "-p") == 0) ||
+                         ((strcmp(argv[1], "-q") == 0) && (argc >= 3)) ||
+                         ((strcmp(argv[1], "-m") == 0) && (argc >= 3)) ||
+                         ((strcmp(argv[1], "-x") == 0) && (argc >= 3)))) {
+    if      (argv[1][1] == 'r') replay = true;
+    else if (argv[1][1] == 'c') cached = true;
+    else if (argv[1][1] == 'p') timing = true;
+    else {
+      if      (argv[1][1] == 'm') memory_budget.set_cap(atoi(argv[2]) * 1024);
+      else if (argv[1][1] == 'x') {
+        for (char * size = strtok(argv[2], ","); size != nullptr; size = strtok(nullptr, ",")) {
+          variant_sizes.push_back(atoi(size));
+        }
+      }
+      else                        query = argv[2];
+      argv[2] = argv[0];
+      argc--;
+      argv++;
+    }
+    argv[1] = argv[0];
+    argc--;
+    argv++;
+  }
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s [-r] [-c] [-p] [-q <query>] [-m <kbytes>] [-x <size>[,<size>...]]\n"
+                    "          <epub file> [<page count> [<output folder>]]\n"
+                    "       %s -w [<word count>]\n"
+                    "       %s -g [<font size>]\n", argv[0], argv[0], argv[0]);
+    return 1;
+  }
+
+  std::string epub_filename = argv[1];
+  int16_t     page_count    = (argc > 2) ? atoi(argv[2]) : DEFAULT_PAGE_COUNT;
+  std::string folder        = (argc > 3) ? argv[3] : ".";
+
+  struct stat file_stat;
+  if ((stat(folder.c_str(), &file_stat) != 0) && (mkdir(folder.c_str(), S_IRWXU) != 0)) {
+    LOG_E("Unable to create folder %s", folder.c_str());
+    return 1;
+  }
+
+  perf_stats.reset();
+
+  if (cached) config.put(Config::Ident::ITEM_CACHE, (int8_t) 1);
+
+  int64_t start = PerfStats::get_time_us();
+
+  if (!epub.open_file(epub_filename)) {
+    LOG_E("Unable to open %s", epub_filename.c_str());
+    return 1;
+  }
+
+  // Pages location are always recomputed, the .locs file being ignored.
+
+  int64_t separate_us = 0;
+
+  if (!variant_sizes.empty()) {
+
+    // The reference: one computation for each font size, after a first one
+    // warming up the caches. The font size of the book is the last one.
+
+    int8_t font_size = epub.get_book_format_params()->font_size;
+
+    variant_sizes.insert(variant_sizes.begin(), font_size);
+    variant_sizes.push_back(font_size);
+
+    for (uint16_t i = 0; i < variant_sizes.size(); i++) {
+      epub.get_book_format_params()->font_size = variant_sizes[i];
+      start = PerfStats::get_time_us();
+      page_locs.check_for_format_changes(epub.get_item_count(), 0, true);
+      while (page_locs.get_page_count() == -1) usleep(1000);
+      int64_t duration = PerfStats::get_time_us() - start;
+      if (i == 0) continue;
+      separate_us += duration;
+      printf("Pagination at %d pt: %.1f ms, %d pages\n", variant_sizes[i], duration / 1000.0, page_locs.get_page_count());
+    }
+
+    variant_sizes.erase(variant_sizes.begin());
+    variant_sizes.pop_back();
+
+    perf_stats.reset();
+    start = PerfStats::get_time_us();
+  }
+
+  page_locs.set_variants(variant_sizes);
+  page_locs.check_for_format_changes(epub.get_item_count(), 0, true);
+  while (page_locs.get_page_count() == -1) usleep(1000);
+
+  int64_t pagination_us = PerfStats::get_time_us() - start;
+
+  show_stats("Pagination", pagination_us);
+  printf("  %d pages\n", page_locs.get_page_count());
+
+  if (!variant_sizes.empty()) {
+    printf("\n%d font sizes: %.1f ms in one pass, %.1f ms in separate passes\n",
+           (int) variant_sizes.size() + 1, pagination_us / 1000.0, separate_us / 1000.0);
+
+    // Changing the font size to each variant, then back
+
+    variant_sizes.push_back(epub.get_book_format_params()->font_size);
+
+    for (int8_t size : variant_sizes) {
+      epub.get_book_format_params()->font_size = size;
+      start = PerfStats::get_time_us();
+      page_locs.check_for_format_changes(epub.get_item_count(), 0);
+      while (page_locs.get_page_count() == -1) usleep(1000);
+      printf("Change to %d pt: %.2f ms, %d pages\n", size,
+             (PerfStats::get_time_us() - start) / 1000.0, page_locs.get_page_count());
+    }
+  }
+
+  if (query != nullptr) {
+    std::vector<int16_t> page_nbrs;
+
+    start = PerfStats::get_time_us();
+    bool found = search_index.search(epub_filename, query, page_nbrs);
+    printf("\nSearch for \"%s\": %.2f ms\n", query, (PerfStats::get_time_us() - start) / 1000.0);
+
+    if (found) {
+      printf("  %d pages:", (int) page_nbrs.size());
+      for (int16_t page_nbr : page_nbrs) printf(" %d", page_nbr + 1);
+      printf("\n");
+    }
+    else {
+      printf("  No search index\n");
+    }
+  }
+
+  perf_stats.reset();
+
+  book_viewer.init();
+  book_viewer.set_use_checkpoints(!replay);
+
+  // With the panel timing, the screen updates last their modeled duration
+  // and the next page is laid out while the panel is updated.
+
+  screen.set_panel_timing(timing);
+
+  // When the pages cache is used, a second pass shows the same pages again,
+  // retrieving them from the cache.
+
+  for (int pass = 0; pass < (cached ? 2 : 1); pass++) {
+    int64_t  render_us  = 0;
+    int16_t  rendered   = 0;
+    int64_t  pass_start = PerfStats::get_time_us();
+
+    const PageLocs::PageId * page_id = page_locs.get_page_id(PageLocs::PageId(0, 0));
+
+    while ((page_id != nullptr) && (rendered < page_count)) {
+      start = PerfStats::get_time_us();
+      book_viewer.show_page(*page_id);
+      render_us += PerfStats::get_time_us() - start;
+
+      char name[32];
+      snprintf(name, 32, (pass == 0) ? "/page_%04d.pgm" : "/cached_%04d.pgm", rendered);
+      if (!screen.save_pgm(folder + name)) break;
+
+      rendered++;
+      page_id = page_locs.get_next_page_id(*page_id);
+    }
+
+    screen.wait_for_updates();
+    int64_t wall_us = PerfStats::get_time_us() - pass_start;
+
+    show_stats((pass == 0) ? "Rendering" : "Rendering from the pages cache", render_us);
+    printf("  %d pages, %.2f ms per page\n",
+           rendered,
+           (rendered == 0) ? 0.0 : render_us / (rendered * 1000.0));
+    if (timing) {
+      printf("  %.1f ms with the panel updates, %.2f ms per page\n",
+             wall_us / 1000.0,
+             (rendered == 0) ? 0.0 : wall_us / (rendered * 1000.0));
+    }
+
+    perf_stats.reset();
+  }
+
+  return 0;
+}
+
+#endif
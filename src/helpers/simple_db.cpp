@@ -101,6 +101,18 @@ SimpleDB::add_record(void * record, int32_t size)
   return true;
 }
 
+bool 
+SimpleDB::replace_record(void * record, int32_t size) 
+{
+  LOG_D("Replacing record of size %d", size);
+
+  if ((size <= 0) || (get_record_size() != size)) return false;
+  if (fseek(db_file, record_offset[current_record_idx] + sizeof(int32_t), SEEK_SET)) return false;
+  if (fwrite(record, size, 1, db_file) != 1) return false;
+  fflush(db_file);
+  return true;
+}
+
 bool 
 SimpleDB::get_record(void * record, int32_t size) 
 {
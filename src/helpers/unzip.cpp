@@ -7,6 +7,8 @@
 
 #include "viewers/msg_viewer.hpp"
 #include "models/epub.hpp"
+#include "helpers/perf_stats.hpp"
+#include "helpers/inflate.hpp"
 #include "alloc.hpp"
 
 #include <fcntl.h>
@@ -22,6 +24,9 @@
 Unzip::Unzip()
 {
   zip_file_is_open = false; 
+  state            = nullptr;
+  index_file       = nullptr;
+  indexing         = false;
 }
 
 bool 
@@ -170,6 +175,7 @@ Unzip::open_zip_file(const char * zip_filename)
         fe->start_pos       = getuint32((const unsigned char *) &buffer[38]);
         fe->compressed_size = getuint32((const unsigned char *) &buffer[16]);
         fe->size            = getuint32((const unsigned char *) &buffer[20]);
+        fe->crc             = getuint32((const unsigned char *) &buffer[12]);
         fe->method          = getuint16((const unsigned char *) &buffer[ 6]);
 
         //LOG_D("File: %s %d %d %d %d", fe.filename, fe.start_pos, fe.compressed_size, fe.size, fe.method);
@@ -207,6 +213,13 @@ Unzip::open_zip_file(const char * zip_filename)
   }
 
   file_entries.reverse();
+
+  if (completed) {
+    index_filename = zip_filename;
+    index_filename = index_filename.substr(0, index_filename.find_last_of('.')) + ".zidx";
+    load_inflate_index();
+  }
+
   return completed;
 }
 
@@ -219,6 +232,7 @@ Unzip::close_zip_file()
       delete entry;
     }
     file_entries.clear();
+    inflate_index.clear();
     fclose(file);
     zip_file_is_open = false;
   }
@@ -298,6 +312,29 @@ Unzip::get_file_size(const char * filename)
   }
 }
 
+bool
+Unzip::get_file_info(const char * filename, uint32_t & size, uint32_t & crc, uint16_t & method)
+{
+  std::scoped_lock guard(mutex);
+
+  if (!zip_file_is_open) return false;
+
+  char * the_filename = clean_fname(filename);
+
+  FileEntries::iterator fe = file_entries.begin();
+  while ((fe != file_entries.end()) && (strcmp((*fe)->filename, the_filename) != 0)) fe++;
+
+  delete [] the_filename;
+
+  if (fe == file_entries.end()) return false;
+
+  size   = (*fe)->size;
+  crc    = (*fe)->crc;
+  method = (*fe)->method;
+
+  return true;
+}
+
 bool
 Unzip::file_exists(const char * filename)
 {
@@ -607,53 +644,123 @@ error:
 #if !STB
 
 bool
-Unzip::open_stream_file(const char * filename, uint32_t & file_size)
+Unzip::fill_buffer()
 {
-  if (!open_file(filename)) return false;
+  uint32_t size = (in_remaining < BUFFER_SIZE) ? in_remaining : BUFFER_SIZE;
+  if (fread(buffer, size, 1, file) != 1) {
+    LOG_E("Error reading zip content.");
+    return false;
+  }
+
+  in_remaining -= size;
+  in_ptr        = buffer;
+  in_avail      = size;
+
+  return true;
+}
 
-  repeat  = ((*current_fe)->compressed_size) / BUFFER_SIZE;
-  remains = ((*current_fe)->compressed_size) % BUFFER_SIZE;
-  current = 0;
-  aborted = false;
+bool
+Unzip::inflate_step()
+{
+  if ((in_avail == 0) && (in_remaining > 0)) {
+    if (!fill_buffer()) return false;
+  }
 
-  zstr.zalloc    = nullptr;
-  zstr.zfree     = nullptr;
-  zstr.opaque    = nullptr;
-  zstr.next_in   = nullptr;
-  zstr.next_out  = nullptr;
-  zstr.avail_in  = 0;
-  zstr.avail_out = 0;
+  size_t in_size  = in_avail;
+  size_t out_size = TINFL_LZ_DICT_SIZE - state->dict_ofs;
 
-  int zret;
+  state->status = tinfl_decompress(&state->decomp,
+                                   (const mz_uint8 *) in_ptr, &in_size,
+                                   state->dict, &state->dict[state->dict_ofs], &out_size,
+                                   (in_remaining > 0) ? TINFL_FLAG_HAS_MORE_INPUT : 0);
 
-  #if ZLIB
-    if ((zret = inflateInit2(&zstr, -MAX_WBITS)) != Z_OK) {
-      aborted = true;
-      close_stream_file();
-      return false;
-    }
-  #else // MINIZ
-    if ((zret = mz_inflateInit2(&zstr, -15)) != MZ_OK) {
+  in_ptr            += in_size;
+  in_avail          -= in_size;
+  in_offset         += in_size;
+  out_offset        += out_size;
+  state->dict_avail  = out_size;
+  state->dict_ofs    = (state->dict_ofs + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+
+  if (state->status < TINFL_STATUS_DONE) {
+    LOG_E("Error inflating data: %d", state->status);
+    return false;
+  }
+
+  if ((state->status == TINFL_STATUS_NEEDS_MORE_INPUT) && 
+      (in_avail == 0) && (in_remaining == 0) && (out_size == 0)) {
+    LOG_E("Truncated compressed data.");
+    return false;
+  }
+
+  if (indexing && (out_offset >= next_checkpoint) && (state->status != TINFL_STATUS_DONE)) {
+    if (!save_checkpoint()) indexing = false;
+    next_checkpoint = out_offset + CHECKPOINT_INTERVAL;
+  }
+
+  return true;
+}
+
+bool
+Unzip::stream_rewind()
+{
+  if (fseek(file, data_start, SEEK_SET)) return false;
+
+  in_offset    = 0;
+  in_remaining = (*current_fe)->compressed_size;
+  in_avail     = 0;
+  out_offset   = 0;
+
+  if ((*current_fe)->method == 8) {
+    tinfl_init(&state->decomp);
+    state->status     = TINFL_STATUS_NEEDS_MORE_INPUT;
+    state->dict_ofs   = 0;
+    state->dict_avail = 0;
+  }
+
+  return true;
+}
+
+bool
+Unzip::open_stream_file(const char * filename, uint32_t & file_size)
+{
+  if (!open_file(filename)) return false;
+
+  aborted  = false;
+  indexing = false;
+
+  if ((*current_fe)->method == 8) {
+    if ((state = (InflateState *) allocate(sizeof(InflateState))) == nullptr) {
+      LOG_E("Unable to allocate inflate state.");
       aborted = true;
-      close_stream_file();
+      close_file();
       return false;
     }
-  #endif
 
-  file_size = (*current_fe)->size;
+    // The index of large entries is extended each time decompression goes
+    // beyond their last checkpoint
 
-  uint16_t size = current < repeat ? BUFFER_SIZE : remains;
-  if (fread(buffer, size, 1, file) != 1) {
-    LOG_E("Error reading zip content.");
-    close_stream_file();
+    if ((*current_fe)->size >= INDEX_MIN_SIZE) {
+      InflateIndex::iterator idx = inflate_index.find((*current_fe)->start_pos);
+      indexing        = true;
+      next_checkpoint = ((idx == inflate_index.end()) ? 0 : idx->second.back().out_offset) + 
+                        CHECKPOINT_INTERVAL;
+    }
+  }
+  else if ((*current_fe)->method != 0) {
+    LOG_E("Unsupported compression method: %d", (*current_fe)->method);
     aborted = true;
+    close_file();
     return false;
   }
 
-  current++;
+  data_start = ftell(file);
+  file_size  = (*current_fe)->size;
 
-  zstr.avail_in = size;
-  zstr.next_in  = (unsigned char *) buffer;
+  if (!stream_rewind() || ((in_remaining > 0) && !fill_buffer())) {
+    close_stream_file();
+    aborted = true;
+    return false;
+  }
 
   return true;
 }
@@ -663,11 +770,16 @@ Unzip::close_stream_file()
 {
   if (aborted) return;
 
-  #if ZLIB
-    inflateEnd(&zstr);
-  #else // MINIZ
-    mz_inflateEnd(&zstr);
-  #endif
+  if (index_file != nullptr) {
+    fclose(index_file);
+    index_file = nullptr;
+  }
+  indexing = false;
+
+  if (state != nullptr) {
+    free(state);
+    state = nullptr;
+  }
 
   close_file();
 }
@@ -675,117 +787,355 @@ Unzip::close_stream_file()
 bool
 Unzip::stream_skip(uint32_t byte_count)
 {
-  char * tmp = (char *) allocate(byte_count);
-  uint32_t size = byte_count;
+  return stream_seek(get_stream_pos() + byte_count);
+}
+
+bool
+Unzip::stream_seek(uint32_t offset)
+{
+  if (aborted) return false;
+  if (offset > (*current_fe)->size) return false;
 
-  do {
-    uint32_t s = size;
-    if (!get_stream_data(tmp, s)) {
-      free(tmp);
+  if ((*current_fe)->method == 0) {
+    if (fseek(file, data_start + offset, SEEK_SET)) {
+      close_stream_file();
+      aborted = true;
       return false;
     }
-    size -= s;
-  } while (size > 0);
-  free(tmp);
-  return true;
+    in_offset    = out_offset = offset;
+    in_remaining = (*current_fe)->compressed_size - offset;
+    in_avail     = 0;
+    return true;
+  }
+
+  uint32_t pos = get_stream_pos();
+
+  // Find the nearest checkpoint located before offset
+
+  const Checkpoint * best = nullptr;
+  InflateIndex::iterator idx = inflate_index.find((*current_fe)->start_pos);
+  if (idx != inflate_index.end()) {
+    for (const Checkpoint & checkpoint : idx->second) {
+      if (checkpoint.out_offset > offset) break;
+      best = &checkpoint;
+    }
+  }
+
+  bool ok = true;
+
+  if ((best != nullptr) && ((offset < pos) || (best->out_offset > out_offset))) {
+    ok = restore_checkpoint(*best);
+  }
+  else if (offset < pos) {
+    ok = stream_rewind();
+  }
+
+  // Skip the remaining bytes, discarding them directly from the dictionary
+
+  while (ok && ((pos = get_stream_pos()) < offset)) {
+    if (state->dict_avail == 0) {
+      if (state->status == TINFL_STATUS_DONE) { ok = false; break; }
+      ok = inflate_step();
+    }
+    else {
+      uint32_t size = offset - pos;
+      if (size > state->dict_avail) size = state->dict_avail;
+      state->dict_avail -= size;
+    }
+  }
+
+  if (!ok) {
+    close_stream_file();
+    aborted = true;
+  }
+
+  return ok;
 }
 
 bool 
 Unzip::get_stream_data(char * data, uint32_t & data_size)
 {
-  zstr.next_out  = (unsigned char *) data;
-  zstr.avail_out = data_size;
-  
+  uint32_t total = 0;
+
   if ((*current_fe)->method == 0) {
-    while (!aborted && (zstr.avail_out > 0)) {
-      uint16_t copy_size = zstr.avail_in <= zstr.avail_out ? zstr.avail_in : zstr.avail_out;
-      memcpy(zstr.next_out, zstr.next_in, copy_size);
-
-      zstr.next_out  += copy_size;
-      zstr.next_in   += copy_size;
-      zstr.avail_out -= copy_size;
-      zstr.avail_in  -= copy_size;
-
-      if (zstr.avail_in == 0) {
-        if (current > repeat) break; // We are at the end
-        uint16_t size = current < repeat ? BUFFER_SIZE : remains;
-        if (fread(buffer, size, 1, file) != 1) {
-          LOG_E("Error reading zip content.");
+    while (!aborted && (total < data_size)) {
+      if (in_avail == 0) {
+        if (in_remaining == 0) break; // We are at the end
+        if (!fill_buffer()) {
           close_stream_file();
           aborted = true;
           break;
         }
+      }
 
-        current++;
+      uint32_t copy_size = (in_avail <= (data_size - total)) ? in_avail : data_size - total;
+      memcpy(&data[total], in_ptr, copy_size);
 
-        zstr.avail_in = size;
-        zstr.next_in  = (unsigned char *) buffer;
+      in_ptr     += copy_size;
+      in_avail   -= copy_size;
+      in_offset  += copy_size;
+      out_offset += copy_size;
+      total      += copy_size;
+    }
+  }
+  else if ((*current_fe)->method == 8) {
+    while (!aborted && (total < data_size)) {
+      if (state->dict_avail == 0) {
+        if (state->status == TINFL_STATUS_DONE) break;
+        if (!inflate_step()) {
+          close_stream_file();
+          aborted = true;
+        }
       }
+      else {
+        // Data written by a single inflate_step() call never wraps around the dictionary
+        uint32_t copy_size = (state->dict_avail <= (data_size - total)) ? state->dict_avail : data_size - total;
+        uint32_t dict_pos  = (state->dict_ofs - state->dict_avail) & (TINFL_LZ_DICT_SIZE - 1);
+        memcpy(&data[total], &state->dict[dict_pos], copy_size);
 
+        state->dict_avail -= copy_size;
+        total             += copy_size;
+      }
     }
   }
-  else if ((*current_fe)->method == 8) {
 
-    while (!aborted && (zstr.avail_out == data_size)) {
+  data_size = total;
+  return !aborted;
+}
 
-      #if ZLIB
-        int zret = inflate(&zstr, Z_NO_FLUSH);
-
-        switch (zret) {
-          case Z_NEED_DICT:
-          case Z_DATA_ERROR:
-          case Z_MEM_ERROR:
-            LOG_E("Error inflating data: %d", zret);
-            close_stream_file();
-            aborted = true;
-          default:
-            ;   
-        }
-      #else // MINIZ
-        int zret = mz_inflate(&zstr, MZ_NO_FLUSH);
-
-        switch (zret) {
-          case MZ_NEED_DICT:
-          case MZ_DATA_ERROR:
-          case MZ_MEM_ERROR:
-            LOG_E("Error inflating data: %d", zret);
-            close_stream_file();
-            aborted = true;
-          default:
-            ;   
-        }
-      #endif
+// ----- Inflate checkpoints index -----
 
-      if (!aborted && (zstr.avail_out != 0)) {
-        if ((zstr.avail_in == 0) && (current <= repeat)) {
-          uint16_t size = current < repeat ? BUFFER_SIZE : remains;
-          if (fread(buffer, size, 1, file) != 1) {
-            LOG_E("Error reading zip content.");
-            close_stream_file();
-            aborted = true;
-          }
-          else {
-            current++;
+void
+Unzip::load_inflate_index()
+{
+  inflate_index.clear();
 
-            zstr.avail_in = size;
-            zstr.next_in  = (unsigned char *) buffer;
-          }
-        }
+  FILE * f = fopen(index_filename.c_str(), "r");
+  if (f == nullptr) return;
+
+  int8_t   version;
+  uint32_t state_size;
+  bool     stale = false;
+
+  if ((fread(&version,    sizeof(version),    1, f) == 1) &&
+      (fread(&state_size, sizeof(state_size), 1, f) == 1) &&
+      (version == ZIDX_FILE_VERSION) && 
+      (state_size == sizeof(InflateState))) {
+
+    CheckpointHeader header;
+    uint32_t         file_pos = ftell(f);
+
+    while (fread(&header, sizeof(header), 1, f) == 1) {
+      file_pos += sizeof(header);
+
+      // A partial record at the end of the file would misalign the next ones appended
+      if (fseek(f, 0, SEEK_END) || (ftell(f) < (long)(file_pos + sizeof(InflateState)))) {
+        stale = true;
+        break;
+      }
+      if (fseek(f, file_pos + sizeof(InflateState), SEEK_SET)) break;
+
+      FileEntries::iterator fe = file_entries.begin();
+      while ((fe != file_entries.end()) && ((*fe)->start_pos != header.entry_pos)) fe++;
+
+      if ((fe == file_entries.end()) || ((*fe)->crc != header.entry_crc)) {
+        stale = true;
+        break;
+      }
+
+      Checkpoints & checkpoints = inflate_index[header.entry_pos];
+      if (checkpoints.empty() || (checkpoints.back().out_offset < header.out_offset)) {
+        checkpoints.push_back({ header.out_offset, header.in_offset, file_pos });
       }
+
+      file_pos += sizeof(InflateState);
     }
   }
+  else {
+    stale = true;
+  }
 
-  data_size = data_size - zstr.avail_out;
-  return !aborted;
+  fclose(f);
+
+  if (stale) {
+    LOG_I("Inflate index file is stale. Removed.");
+    inflate_index.clear();
+    remove(index_filename.c_str());
+  }
+  else {
+    LOG_D("Inflate index loaded: %d entries.", inflate_index.size());
+  }
+}
+
+bool
+Unzip::save_checkpoint()
+{
+  if (index_file == nullptr) {
+    bool new_file = inflate_index.empty();
+    if ((index_file = fopen(index_filename.c_str(), new_file ? "w" : "a")) == nullptr) {
+      LOG_E("Unable to open inflate index file: %s", index_filename.c_str());
+      return false;
+    }
+    if (new_file) {
+      int8_t   version    = ZIDX_FILE_VERSION;
+      uint32_t state_size = sizeof(InflateState);
+      if ((fwrite(&version,    sizeof(version),    1, index_file) != 1) ||
+          (fwrite(&state_size, sizeof(state_size), 1, index_file) != 1)) {
+        return false;
+      }
+    }
+  }
+
+  CheckpointHeader header;
+
+  header.entry_pos  = (*current_fe)->start_pos;
+  header.entry_crc  = (*current_fe)->crc;
+  header.in_offset  = in_offset;
+  header.out_offset = out_offset;
+
+  if (fseek(index_file, 0, SEEK_END)) return false;
+  uint32_t file_pos = ftell(index_file) + sizeof(header);
+
+  if ((fwrite(&header, sizeof(header),       1, index_file) != 1) ||
+      (fwrite(state,   sizeof(InflateState), 1, index_file) != 1)) {
+    LOG_E("Unable to write inflate checkpoint.");
+    return false;
+  }
+
+  inflate_index[header.entry_pos].push_back({ out_offset, in_offset, file_pos });
+
+  return true;
 }
 
-// Test version of get_file using stream methods
+bool
+Unzip::restore_checkpoint(const Checkpoint & checkpoint)
+{
+  if (index_file != nullptr) fflush(index_file);
+
+  FILE * f = fopen(index_filename.c_str(), "r");
+  if (f == nullptr) return false;
+
+  bool ok = (fseek(f, checkpoint.file_pos, SEEK_SET) == 0) &&
+            (fread(state, sizeof(InflateState), 1, f) == 1);
+  fclose(f);
+
+  if (!ok || fseek(file, data_start + checkpoint.in_offset, SEEK_SET)) {
+    LOG_E("Unable to restore inflate checkpoint.");
+    return false;
+  }
+
+  in_offset         = checkpoint.in_offset;
+  in_remaining      = (*current_fe)->compressed_size - checkpoint.in_offset;
+  in_avail          = 0;
+  out_offset        = checkpoint.out_offset;
+  state->dict_avail = 0;
+
+  return true;
+}
+
+int16_t
+Unzip::get_checkpoint_count(const char * filename)
+{
+  std::scoped_lock guard(mutex);
+
+  if (!zip_file_is_open) return -1;
+
+  char * the_filename = clean_fname(filename);
+
+  FileEntries::iterator fe = file_entries.begin();
+  while ((fe != file_entries.end()) && (strcmp((*fe)->filename, the_filename) != 0)) fe++;
+
+  delete [] the_filename;
+
+  if (fe == file_entries.end()) return -1;
+
+  InflateIndex::iterator idx = inflate_index.find((*fe)->start_pos);
+  return (idx == inflate_index.end()) ? 0 : idx->second.size();
+}
+
+bool
+Unzip::get_whole_file(const char * filename, char * & data, uint32_t & file_size)
+{
+  data      = nullptr;
+  file_size = 0;
+
+  if (!open_file(filename)) return true;
+
+  FileEntry * fe = *current_fe;
+
+  // The stream decompression builds the index of large entries (see
+  // open_stream_file()). It is complete when no checkpoint would follow the
+  // last one.
+
+  bool whole = (fe->method == 0) || (fe->method == 8);
+  if (whole && (fe->method == 8) && (fe->size >= INDEX_MIN_SIZE)) {
+    InflateIndex::iterator idx = inflate_index.find(fe->start_pos);
+    whole = (idx != inflate_index.end()) &&
+            ((idx->second.back().out_offset + CHECKPOINT_INTERVAL) >= fe->size);
+  }
+
+  uint8_t * in = nullptr;
+
+  if (whole) {
+    data = (char *) allocate(fe->size + 1);
+    if ((data != nullptr) && (fe->method == 8)) {
+      in = (uint8_t *) allocate(fe->compressed_size + 1);
+    }
+    if ((data == nullptr) || ((fe->method == 8) && (in == nullptr))) whole = false;
+  }
+
+  if (whole) {
+    bool ok;
+
+    if (fe->method == 0) {
+      ok = fread(data, 1, fe->size, file) == fe->size;
+    }
+    else {
+      ok = (fread(in, 1, fe->compressed_size, file) == fe->compressed_size) &&
+           Inflate::decompress(in, fe->compressed_size, (uint8_t *) data, fe->size);
+    }
+
+    if (!ok) {
+      LOG_E("Unable to retrieve %s", fe->filename);
+    }
+    else if (Inflate::update_crc32(0, (const uint8_t *) data, fe->size) != fe->crc) {
+      LOG_E("CRC error on %s", fe->filename);
+      ok = false;
+    }
+
+    if (ok) {
+      data[fe->size] = 0;
+      file_size      = fe->size;
+    }
+    else {
+      free(data);
+      data = nullptr;
+    }
+  }
+  else if (data != nullptr) {
+    free(data);
+    data = nullptr;
+  }
+
+  if (in != nullptr) free(in);
+
+  close_file();
+  return whole;
+}
+
+// Entries are retrieved with the stream methods when they can't be
+// decompressed at once
 char * 
 Unzip::get_file(const char * filename, uint32_t & file_size)
 {
   // LOG_D("get_file: %s", filename);
+
+  PERF_SCOPE(UNZIP);
   
   char * data        = nullptr;
+
+  if (get_whole_file(filename, data, file_size)) return data;
+
   char * window      = nullptr;
   int    total       = 0;
   int    err         = 0;
@@ -0,0 +1,154 @@
+#if TESTING && EPUB_LINUX_BUILD
+
+#include "gtest/gtest.h"
+#include "helpers/unzip.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <unistd.h>
+
+// Synthetic ebook with a single large chapter, built with the zip command line tool.
+
+static constexpr char const * SYNTH_FOLDER  = "/tmp/epub_unzip_tests";
+static constexpr char const * SYNTH_EPUB    = "/tmp/epub_unzip_tests/synthetic.epub";
+static constexpr char const * SYNTH_INDEX   = "/tmp/epub_unzip_tests/synthetic.zidx";
+static constexpr char const * SYNTH_CHAPTER = "OEBPS/chapter.xhtml";
+static constexpr uint32_t     SYNTH_SIZE    = 4 * 1024 * 1024;
+
+static std::string chapter;
+
+static bool
+build_synthetic_epub()
+{
+  if (!chapter.empty()) return true;
+
+  static const char * words[] = {
+    "lorem ", "ipsum ", "dolor ", "sit ", "amet, ", "consectetur ", "adipiscing ", "elit. ",
+    "<p>", "</p>\n", "<em>", "</em> ", "sed ", "do ", "eiusmod ", "tempor "
+  };
+
+  std::mt19937 rng(1234);
+  chapter = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<html><body>\n";
+  while (chapter.size() < SYNTH_SIZE) chapter += words[rng() & 15];
+  chapter += "</body></html>\n";
+
+  std::string cmd = std::string("rm -rf ") + SYNTH_FOLDER + " && mkdir -p " + SYNTH_FOLDER + "/OEBPS";
+  if (system(cmd.c_str()) != 0) return false;
+
+  std::ofstream mimetype(std::string(SYNTH_FOLDER) + "/mimetype");
+  mimetype << "application/epub+zip";
+  mimetype.close();
+
+  std::ofstream chap(std::string(SYNTH_FOLDER) + "/" + SYNTH_CHAPTER);
+  chap << chapter;
+  chap.close();
+
+  cmd = std::string("cd ") + SYNTH_FOLDER + " && zip -q -X -0 synthetic.epub mimetype && zip -q -X -9 synthetic.epub " + SYNTH_CHAPTER;
+  return system(cmd.c_str()) == 0;
+}
+
+static bool
+read_at(uint32_t offset, uint32_t size)
+{
+  char     data[256];
+  uint32_t got = size;
+
+  if (!unzip.stream_seek(offset))        return false;
+  if (!unzip.get_stream_data(data, got)) return false;
+  return (got == size) && (memcmp(data, &chapter[offset], size) == 0);
+}
+
+TEST(UnzipTest, inflate_index_creation) {
+  ASSERT_TRUE(build_synthetic_epub());
+  unlink(SYNTH_INDEX);
+
+  uint32_t size;
+  ASSERT_TRUE(unzip.open_zip_file(SYNTH_EPUB));
+  EXPECT_EQ(unzip.get_checkpoint_count(SYNTH_CHAPTER), 0);
+
+  char * data = unzip.get_file(SYNTH_CHAPTER, size);
+  ASSERT_TRUE(data != nullptr);
+  EXPECT_EQ(size, chapter.size());
+  EXPECT_TRUE(memcmp(data, chapter.c_str(), size) == 0);
+  free(data);
+
+  int16_t count = unzip.get_checkpoint_count(SYNTH_CHAPTER);
+  EXPECT_GT(count, 0);
+  unzip.close_zip_file();
+
+  // The sidecar file is reloaded when the book is reopened
+
+  ASSERT_TRUE(unzip.open_zip_file(SYNTH_EPUB));
+  EXPECT_EQ(unzip.get_checkpoint_count(SYNTH_CHAPTER), count);
+  unzip.close_zip_file();
+}
+
+TEST(UnzipTest, random_access_through_checkpoints) {
+  ASSERT_TRUE(build_synthetic_epub());
+
+  uint32_t size;
+  ASSERT_TRUE(unzip.open_zip_file(SYNTH_EPUB));
+  ASSERT_TRUE(unzip.open_stream_file(SYNTH_CHAPTER, size));
+
+  std::mt19937 rng(4321);
+  for (int i = 0; i < 200; i++) {
+    uint32_t offset = rng() % (size - 256);
+    ASSERT_TRUE(read_at(offset, 256)) << "At offset " << offset;
+  }
+  EXPECT_TRUE(read_at(0, 256));
+  EXPECT_TRUE(read_at(size - 256, 256));
+  EXPECT_FALSE(unzip.stream_seek(size + 1));
+
+  unzip.close_stream_file();
+  unzip.close_zip_file();
+}
+
+TEST(UnzipTest, benchmark_item_retrieval_vs_seek) {
+  ASSERT_TRUE(build_synthetic_epub());
+
+  static constexpr int READ_COUNT = 20;
+
+  uint32_t size;
+  int64_t  durations[2];
+  std::mt19937 rng(5678);
+
+  ASSERT_TRUE(unzip.open_zip_file(SYNTH_EPUB));
+  ASSERT_GT(unzip.get_checkpoint_count(SYNTH_CHAPTER), 0);
+
+  // Reading some bytes in the second half of the chapter, the way EPub::load_item()
+  // does it (inflating the whole entry) and through the inflate index. The
+  // durations depend on the host load: they are reported, not checked.
+
+  for (int pass = 0; pass < 2; pass++) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < READ_COUNT; i++) {
+      uint32_t offset = (chapter.size() >> 1) + rng() % ((chapter.size() >> 1) - 256);
+      if (pass == 0) {
+        char * data = unzip.get_file(SYNTH_CHAPTER, size);
+        ASSERT_TRUE(data != nullptr);
+        EXPECT_TRUE(memcmp(&data[offset], &chapter[offset], 256) == 0);
+        free(data);
+      }
+      else {
+        ASSERT_TRUE(unzip.open_stream_file(SYNTH_CHAPTER, size));
+        EXPECT_TRUE(read_at(offset, 256));
+        unzip.close_stream_file();
+      }
+    }
+
+    durations[pass] = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+  }
+
+  unzip.close_zip_file();
+
+  std::cout << "[ BENCH    ] " << READ_COUNT << " reads in the second half of a "
+            << (chapter.size() >> 10) << " KB chapter: "
+            << durations[0] << " us inflating the whole entry, "
+            << durations[1] << " us through checkpoints." << std::endl;
+}
+
+#endif
@@ -0,0 +1,149 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#include "helpers/upload_pipeline.hpp"
+#include "helpers/perf_stats.hpp"
+#include "helpers/pthread_config.hpp"
+#include "alloc.hpp"
+
+UploadPipeline::UploadPipeline() :
+  next_in(0), next_out(0), queued(0),
+  file(nullptr), scanner(nullptr),
+  running(false), failed(false),
+  byte_count(0), start_us(0), end_us(0), write_us(0), stall_us(0)
+{
+  for (auto & buffer : buffers) buffer = { nullptr, 0 };
+}
+
+void
+UploadPipeline::free_buffers()
+{
+  for (auto & buffer : buffers) {
+    if (buffer.data != nullptr) free(buffer.data);
+    buffer = { nullptr, 0 };
+  }
+}
+
+void
+UploadPipeline::task()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+    cond.wait(lock, [this] { return (queued > 0) || !running; });
+    if (queued == 0) break; // Stopped, nothing pending
+
+    Buffer & buffer = buffers[next_out];
+    bool     ok     = !failed;
+
+    // The write is done without the lock: the receiver fills the
+    // next buffer meanwhile.
+
+    lock.unlock();
+    if (ok) {
+      int64_t start = PerfStats::get_time_us();
+      ok = fwrite(buffer.data, 1, buffer.size, file) == buffer.size;
+      write_us += PerfStats::get_time_us() - start;
+      if (ok && (scanner != nullptr)) scanner->feed((const uint8_t *) buffer.data, buffer.size);
+    }
+    lock.lock();
+
+    if (!ok && !failed) {
+      LOG_E("Write failed");
+      failed = true;
+    }
+    next_out = (next_out + 1) % BUFFER_COUNT;
+    queued--;
+    cond.notify_all();
+  }
+}
+
+bool
+UploadPipeline::start(FILE * f, ZipStreamScanner * s)
+{
+  std::scoped_lock guard(mutex);
+
+  if (running) return false;
+
+  for (auto & buffer : buffers) {
+    if ((buffer.data == nullptr) &&
+        ((buffer.data = (char *) allocate(BUFFER_SIZE)) == nullptr)) {
+      LOG_E("Unable to allocate upload buffers");
+      free_buffers();
+      return false;
+    }
+  }
+
+  file       = f;
+  scanner    = s;
+  next_in    = next_out = queued = 0;
+  failed     = false;
+  byte_count = 0;
+  write_us   = stall_us = 0;
+  start_us   = end_us   = PerfStats::get_time_us();
+
+  #if EPUB_INKPLATE_BUILD
+    PThreadConfig task_cfg("sdWriter", 6 * 1024, 5);
+  #endif
+
+  running = true;
+  thread  = std::thread(&UploadPipeline::task, this);
+
+  return true;
+}
+
+char *
+UploadPipeline::get_buffer()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (queued == BUFFER_COUNT) {
+    int64_t start = PerfStats::get_time_us();
+    cond.wait(lock, [this] { return (queued < BUFFER_COUNT) || failed; });
+    stall_us += PerfStats::get_time_us() - start;
+  }
+
+  return failed ? nullptr : buffers[next_in].data;
+}
+
+bool
+UploadPipeline::put_buffer(uint32_t size)
+{
+  std::scoped_lock guard(mutex);
+
+  if (failed || !running) return false;
+
+  buffers[next_in].size = size;
+  next_in     = (next_in + 1) % BUFFER_COUNT;
+  byte_count += size;
+  queued++;
+  cond.notify_all();
+
+  return true;
+}
+
+bool
+UploadPipeline::finish()
+{
+  {
+    std::scoped_lock guard(mutex);
+    if (!running) return !failed;
+    running = false;
+  }
+
+  cond.notify_all();
+  if (thread.joinable()) thread.join();
+
+  end_us = PerfStats::get_time_us();
+
+  return !failed;
+}
+
+uint32_t
+UploadPipeline::get_throughput() const
+{
+  int64_t elapsed = end_us - start_us;
+
+  return (elapsed > 0) ? (uint64_t) byte_count * 1000000 / elapsed : 0;
+}
@@ -0,0 +1,232 @@
+#if TESTING && EPUB_LINUX_BUILD
+
+#include "gtest/gtest.h"
+#include "helpers/upload_pipeline.hpp"
+#include "helpers/perf_stats.hpp"
+#include "models/epub_scanner.hpp"
+
+#include <fstream>
+#include <random>
+#include <unistd.h>
+
+static constexpr char const * UPLOAD_FOLDER = "/tmp/epub_upload_tests";
+static constexpr uint32_t     NETWORK_DELAY = 20000;  // Time to receive a buffer (us)
+static constexpr uint32_t     STORAGE_DELAY = 20000;  // Time to write a buffer (us)
+
+static std::string
+random_data(uint32_t size)
+{
+  std::mt19937 rng(4321);
+  std::string  data(size, 0);
+
+  for (auto & ch : data) ch = rng() & 0xFF;
+  return data;
+}
+
+// Sends data through a pipeline, in chunks of the size usually returned
+// by a socket read.
+
+static bool
+upload(UploadPipeline & pipeline, const std::string & data, uint32_t network_delay = 0)
+{
+  uint32_t pos = 0;
+
+  while (pos < data.size()) {
+    char * buf = pipeline.get_buffer();
+    if (buf == nullptr) return false;
+
+    uint32_t size = 0;
+    while ((size < UploadPipeline::BUFFER_SIZE) && (pos < data.size())) {
+      uint32_t n = std::min<uint32_t>({ 1460, UploadPipeline::BUFFER_SIZE - size, (uint32_t) data.size() - pos });
+      memcpy(buf + size, &data[pos], n);
+      size += n; pos += n;
+    }
+    if (network_delay) usleep(network_delay);
+    if (!pipeline.put_buffer(size)) return false;
+  }
+
+  return pipeline.finish();
+}
+
+static std::string
+read_file(const std::string & filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static ssize_t
+slow_write(void * cookie, const char * buf, size_t size)
+{
+  usleep(STORAGE_DELAY);
+  return size;
+}
+
+// When written to a pipe, the zip file entries are followed by data
+// descriptors.
+
+static bool
+build_epub(bool streamed)
+{
+  std::string cmd = std::string("rm -rf ") + UPLOAD_FOLDER + " && mkdir -p " + UPLOAD_FOLDER + "/book/META-INF " + UPLOAD_FOLDER + "/book/OEBPS/images";
+  if (system(cmd.c_str()) != 0) return false;
+
+  std::string folder = std::string(UPLOAD_FOLDER) + "/book/";
+
+  std::ofstream(folder + "mimetype") << "application/epub+zip";
+  std::ofstream(folder + "META-INF/container.xml") <<
+    "<?xml version=\"1.0\"?>\n"
+    "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">\n"
+    "  <rootfiles><rootfile full-path=\"OEBPS/content.opf\" media-type=\"application/oebps-package+xml\"/></rootfiles>\n"
+    "</container>\n";
+  std::ofstream(folder + "OEBPS/content.opf") <<
+    "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"2.0\" unique-identifier=\"id\">\n"
+    "  <metadata xmlns:dc=\"http://purl.org/dc/elements/1.1/\">\n"
+    "    <dc:title>Streamed Book</dc:title>\n"
+    "    <dc:creator>Jane Writer</dc:creator>\n"
+    "    <dc:description>Received through the Web server.</dc:description>\n"
+    "    <meta name=\"cover\" content=\"cover-img\"/>\n"
+    "  </metadata>\n"
+    "  <manifest>\n"
+    "    <item id=\"cover-img\" href=\"images/cover.png\" media-type=\"image/png\"/>\n"
+    "    <item id=\"chap\" href=\"chapter.xhtml\" media-type=\"application/xhtml+xml\"/>\n"
+    "  </manifest>\n"
+    "  <spine><itemref idref=\"chap\"/></spine>\n"
+    "</package>\n";
+  std::ofstream(folder + "OEBPS/images/cover.png", std::ios::binary) << random_data(40000);
+  std::ofstream(folder + "OEBPS/chapter.xhtml") << "<html><body><p>" << std::string(200000, 'a') << "</p></body></html>";
+
+  const char * files = " META-INF/container.xml OEBPS/content.opf OEBPS/images/cover.png OEBPS/chapter.xhtml";
+
+  cmd = "cd " + folder + (streamed ? 
+          std::string(" && zip -q -X -9 - mimetype") + files + " | cat > ../book.epub" :
+          std::string(" && zip -q -X -0 ../book.epub mimetype && zip -q -X -9 ../book.epub") + files);
+  return system(cmd.c_str()) == 0;
+}
+
+TEST(UploadPipelineTest, writes_all_the_data_in_order) {
+  ASSERT_EQ(system((std::string("mkdir -p ") + UPLOAD_FOLDER).c_str()), 0);
+
+  std::string    data     = random_data(5 * UploadPipeline::BUFFER_SIZE + 1234);
+  std::string    filename = std::string(UPLOAD_FOLDER) + "/data.bin";
+  FILE         * file     = fopen(filename.c_str(), "w");
+  UploadPipeline pipeline;
+
+  ASSERT_TRUE(file != nullptr);
+  ASSERT_TRUE(pipeline.start(file));
+  EXPECT_TRUE(upload(pipeline, data));
+  fclose(file);
+
+  EXPECT_EQ(pipeline.get_byte_count(), data.size());
+  EXPECT_TRUE(read_file(filename) == data);
+}
+
+TEST(UploadPipelineTest, reception_and_writes_overlap) {
+  cookie_io_functions_t functions = { nullptr, slow_write, nullptr, nullptr };
+
+  std::string    data     = random_data(16 * UploadPipeline::BUFFER_SIZE);
+  FILE         * file     = fopencookie(nullptr, "w", functions);
+  UploadPipeline pipeline;
+
+  ASSERT_TRUE(file != nullptr);
+  setvbuf(file, nullptr, _IONBF, 0);
+
+  ASSERT_TRUE(pipeline.start(file));
+  EXPECT_TRUE(upload(pipeline, data, NETWORK_DELAY));
+  fclose(file);
+
+  // Done in sequence, the upload would take 16 * (NETWORK_DELAY + STORAGE_DELAY)
+
+  EXPECT_LT(pipeline.get_elapsed_us(), 16 * (NETWORK_DELAY + STORAGE_DELAY) * 3 / 4);
+  EXPECT_GE(pipeline.get_write_us(), 16 * STORAGE_DELAY);
+  EXPECT_GT(pipeline.get_throughput(), 0);
+}
+
+TEST(UploadPipelineTest, metadata_retrieved_while_received) {
+  ASSERT_TRUE(build_epub(false));
+
+  std::string    data     = read_file(std::string(UPLOAD_FOLDER) + "/book.epub");
+  std::string    filename = std::string(UPLOAD_FOLDER) + "/uploaded.epub";
+  FILE         * file     = fopen(filename.c_str(), "w");
+  UploadPipeline pipeline;
+  EPubScanner    scanner;
+
+  ASSERT_TRUE(file != nullptr);
+  ASSERT_TRUE(scanner.begin());
+  ASSERT_TRUE(pipeline.start(file, &scanner));
+  EXPECT_TRUE(upload(pipeline, data));
+  fclose(file);
+
+  EXPECT_TRUE(scanner.is_scanned());
+  EXPECT_TRUE(scanner.finish());
+  EXPECT_TRUE(scanner.is_complete());
+  EXPECT_EQ(scanner.get_entries().size(), 5);
+  EXPECT_EQ(scanner.get_opf_filename(),            "OEBPS/content.opf");
+  EXPECT_EQ(scanner.get_metadata().title,          "Streamed Book");
+  EXPECT_EQ(scanner.get_metadata().author,         "Jane Writer");
+  EXPECT_EQ(scanner.get_metadata().cover_filename, "OEBPS/images/cover.png");
+
+  const ZipStreamScanner::Entry * entry = scanner.find("OEBPS/chapter.xhtml");
+  ASSERT_TRUE(entry != nullptr);
+  EXPECT_EQ(entry->size, 200000 + 33);
+  EXPECT_EQ(entry->method, 8);
+}
+
+TEST(UploadPipelineTest, central_directory_only_with_data_descriptors) {
+  ASSERT_TRUE(build_epub(true));
+
+  std::string data = read_file(std::string(UPLOAD_FOLDER) + "/book.epub");
+  EPubScanner scanner;
+
+  // Fed by tiny chunks: the headers are split between calls
+
+  ASSERT_TRUE(scanner.begin());
+  for (uint32_t pos = 0; pos < data.size(); pos += 7) {
+    scanner.feed((const uint8_t *) &data[pos], std::min<uint32_t>(7, data.size() - pos));
+  }
+
+  EXPECT_FALSE(scanner.is_scanned());
+  EXPECT_TRUE(scanner.finish());
+  EXPECT_EQ(scanner.get_entries().size(), 5);
+  EXPECT_FALSE(scanner.is_complete());
+}
+
+// The sizes of the local file headers are not trusted: a stored entry
+// claiming more data than it holds is not retrieved.
+
+static void
+set_local_size(std::string & data, const std::string & filename, uint32_t size)
+{
+  std::string header("PK\x03\x04", 4);
+
+  for (size_t pos = data.find(header); pos != std::string::npos; pos = data.find(header, pos + 1)) {
+    if (data.compare(pos + 30, filename.size(), filename) == 0) {
+      memcpy(&data[pos + 22], &size, 4);
+      return;
+    }
+  }
+}
+
+TEST(UploadPipelineTest, wrong_stored_sizes_rejected) {
+  std::string cmd = std::string("cd ") + UPLOAD_FOLDER + "/book && rm -f ../stored.epub && " +
+                    "zip -q -X -0 ../stored.epub mimetype META-INF/container.xml OEBPS/content.opf";
+  ASSERT_TRUE(build_epub(false));
+  ASSERT_EQ(system(cmd.c_str()), 0);
+
+  std::string data = read_file(std::string(UPLOAD_FOLDER) + "/stored.epub");
+
+  for (uint32_t size : { 100000u, 0xFFFFFFFFu }) {
+    std::string corrupted = data;
+    set_local_size(corrupted, "META-INF/container.xml", size);
+
+    EPubScanner scanner;
+    ASSERT_TRUE(scanner.begin());
+    scanner.feed((const uint8_t *) corrupted.data(), corrupted.size());
+
+    EXPECT_TRUE(scanner.is_scanned());
+    EXPECT_EQ(scanner.get_opf_filename(), "");
+  }
+}
+
+#endif
@@ -0,0 +1,303 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#include "helpers/zip_stream_scanner.hpp"
+#include "helpers/unzip.hpp"
+#include "helpers/inflate.hpp"
+#include "alloc.hpp"
+
+void
+ZipStreamScanner::reset()
+{
+  if (capture != nullptr) { free(capture); capture = nullptr; }
+  if (tail    != nullptr) { free(tail);    tail    = nullptr; }
+
+  entries.clear();
+  name.clear();
+
+  state             = State::HEADER;
+  header_fill       = 0;
+  remaining         = 0;
+  capture_fill      = 0;
+  stream_pos        = 0;
+  scanned           = false;
+  central_dir_found = false;
+}
+
+bool
+ZipStreamScanner::begin()
+{
+  reset();
+
+  tail = (uint8_t *) allocate(TAIL_SIZE);
+  if (tail == nullptr) {
+    LOG_E("Unable to allocate the tail buffer");
+    return false;
+  }
+
+  return true;
+}
+
+void
+ZipStreamScanner::header_completed()
+{
+  uint16_t flags = getuint16(&header[6]);
+
+  entry.method          = getuint16(&header[ 8]);
+  entry.crc             = getuint32(&header[14]);
+  entry.compressed_size = getuint32(&header[18]);
+  entry.size            = getuint32(&header[22]);
+
+  if ((flags & 0x08) && (entry.compressed_size == 0)) {
+    // Sizes are in a data descriptor following the data: the next
+    // header can't be located.
+
+    LOG_D("Data descriptor found, sequential scan stopped");
+    state = State::DONE;
+    return;
+  }
+
+  name.clear();
+  remaining = getuint16(&header[26]);
+  state     = State::NAME;
+}
+
+char *
+ZipStreamScanner::decompress(const char * data, uint32_t size, uint32_t out_size)
+{
+  char * out = (char *) allocate(out_size + 1);
+  if (out == nullptr) return nullptr;
+
+  if (entry.method == 0) {
+    if (size != out_size) {
+      LOG_E("Wrong size for %s", name.c_str());
+      free(out);
+      return nullptr;
+    }
+    memcpy(out, data, out_size);
+  }
+  else if (!Inflate::decompress((const uint8_t *) data, size, (uint8_t *) out, out_size)) {
+    LOG_E("Unable to inflate %s", name.c_str());
+    free(out);
+    return nullptr;
+  }
+
+  if (Inflate::update_crc32(0, (const uint8_t *) out, out_size) != entry.crc) {
+    LOG_E("CRC error on %s", name.c_str());
+    free(out);
+    return nullptr;
+  }
+
+  out[out_size] = 0;
+  return out;
+}
+
+void
+ZipStreamScanner::entry_completed()
+{
+  if (capture != nullptr) {
+    char * data = decompress(capture, capture_fill, entry.size);
+    free(capture);
+    capture = nullptr;
+    if (data != nullptr) entry_received(name, data, entry.size);
+  }
+
+  header_fill = 0;
+  state       = State::HEADER;
+}
+
+void
+ZipStreamScanner::feed(const uint8_t * data, uint32_t size)
+{
+  // Keep the tail for the central directory
+
+  if (tail != nullptr) {
+    uint32_t        count = (size > TAIL_SIZE) ? TAIL_SIZE : size;
+    const uint8_t * src   = data + size - count;
+    uint32_t        idx   = (stream_pos + size - count) % TAIL_SIZE;
+
+    while (count > 0) {
+      uint32_t n = ((TAIL_SIZE - idx) < count) ? (TAIL_SIZE - idx) : count;
+      memcpy(&tail[idx], src, n);
+      src += n; count -= n; idx = 0;
+    }
+  }
+
+  const uint8_t * p    = data;
+  uint32_t        left = size;
+
+  while ((left > 0) && (state != State::DONE)) {
+    uint32_t n;
+
+    switch (state) {
+      case State::HEADER:
+        if (header_fill == 0) entry.header_pos = stream_pos + (p - data);
+        n = LOCAL_HEADER_SIZE - header_fill;
+        if (n > left) n = left;
+        memcpy(&header[header_fill], p, n);
+        header_fill += n;
+        if (header_fill >= 4) {
+          uint32_t sig = getuint32(header);
+          if (sig != LOCAL_HEADER_SIG) {
+            scanned = (sig == CENTRAL_HEADER_SIG) || (sig == END_OF_DIR_SIG);
+            state   = State::DONE;
+            break;
+          }
+        }
+        if (header_fill == LOCAL_HEADER_SIZE) header_completed();
+        break;
+
+      case State::NAME:
+        n = (remaining < left) ? remaining : left;
+        name.append((const char *) p, n);
+        remaining -= n;
+        if (remaining == 0) {
+          remaining = getuint16(&header[28]);
+          state     = State::EXTRA;
+        }
+        break;
+
+      case State::EXTRA:
+        n = (remaining < left) ? remaining : left;
+        remaining -= n;
+        break;
+
+      case State::DATA:
+        n = (remaining < left) ? remaining : left;
+        if (capture != nullptr) {
+          memcpy(&capture[capture_fill], p, n);
+          capture_fill += n;
+        }
+        remaining -= n;
+        break;
+
+      default:
+        n = left;
+        break;
+    }
+
+    p += n; left -= n;
+
+    // Parts may be empty: move to the next one without waiting for more data
+
+    if ((state == State::EXTRA) && (remaining == 0)) {
+      entry.filename = name;
+      remaining      = entry.compressed_size;
+      capture_fill   = 0;
+      state          = State::DATA;
+
+      // The sizes come from the uploaded file: a stored entry must be of
+      // the same size once "decompressed".
+
+      if (((getuint16(&header[6]) & 0x01) == 0) &&
+          (((entry.method == 0) && (entry.size == entry.compressed_size)) || (entry.method == 8)) &&
+          (entry.compressed_size <= MAX_CAPTURE_SIZE) &&
+          (entry.size <= MAX_ENTRY_SIZE) &&
+          is_wanted(name)) {
+        capture = (char *) allocate(entry.compressed_size + 1);
+      }
+    }
+    if ((state == State::DATA) && (remaining == 0)) entry_completed();
+  }
+
+  stream_pos += size;
+}
+
+bool
+ZipStreamScanner::read_tail(uint32_t pos, uint8_t * data, uint32_t size)
+{
+  uint32_t tail_start = (stream_pos > TAIL_SIZE) ? stream_pos - TAIL_SIZE : 0;
+
+  if ((tail == nullptr) || (pos < tail_start) || ((pos + size) > stream_pos)) return false;
+
+  while (size > 0) {
+    uint32_t idx = pos % TAIL_SIZE;
+    uint32_t n   = ((TAIL_SIZE - idx) < size) ? (TAIL_SIZE - idx) : size;
+    memcpy(data, &tail[idx], n);
+    data += n; pos += n; size -= n;
+  }
+
+  return true;
+}
+
+bool
+ZipStreamScanner::finish()
+{
+  if (capture != nullptr) { free(capture); capture = nullptr; }
+
+  // Locate the end of central directory record, from the end (it may be
+  // followed by a comment)
+
+  uint8_t  eocd[END_OF_DIR_SIZE];
+  uint32_t tail_start = (stream_pos > TAIL_SIZE) ? stream_pos - TAIL_SIZE : 0;
+  bool     found      = false;
+
+  if (stream_pos >= END_OF_DIR_SIZE) {
+    for (uint32_t pos = stream_pos - END_OF_DIR_SIZE; ; pos--) {
+      if (read_tail(pos, eocd, END_OF_DIR_SIZE) && (getuint32(eocd) == END_OF_DIR_SIG)) {
+        found = true;
+        break;
+      }
+      if (pos == tail_start) break;
+    }
+  }
+
+  if (!found) {
+    LOG_E("End of central directory not found");
+    return false;
+  }
+
+  uint16_t count    = getuint16(&eocd[10]);
+  uint32_t dir_size = getuint32(&eocd[12]);
+  uint32_t dir_pos  = getuint32(&eocd[16]);
+
+  uint8_t * dir = (uint8_t *) allocate(dir_size + 1);
+  if (dir == nullptr) return false;
+
+  if (!read_tail(dir_pos, dir, dir_size)) {
+    LOG_E("Central directory not in the tail: %u bytes", dir_size);
+    free(dir);
+    return false;
+  }
+
+  entries.clear();
+  entries.reserve(count);
+
+  const uint8_t * p   = dir;
+  const uint8_t * end = dir + dir_size;
+
+  while ((entries.size() < count) && ((p + CENTRAL_HEADER_SIZE) <= end) && (getuint32(p) == CENTRAL_HEADER_SIG)) {
+    uint16_t name_len = getuint16(&p[28]);
+    uint16_t skip     = getuint16(&p[30]) + getuint16(&p[32]);
+
+    if ((p + CENTRAL_HEADER_SIZE + name_len) > end) break;
+
+    entries.push_back(Entry {
+      .filename        = std::string((const char *) &p[CENTRAL_HEADER_SIZE], name_len),
+      .header_pos      = getuint32(&p[42]),
+      .compressed_size = getuint32(&p[20]),
+      .size            = getuint32(&p[24]),
+      .crc             = getuint32(&p[16]),
+      .method          = getuint16(&p[10])
+    });
+
+    p += CENTRAL_HEADER_SIZE + name_len + skip;
+  }
+
+  free(dir);
+
+  central_dir_found = (entries.size() == count);
+  if (!central_dir_found) LOG_E("Central directory is corrupted");
+
+  return central_dir_found;
+}
+
+const ZipStreamScanner::Entry *
+ZipStreamScanner::find(const std::string & filename) const
+{
+  for (auto & e : entries) {
+    if (e.filename == filename) return &e;
+  }
+  return nullptr;
+}
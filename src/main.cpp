@@ -17,9 +17,11 @@
   #include "models/epub.hpp"
   #include "models/config.hpp"
   #include "models/nvs_mgr.hpp"
+  #include "models/resume_state.hpp"
   #include "screen.hpp"
   #include "inkplate_platform.hpp"
   #include "helpers/unzip.hpp"
+  #include "helpers/memory_budget.hpp"
   #include "viewers/msg_viewer.hpp"
   #include "pugixml.hpp"
   #include "alloc.hpp"
@@ -91,6 +93,13 @@
 
       pugi::set_memory_management_functions(allocate, free);
 
+      // When waking up from deep sleep while a book was shown, the book is
+      // reopened directly. The books directory will be read only when needed.
+
+      ResumeState::Snapshot snapshot;
+      bool resuming = !config_err && resume_state.retrieve(snapshot);
+
+      memory_budget.setup();
       page_locs.setup();
 
       #if INKPLATE_6PLUS
@@ -112,7 +121,7 @@
         #define INT_PIN ((gpio_num_t)0)
       #endif
 
-      if (fonts.setup()) {
+      if (fonts.setup(resuming ? snapshot.format_params.font : -1)) {
         
         Screen::Orientation    orientation;
         Screen::PixelResolution resolution;
@@ -174,11 +183,17 @@
           inkplate_platform.deep_sleep(INT_PIN, LEVEL);
         }
 
-        msg_viewer.show(MsgViewer::MsgType::INFO, false, true, "Starting", "One moment please...");
+        if (resuming && books_dir_controller.resume(snapshot)) {
+          LOG_D("Resuming from deep sleep");
+          app_controller.start(AppController::Ctrl::BOOK);
+        }
+        else {
+          msg_viewer.show(MsgViewer::MsgType::INFO, false, true, "Starting", "One moment please...");
 
-        books_dir_controller.setup();
-        LOG_D("Initialization completed");
-        app_controller.start();
+          books_dir_controller.setup();
+          LOG_D("Initialization completed");
+          app_controller.start();
+        }
       }
       else {
         LOG_E("Font loading error.");
@@ -255,8 +270,21 @@
   #include "models/fonts.hpp"
   #include "models/config.hpp"
   #include "models/page_locs.hpp"
+  #include "models/resume_state.hpp"
+  #include "helpers/memory_budget.hpp"
   #include "screen.hpp"
 
+  #if PERF_STATS
+    #include "helpers/perf_stats.hpp"
+  #endif
+
+  #if EPUB_HEADLESS
+    #include "helpers/render_bench.hpp"
+    #include "helpers/pre_paginator.hpp"
+    #include "helpers/font_compiler.hpp"
+    #include <unistd.h>
+  #endif
+
   #if TESTING
     #include "gtest/gtest.h"
   #endif
@@ -265,10 +293,15 @@
 
   void exit_app()
   {
+    #if PERF_STATS && !EPUB_HEADLESS
+      std::string report;
+      perf_stats.get_report(report);
+      printf("\nPerformance statistics:\n%s", report.c_str());
+    #endif
+
     fonts.clear_glyph_caches();
     fonts.clear(true);
     epub.close_file();
-    DOM::delete_pool();
   }
 
   int 
@@ -281,9 +314,17 @@
       config.show();
     #endif
 
+    ResumeState::Snapshot snapshot;
+    bool resuming = false;
+
+    #if !(TESTING || EPUB_HEADLESS)
+      resuming = !config_err && resume_state.retrieve(snapshot);
+    #endif
+
+    memory_budget.setup();
     page_locs.setup();
     
-    if (fonts.setup()) {
+    if (fonts.setup(resuming ? snapshot.format_params.font : -1)) {
 
       Screen::Orientation     orientation;
       Screen::PixelResolution resolution;
@@ -292,7 +333,9 @@
       screen.setup(resolution, orientation);
 
       event_mgr.setup();
-      books_dir_controller.setup();
+
+      if (resuming) resuming = books_dir_controller.resume(snapshot);
+      if (!resuming) books_dir_controller.setup();
 
       #if defined(INKPLATE_6PLUS)
         #define MSG "the WakeUp button"
@@ -312,8 +355,15 @@
       #if TESTING
         testing::InitGoogleTest();
         return RUN_ALL_TESTS();
+      #elif EPUB_HEADLESS
+        int res = ((argc >= 2) && (strcmp(argv[1], "-l") == 0)) ? pre_paginator.run(argc, argv) :
+                  ((argc >= 2) && (strcmp(argv[1], "-b") == 0)) ? font_compiler.run(argc, argv) :
+                                                                  render_bench.run(argc, argv);
+        page_locs.abort_threads();
+        exit_app();
+        return res;
       #else
-        app_controller.start();
+        app_controller.start(resuming ? AppController::Ctrl::BOOK : AppController::Ctrl::DIR);
       #endif
     }
     else {
@@ -0,0 +1,315 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define _BFNT_ 1
+#include "models/bfnt.hpp"
+#include "viewers/msg_viewer.hpp"
+
+#include "screen.hpp"
+#include "helpers/perf_stats.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+FILE       * BFNT::file{ nullptr };
+const BFNT * BFNT::file_owner{ nullptr };
+std::mutex   BFNT::file_mutex;
+
+std::string
+BFNT::get_filename(const std::string & font_filename, uint16_t resolution)
+{
+  char res[8];
+  int_to_str(resolution, res, 8);
+
+  return font_filename.substr(0, font_filename.find_last_of('.')) + "_" + res + ".bfnt";
+}
+
+bool
+BFNT::decode(const uint8_t * rle, uint16_t size,
+             uint16_t width, uint16_t height,
+             bool one_bit, uint8_t * out)
+{
+  uint16_t pitch = one_bit ? ((width + 7) >> 3) : width;
+  uint16_t x     = 0;
+  uint16_t y     = 0;
+
+  if (one_bit) memset(out, 0, pitch * height);
+
+  for (const uint8_t * end = rle + size; (rle < end) && (y < height); rle++) {
+    uint8_t value = *rle & 0x0F;
+    uint8_t count = (*rle >> 4) + 1;
+
+    while (count-- > 0) {
+      if (one_bit) {
+        if (value >= 8) out[(y * pitch) + (x >> 3)] |= 0x80 >> (x & 7);
+      }
+      else {
+        out[(y * pitch) + x] = value * 17;
+      }
+      if (++x >= width) {
+        x = 0;
+        if (++y >= height) break;
+      }
+    }
+  }
+
+  return y >= height;
+}
+
+BFNT::BFNT(const std::string & the_filename, const std::string & the_fallback_filename) : Font()
+{
+  filename          = the_filename;
+  fallback_filename = the_fallback_filename;
+
+  FILE * f = fopen(filename.c_str(), "rb");
+  if (f == nullptr) {
+    LOG_E("Unable to open font file %s", filename.c_str());
+    return;
+  }
+
+  Header header;
+
+  if ((fread(&header, sizeof(Header), 1, f) == 1) &&
+      (memcmp(header.ident, "BFNT", 4) == 0) &&
+      (header.version    == BFNT_FILE_VERSION) &&
+      (header.resolution == Screen::RESOLUTION)) {
+    sizes.resize(header.size_count);
+    ready = (header.size_count == 0) ||
+            (fread(sizes.data(), sizeof(SizeInfo), header.size_count, f) == header.size_count);
+  }
+
+  if (!ready) {
+    LOG_E("Font file %s is not a BFNT font for this screen", filename.c_str());
+    sizes.clear();
+  }
+
+  fclose(f);
+}
+
+BFNT::~BFNT()
+{
+  ready = false;
+  clear_cache();
+
+  std::scoped_lock guard(file_mutex);
+  if (file_owner == this) {
+    fclose(file);
+    file       = nullptr;
+    file_owner = nullptr;
+  }
+}
+
+void
+BFNT::clear_cache()
+{
+  Font::clear_cache();
+  if (fallback != nullptr) fallback->clear_cache();
+}
+
+const BFNT::SizeInfo *
+BFNT::get_size_info(int16_t glyph_size) const
+{
+  for (auto & size_info : sizes) {
+    if (size_info.size == glyph_size) return &size_info;
+  }
+  return nullptr;
+}
+
+TTF *
+BFNT::get_fallback()
+{
+  std::call_once(fallback_loaded, [this]() {
+    LOG_D("Loading %s for sizes not precompiled", fallback_filename.c_str());
+    fallback = std::make_unique<TTF>(fallback_filename);
+  });
+
+  return fallback->is_ready() ? fallback.get() : nullptr;
+}
+
+// Partial read of the font file, kept open until another BFNT font needs its own.
+
+bool
+BFNT::read(uint32_t offset, void * buffer, uint32_t size)
+{
+  std::scoped_lock guard(file_mutex);
+
+  if (file_owner != this) {
+    if (file != nullptr) fclose(file);
+    file_owner = ((file = fopen(filename.c_str(), "rb")) != nullptr) ? this : nullptr;
+    if (file == nullptr) {
+      LOG_E("Unable to open font file %s", filename.c_str());
+      return false;
+    }
+  }
+
+  return (fseek(file, offset, SEEK_SET) == 0) && (fread(buffer, 1, size, file) == size);
+}
+
+const BFNT::SizeTables *
+BFNT::get_tables(int16_t glyph_size)
+{
+  auto it = tables.find(glyph_size);
+  if (it != tables.end()) return &it->second;
+
+  const SizeInfo * size_info = get_size_info(glyph_size);
+  if (size_info == nullptr) return nullptr;
+
+  SizeTables & size_tables = tables[glyph_size];
+
+  size_tables.glyphs.resize(size_info->glyph_count);
+  size_tables.kerns.resize(size_info->kern_count);
+
+  uint32_t glyphs_size = size_info->glyph_count * sizeof(GlyphInfo);
+
+  if (!(read(size_info->glyphs_offset, size_tables.glyphs.data(), glyphs_size) &&
+        read(size_info->glyphs_offset + glyphs_size,
+             size_tables.kerns.data(),
+             size_info->kern_count * sizeof(KernPair)))) {
+    LOG_E("Unable to read the tables of size %d from %s", glyph_size, filename.c_str());
+    size_tables.glyphs.clear();
+    size_tables.kerns.clear();
+  }
+
+  return &size_tables;
+}
+
+Font::Glyph *
+BFNT::get_glyph_internal(uint32_t charcode, int16_t glyph_size)
+{
+  Glyphs::iterator git;
+
+  GlyphsCache::iterator cache_it = cache.find(glyph_size);
+
+  bool found = (cache_it != cache.end()) &&
+               ((git = cache_it->second.find(charcode)) != cache_it->second.end());
+
+  if (found) {
+    PERF_COUNT(GLYPH_CACHE_HIT);
+    return git->second;
+  }
+
+  const SizeTables * size_tables = get_tables(glyph_size);
+
+  if (size_tables == nullptr) {
+    TTF * ttf = get_fallback();
+    if (ttf == nullptr) return nullptr;
+
+    // The glyph is kept in the fallback font cache. It is identified as
+    // coming from this font for the page cache.
+
+    Glyph * glyph = ttf->get_glyph(charcode, glyph_size);
+    if (glyph != nullptr) glyph->font = this;
+    return glyph;
+  }
+
+  PERF_SCOPE(GLYPH);
+  PERF_COUNT(GLYPH_CACHE_MISS);
+
+  auto info = std::lower_bound(size_tables->glyphs.begin(), size_tables->glyphs.end(), charcode,
+                               [](const GlyphInfo & g, uint32_t code) { return g.code < code; });
+
+  if ((info == size_tables->glyphs.end()) || (info->code != charcode)) {
+    LOG_D("Charcode not found in face: %d, font_index: %d", charcode, fonts_cache_index);
+    return nullptr;
+  }
+
+  Glyph * glyph = bitmap_glyph_pool.newElement();
+
+  if (glyph == nullptr) {
+    LOG_E("Unable to allocate memory for glyph.");
+    msg_viewer.out_of_memory("glyph allocation");
+  }
+
+  bool one_bit = screen.get_pixel_resolution() == Screen::PixelResolution::ONE_BIT;
+
+  glyph->dim.width   = info->width;
+  glyph->dim.height  = info->height;
+  glyph->pitch       = one_bit ? ((info->width + 7) >> 3) : info->width;
+  glyph->xoff        = info->xoff;
+  glyph->yoff        = info->yoff;
+  glyph->advance     = info->advance;
+  glyph->line_height = get_size_info(glyph_size)->line_height;
+  glyph->buffer      = nullptr;
+
+  // The index of the glyph in its size table, to retrieve its kerning pairs
+
+  glyph->ligature_and_kern_pgm_index = (info->kern_count > 0) ?
+                                       (info - size_tables->glyphs.begin()) : -1;
+
+  int32_t size = glyph->pitch * glyph->dim.height;
+
+  if (size > 0) {
+    rle_buffer.resize(info->bitmap_size);
+
+    glyph->buffer = byte_pool_alloc(size);
+
+    if (glyph->buffer == nullptr) {
+      LOG_E("Unable to allocate memory for glyph.");
+      msg_viewer.out_of_memory("glyph allocation");
+    }
+
+    if (!(read(get_size_info(glyph_size)->bitmaps_offset + info->bitmap_offset, 
+               rle_buffer.data(), 
+               info->bitmap_size) &&
+          decode(rle_buffer.data(), info->bitmap_size, info->width, info->height, one_bit, glyph->buffer))) {
+      LOG_E("Unable to read glyph for charcode: %d", charcode);
+      bitmap_glyph_pool.deallocate(glyph);
+      return nullptr;
+    }
+  }
+
+  glyph->font = this;
+  glyph->code = charcode;
+  glyph->size = glyph_size;
+
+  cache[glyph_size][charcode] = glyph;
+
+  return glyph;
+}
+
+Font::Glyph *
+BFNT::adjust_ligature_and_kern(Glyph   * glyph,
+                               uint16_t  glyph_size,
+                               uint32_t  next_charcode,
+                               int16_t & kern,
+                               bool    & ignore_next)
+{
+  ignore_next = false;
+  kern        = 0;
+
+  auto it = tables.find(glyph_size);
+
+  if ((next_charcode != 0) && (it != tables.end()) &&
+      (glyph->ligature_and_kern_pgm_index < (int16_t) it->second.glyphs.size())) {
+    const GlyphInfo & info  = it->second.glyphs[glyph->ligature_and_kern_pgm_index];
+    auto              first = it->second.kerns.begin() + info.kern_index;
+    auto              last  = first + info.kern_count;
+    auto              pair  = std::lower_bound(first, last, next_charcode,
+                                [](const KernPair & p, uint32_t code) { return p.next_code < code; });
+
+    if ((pair != last) && (pair->next_code == next_charcode)) kern = pair->kern;
+  }
+
+  return glyph;
+}
+
+int32_t
+BFNT::get_line_height(int16_t glyph_size)
+{
+  const SizeInfo * size_info = get_size_info(glyph_size);
+  if (size_info != nullptr) return size_info->line_height;
+
+  TTF * ttf = get_fallback();
+  return (ttf == nullptr) ? 0 : ttf->get_line_height(glyph_size);
+}
+
+int32_t
+BFNT::get_descender_height(int16_t glyph_size)
+{
+  const SizeInfo * size_info = get_size_info(glyph_size);
+  if (size_info != nullptr) return size_info->descender;
+
+  TTF * ttf = get_fallback();
+  return (ttf == nullptr) ? 0 : ttf->get_descender_height(glyph_size);
+}
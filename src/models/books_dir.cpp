@@ -7,8 +7,12 @@
 
 #include "models/epub.hpp"
 #include "models/default_cover.hpp"
+#include "models/image_factory.hpp"
+#include "helpers/unzip.hpp"
+#include "screen.hpp"
 #include "viewers/book_viewer.hpp"
 #include "viewers/msg_viewer.hpp"
+#include "models/search_index.hpp"
 #include "alloc.hpp"
 
 #if EPUB_INKPLATE_BUILD
@@ -207,25 +211,15 @@ std::istream & deserialize(std::istream & is, std::vector<POD> & v)
 }
 #endif
 
-const BooksDir::EBookRecord * 
+const BooksDir::EBookRecord *
 BooksDir::get_book_data(uint16_t idx)
 {
-  if (idx >= sorted_index.size()) {
+  if (idx >= view.size()) {
     LOG_E("Idx too large: %d", idx);
     return nullptr;
   }
 
-  int i = 0;
-  int16_t index = -1;
-
-  for (auto & entry : sorted_index) {
-    if (idx == i) { index = entry.second.db_index; break; }
-    i++;
-  }
-  if (index == -1) {
-    LOG_E("Unable to find idx: %d", idx);
-    return nullptr;
-  }
+  int16_t index = books[view[idx]]->second.db_index;
 
   db.set_current_idx(index);
 
@@ -242,36 +236,39 @@ BooksDir::get_book_data(uint16_t idx)
 bool
 BooksDir::get_book_id(uint16_t idx, uint32_t & id)
 {
-  if (idx >= sorted_index.size()) {
+  if (idx >= view.size()) {
     LOG_E("Idx too large: %d", idx);
     return false;
   }
 
-  int i = 0;
-  bool found = false;
+  id = books[view[idx]]->second.id;
 
-  for (auto & entry : sorted_index) {
-    if (idx == i) { id = entry.second.id; found = true; break; }
-    i++;
-  }
-  if (!found) LOG_E("Unable to find idx: %d", idx);
+  return true;
+}
+
+bool
+BooksDir::get_title_author(uint16_t idx, std::string & title, std::string & author)
+{
+  if (idx >= view.size()) return false;
+
+  title  = books[view[idx]]->first.substr(1);
+  author = books[view[idx]]->second.author;
 
-  return found;
+  return true;
 }
 
 bool
 BooksDir::get_book_index(uint32_t id, uint16_t & idx)
 {
-  int  i     = 0;
-  bool found = false;
+  int16_t i = get_sorted_idx_from_id(id);
 
-  for (auto & entry : sorted_index) {
-    if (entry.second.id == id) { idx = i; found = true; break; }
-    i++;
+  if (i == -1) {
+    LOG_E("Unable to find id: 0x%08x", id);
+    return false;
   }
-  if (!found) LOG_E("Unable to find id: 0x%08x", id);
 
-  return found;
+  idx = i;
+  return true;
 }
 
 void
@@ -281,25 +278,27 @@ BooksDir::set_track_order(uint32_t id, int8_t pos)
   if (no_recurse) return;
 
   LOG_D("-------------------------> set_track_order(%u, %d)", id, pos);
-  bool found = false;
-
-  for (auto & entry : sorted_index) {
-    if (entry.second.id == id) {
-      char ch = (pos >= 0) ? 'a' + pos : 'z';
-      LOG_D("Old key: %s", entry.first.c_str());
-      if (entry.first.front() != ch) {
-        auto e = sorted_index.extract(entry.first);
-        e.key().front() = ch;
-        LOG_D("New key: %s", e.key().c_str());
-        sorted_index.insert(std::move(e));
-      }
-      found = true;
-      break;
+  auto it    = positions.find(id);
+  bool found = it != positions.end();
+
+  if (found) {
+    SortedIndex::const_iterator entry = books[it->second];
+    char ch = (pos >= 0) ? 'a' + pos : 'z';
+    LOG_D("Old key: %s", entry->first.c_str());
+    if (entry->first.front() != ch) {
+      auto e = sorted_index.extract(entry);
+      e.key().front() = ch;
+      LOG_D("New key: %s", e.key().c_str());
+      sorted_index.insert(std::move(e));
+      build_positions();
     }
   }
 
+  // The directory is not loaded yet after a resume from deep sleep.
+  // Books not found can't be considered as removed.
+
   #if EPUB_INKPLATE_BUILD
-    if (!found) {
+    if (!found && !sorted_index.empty()) {
       no_recurse = true;
       nvs_mgr.erase(id);
       no_recurse = false;
@@ -322,6 +321,444 @@ BooksDir::get_book_data_from_db_index(uint16_t idx)
   return &book;
 }
 
+void
+BooksDir::set_cover(EBookRecord * the_book, Image * img)
+{
+  if (img == nullptr) {
+    memcpy(the_book->cover_bitmap, default_cover, default_cover_width * default_cover_height);
+    the_book->cover_width     = default_cover_width;
+    the_book->cover_height    = default_cover_height;
+  }
+  else {
+    LOG_D("Image: width: %d height: %d", img->get_dim().width, img->get_dim().height);
+
+    int32_t w = max_cover_width;
+    int32_t h = img->get_dim().height * max_cover_width / img->get_dim().width;
+
+    if (h > max_cover_height) {
+      h = max_cover_height;
+      w = img->get_dim().width * max_cover_height / img->get_dim().height;
+    }
+
+    img->resize(Dim(w, h));
+    memcpy(the_book->cover_bitmap, img->get_bitmap(), w * h);
+
+    the_book->cover_width     = w;
+    the_book->cover_height    = h;
+
+    delete img;
+  }
+}
+
+void
+BooksDir::index_book(const char * title, uint32_t id, const char * author, uint16_t db_index)
+{
+  #if EPUB_INKPLATE_BUILD
+    int8_t pos = nvs_mgr.get_pos(id);
+    std::string key = " ";
+    key += title;
+    key.front() = (pos >= 0) ? 'a' + pos : 'z';
+  #else
+    std::string key = "z";
+    key += title;
+  #endif
+  sorted_index[key] = IndexInfo {
+    .id       = id,
+    .db_index = db_index,
+    .author   = author };
+}
+
+void
+BooksDir::index_book(const EBookRecord * the_book, uint16_t db_index)
+{
+  index_book(the_book->title, the_book->id, the_book->author, db_index);
+}
+
+void
+BooksDir::add_words(const std::string & text, uint16_t db_index, std::vector<WordRef> & refs)
+{
+  std::string term;
+
+  SearchIndex::for_each_term(text.c_str(), text.size(), term, [db_index, &refs](std::string & t) {
+    refs.push_back(WordRef { .word = t, .db_index = db_index });
+  }, 1);
+}
+
+// The position of the books in the primary index, after a change in it
+
+void
+BooksDir::build_positions()
+{
+  books.clear();
+  books.reserve(sorted_index.size());
+  positions.clear();
+  db_positions.clear();
+
+  for (auto it = sorted_index.cbegin(); it != sorted_index.cend(); it++) {
+    uint16_t pos = books.size();
+    books.push_back(it);
+    positions[it->second.id] = pos;
+    if (it->second.db_index >= db_positions.size()) db_positions.resize(it->second.db_index + 1, -1);
+    db_positions[it->second.db_index] = pos;
+  }
+
+  build_view();
+}
+
+// The author and words indexes, after books have been added or removed
+
+void
+BooksDir::build_secondary_indexes()
+{
+  std::vector<std::string> author_keys(db_positions.size());
+  std::vector<std::string> title_keys(db_positions.size());
+  std::string              term;
+
+  words.clear();
+  by_author.clear();
+
+  for (auto & entry : books) {
+    uint16_t db_index = entry->second.db_index;
+    std::string title = entry->first.substr(1);
+
+    add_words(title,                db_index, words);
+    add_words(entry->second.author, db_index, words);
+
+    SearchIndex::for_each_term(entry->second.author.c_str(), entry->second.author.size(), term,
+      [&author_keys, db_index](std::string & t) { author_keys[db_index] += t; author_keys[db_index] += ' '; }, 1);
+    SearchIndex::for_each_term(title.c_str(), title.size(), term,
+      [&title_keys, db_index](std::string & t) { title_keys[db_index] += t; title_keys[db_index] += ' '; }, 1);
+
+    by_author.push_back(db_index);
+  }
+
+  std::sort(words.begin(), words.end(), [](const WordRef & a, const WordRef & b) {
+    return (a.word < b.word) || ((a.word == b.word) && (a.db_index < b.db_index));
+  });
+  words.erase(std::unique(words.begin(), words.end(), [](const WordRef & a, const WordRef & b) {
+    return (a.word == b.word) && (a.db_index == b.db_index);
+  }), words.end());
+
+  std::sort(by_author.begin(), by_author.end(), [&author_keys, &title_keys](uint16_t a, uint16_t b) {
+    int res = author_keys[a].compare(author_keys[b]);
+    return (res < 0) || ((res == 0) && (title_keys[a] < title_keys[b]));
+  });
+}
+
+void
+BooksDir::build_view()
+{
+  std::vector<std::string> terms;
+  std::string              term;
+  std::vector<bool>        selected;
+
+  SearchIndex::for_each_term(query.c_str(), query.size(), term, [&terms](std::string & t) {
+    terms.push_back(t);
+  }, 1);
+
+  // The books having, for each term of the query, a word beginning with it
+
+  if (!terms.empty()) {
+    std::vector<bool> found;
+
+    selected.assign(db_positions.size(), true);
+    for (auto & t : terms) {
+      found.assign(db_positions.size(), false);
+      auto it = std::lower_bound(words.begin(), words.end(), t, [](const WordRef & ref, const std::string & t) {
+        return ref.word < t;
+      });
+      while ((it != words.end()) && (it->word.compare(0, t.size(), t) == 0)) {
+        if (it->db_index < found.size()) found[it->db_index] = true;
+        it++;
+      }
+      for (uint16_t i = 0; i < selected.size(); i++) selected[i] = selected[i] && found[i];
+    }
+  }
+
+  auto in_view = [&selected](uint16_t db_index) {
+    return selected.empty() || ((db_index < selected.size()) && selected[db_index]);
+  };
+
+  view.clear();
+  switch (order) {
+    case Order::TITLE:
+      for (uint16_t pos = 0; pos < books.size(); pos++) {
+        if (in_view(books[pos]->second.db_index)) view.push_back(pos);
+      }
+      break;
+
+    case Order::AUTHOR:
+      for (uint16_t db_index : by_author) {
+        if ((db_index < db_positions.size()) && (db_positions[db_index] != -1) && in_view(db_index)) {
+          view.push_back(db_positions[db_index]);
+        }
+      }
+      break;
+
+    case Order::RECENT:
+      // The recently read books are first in the primary index, with a key
+      // not beginning with 'z'
+      for (uint16_t pos = 0; pos < books.size(); pos++) {
+        if ((books[pos]->first.front() != 'z') && in_view(books[pos]->second.db_index)) view.push_back(pos);
+      }
+      break;
+  }
+
+  view_idx.assign(books.size(), -1);
+  for (uint16_t idx = 0; idx < view.size(); idx++) view_idx[view[idx]] = idx;
+}
+
+void
+BooksDir::set_view(Order the_order, const std::string & the_query)
+{
+  order = the_order;
+  query = the_query;
+
+  build_view();
+}
+
+static bool
+write_string(FILE * file, const std::string & str)
+{
+  uint8_t size = (str.size() > 255) ? 255 : str.size();
+  return (fwrite(&size, 1, 1, file) == 1) && (fwrite(str.data(), 1, size, file) == size);
+}
+
+static bool
+read_string(FILE * file, std::string & str)
+{
+  uint8_t size;
+  if (fread(&size, 1, 1, file) != 1) return false;
+  str.resize(size);
+  return fread(&str[0], 1, size, file) == size;
+}
+
+bool
+BooksDir::load_index_file(std::vector<BookInfo> & infos)
+{
+  FILE * file = fopen(INDEX_FILE, "rb");
+  if (file == nullptr) return false;
+
+  uint16_t version, record_count, count;
+  uint32_t file_size, word_count;
+  bool     ok = false;
+
+  while (true) {
+    if (fread(&version,      sizeof(version),      1, file) != 1) break;
+    if (fread(&record_count, sizeof(record_count), 1, file) != 1) break;
+    if (fread(&file_size,    sizeof(file_size),    1, file) != 1) break;
+
+    // Only valid with the database it was saved with
+
+    if ((version      != BOOKS_DIR_INDEX_VERSION) ||
+        (record_count != db.get_record_count()  ) ||
+        (file_size    != db.get_file_size()     )) break;
+
+    if (fread(&count, sizeof(count), 1, file) != 1) break;
+    infos.resize(count);
+    uint16_t i;
+    for (i = 0; i < count; i++) {
+      BookInfo & info = infos[i];
+      if (fread(&info.db_index,  sizeof(info.db_index),  1, file) != 1) break;
+      if (fread(&info.id,        sizeof(info.id),        1, file) != 1) break;
+      if (fread(&info.file_size, sizeof(info.file_size), 1, file) != 1) break;
+      if (!read_string(file, info.filename) ||
+          !read_string(file, info.title   ) ||
+          !read_string(file, info.author  )) break;
+      if (info.db_index >= record_count) break;
+    }
+    if (i < count) break;
+
+    if (fread(&count, sizeof(count), 1, file) != 1) break;
+    by_author.resize(count);
+    if (fread(by_author.data(), sizeof(uint16_t), count, file) != count) break;
+
+    if (fread(&word_count, sizeof(word_count), 1, file) != 1) break;
+    words.resize(word_count);
+    uint32_t j;
+    for (j = 0; j < word_count; j++) {
+      if (!read_string(file, words[j].word)) break;
+      if (fread(&words[j].db_index, sizeof(words[j].db_index), 1, file) != 1) break;
+    }
+    ok = j == word_count;
+    break;
+  }
+
+  fclose(file);
+
+  if (!ok) {
+    LOG_I("Books directory index file not valid. Reading the database...");
+    infos.clear();
+    by_author.clear();
+    words.clear();
+  }
+
+  return ok;
+}
+
+bool
+BooksDir::save_index_file()
+{
+  FILE * file = fopen(INDEX_FILE, "wb");
+  if (file == nullptr) {
+    LOG_E("Unable to create the books directory index file.");
+    return false;
+  }
+
+  // The books infos not present in sorted_index are read from the database
+  // records, skipping the cover bitmaps.
+
+  struct PartialRecord {
+    char     filename[FILENAME_SIZE];
+    int32_t  file_size;
+  } partial_record;
+
+  uint16_t version      = BOOKS_DIR_INDEX_VERSION;
+  uint16_t record_count = db.get_record_count();
+  uint32_t file_size    = db.get_file_size();
+  uint16_t count        = books.size();
+  uint32_t word_count   = words.size();
+  bool     ok           = false;
+
+  while (true) {
+    if (fwrite(&version,      sizeof(version),      1, file) != 1) break;
+    if (fwrite(&record_count, sizeof(record_count), 1, file) != 1) break;
+    if (fwrite(&file_size,    sizeof(file_size),    1, file) != 1) break;
+    if (fwrite(&count,        sizeof(count),        1, file) != 1) break;
+
+    uint16_t i;
+    for (i = 0; i < count; i++) {
+      const IndexInfo & info = books[i]->second;
+      db.set_current_idx(info.db_index);
+      if (!db.get_partial_record(&partial_record, sizeof(partial_record), 0)) break;
+      if (fwrite(&info.db_index,              sizeof(info.db_index),              1, file) != 1) break;
+      if (fwrite(&info.id,                    sizeof(info.id),                    1, file) != 1) break;
+      if (fwrite(&partial_record.file_size,   sizeof(partial_record.file_size),   1, file) != 1) break;
+      if (!write_string(file, partial_record.filename) ||
+          !write_string(file, books[i]->first.substr(1)) ||
+          !write_string(file, info.author)) break;
+    }
+    if (i < count) break;
+
+    count = by_author.size();
+    if (fwrite(&count, sizeof(count), 1, file) != 1) break;
+    if (fwrite(by_author.data(), sizeof(uint16_t), count, file) != count) break;
+
+    if (fwrite(&word_count, sizeof(word_count), 1, file) != 1) break;
+    uint32_t j;
+    for (j = 0; j < word_count; j++) {
+      if (!write_string(file, words[j].word)) break;
+      if (fwrite(&words[j].db_index, sizeof(words[j].db_index), 1, file) != 1) break;
+    }
+    ok = j == word_count;
+    break;
+  }
+
+  if (fclose(file) != 0) ok = false;
+  if (!ok) {
+    LOG_E("Unable to save the books directory index file.");
+    remove(INDEX_FILE);
+  }
+
+  return ok;
+}
+
+bool
+BooksDir::add_book(const char * filename, const EPub::Metadata & metadata)
+{
+  std::string fname = BOOKS_FOLDER "/";
+  fname.append(filename);
+
+  struct stat stat_buffer;
+  if (stat(fname.c_str(), &stat_buffer) != 0) {
+    LOG_E("Unable to get stats for file: %s", fname.c_str());
+    return false;
+  }
+
+  if (!db.is_db_open()) return false;
+
+  EBookRecord * the_book = (EBookRecord *) allocate(sizeof(EBookRecord));
+  if (the_book == nullptr) {
+    LOG_E("Not enough memory for new book: %d bytes required.", sizeof(EBookRecord));
+    return false;
+  }
+
+  memset(the_book, 0, sizeof(EBookRecord));
+
+  strlcpy(the_book->filename,    filename,                     FILENAME_SIZE   );
+  strlcpy(the_book->title,       metadata.title.c_str(),       TITLE_SIZE      );
+  strlcpy(the_book->author,      metadata.author.c_str(),      AUTHOR_SIZE     );
+  strlcpy(the_book->description, metadata.description.c_str(), DESCRIPTION_SIZE);
+  the_book->file_size = stat_buffer.st_size;
+  the_book->id        = generate_id((uint8_t *)the_book->filename, strlen(the_book->filename));
+
+  // A previous version of the book, deleted since the last refresh, is
+  // removed from the list. Its database record is reused for the new one.
+
+  int32_t db_index = -1;
+  for (auto it = sorted_index.begin(); it != sorted_index.end(); ) {
+    if (it->second.id == the_book->id) {
+      db_index = it->second.db_index;
+      it = sorted_index.erase(it);
+    }
+    else it++;
+  }
+
+  // The image decoders read through unzip: the cover is retrieved from 
+  // the stored file, without opening the book through the EPub class.
+
+  Image * img = nullptr;
+  if (!metadata.cover_filename.empty() && unzip.open_zip_file(fname.c_str())) {
+    img = ImageFactory::create(metadata.cover_filename, 
+                               Dim(Screen::get_width(), Screen::get_height()), 
+                               true);
+    if ((img != nullptr) &&
+        ((img->get_bitmap()     == nullptr) ||
+         (img->get_dim().height == 0) ||
+         (img->get_dim().width  == 0))) {
+      delete img;
+      img = nullptr;
+    }
+    if (img == nullptr) {
+      LOG_D("Unable to retrieve cover file: %s", metadata.cover_filename.c_str());
+    }
+    set_cover(the_book, img);
+    unzip.close_zip_file();
+  }
+  else {
+    set_cover(the_book, nullptr);
+  }
+
+  bool completed;
+  if (db_index >= 0) {
+    db.set_current_idx(db_index);
+    completed = db.replace_record(the_book, sizeof(EBookRecord));
+  }
+  else {
+    completed = db.add_record(the_book, sizeof(EBookRecord));
+    db_index = db.get_record_count() - 1;
+  }
+
+  if (completed) {
+    index_book(the_book, db_index);
+
+    db.close(); // To ensure that data is well written on SD Card
+    completed = db.open(BOOKS_DIR_FILE);
+
+    build_positions();
+    build_secondary_indexes();
+    if (completed) save_index_file();
+    build_view();
+  }
+  else {
+    LOG_E("Unable to add a new record to DB file.");
+  }
+
+  free(the_book);
+
+  return completed;
+}
+
 bool
 BooksDir::refresh(char * book_filename, int16_t & book_index, bool force_init)
 {
@@ -338,6 +775,8 @@ BooksDir::refresh(char * book_filename, int16_t & book_index, bool force_init)
   SortedIndex     temp_index;
 
   bool some_added_record = false;
+  bool index_loaded      = false;
+  bool some_removed_record;
 
   sorted_index.clear();
 
@@ -349,61 +788,73 @@ BooksDir::refresh(char * book_filename, int16_t & book_index, bool force_init)
     }
   }
   else {
-    struct PartialRecord {
-      char     filename[FILENAME_SIZE];
-      int32_t  file_size;
-      uint32_t id;
-      char     title[TITLE_SIZE];
-    } * partial_record = (PartialRecord *) allocate(sizeof(PartialRecord));
-
-    if (partial_record == nullptr) msg_viewer.out_of_memory("partial record allocation");
-    
-    db.goto_first(); // Go pass the DB version record
+    // The books list is taken from the index file when it was saved with
+    // the current database. If not, the records are read.
+
+    std::vector<BookInfo> infos;
+
+    index_loaded = load_index_file(infos);
+
+    if (!index_loaded) {
+      struct PartialRecord {
+        char     filename[FILENAME_SIZE];
+        int32_t  file_size;
+        uint32_t id;
+        char     title[TITLE_SIZE];
+        char     author[AUTHOR_SIZE];
+      } * partial_record = (PartialRecord *) allocate(sizeof(PartialRecord));
+
+      if (partial_record == nullptr) msg_viewer.out_of_memory("partial record allocation");
+
+      db.goto_first(); // Go pass the DB version record
+
+      while (db.goto_next()) {
+        db.get_record(partial_record, sizeof(PartialRecord));
+        infos.push_back(BookInfo {
+          .db_index  = db.get_current_idx(),
+          .id        = partial_record->id,
+          .file_size = partial_record->file_size,
+          .filename  = partial_record->filename,
+          .title     = partial_record->title,
+          .author    = partial_record->author });
+      }
 
-    while (db.goto_next()) {
-      db.get_record(partial_record, sizeof(PartialRecord));
+      free(partial_record);
+    }
 
+    for (auto & info : infos) {
       std::string fname = BOOKS_FOLDER "/";
-      fname.append(partial_record->filename);
+      fname.append(info.filename);
 
       struct stat stat_buffer;   
 
       // if file with filename not found or the file size is not the same, 
       // remove the database entry
       if ((stat(fname.c_str(), &stat_buffer) != 0) || 
-          (stat_buffer.st_size != partial_record->file_size)) {
-        LOG_D("Book no longer available: %s", partial_record->filename);
+          (stat_buffer.st_size != info.file_size)) {
+        LOG_D("Book no longer available: %s", info.filename.c_str());
+        db.set_current_idx(info.db_index);
         db.set_deleted();
       }
       else {
-        LOG_D("Title: %s", partial_record->title);
-        temp_index[partial_record->filename] = IndexInfo { 
-          .id = 0, 
-          .db_index = 0 }; 
-
-        #if EPUB_INKPLATE_BUILD
-          int8_t pos = nvs_mgr.get_pos(partial_record->id);
-          std::string title = " ";
-          title += partial_record->title;
-          title.front() = (pos >= 0) ? 'a' + pos : 'z';
-        #else
-          std::string title = "z";
-          title += partial_record->title;
-        #endif
-
-        sorted_index[title] = IndexInfo {
-          .id      = partial_record->id,
-          .db_index = db.get_current_idx() };
+        LOG_D("Title: %s", info.title.c_str());
+        temp_index[info.filename] = IndexInfo { 
+          .id       = 0, 
+          .db_index = 0,
+          .author   = "" }; 
+
+        index_book(info.title.c_str(), info.id, info.author.c_str(), info.db_index);
+
         if (book_filename) {
-          if (strcmp(book_filename, partial_record->filename) == 0) book_index = db.get_current_idx();
+          if (strcmp(book_filename, info.filename.c_str()) == 0) book_index = info.db_index;
         }
       }
     }
-    
-    free(partial_record);
   }
 
-  if (db.is_some_record_deleted()) {
+  some_removed_record = db.is_some_record_deleted();
+
+  if (some_removed_record) {
 
     // Some record have been deleted. We have to recreate a database
     // with the cleaned records
@@ -440,18 +891,7 @@ BooksDir::refresh(char * book_filename, int16_t & book_index, bool force_init)
         }
         if (!first) {
           uint16_t idx = new_db->get_record_count() - 1;
-          #if EPUB_INKPLATE_BUILD
-            int8_t pos = nvs_mgr.get_pos(data->id);
-            std::string title = " ";
-            title += data->title;
-            title.front() = (pos >= 0) ? 'a' + pos : 'z';
-          #else
-            std::string title = "z";
-            title += data->title;
-          #endif
-          sorted_index[title] = IndexInfo {
-            .id       = data->id,
-            .db_index = idx };
+          index_book(data->title, data->id, data->author, idx);
           if (book_filename) {
             if (strcmp(book_filename, data->filename) == 0) book_index = new_db->get_record_count() - 1;
           }
@@ -565,60 +1005,14 @@ BooksDir::refresh(char * book_filename, int16_t & book_index, bool force_init)
 
             std::string filename = epub.get_cover_filename();
 
-            if (!filename.empty()) {
-
-              // LOG_D("Cover filename: %s", filename);
-              Image * img = epub.get_image(filename, true);
-              if (img == nullptr) {
-                LOG_D("Unable to retrieve cover file: %s", filename.c_str());
-                memcpy(the_book->cover_bitmap, default_cover, default_cover_width * default_cover_height);
-                the_book->cover_width     = default_cover_width;
-                the_book->cover_height    = default_cover_height;
-              }
-              else {
-                LOG_D("Image: width: %d height: %d", img->get_dim().width, img->get_dim().height);
-
-                int32_t w = max_cover_width;
-                int32_t h = img->get_dim().height * max_cover_width / img->get_dim().width;
-
-                if (h > max_cover_height) {
-                  h = max_cover_height;
-                  w = img->get_dim().width * max_cover_height / img->get_dim().height;
-                }
-
-                img->resize(Dim(w, h));
-                memcpy(the_book->cover_bitmap, img->get_bitmap(), w * h);
-
-                the_book->cover_width     = w;
-                the_book->cover_height    = h;
-
-                delete img;
-              }
-            }
-            else {
-              memcpy(the_book->cover_bitmap, default_cover, default_cover_width * default_cover_height);
-              the_book->cover_width     = default_cover_width;
-              the_book->cover_height    = default_cover_height;
-            }
+            set_cover(the_book, filename.empty() ? nullptr : epub.get_image(filename, true));
         
             if (!db.add_record(the_book, sizeof(EBookRecord))) {
               LOG_E("Unable to add a new record to DB file.");
               goto error_clear;
             }
 
-            uint16_t idx = db.get_record_count() - 1;
-            #if EPUB_INKPLATE_BUILD
-              int8_t pos = nvs_mgr.get_pos(the_book->id);
-              std::string title = " ";
-              title += the_book->title;
-              title.front() = (pos >= 0) ? 'a' + pos : 'z';
-            #else
-              std::string title = "z";
-              title += the_book->title;
-            #endif
-            sorted_index[title] = {
-              .id       = the_book->id,
-              .db_index = idx };
+            index_book(the_book, db.get_record_count() - 1);
 
             if (book_filename) {
               if (strcmp(book_filename, the_book->filename) == 0) book_index = db.get_record_count() - 1;
@@ -650,6 +1044,16 @@ BooksDir::refresh(char * book_filename, int16_t & book_index, bool force_init)
     }
   }
 
+  // The secondary indexes loaded from the index file are kept when no
+  // book was added or removed.
+
+  build_positions();
+  if (!index_loaded || some_added_record || some_removed_record) {
+    build_secondary_indexes();
+    save_index_file();
+    build_view();
+  }
+
   return true;
 
 error_clear:
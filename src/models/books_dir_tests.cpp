@@ -0,0 +1,67 @@
+#if TESTING && EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "gtest/gtest.h"
+#include "models/books_dir.hpp"
+
+#include <sys/stat.h>
+
+static std::vector<std::string>
+titles_of(BooksDir::Order order, const std::string & query)
+{
+  std::vector<std::string> titles;
+  std::string              title, author;
+
+  books_dir.set_view(order, query);
+  for (int16_t idx = 0; idx < books_dir.get_book_count(); idx++) {
+    if (books_dir.get_title_author(idx, title, author)) titles.push_back(title);
+  }
+  return titles;
+}
+
+TEST(BooksDirTest, books_filtered_by_prefixes) {
+  int16_t dummy;
+  struct stat stat_buffer;
+
+  remove(MAIN_FOLDER "/books_dir.idx");
+  ASSERT_TRUE(books_dir.read_books_directory(nullptr, dummy));
+  EXPECT_EQ(stat(MAIN_FOLDER "/books_dir.idx", &stat_buffer), 0);
+
+  std::vector<std::string> all = titles_of(BooksDir::Order::TITLE, "");
+  ASSERT_GE(all.size(), 2);
+
+  EXPECT_EQ(titles_of(BooksDir::Order::TITLE, "PRIDE"),  std::vector<std::string>({ "Pride and Prejudice" }));
+  EXPECT_EQ(titles_of(BooksDir::Order::TITLE, "aus pr"), titles_of(BooksDir::Order::TITLE, "prej"));
+  EXPECT_EQ(titles_of(BooksDir::Order::TITLE, "prej").size(), 2);   // Prejudice, préjugés
+  EXPECT_TRUE(titles_of(BooksDir::Order::TITLE, "austen xylophone").empty());
+  EXPECT_EQ(titles_of(BooksDir::Order::AUTHOR, "").size(), all.size());
+
+  // The indexes are retrieved from the index file the next time
+
+  std::vector<std::string> pride = titles_of(BooksDir::Order::AUTHOR, "pride");
+
+  books_dir.close_db();
+  ASSERT_TRUE(books_dir.read_books_directory(nullptr, dummy));
+  EXPECT_EQ(titles_of(BooksDir::Order::AUTHOR, "pride"), pride);
+  EXPECT_EQ(titles_of(BooksDir::Order::TITLE,  ""),      all);
+}
+
+TEST(BooksDirTest, book_added_again_reuses_its_record) {
+  int16_t dummy;
+  struct stat before, after;
+
+  ASSERT_TRUE(books_dir.read_books_directory(nullptr, dummy));
+  std::vector<std::string> all = titles_of(BooksDir::Order::TITLE, "");
+  ASSERT_EQ(stat(MAIN_FOLDER "/books_dir.db", &before), 0);
+
+  EPub::Metadata metadata;
+  metadata.title  = "Pride and Prejudice";
+  metadata.author = "Jane Austen";
+
+  ASSERT_TRUE(books_dir.add_book("Austen, Jane - Pride and Prejudice.epub", metadata));
+
+  ASSERT_EQ(stat(MAIN_FOLDER "/books_dir.db", &after), 0);
+  EXPECT_EQ(after.st_size, before.st_size);
+  EXPECT_EQ(titles_of(BooksDir::Order::TITLE, ""), all);
+}
+
+#endif
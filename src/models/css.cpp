@@ -4,12 +4,7 @@
 
 #include "models/css.hpp"
 #include "models/css_parser.hpp"
-
-MemoryPool<CSS::Value>        CSS::value_pool;
-MemoryPool<CSS::Property>     CSS::property_pool;
-MemoryPool<CSS::Properties>   CSS::properties_pool;
-MemoryPool<CSS::SelectorNode> CSS::selector_node_pool;
-MemoryPool<CSS::Selector>     CSS::selector_pool;
+#include "helpers/perf_stats.hpp"
 
 CSS::PropertyMap CSS::property_map = {
   { "not-used",       CSS::PropertyId::NOT_USED       },
@@ -56,7 +51,8 @@ CSS::CSS(const char * css_id,
          const char * file_folder_path, 
          const char * buffer, 
          int32_t      size,
-         uint8_t      prio)  
+         uint8_t      prio,
+         Arena      & scope) : arena("css", &scope), rules_map(*make<ArenaRulesMap>())
 {
   id          = css_id;
   folder_path = file_folder_path;
@@ -71,7 +67,8 @@ CSS::CSS(const char * css_id,
          DOM::Tag     tag,
          const char * buffer, 
          int32_t      size,
-         uint8_t      prio)
+         uint8_t      prio,
+         Arena      & scope) : arena("css", &scope), rules_map(*make<ArenaRulesMap>())
 {
   id          = css_id;
   folder_path = "";
@@ -82,27 +79,6 @@ CSS::CSS(const char * css_id,
   delete parser;
 }
 
-CSS::~CSS()
-{
-  if (ghost) {
-    rules_map.clear();
-  }
-  else {
-    for (auto * props : suites) {
-      for (auto * prop : *props) {
-        property_pool.deleteElement(prop);
-      }
-      properties_pool.deleteElement(props);
-    }
-    suites.clear();
-
-    for (auto & rule : rules_map) {
-      selector_pool.deleteElement(rule.first);
-    }
-    rules_map.clear();
-  }
-}
-
 bool 
 CSS::match_simple_selector(DOM::Node & node, SelectorNode & simple_sel) 
 {
@@ -160,6 +136,8 @@ CSS::match_selector(DOM::Node * node, Selector & sel)
 void 
 CSS::match(DOM::Node * node, RulesMap & to_rules) 
 {
+  PERF_SCOPE(CSS_MATCH);
+
   for (auto & rule : rules_map) {
     if (match_selector(node, *rule.first)) {
       to_rules.insert(std::pair<Selector *, Properties *>(rule.first, rule.second));
@@ -167,19 +145,197 @@ CSS::match(DOM::Node * node, RulesMap & to_rules)
   }
 }
 
-void
-CSS::show(RulesMap & the_rules_map) 
+template <typename T>
+static inline void
+put_value(std::vector<uint8_t> & data, T value)
+{
+  const uint8_t * p = (const uint8_t *) &value;
+  data.insert(data.end(), p, p + sizeof(T));
+}
+
+template <typename T>
+static inline bool
+get_value(const uint8_t * & data, const uint8_t * end, T & value)
+{
+  if ((end - data) < (int32_t) sizeof(T)) return false;
+  memcpy(&value, data, sizeof(T));
+  data += sizeof(T);
+  return true;
+}
+
+static inline bool
+put_count(std::vector<uint8_t> & data, size_t count)
+{
+  if (count > 0xFF) return false;
+  put_value<uint8_t>(data, count);
+  return true;
+}
+
+template <class Str>
+static inline bool
+put_str(std::vector<uint8_t> & data, const Str & str)
+{
+  if (str.size() > 0xFFFF) return false;
+  put_value<uint16_t>(data, str.size());
+  data.insert(data.end(), str.begin(), str.end());
+  return true;
+}
+
+template <class Str>
+static inline bool
+get_str(const uint8_t * & data, const uint8_t * end, Str & str)
+{
+  uint16_t size;
+  if (!get_value(data, end, size) || ((end - data) < size)) return false;
+  str.assign((const char *) data, size);
+  data += size;
+  return true;
+}
+
+bool
+CSS::serialize(std::vector<uint8_t> & data) const
+{
+  std::map<const Properties *, uint16_t> set_indexes;
+  std::vector<const Properties *>        sets;
+
+  data.clear();
+
+  // Selectors of a group share the same property set
+
+  for (auto & rule : rules_map) {
+    if (set_indexes.find(rule.second) == set_indexes.end()) {
+      set_indexes[rule.second] = sets.size();
+      sets.push_back(rule.second);
+    }
+  }
+
+  bool ok = (sets.size() <= 0xFFFF) && (rules_map.size() <= 0xFFFF) && put_str(data, folder_path);
+
+  put_value<uint8_t >(data, priority);
+  put_value<uint16_t>(data, sets.size());
+
+  for (auto * props : sets) {
+    ok = ok && put_count(data, std::distance(props->begin(), props->end()));
+    for (auto * prop : *props) {
+      put_value<uint8_t>(data, (uint8_t) prop->id);
+      ok = ok && put_count(data, std::distance(prop->values.begin(), prop->values.end()));
+      for (auto * v : prop->values) {
+        put_value<uint8_t>(data, (uint8_t) v->value_type);
+        put_value<float  >(data, v->num);
+        put_value(data, v->choice);
+        ok = ok && put_str(data, v->str);
+      }
+    }
+  }
+
+  put_value<uint16_t>(data, rules_map.size());
+
+  for (auto & rule : rules_map) {
+    const Selector * sel = rule.first;
+    put_value<uint32_t>(data, sel->specificity.value);
+    put_value<uint16_t>(data, set_indexes[rule.second]);
+    ok = ok && put_count(data, std::distance(sel->selector_node_list.begin(), sel->selector_node_list.end()));
+    for (auto * node : sel->selector_node_list) {
+      put_value<uint8_t>(data, (uint8_t) node->op);
+      put_value<uint8_t>(data, (uint8_t) node->tag);
+      put_value<uint8_t>(data, (uint8_t) node->qualifier);
+      put_value<uint8_t>(data, node->class_count);
+      put_value<uint8_t>(data, node->id_count);
+      ok = ok && put_str(data, node->id) &&
+                 put_count(data, std::distance(node->class_list.begin(), node->class_list.end()));
+      for (auto & class_name : node->class_list) {
+        ok = ok && put_str(data, class_name);
+      }
+    }
+  }
+
+  if (!ok) data.clear();
+
+  return ok;
+}
+
+bool
+CSS::restore(const uint8_t * data, uint32_t size)
 {
-  #if DEBUGGING
-    std::cout << "------ Rules Map: -----" << std::endl;
-    for (auto & rule : the_rules_map) {
-      rule.first->show();
-      std::cout << " {" << std::endl;
-      for (auto * prop : *rule.second) {
-        prop->show();
+  const uint8_t           * end = data + size;
+  std::vector<Properties *> sets;
+  uint16_t                  count;
+
+  if (!(get_str(data, end, folder_path) &&
+        get_value(data, end, priority)  &&
+        get_value(data, end, count))) return false;
+
+  ghost = false;
+
+  // The lists are rebuilt in the same order as they were saved
+
+  sets.reserve(count);
+  while (count--) {
+    Properties * props = make<Properties>();
+    uint8_t      prop_count;
+
+    if (!get_value(data, end, prop_count)) return false;
+    auto prop_it = props->before_begin();
+    while (prop_count--) {
+      Property * prop = make<Property>();
+      PropertyId id;
+      uint8_t    value_count;
+
+      if (!(get_value(data, end, id) && get_value(data, end, value_count))) return false;
+      prop->id = id;
+      auto value_it = prop->values.before_begin();
+      while (value_count--) {
+        Value   * v = make<Value>();
+        ValueType value_type;
+        float     num;
+
+        if (!(get_value(data, end, value_type) &&
+              get_value(data, end, num)        &&
+              get_value(data, end, v->choice)  &&
+              get_str(data, end, v->str))) return false;
+        v->value_type = value_type;
+        v->num        = num;
+        value_it = prop->values.insert_after(value_it, v);
       }
-      std::cout << "}" << std::endl;
+      prop_it = props->insert_after(prop_it, prop);
     }
-    std::cout << "[END]" << std::endl;
-  #endif
-}
\ No newline at end of file
+    sets.push_back(props);
+  }
+
+  if (!get_value(data, end, count)) return false;
+
+  while (count--) {
+    Selector * sel = make<Selector>();
+    uint32_t   specificity;
+    uint16_t   set_idx;
+    uint8_t    node_count;
+
+    if (!(get_value(data, end, specificity) &&
+          get_value(data, end, set_idx)     &&
+          (set_idx < sets.size())           &&
+          get_value(data, end, node_count))) return false;
+    sel->specificity.value = specificity;
+    auto node_it = sel->selector_node_list.before_begin();
+    while (node_count--) {
+      SelectorNode * node = make<SelectorNode>();
+      uint8_t        class_count;
+
+      if (!(get_value(data, end, node->op)          &&
+            get_value(data, end, node->tag)         &&
+            get_value(data, end, node->qualifier)   &&
+            get_value(data, end, node->class_count) &&
+            get_value(data, end, node->id_count)    &&
+            get_str(data, end, node->id)            &&
+            get_value(data, end, class_count))) return false;
+      auto class_it = node->class_list.before_begin();
+      while (class_count--) {
+        class_it = node->class_list.emplace_after(class_it, node->class_list.get_allocator());
+        if (!get_str(data, end, *class_it)) return false;
+      }
+      node_it = sel->selector_node_list.insert_after(node_it, node);
+    }
+    add_rule(sel, sets[set_idx]);
+  }
+
+  return data == end;
+}
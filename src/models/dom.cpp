@@ -4,8 +4,6 @@
 
 #include "models/dom.hpp"
 
-MemoryPool<DOM::Node> * DOM::node_pool = nullptr;
-
 DOM::Tags DOM::tags
   = {{"p",           Tag::P}, {"div",               Tag::DIV}, {"span", Tag::SPAN}, {"br",   Tag::BREAK}, {"h1",                 Tag::H1},  
      {"h2",         Tag::H2}, {"h3",                 Tag::H3}, {"h4",     Tag::H4}, {"h5",      Tag::H5}, {"h6",                 Tag::H6}, 
@@ -13,6 +13,10 @@
 #include "viewers/msg_viewer.hpp"
 #include "viewers/book_viewer.hpp"
 #include "helpers/unzip.hpp"
+#include "models/item_cache.hpp"
+#include "models/page_cache.hpp"
+#include "models/style_cache.hpp"
+#include "helpers/perf_stats.hpp"
 
 #include "logging.hpp"
 #if EPUB_INKPLATE_BUILD
@@ -25,6 +29,9 @@
 #include <iterator>
 #include <algorithm>
 #include <cctype>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace pugi;
 
@@ -105,15 +112,15 @@ xml_node one_by_attr(xml_node n, const char * name1, const char * name2, const c
   return res;
 }
 
+Arena EPub::book_arena("book");
+
 EPub::EPub()
 {
-  opf_data               = nullptr;
-  encryption_data        = nullptr;
-  current_item_info.data = nullptr;
-  file_is_open           = false;
-  fonts_size_too_large   = false;
-  fonts_size             = 0;
-  current_itemref        = xml_node(NULL);
+  encryption_data             = nullptr;
+  file_is_open                = false;
+  fonts_size_too_large        = false;
+  fonts_size                  = 0;
+  css_cache                   = std::make_shared<const CSSRefs>();
   opf_base_path.clear();
   current_filename.clear();
 }
@@ -228,14 +235,24 @@ EPub::get_encryption_xml()
 bool
 EPub::get_opf_filename(std::string & filename)
 {
-  int          err = 0;
   char       * data;
   uint32_t     size;
 
   // A file named 'META-INF/container.xml' must be present and point to the OPF file
   LOG_D("Check container.xml.");
   if (!(data = unzip.get_file("META-INF/container.xml", size))) return false;
-  
+
+  bool completed = get_rootfile(data, size, filename);
+
+  free(data);
+
+  return completed;
+}
+
+bool
+EPub::get_rootfile(char * data, uint32_t size, std::string & filename)
+{
+  int             err = 0;
   xml_document    doc;
   xml_node        node;
   xml_attribute   attr;
@@ -243,7 +260,6 @@ EPub::get_opf_filename(std::string & filename)
   xml_parse_result res = doc.load_buffer_inplace(data, size);
   if (res.status != status_ok) {
     LOG_E("xml load error: %d", res.status);
-    free(data);
     return false;
   }
 
@@ -264,7 +280,6 @@ EPub::get_opf_filename(std::string & filename)
   }
 
   doc.reset(); 
-  free(data);
 
   return completed;
 }
@@ -272,17 +287,9 @@ EPub::get_opf_filename(std::string & filename)
 std::string
 EPub::get_unique_identifier()
 {
-  xml_attribute attr;
-  xml_node      node, node2;
-  const char  * id;
-
-  if ((node  = opf.find_child(package_pred)) &&
-      (id    = node.attribute("unique-identifier").value()) &&
-      (node2 = node.find_child(metadata_pred)) &&
-      (node2.find_child_by_attribute("dc:identifier", "id", id))) {
-    return node2.text().get();
-  }
-  return "";
+  PackageSnapshot pkg = get_package();
+
+  return (pkg == nullptr) ? "" : pkg->unique_identifier;
 }
 
 uint8_t 
@@ -367,31 +374,53 @@ EPub::get_keys()
   return true;
 }
 
+bool
+EPub::retrieve_package(const std::string & epub_filename, const std::string & opf_filename)
+{
+  uint32_t size, crc;
+  uint16_t method;
+
+  if (!unzip.get_file_info(opf_filename.c_str(), size, crc, method)) {
+    LOG_E("OPF file not found: %s", opf_filename.c_str());
+    return false;
+  }
+
+  std::shared_ptr<Package> pkg = std::make_shared<Package>();
+
+  if (!load_package(epub_filename, crc, *pkg)) {
+    *pkg = Package();
+    if (!build_package(opf_filename, *pkg)) return false;
+    save_package(epub_filename, crc, *pkg);
+  }
+
+  std::atomic_store(&package, PackageSnapshot(pkg));
+  return true;
+}
+
 bool 
-EPub::get_opf(std::string & filename)
+EPub::build_package(const std::string & filename, Package & pkg)
 {
   int err = 0;
   uint32_t size;
 
+  xml_document  opf;
   xml_node      node;
   xml_attribute attr;
+  char *        opf_data;
 
-  bool completed = false;
-  while (!completed) {
-    extract_path(filename.c_str(), opf_base_path);
-    LOG_D("opf_base_path: %s", opf_base_path.c_str());
+  PERF_SCOPE(XML_PARSE);
 
-    if (!(opf_data = unzip.get_file(filename.c_str(), size))) ERR(6);
+  if (!(opf_data = unzip.get_file(filename.c_str(), size))) return false;
 
-    xml_parse_result res = opf.load_buffer_inplace(opf_data, size);
-    if (res.status != status_ok) {
-      LOG_E("xml load error: %d", res.status);
-      opf.reset();
-      free(opf_data);
-      opf_data = nullptr;
-      return false;
-    }
+  xml_parse_result res = opf.load_buffer_inplace(opf_data, size);
+  if (res.status != status_ok) {
+    LOG_E("xml load error: %d", res.status);
+    free(opf_data);
+    return false;
+  }
 
+  bool completed = false;
+  while (!completed) {
     // Verifie that the OPF is of one of the version understood by this application
     if (!((node = opf.find_child(package_pred)) && 
           (attr = node.find_attribute(xmlns_pred)) &&
@@ -401,25 +430,187 @@ EPub::get_opf(std::string & filename)
            (strcmp(attr.value(), "2.0") == 0) || 
            (strcmp(attr.value(), "3.0") == 0)))) {
       LOG_E("This book is not compatible with this software.");
-      break;
+      ERR(1);
+    }
+
+    xml_node     metadata = node.find_child(metadata_pred);
+    const char * id       = node.attribute("unique-identifier").value();
+    xml_node     ident;
+
+    if (metadata && (ident = metadata.find_child_by_attribute("dc:identifier", "id", id))) {
+      pkg.unique_identifier = ident.text().get();
+    }
+    pkg.title          = metadata.child_value("dc:title");
+    pkg.author         = metadata.child_value("dc:creator");
+    pkg.description    = metadata.child_value("dc:description");
+    pkg.cover_filename = find_cover(node);
+
+    for (auto n : node.find_child(manifest_pred).children()) {
+      if (!item_pred(n)) continue;
+      ManifestItem item = {
+        .href       = n.attribute("href").value(),
+        .properties = n.attribute("properties").value(),
+        .media_type = media_type_of(n.attribute("media-type").value())
+      };
+      pkg.ids.insert(std::make_pair(n.attribute("id").value(), (int16_t) pkg.manifest.size()));
+      pkg.manifest.push_back(item);
+    }
+
+    // Entries are kept in the same order as the spine children, such that the
+    // indexes are the same as the ones used by the pages location.
+
+    for (auto n : node.find_child(spine_pred).children()) {
+      auto    it  = pkg.ids.find(n.attribute("idref").value());
+      int16_t idx = (it == pkg.ids.end()) ? -1 : it->second;
+      if (idx >= 0) pkg.hrefs.insert(std::make_pair(pkg.manifest[idx].href, (int16_t) pkg.spine.size()));
+      pkg.spine.push_back(idx);
     }
 
     completed = true;
   }
 
   if (!completed) {
-    LOG_E("EPub get_opf error: %d", err);
-    opf.reset();
-    free(opf_data);
+    LOG_E("EPub build_package error: %d", err);
   }
- 
-  LOG_D("get_opf() completed.");
+
+  opf.reset();
+  free(opf_data);
+
+  LOG_D("build_package() completed: %d manifest items, %d spine items.", 
+        (int) pkg.manifest.size(), (int) pkg.spine.size());
 
   return completed;
 }
 
-std::string 
-EPub::filename_locate(const char * fname)
+static bool
+read_str(std::ifstream & file, std::string & str)
+{
+  uint16_t size;
+
+  if (file.read(reinterpret_cast<char *>(&size), sizeof(size)).fail()) return false;
+  str.resize(size);
+  return !file.read(&str[0], size).fail();
+}
+
+static bool
+write_str(std::ofstream & file, const std::string & str)
+{
+  uint16_t size = str.size();
+
+  if (file.write(reinterpret_cast<const char *>(&size), sizeof(size)).fail()) return false;
+  return !file.write(str.data(), size).fail();
+}
+
+bool
+EPub::load_package(const std::string & epub_filename, uint32_t opf_crc, Package & pkg)
+{
+  std::string   filename = epub_filename.substr(0, epub_filename.find_last_of('.')) + ".pkg";
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+
+  if (!file.is_open()) return false;
+
+  int8_t   version;
+  uint32_t crc;
+  uint16_t count;
+
+  bool ok = false;
+  while (true) {
+    if (file.read(reinterpret_cast<char *>(&version), 1).fail()) break;
+    if (version != PKG_FILE_VERSION) break;
+    if (file.read(reinterpret_cast<char *>(&crc), sizeof(crc)).fail()) break;
+    if (crc != opf_crc) break;
+
+    if (!(read_str(file, pkg.unique_identifier) &&
+          read_str(file, pkg.title            ) &&
+          read_str(file, pkg.author           ) &&
+          read_str(file, pkg.description      ) &&
+          read_str(file, pkg.cover_filename   ))) break;
+
+    if (file.read(reinterpret_cast<char *>(&count), sizeof(count)).fail()) break;
+    pkg.manifest.resize(count);
+    for (int16_t idx = 0; idx < count; idx++) {
+      ManifestItem & item = pkg.manifest[idx];
+      std::string    id;
+      if (!(read_str(file, id) && read_str(file, item.href) && read_str(file, item.properties))) break;
+      if (file.read(reinterpret_cast<char *>(&item.media_type), sizeof(item.media_type)).fail()) break;
+      pkg.ids.insert(std::make_pair(id, idx));
+    }
+    if (file.fail()) break;
+
+    if (file.read(reinterpret_cast<char *>(&count), sizeof(count)).fail()) break;
+    pkg.spine.resize(count);
+    if (file.read(reinterpret_cast<char *>(pkg.spine.data()), count * sizeof(int16_t)).fail()) break;
+
+    ok = true;
+    for (int16_t idx = 0; idx < count; idx++) {
+      if (pkg.spine[idx] >= (int16_t) pkg.manifest.size()) { ok = false; break; }
+      if (pkg.spine[idx] >= 0) pkg.hrefs.insert(std::make_pair(pkg.manifest[pkg.spine[idx]].href, idx));
+    }
+    break;
+  }
+
+  file.close();
+
+  LOG_D("Package index load %s.", ok ? "Success" : "Error");
+
+  return ok;
+}
+
+bool
+EPub::save_package(const std::string & epub_filename, uint32_t opf_crc, const Package & pkg)
+{
+  std::string   filename = epub_filename.substr(0, epub_filename.find_last_of('.')) + ".pkg";
+  std::ofstream file(filename, std::ios::out | std::ios::binary);
+
+  if (!file.is_open()) {
+    LOG_E("Not able to open package index file.");
+    return false;
+  }
+
+  // The ids are saved in manifest order
+
+  std::vector<const std::string *> ids(pkg.manifest.size(), nullptr);
+  for (auto & id : pkg.ids) ids[id.second] = &id.first;
+
+  static const std::string none;
+
+  while (true) {
+    if (file.write(reinterpret_cast<const char *>(&PKG_FILE_VERSION), 1).fail()) break;
+    if (file.write(reinterpret_cast<const char *>(&opf_crc), sizeof(opf_crc)).fail()) break;
+
+    if (!(write_str(file, pkg.unique_identifier) &&
+          write_str(file, pkg.title            ) &&
+          write_str(file, pkg.author           ) &&
+          write_str(file, pkg.description      ) &&
+          write_str(file, pkg.cover_filename   ))) break;
+
+    uint16_t count = pkg.manifest.size();
+    if (file.write(reinterpret_cast<const char *>(&count), sizeof(count)).fail()) break;
+    for (int16_t idx = 0; idx < count; idx++) {
+      const ManifestItem & item = pkg.manifest[idx];
+      if (!(write_str(file, (ids[idx] == nullptr) ? none : *ids[idx]) && 
+            write_str(file, item.href) && 
+            write_str(file, item.properties))) break;
+      if (file.write(reinterpret_cast<const char *>(&item.media_type), sizeof(item.media_type)).fail()) break;
+    }
+    if (file.fail()) break;
+
+    count = pkg.spine.size();
+    if (file.write(reinterpret_cast<const char *>(&count), sizeof(count)).fail()) break;
+    file.write(reinterpret_cast<const char *>(pkg.spine.data()), count * sizeof(int16_t));
+    break;
+  }
+
+  bool res = !file.fail();
+  file.close();
+
+  LOG_D("Package index save %s.", res ? "Success" : "Error");
+
+  return res;
+}
+
+std::string
+EPub::locate(const std::string & base_path, const char * fname)
 {
   char name[256];
   uint8_t idx = 0;
@@ -442,12 +633,18 @@ EPub::filename_locate(const char * fname)
   }
   name[idx] = 0;
 
-  std::string filename = opf_base_path;
+  std::string filename = base_path;
   filename.append(name);
 
   return filename;
 }
 
+std::string
+EPub::filename_locate(const char * fname)
+{
+  return locate(opf_base_path, fname);
+}
+
 char *
 EPub::retrieve_file(const char * fname, uint32_t & size)
 {
@@ -460,15 +657,29 @@ EPub::retrieve_file(const char * fname, uint32_t & size)
 
   // LOG_D("Retrieving file %s", filename.c_str());
 
-  char * str = unzip.get_file(filename.c_str(), size);
+  char * str = item_cache.get(filename, size);
+
+  if (str == nullptr) {
+    str = unzip.get_file(filename.c_str(), size);
+    if (str != nullptr) item_cache.put(filename, str, size);
+  }
 
   return str;
 }
 
+void
+EPub::release_file(char * data)
+{
+  item_cache.release(data);
+}
+
 void
 EPub::load_fonts()
 {
-  for (auto * css: css_cache) {
+  CSSCache cache = get_css_cache();
+  std::scoped_lock guard(css_mutex);
+
+  for (auto & css : *cache) {
     retrieve_fonts_from_css(*css);
   }
 }
@@ -567,7 +778,7 @@ EPub::retrieve_fonts_from_css(CSS & css)
         (fonts_size_too_large)) return;
     
     CSS::RulesMap font_rules;
-    DOM * dom = new DOM;
+    DOM * dom = new DOM(book_arena);
     DOM::Node * ff = dom->body->add_child(DOM::Tag::FONT_FACE);
 
     css.match(ff, font_rules);
@@ -586,7 +797,7 @@ EPub::retrieve_fonts_from_css(CSS & css)
         Fonts::FaceStyle style       = Fonts::FaceStyle::NORMAL;
         Fonts::FaceStyle font_weight = Fonts::FaceStyle::NORMAL;
         Fonts::FaceStyle font_style  = Fonts::FaceStyle::NORMAL;
-        std::string      font_family = values->front()->str;
+        std::string      font_family = values->front()->str.c_str();
 
         if ((values = css.get_values_from_props(*rule.second, CSS::PropertyId::FONT_STYLE))) {
           font_style = (Fonts::FaceStyle) values->front()->choice.face_style;
@@ -613,7 +824,7 @@ EPub::retrieve_fonts_from_css(CSS & css)
               );
             }
 
-            std::string filename = css.get_folder_path() + values->front()->str;
+            std::string filename = css.get_folder_path() + values->front()->str.c_str();
             filename = filename_locate(filename.c_str());
 
             load_font(filename, font_family, style);
@@ -636,8 +847,15 @@ EPub::retrieve_css(ItemInfo & item)
   // Retrieve css files, puting them in the css_cache vector (as a cache).
   // The properties are then merged into the current_css map for the item
   // being processed.
+  //
+  // The cache is copy-on-write: it is searched without any lock and a new
+  // list is published when a css file is added to it. As the viewer and the
+  // pages location retriever may parse the same file at the same time, the
+  // list is checked again before publishing.
 
   LOG_D("retrieve_css()");
+  PERF_SCOPE(CSS);
+
   #if EPUB_INKPLATE_BUILD && (LOG_LOCAL_LEVEL == ESP_LOG_VERBOSE)
     ESP::show_heaps_info();
   #endif
@@ -654,44 +872,64 @@ EPub::retrieve_css(ItemInfo & item)
         std::string css_id = attr.value(); // uses href as id
 
         // search the list of css files to see if it already been parsed
-        int16_t idx = 0;
-        CSSList::iterator css_cache_it = css_cache.begin();
+        CSSCache cache = get_css_cache();
+        CSSRef   found = nullptr;
 
-        while (css_cache_it != css_cache.end()) {
-          if ((*css_cache_it)->get_id().compare(css_id) == 0) break;
-          css_cache_it++;
-          idx++;
+        for (auto & css : *cache) {
+          if (css->get_id().compare(css_id) == 0) { found = css; break; }
         }
-        if (css_cache_it == css_cache.end()) {
+        if (found == nullptr) {
 
-          // The css file was not found. Load it in the cache.
-          uint32_t size;
+          // The css file was not found. Load it in the cache, from the
+          // stylesheets cache if it was parsed when the book was last opened.
+          uint32_t size, crc;
+          uint16_t method;
           std::string fname = item.file_path;
           fname.append(css_id.c_str());
-          char * data = retrieve_file(fname.c_str(), size);
+          std::string filename  = filename_locate(fname.c_str());
+          bool        crc_found = unzip.get_file_info(filename.c_str(), size, crc, method);
+
+          CSSRef css_tmp = nullptr;
+          if (crc_found) css_tmp = CSSRef(style_cache.get(filename, crc, css_id.c_str(), book_arena));
 
-          if (data != nullptr) {
+          char * data = nullptr;
+          if ((css_tmp == nullptr) && ((data = retrieve_file(fname.c_str(), size)) != nullptr)) {
             #if COMPUTE_SIZE
               memory_used += size;
             #endif
             LOG_D("CSS Filename: %s", fname.c_str());
             std::string path;
             extract_path(fname.c_str(), path);
-            CSS * css_tmp = new CSS(css_id.c_str(), path.c_str(), data, size, 0);
+            css_tmp = CSSRef(new CSS(css_id.c_str(), path.c_str(), data, size, 0, book_arena));
             if (css_tmp == nullptr) msg_viewer.out_of_memory("css temp allocation");
-            free(data);
+            release_file(data);
+
+            if (crc_found) style_cache.put(filename, crc, *css_tmp);
+          }
 
+          if (css_tmp != nullptr) {
             // #if DEBUGGING
             //   css_tmp->show();
             // #endif
 
-            retrieve_fonts_from_css(*css_tmp);
-                css_cache.push_back(css_tmp);
-            item.css_list.push_back(css_tmp);
+            { std::scoped_lock guard(css_mutex);
+
+              CSSRefs refs = *get_css_cache();
+              for (auto & css : refs) {
+                if (css->get_id().compare(css_id) == 0) { found = css; break; }
+              }
+              if (found == nullptr) {
+                retrieve_fonts_from_css(*css_tmp);
+                refs.push_back(css_tmp);
+                std::atomic_store(&css_cache, CSSCache(std::make_shared<const CSSRefs>(std::move(refs))));
+                found = css_tmp;
+              }
+            }
+            item.css_list.push_back(found);
           }
         } 
         else {
-          item.css_list.push_back(*css_cache_it);
+          item.css_list.push_back(found);
         }
       }
     } while ((node = node.next_sibling("link")));
@@ -710,9 +948,11 @@ EPub::retrieve_css(ItemInfo & item)
       else {
         buffer = node.child_value();
       }
-      CSS * css_tmp = new CSS("current-item", item.file_path.c_str(), buffer, strlen(buffer), 1);
+      CSS * css_tmp = new CSS("current-item", item.file_path.c_str(), buffer, strlen(buffer), 1, item.arena);
       if (css_tmp == nullptr) msg_viewer.out_of_memory("css temp allocation");
-      retrieve_fonts_from_css(*css_tmp);
+      { std::scoped_lock guard(css_mutex);
+        retrieve_fonts_from_css(*css_tmp);
+      }
       // css_tmp->show();
       item.css_cache.push_back(css_tmp);
     } while ((node = node.next_sibling("style")));
@@ -722,10 +962,10 @@ EPub::retrieve_css(ItemInfo & item)
   // the identified css files in the <meta> portion of the html file.
 
   if (item.css != nullptr) delete item.css;
-  if ((item.css = new CSS("MergedForItem")) == nullptr) {
+  if ((item.css = new CSS("MergedForItem", item.arena)) == nullptr) {
     msg_viewer.out_of_memory("css allocation");
   }
-  for (auto * css : item.css_list ) item.css->retrieve_data_from_css(*css);
+  for (auto & css : item.css_list ) item.css->retrieve_data_from_css(*css);
   for (auto * css : item.css_cache) item.css->retrieve_data_from_css(*css);
 
   // item.css->show();
@@ -736,51 +976,44 @@ EPub::retrieve_css(ItemInfo & item)
 }
 
 
+EPub::MediaType
+EPub::media_type_of(const char * media_type)
+{
+  if      (strcmp(media_type, "application/xhtml+xml") == 0) return MediaType::XML;
+  else if (strcmp(media_type, "image/jpeg"           ) == 0) return MediaType::JPEG;
+  else if (strcmp(media_type, "image/png"            ) == 0) return MediaType::PNG;
+  else if (strcmp(media_type, "image/bmp"            ) == 0) return MediaType::BMP;
+  else if (strcmp(media_type, "image/gif"            ) == 0) return MediaType::GIF;
+  else if (strcmp(media_type, "application/x-dtbncx+xml") == 0) return MediaType::NCX;
+  else                                                       return MediaType::OTHER;
+}
+
 bool 
-EPub::get_item(pugi::xml_node itemref, 
-               ItemInfo &     item)
+EPub::load_item(const char * href, 
+                MediaType    media_type,
+                ItemInfo &   item)
 {
   int err = 0;
   #define ERR(e) { err = e; break; }
 
-  if (!file_is_open) return false;
-
-  // if ((item.data != nullptr) && (current_itemref == itemref))
-  // return true;
-
   clear_item_data(item);
 
-  xml_node      node, node2;
-  xml_attribute attr;
-
-  const char * id = itemref.attribute("idref").value();
-
   bool completed = false;
 
   while (!completed) {
-    if (!((node = opf.find_child(package_pred).find_child(manifest_pred)) &&
-          (node = one_by_attr(node, "item", "opf:item", "id", id)))) ERR(1);
-
-    if (!(attr = node.attribute("media-type"))) ERR(2);
-    const char* media_type = attr.value();
-
-    if      (strcmp(media_type, "application/xhtml+xml") == 0) item.media_type = MediaType::XML;
-    else if (strcmp(media_type, "image/jpeg"           ) == 0) item.media_type = MediaType::JPEG;
-    else if (strcmp(media_type, "image/png"            ) == 0) item.media_type = MediaType::PNG;
-    else if (strcmp(media_type, "image/bmp"            ) == 0) item.media_type = MediaType::BMP;
-    else if (strcmp(media_type, "image/gif"            ) == 0) item.media_type = MediaType::GIF;
-    else ERR(3);
+    if ((media_type == MediaType::NCX) || (media_type == MediaType::OTHER)) ERR(3);
+    item.media_type = media_type;
 
-    if (!(attr = node.attribute("href"))) ERR(5);
-
-    LOG_D("Retrieving file %s", attr.value());
+    LOG_D("Retrieving file %s", href);
 
     uint32_t size;
-    extract_path(attr.value(), item.file_path);
+    extract_path(href, item.file_path);
 
     // LOG_D("item.file_path: %s.", item.file_path.c_str());
 
-    if ((item.data = retrieve_file(attr.value(), size)) == nullptr) ERR(6);
+    if ((item.data = retrieve_file(href, size)) == nullptr) ERR(6);
+    item.data_size = size;
+    memory_budget.add(MemoryBudget::Consumer::ITEMS, size);
 
     if (item.media_type == MediaType::XML) {
 
@@ -799,9 +1032,13 @@ EPub::get_item(pugi::xml_node itemref,
         *str++ = ' ';
         *str   = ' ';
       }
-      LOG_D("Reading file %s", attr.value());
+      LOG_D("Reading file %s", href);
 
-      xml_parse_result res = item.xml_doc.load_buffer_inplace(item.data, size);
+      xml_parse_result res;
+      {
+        PERF_SCOPE(XML_PARSE);
+        res = item.xml_doc.load_buffer_inplace(item.data, size);
+      }
       if (res.status != status_ok) {
         LOG_E("item_doc xml load error: %d", res.status);
         // msg_viewer.show(
@@ -809,13 +1046,9 @@ EPub::get_item(pugi::xml_node itemref,
         //   true, false, 
         //   "XML Error in eBook.", 
         //   "File %s contains XHTML errors and cannot be loaded.",
-        //   attr.value()
+        //   href
         // );
-        item.xml_doc.reset();
-        if (item.data != nullptr) {
-          free(item.data);
-          item.data = nullptr;
-        }
+        clear_item_data(item);
         return false;
       }
 
@@ -830,7 +1063,7 @@ EPub::get_item(pugi::xml_node itemref,
   }
 
   if (!completed) {
-    LOG_E("EPub get_current_item error: %d", err);
+    LOG_E("EPub load_item error: %d", err);
     clear_item_data(item);
   }
   return completed;
@@ -853,6 +1086,7 @@ EPub::update_book_format_params()
     };
   }
   else {
+    book_format_params.ident = Screen::IDENT;
     book_params->get(BookParams::Ident::SHOW_IMAGES,        &book_format_params.show_images      );
     book_params->get(BookParams::Ident::FONT_SIZE,          &book_format_params.font_size        );
     book_params->get(BookParams::Ident::USE_FONTS_IN_BOOK,  &book_format_params.use_fonts_in_book);
@@ -883,6 +1117,8 @@ EPub::open_params(const std::string & epub_filename)
 bool 
 EPub::open_file(const std::string & epub_filename)
 {
+  MemoryBudget::InUse in_use(MemoryBudget::Consumer::ITEMS);
+
   if (file_is_open && (current_filename == epub_filename)) return true;
   if (file_is_open) close_file();
 
@@ -904,7 +1140,10 @@ EPub::open_file(const std::string & epub_filename)
   std::string filename;
   if (!get_opf_filename(filename)) return false;
 
-  if (!get_opf(filename)) {
+  extract_path(filename.c_str(), opf_base_path);
+  LOG_D("opf_base_path: %s", opf_base_path.c_str());
+
+  if (!retrieve_package(epub_filename, filename)) {
     LOG_E("EPub open_file: Unable to get opf of %s", epub_filename.c_str());
     unzip.close_zip_file();
     return false;
@@ -912,6 +1151,10 @@ EPub::open_file(const std::string & epub_filename)
 
   get_encryption_xml();
 
+  item_cache.open(epub_filename);
+  page_cache.open(epub_filename);
+  style_cache.open(epub_filename);
+
   open_params(epub_filename);
   update_book_format_params();
 
@@ -934,7 +1177,8 @@ EPub::clear_item_data(ItemInfo & item)
 {
   item.xml_doc.reset();
   if (item.data != nullptr) {
-    free(item.data);
+    release_file(item.data);
+    memory_budget.remove(MemoryBudget::Consumer::ITEMS, item.data_size);
     item.data = nullptr;
   }
 
@@ -946,22 +1190,33 @@ EPub::clear_item_data(ItemInfo & item)
   for (auto * css : item.css_cache) delete css;
   item.css_cache.clear();
 
+  if (item.css != nullptr) {
+    delete item.css;
+    item.css = nullptr;
+  }
+
+  item.arena.reset();
+
   item.itemref_index = -1;
 }
 
+void
+EPub::release_current_item()
+{
+  std::scoped_lock guard(mutex);
+
+  clear_item_data(current_item_info);
+}
+
 bool 
 EPub::close_file()
 {
+  MemoryBudget::InUse in_use(MemoryBudget::Consumer::ITEMS);
+
   if (!file_is_open) return true;
 
   clear_item_data(current_item_info);
 
-  if (opf_data) {
-    opf.reset();
-    free(opf_data);
-    opf_data = nullptr;
-  }
-
   opf_base_path.clear();
 
   if (encryption_data) {
@@ -970,13 +1225,17 @@ EPub::close_file()
     encryption_data = nullptr;
   }
 
+  page_cache.close();
+  item_cache.close();
+  style_cache.close();
   unzip.close_zip_file();
 
-  for (auto * css : css_cache) delete css;
-
-  css_cache.clear();
+  std::atomic_store(&css_cache, CSSCache(std::make_shared<const CSSRefs>()));
+  std::atomic_store(&package,   PackageSnapshot(nullptr));
   fonts.clear();
 
+  book_arena.reset();
+
   file_is_open = false;
   encryption_present = false;
   current_filename.clear();
@@ -990,29 +1249,9 @@ EPub::close_file()
   return true;
 }
 
-const char * 
-EPub::get_meta(const std::string & name)
-{
-  if (!file_is_open) return nullptr;
-
-  xml_node node;
-  
-  if ((node = opf.find_child(package_pred).find_child(metadata_pred))) {
-    return node.child_value(name.c_str());
-  }
-  return nullptr;
-
-  // if (!((node = opf.child("package" ).child("metadata")))) {
-  //   node = opf.child("package").child("opf:metadata");
-  // }
-  // return node == nullptr ? nullptr : node.child_value(name.c_str());
-}
-
 const char *
-EPub::get_cover_filename()
+EPub::find_cover(xml_node package)
 {
-  if (!file_is_open) return nullptr;
-
   xml_node      node;
   xml_attribute attr;
 
@@ -1021,12 +1260,11 @@ EPub::get_cover_filename()
 
   // First, try to find its from metadata
 
-  if ((node = opf.find_child(package_pred)
-                 .find_child(metadata_pred)) &&
+  if ((node = package.find_child(metadata_pred)) &&
       (node = one_by_attr(node, "meta", "opf:meta", "name", "cover")) &&
       (itemref = node.attribute("content").value())) {
 
-    for (auto n : opf.find_child(package_pred).find_child(manifest_pred).children()) {
+    for (auto n : package.find_child(manifest_pred).children()) {
       if ((strcmp(n.name(), "item") == 0) || (strcmp(n.name(), "opf:item") == 0)) {
         if ((((attr = n.attribute("id"        )) && (strcmp(attr.value(), itemref) == 0)) ||
             ((attr = n.attribute("properties")) && (strcmp(attr.value(), itemref) == 0))) &&
@@ -1040,7 +1278,7 @@ EPub::get_cover_filename()
 
   if (filename == nullptr) {
     // Look inside manifest
-    for (auto n : opf.find_child(package_pred).find_child(manifest_pred).children()) {
+    for (auto n : package.find_child(manifest_pred).children()) {
       if ((strcmp(n.name(), "item") == 0) || (strcmp(n.name(), "opf:item") == 0)) {
         if ((attr = n.attribute("id")) && 
             ((strcmp(attr.value(), "cover-image") == 0) || 
@@ -1056,80 +1294,155 @@ EPub::get_cover_filename()
   return filename == nullptr ? "" : filename;
 }
 
+const char *
+EPub::get_cover_filename()
+{
+  if (!file_is_open) return nullptr;
+
+  return get_package()->cover_filename.c_str();
+}
+
+bool
+EPub::get_metadata(char * opf_data, uint32_t size, const std::string & opf_filename, Metadata & metadata)
+{
+  xml_document doc;
+  xml_node     package, node;
+
+  xml_parse_result res = doc.load_buffer_inplace(opf_data, size);
+  if (res.status != status_ok) {
+    LOG_E("xml load error: %d", res.status);
+    return false;
+  }
+
+  if (!((package = doc.find_child(package_pred)) &&
+        (node    = package.find_child(metadata_pred)))) {
+    LOG_E("No metadata in %s", opf_filename.c_str());
+    return false;
+  }
+
+  metadata.title       = node.child_value("dc:title"      );
+  metadata.author      = node.child_value("dc:creator"    );
+  metadata.description = node.child_value("dc:description");
+
+  const char * cover = find_cover(package);
+  if (*cover) {
+    std::string base_path;
+    extract_path(opf_filename.c_str(), base_path);
+    metadata.cover_filename = locate(base_path, cover);
+  }
+  else {
+    metadata.cover_filename.clear();
+  }
+
+  return true;
+}
+
+void
+EPub::remove_sidecars(const std::string & epub_filename)
+{
+  static constexpr char const * SIDECARS[] = { 
+    ".pars", ".locs", ".toc", ".sidx", ".zidx", ".pkg", ".cssb" 
+  };
+
+  std::string base = epub_filename.substr(0, epub_filename.find_last_of('.'));
+  struct stat file_stat;
+
+  for (const char * ext : SIDECARS) {
+    std::string filename = base + ext;
+    if (stat(filename.c_str(), &file_stat) != -1) {
+      LOG_I("Deleting file : %s", filename.c_str());
+      unlink(filename.c_str());
+    }
+  }
+
+  ItemCache::remove(epub_filename);
+  PageLocs::remove_variants(epub_filename);
+}
+
 int16_t 
 EPub::get_item_count()
 {
   if (!file_is_open) return 0;
 
-  auto it = opf.find_child(package_pred).find_child(spine_pred).children("itemref");
-  int16_t count = std::distance(it.begin(), it.end());
-  
-  if (count == 0) {
-    it = opf.find_child(package_pred).find_child(spine_pred).children("opf:itemref");
-    count = std::distance(it.begin(), it.end());
-  }
+  int16_t count = get_package()->spine.size();
 
   LOG_D("Item count: %d", count);
   return count;
 }
 
+int16_t
+EPub::get_itemref_index(const std::string & href)
+{
+  if (!file_is_open) return -1;
+
+  PackageSnapshot pkg = get_package();
+  auto            it  = pkg->hrefs.find(href);
+
+  return (it == pkg->hrefs.end()) ? -1 : it->second;
+}
+
+bool
+EPub::get_manifest_item(const std::string & id, ManifestItem & item)
+{
+  if (!file_is_open) return false;
+
+  PackageSnapshot pkg = get_package();
+  auto            it  = pkg->ids.find(id);
+
+  if (it == pkg->ids.end()) return false;
+
+  item = pkg->manifest[it->second];
+  return true;
+}
+
 bool 
 EPub::get_item_at_index(int16_t itemref_index)
 {
   if (!file_is_open) return false;
 
   if (current_item_info.itemref_index == itemref_index) return true;
-  
-  xml_node node  = xml_node();
-  int16_t  index = 0;
 
-  for (auto n : opf.find_child(package_pred).find_child(spine_pred).children()) {
-    if (index == itemref_index) { node = n; break; }
-    index++;
-  }
+  PackageSnapshot pkg = get_package();
 
-  if (node == nullptr) return false;
+  if ((itemref_index < 0) || 
+      ((size_t) itemref_index >= pkg->spine.size()) || 
+      (pkg->spine[itemref_index] < 0)) return false;
 
-  bool res = false;
+  const ManifestItem & item = pkg->manifest[pkg->spine[itemref_index]];
+
+  bool res = load_item(item.href.c_str(), item.media_type, current_item_info);
+  current_item_info.itemref_index = itemref_index;
 
-  if ((current_item_info.data == nullptr) || (current_itemref != node)) {
-    if ((res = get_item(node, current_item_info))) current_itemref = node;
-    current_item_info.itemref_index = itemref_index;
-  }
   return res;
 }
 
 // This is in support of the pages location retrieval mechanism. The ItemInfo
 // is being used to retrieve asynchroniously the book page numbers without
-// interfering with the main book viewer thread.
+// interfering with the main book viewer thread. The item is located through
+// the package snapshot: the EPub mutex is not used.
 bool 
 EPub::get_item_at_index(int16_t    itemref_index, 
                         ItemInfo & item)
 {
   if (!file_is_open) return false;
 
-  LOG_D("Mutex lock...");
-  
-  { std::scoped_lock guard(mutex);
-    
-    xml_node node = xml_node();
-    int16_t index = 0;
+  PackageSnapshot pkg = get_package();
 
-    for (auto n : opf.find_child(package_pred).find_child(spine_pred).children()) {
-      if (index == itemref_index) { node = n; break; }
-      index++;
-    }
+  if ((pkg == nullptr) || 
+      (itemref_index < 0) || 
+      ((size_t) itemref_index >= pkg->spine.size())) return false;
 
-    bool res = false;
+  if (pkg->spine[itemref_index] < 0) {
+    clear_item_data(item);
+    return false;
+  }
 
-    if (node) {
-      res = get_item(node, item);
-      item.itemref_index = itemref_index;
-    }
+  const ManifestItem & manifest_item = pkg->manifest[pkg->spine[itemref_index]];
 
-    LOG_D("Mutex unlocked...");
-    return res;
-  }
+  bool res = load_item(manifest_item.href.c_str(), manifest_item.media_type, item);
+  item.itemref_index = itemref_index;
+
+  return res;
 }
 
 Image *
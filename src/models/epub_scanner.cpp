@@ -0,0 +1,44 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#include "models/epub_scanner.hpp"
+
+bool
+EPubScanner::begin()
+{
+  opf_filename.clear();
+  metadata_found = false;
+
+  return ZipStreamScanner::begin();
+}
+
+bool
+EPubScanner::is_wanted(const std::string & filename)
+{
+  return (filename == CONTAINER_FILE) ||
+         (!opf_filename.empty() && (filename == opf_filename));
+}
+
+void
+EPubScanner::entry_received(const std::string & filename, char * data, uint32_t size)
+{
+  if (filename == CONTAINER_FILE) {
+    if (EPub::get_rootfile(data, size, opf_filename)) {
+      LOG_D("OPF file: %s", opf_filename.c_str());
+    }
+  }
+  else if (!metadata_found) {
+    metadata_found = EPub::get_metadata(data, size, opf_filename, metadata);
+  }
+
+  free(data);
+}
+
+bool
+EPubScanner::is_complete() const
+{
+  return metadata_found          &&
+         is_central_dir_found()  &&
+         (find(opf_filename) != nullptr);
+}
@@ -12,6 +12,70 @@ TEST(EpubTest, reading_identifier) {
   EXPECT_EQ(epub.get_unique_identifier(), "http://www.gutenberg.org/1342");
 }
 
+TEST(EpubTest, package_index_reloaded) {
+  static constexpr char const * BOOK  = BOOKS_FOLDER "/Austen, Jane - Pride and Prejudice.epub";
+  static constexpr char const * ITEM5 = "@public@vhost@g@gutenberg@html@files@1342@1342-h@1342-h-0.htm.html";
+
+  EPub::ManifestItem item;
+
+  epub.close_file();
+  remove(BOOKS_FOLDER "/Austen, Jane - Pride and Prejudice.pkg");
+  ASSERT_TRUE(epub.open_file(BOOK));
+
+  int16_t     count = epub.get_item_count();
+  std::string title = epub.get_title();
+
+  EXPECT_GT(count, 1);
+  EXPECT_EQ(epub.get_itemref_index(ITEM5), 1);
+  EXPECT_TRUE(epub.get_manifest_item("ncx", item));
+  EXPECT_TRUE(item.media_type == EPub::MediaType::NCX);
+
+  // The second time, the package index comes from the .pkg file
+
+  epub.close_file();
+  ASSERT_TRUE(epub.open_file(BOOK));
+  EXPECT_EQ(epub.get_item_count(), count);
+  EXPECT_EQ(epub.get_title(), title);
+  EXPECT_EQ(epub.get_unique_identifier(), "http://www.gutenberg.org/1342");
+  EXPECT_EQ(epub.get_itemref_index(ITEM5), 1);
+  EXPECT_TRUE(epub.get_item_at_index(1));
+}
+
+TEST(EpubTest, stylesheets_cache_reloaded) {
+  static constexpr char const * BOOK = BOOKS_FOLDER "/Austen, Jane - Pride and Prejudice.epub";
+
+  std::vector<std::vector<uint8_t>> parsed, restored;
+
+  epub.close_file();
+  remove(BOOKS_FOLDER "/Austen, Jane - Pride and Prejudice.cssb");
+  ASSERT_TRUE(epub.open_file(BOOK));
+  ASSERT_TRUE(epub.get_item_at_index(1));
+
+  for (auto & css : *epub.get_css_cache()) {
+    parsed.emplace_back();
+    EXPECT_TRUE(css->serialize(parsed.back()));
+  }
+  ASSERT_FALSE(parsed.empty());
+
+  // The second time, the stylesheets come from the .cssb file
+
+  epub.close_file();
+  FILE * file = fopen(BOOKS_FOLDER "/Austen, Jane - Pride and Prejudice.cssb", "rb");
+  ASSERT_TRUE(file != nullptr);
+  fclose(file);
+
+  ASSERT_TRUE(epub.open_file(BOOK));
+  ASSERT_TRUE(epub.get_item_at_index(1));
+
+  for (auto & css : *epub.get_css_cache()) {
+    restored.emplace_back();
+    EXPECT_TRUE(css->serialize(restored.back()));
+  }
+  EXPECT_EQ(restored, parsed);
+  EXPECT_TRUE(epub.get_current_item_css() != nullptr);
+  EXPECT_FALSE(epub.get_current_item_css()->rules_map.empty());
+}
+
 TEST(EpubTest, get_uuid) {
   EPub::BinUUID uuid_res = { 0x91, 0xd3, 0x52, 0xf0, 0x53, 0xc7, 0x43, 0x61, 
                              0xb8, 0x46, 0x17, 0x65, 0x9d, 0x64, 0xe9, 0x76 };
@@ -5,6 +5,7 @@
 #define _FONT_ 1
 #include "models/font.hpp"
 #include "viewers/msg_viewer.hpp"
+#include "helpers/memory_budget.hpp"
 
 #include "screen.hpp"
 #include "alloc.hpp"
@@ -18,12 +19,12 @@ Font::Font()
   memory_font       = nullptr;
   current_font_size = -1;
   ready             = false;
- }
+}
 
 void
 Font::add_buff_to_byte_pool()
 {
-  BytePool * pool = (BytePool *) allocate(BYTE_POOL_SIZE);
+  BytePool * pool = (BytePool *) memory_budget.allocate(MemoryBudget::Consumer::GLYPHS, BYTE_POOL_SIZE);
   if (pool == nullptr) {
     LOG_E("Unable to allocated memory for bytes pool.");
     msg_viewer.out_of_memory("ttf pool allocation");
@@ -64,12 +65,14 @@ Font::clear_cache()
   }
 
   for (auto * buff : byte_pools) {
-    free(buff);
+    memory_budget.release(MemoryBudget::Consumer::GLYPHS, buff, BYTE_POOL_SIZE);
   }
   byte_pools.clear();
   
   cache.clear();
   cache.reserve(50);
+
+  words_cache.clear();
 }
 
 Font::Glyph *
@@ -80,6 +83,13 @@ Font::get_glyph(uint32_t charcode, int16_t glyph_size)
   return ready ? get_glyph_internal(charcode, glyph_size) : nullptr;
 }
 
+Font::Glyph *
+Font::get_glyph_from_code(uint32_t code, int16_t glyph_size)
+{
+  std::scoped_lock guard(mutex);
+
+  return ready ? get_glyph_internal(code, glyph_size) : nullptr;
+}
 
 Font::Glyph *
 Font::get_glyph(uint32_t charcode, uint32_t next_charcode, int16_t glyph_size, int16_t & kern, bool & ignore_next)
@@ -103,6 +113,70 @@ Font::get_glyph(uint32_t charcode, uint32_t next_charcode, int16_t glyph_size, i
   return (glyph == nullptr) ? nullptr : glyph;
 }
 
+bool
+Font::get_word(const std::string & key, int16_t glyph_size, WordGlyphs & glyphs, int16_t & width)
+{
+  std::scoped_lock guard(mutex);
+
+  auto words = words_cache.find(glyph_size);
+  if (words == words_cache.end()) return false;
+
+  auto word = words->second.find(key);
+  if (word == words->second.end()) return false;
+
+  glyphs = word->second.glyphs;
+  width  = word->second.width;
+
+  return true;
+}
+
+int16_t
+Font::add_word(const std::string           & key, 
+               const std::vector<uint32_t> & codes, 
+               int16_t                       glyph_size, 
+               WordGlyphs                  & glyphs)
+{
+  glyphs.clear();
+  if (!ready) return 0;
+
+  // The glyphs are retrieved through the virtual get_glyph() such that the
+  // fonts translating the character codes (IBMF) are served properly.
+
+  int16_t width = 0;
+  size_t  idx   = 0;
+
+  while (idx < codes.size()) {
+    bool     ignore_next = false;
+    uint32_t next        = ((idx + 1) < codes.size()) ? codes[idx + 1] : 0;
+    int16_t  kern        = 0;
+    Glyph  * glyph       = get_glyph(codes[idx], next, glyph_size, kern, ignore_next);
+
+    if ((glyph == nullptr) && ((glyph = get_glyph(' ', glyph_size)) != nullptr)) {
+      kern = glyph->advance;
+    }
+
+    idx += ignore_next ? 2 : 1;
+
+    if (glyph != nullptr) {
+      glyphs.push_back({ .glyph = glyph, .kern = kern });
+      width += kern;
+    }
+  }
+
+  std::scoped_lock guard(mutex);
+
+  // The limit is per size: the pages locations of several font sizes
+  // computed in the same pass (PageLocs::Variant) alternate between them
+  // from one item to the next.
+
+  Words & words = words_cache[glyph_size];
+  if (words.size() >= WORDS_CACHE_SIZE) words.clear();
+  
+  words[key] = { .glyphs = glyphs, .width = width };
+
+  return width;
+}
+
 bool 
 Font::set_font_face_from_file(const std::string font_filename)
 {
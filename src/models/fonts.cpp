@@ -44,11 +44,7 @@ static constexpr const char * font_labels[8] = {
 
 Fonts::Fonts()
 {
-  #if USE_EPUB_FONTS
-    font_cache.reserve(20);
-  #else
-    font_cache.reserve(4);
-  #endif
+  publish(FontCache());
 }
 
 char *
@@ -106,7 +102,7 @@ std::string & Fonts::filter_filename(std::string & fname)
   return fname;
 }
 
-bool Fonts::setup()
+bool Fonts::setup(int8_t font_index)
 {
   FontEntry   font_entry;
   struct stat file_stat;
@@ -202,8 +198,7 @@ bool Fonts::setup()
     book_param_controller.set_font_count(font_count);
         option_controller.set_font_count(font_count);
 
-    int8_t font_index;
-    config.get(Config::Ident::DEFAULT_FONT, &font_index);
+    if (font_index < 0) config.get(Config::Ident::DEFAULT_FONT, &font_index);
     if ((font_index < 0) || (font_index >= font_count)) font_index = 0;
 
     std::string normal      = std::string(FONTS_FOLDER "/").append(    regular_fname[font_index]);
@@ -227,10 +222,7 @@ bool Fonts::setup()
 
 Fonts::~Fonts()
 {
-  for (auto & entry : font_cache) {
-    delete entry.font;
-  }
-  font_cache.clear();
+  font_cache.reset();
 }
 
 void
@@ -240,15 +232,16 @@ Fonts::clear(bool all)
   
   // LOG_D("Fonts Clear!");
   // Keep the first 7 fonts as they are reused. Caches will be cleared.
+  // The fonts removed are deleted when no more snapshot is using them.
   #if USE_EPUB_FONTS
+    FontCache cache = *get_snapshot();
     int i = 0;
-    for (auto & entry : font_cache) {
-      if ((all && (i >= 3)) || (i >= 7)) delete entry.font;
-      else entry.font->clear_cache();
+    for (auto & entry : cache) {
+      if (!((all && (i >= 3)) || (i >= 7))) entry.font->clear_cache();
       i++;
     }
-    font_cache.resize(all ? 3 : 7);
-    font_cache.reserve(20);
+    cache.resize(all ? 3 : 7);
+    publish(std::move(cache));
   #endif
 }
 
@@ -257,19 +250,13 @@ Fonts::clear_everything()
 {
   std::scoped_lock guard(mutex);
   
-  // LOG_D("Fonts Clear!");
-  // Keep the first 7 fonts as they are reused. Caches will be cleared.
-  for (auto & entry : font_cache) {
-    delete entry.font;
-  }
-  font_cache.resize(0);
-  font_cache.reserve(20);
+  publish(FontCache());
 }
 
 void
 Fonts::adjust_default_font(uint8_t font_index)
 {
-  if (font_cache.at(3).name.compare(font_names[font_index]) != 0) {
+  if (get_snapshot()->at(3).name.compare(font_names[font_index]) != 0) {
     std::string normal      = std::string(FONTS_FOLDER "/").append(    regular_fname[font_index]);
     std::string bold        = std::string(FONTS_FOLDER "/").append(       bold_fname[font_index]);
     std::string italic      = std::string(FONTS_FOLDER "/").append(     italic_fname[font_index]);
@@ -287,7 +274,7 @@ Fonts::adjust_default_font(uint8_t font_index)
 void
 Fonts::clear_glyph_caches()
 {
-  for (auto & entry : font_cache) {
+  for (auto & entry : *get_snapshot()) {
     entry.font->clear_cache();
   }
 }
@@ -297,15 +284,25 @@ Fonts::get_index(const std::string & name, FaceStyle style)
 {
   int16_t idx = 0;
 
-  { std::scoped_lock guard(mutex);
+  for (auto & entry : *get_snapshot()) {
+    if ((entry.name.compare(name) == 0) && 
+        (entry.style == style)) return idx;
+    idx++;
+  }
+  return -1;
+}
 
-    for (auto & entry : font_cache) {
-      if ((entry.name.compare(name) == 0) && 
-          (entry.style == style)) return idx;
-      idx++;
+bool
+Fonts::get_name_and_style(const Font * font, std::string & name, FaceStyle & style)
+{
+  for (auto & entry : *get_snapshot()) {
+    if (entry.font.get() == font) {
+      name  = entry.name;
+      style = entry.style;
+      return true;
     }
   }
-  return -1;
+  return false;
 }
 
 bool 
@@ -317,13 +314,14 @@ Fonts::replace(int16_t             index,
   std::scoped_lock guard(mutex);
   
   FontEntry f;
-  if ((f.font = FontFactory::create(filename))) {
+  if ((f.font = std::shared_ptr<Font>(FontFactory::create(filename)))) {
     if (f.font->is_ready()) {
       f.name  = name;
       f.style = style;
       f.font->set_fonts_cache_index(index);
-      delete font_cache.at(index).font;
-      font_cache.at(index) = f;
+      FontCache cache = *get_snapshot();
+      cache.at(index) = f;
+      publish(std::move(cache));
 
       LOG_D("Font %s (%s) replacement at index %d and style %d.",
         f.name.c_str(), 
@@ -332,9 +330,6 @@ Fonts::replace(int16_t             index,
         (int)f.style);
       return true;
     }
-    else {
-      delete f.font;
-    }
   }
   else {
     LOG_E("Unable to allocate memory.");
@@ -352,18 +347,20 @@ Fonts::add(const std::string & name,
   std::scoped_lock guard(mutex);
   
   // If the font is already loaded, return promptly
-  for (auto & font : font_cache) {
+  for (auto & font : *get_snapshot()) {
     if ((name.compare(font.name) == 0) && 
         (font.style == style)) return true;
   }
 
   FontEntry f;
-  if ((f.font = FontFactory::create(filename))) {
+  if ((f.font = std::shared_ptr<Font>(FontFactory::create(filename)))) {
     if (f.font->is_ready()) {
       f.name  = name;
       f.style = style;
-      f.font->set_fonts_cache_index(font_cache.size());
-      font_cache.push_back(f);
+      FontCache cache = *get_snapshot();
+      f.font->set_fonts_cache_index(cache.size());
+      cache.push_back(f);
+      publish(std::move(cache));
 
       LOG_D("Font %s added to cache at index %d and style %d.",
         f.name.c_str(), 
@@ -371,9 +368,6 @@ Fonts::add(const std::string & name,
         (int)f.style);
       return true;
     }
-    else {
-      delete f.font;
-    }
   }
   else {
     LOG_E("Unable to allocate memory.");
@@ -393,19 +387,21 @@ Fonts::add(const std::string & name,
   std::scoped_lock guard(mutex);
   
   // If the font is already loaded, return promptly
-  for (auto & font : font_cache) {
+  for (auto & font : *get_snapshot()) {
     if ((name.compare(font.name) == 0) && 
         (font.style == style)) return true;
   }
 
   FontEntry f;
 
-  if ((f.font = FontFactory::create(filename, buffer, size))) {
+  if ((f.font = std::shared_ptr<Font>(FontFactory::create(filename, buffer, size)))) {
     if (f.font->is_ready()) {
       f.name  = name;
       f.style = style;
-      f.font->set_fonts_cache_index(font_cache.size());
-      font_cache.push_back(f);
+      FontCache cache = *get_snapshot();
+      f.font->set_fonts_cache_index(cache.size());
+      cache.push_back(f);
+      publish(std::move(cache));
 
       LOG_D("Font %s added to cache at index %d and style %d.",
         f.name.c_str(), 
@@ -413,9 +409,6 @@ Fonts::add(const std::string & name,
         (int)f.style);
       return true;
     }
-    else {
-      delete f.font;
-    }
   }
   else {
     LOG_E("Unable to allocate memory.");
@@ -7,6 +7,7 @@
 #include "viewers/msg_viewer.hpp"
 
 #include "screen.hpp"
+#include "helpers/perf_stats.hpp"
 #include "alloc.hpp"
 
 #include <iostream>
@@ -430,10 +431,14 @@ IBMF::get_glyph_internal(uint32_t glyph_code, int16_t glyph_size)
                ((git = cache_it->second.find(glyph_code)) != cache_it->second.end());
 
   if (found) {
+    PERF_COUNT(GLYPH_CACHE_HIT);
     glyph_data = face->get_glyph_info(glyph_code & 0x000000FF);
     return git->second;
   }
   else {
+    PERF_SCOPE(GLYPH);
+    PERF_COUNT(GLYPH_CACHE_MISS);
+
     Glyph * glyph = bitmap_glyph_pool.newElement();
 
     if (glyph == nullptr) {
@@ -469,6 +474,10 @@ IBMF::get_glyph_internal(uint32_t glyph_code, int16_t glyph_size)
     //   " y:"  << glyph->yoff <<
     //   " a:"  << glyph->advance << std::endl;
 
+    glyph->font = this;
+    glyph->code = glyph_code;
+    glyph->size = glyph_size;
+
     cache[current_font_size][glyph_code] = glyph;
     return glyph;
   }
@@ -0,0 +1,43 @@
+#if TESTING && EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "gtest/gtest.h"
+#include "models/ibmf.hpp"
+
+static constexpr char const * IBMF_FONT = FONTS_FOLDER "/EC-BoldItalic_166.ibmf";
+
+TEST(IBMFTest, composed_glyphs) {
+  IBMF font(IBMF_FONT);
+
+  ASSERT_TRUE(font.is_ready());
+
+  // Accents below a slanted glyph (ç, ą) start at its left
+
+  for (uint32_t code = 0xC0; code < 0x180; code++) {
+    Font::Glyph * glyph = font.get_glyph(code, 12);
+    ASSERT_TRUE(glyph != nullptr) << "code " << code;
+    EXPECT_EQ(font.get_glyph(code, 12), glyph) << "code " << code;
+  }
+
+  Font::Glyph * c       = font.get_glyph('c',  12);
+  Font::Glyph * cedilla = font.get_glyph(0xE7, 12);
+
+  ASSERT_TRUE((c != nullptr) && (cedilla != nullptr));
+  EXPECT_GT(cedilla->dim.height, c->dim.height);
+  EXPECT_EQ(cedilla->advance,    c->advance);
+
+  // A character without glyph is a space
+
+  Font::Glyph * glyph = font.get_glyph(0x17F, 12);
+  ASSERT_TRUE(glyph != nullptr);
+  EXPECT_EQ(glyph->buffer, nullptr);
+  EXPECT_GT(glyph->advance, 0);
+
+  // The tables of each size are kept when sizes are mixed
+
+  int32_t line_height = font.get_line_height(12);
+  EXPECT_NE(font.get_line_height(24), line_height);
+  EXPECT_EQ(font.get_glyph('a', 24)->size, 24);
+  EXPECT_EQ(font.get_line_height(12), line_height);
+}
+
+#endif
@@ -0,0 +1,362 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __ITEM_CACHE__ 1
+#include "models/item_cache.hpp"
+
+#include "models/config.hpp"
+#include "helpers/unzip.hpp"
+#include "helpers/inflate.hpp"
+#include "alloc.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#if EPUB_LINUX_BUILD
+  #include <sys/mman.h>
+#endif
+
+static const std::string CACHE_FOLDER = MAIN_FOLDER "/cache";
+
+uint32_t
+ItemCache::hash(const std::string & str)
+{
+  // FNV-1a
+
+  uint32_t h = 2166136261UL;
+  for (char ch : str) {
+    h ^= (uint8_t) ch;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+std::string
+ItemCache::get_book_folder(const std::string & epub_filename)
+{
+  char name[16];
+  snprintf(name, 16, "/%08" PRIx32, hash(epub_filename));
+  return CACHE_FOLDER + name;
+}
+
+void
+ItemCache::clear_folder(const std::string & path)
+{
+  DIR * dp = opendir(path.c_str());
+  if (dp == nullptr) return;
+
+  struct dirent * de;
+  while ((de = readdir(dp)) != nullptr) {
+    if (de->d_name[0] == '.') continue;
+    std::string filename = path + '/' + de->d_name;
+    unlink(filename.c_str());
+  }
+  closedir(dp);
+}
+
+void
+ItemCache::remove(const std::string & epub_filename)
+{
+  std::string path = get_book_folder(epub_filename);
+  clear_folder(path);
+  rmdir(path.c_str());
+}
+
+void
+ItemCache::open(const std::string & epub_filename)
+{
+  std::scoped_lock guard(mutex);
+
+  int8_t item_cache_enabled = 0;
+  config.get(Config::Ident::ITEM_CACHE, &item_cache_enabled);
+
+  entries.clear();
+  total_size = 0;
+  modified   = false;
+  enabled    = item_cache_enabled != 0;
+
+  if (!enabled) return;
+
+  folder = get_book_folder(epub_filename);
+
+  struct stat file_stat;
+  if (((stat(CACHE_FOLDER.c_str(), &file_stat) == -1) && (mkdir(CACHE_FOLDER.c_str(), 0775) == -1)) ||
+      ((stat(folder.c_str(),       &file_stat) == -1) && (mkdir(folder.c_str(),       0775) == -1))) {
+    LOG_E("Unable to create cache folder: %s", folder.c_str());
+    enabled = false;
+    return;
+  }
+
+  if (!load_index()) {
+    LOG_I("No valid cache index. Cache folder cleared.");
+    clear_folder(folder);
+    modified = true;
+  }
+}
+
+void
+ItemCache::close()
+{
+  std::scoped_lock guard(mutex);
+
+  if (enabled && modified) save_index();
+
+  entries.clear();
+  total_size = 0;
+  enabled    = false;
+}
+
+bool
+ItemCache::load_index()
+{
+  FILE * f = fopen((folder + "/index").c_str(), "r");
+  if (f == nullptr) return false;
+
+  int8_t      version;
+  uint16_t    count;
+  IndexRecord record;
+  bool        ok = false;
+
+  if ((fread(&version, sizeof(version), 1, f) == 1) &&
+      (version == INDEX_FILE_VERSION) &&
+      (fread(&count, sizeof(count), 1, f) == 1)) {
+    ok = true;
+    while (count-- > 0) {
+      if (fread(&record, sizeof(record), 1, f) != 1) { ok = false; break; }
+      entries.push_back(record);
+      total_size += record.size;
+    }
+  }
+
+  fclose(f);
+
+  if (!ok) {
+    entries.clear();
+    total_size = 0;
+  }
+
+  return ok;
+}
+
+bool
+ItemCache::save_index()
+{
+  FILE * f = fopen((folder + "/index").c_str(), "w");
+  if (f == nullptr) return false;
+
+  int8_t   version = INDEX_FILE_VERSION;
+  uint16_t count   = entries.size();
+
+  bool ok = (fwrite(&version, sizeof(version), 1, f) == 1) &&
+            (fwrite(&count,   sizeof(count),   1, f) == 1);
+
+  for (auto & record : entries) {
+    if (!ok) break;
+    ok = fwrite(&record, sizeof(record), 1, f) == 1;
+  }
+
+  fclose(f);
+
+  if (ok) modified = false;
+  else LOG_E("Unable to save cache index.");
+
+  return ok;
+}
+
+ItemCache::Entries::iterator
+ItemCache::find(uint32_t key)
+{
+  Entries::iterator it = entries.begin();
+  while ((it != entries.end()) && (it->key != key)) it++;
+  return it;
+}
+
+void
+ItemCache::drop(Entries::iterator it)
+{
+  unlink(get_item_filename(it->key).c_str());
+  total_size -= it->size;
+  entries.erase(it);
+  modified = true;
+}
+
+bool
+ItemCache::check_entry(const std::string & filename, uint32_t & size, uint32_t & crc)
+{
+  uint16_t method;
+
+  // Items that are not compressed are read as fast from the zip file
+
+  return enabled && 
+         unzip.get_file_info(filename.c_str(), size, crc, method) &&
+         (method != 0) &&
+         (size >= MIN_ITEM_SIZE);
+}
+
+char *
+ItemCache::get(const std::string & filename, uint32_t & size)
+{
+  std::scoped_lock guard(mutex);
+
+  uint32_t crc;
+  if (!check_entry(filename, size, crc)) return nullptr;
+
+  Entries::iterator it = find(hash(filename));
+  if (it == entries.end()) return nullptr;
+
+  std::string item_filename = get_item_filename(it->key);
+  uint32_t    data_offset   = sizeof(ItemHeader) + filename.size();
+  char      * data          = nullptr;
+  ItemHeader  header;
+  
+  bool completed = false;
+  
+  #if EPUB_LINUX_BUILD
+    int fd;
+    if ((fd = ::open(item_filename.c_str(), O_RDONLY)) != -1) {
+      size_t      length = data_offset + size + 1;
+      struct stat file_stat;
+
+      // Reading the missing pages of a truncated file would raise SIGBUS
+
+      void * addr = ((fstat(fd, &file_stat) == 0) && ((size_t) file_stat.st_size >= length)) ?
+                    mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) :
+                    MAP_FAILED;
+      ::close(fd);
+
+      if (addr != MAP_FAILED) {
+        memcpy(&header, addr, sizeof(ItemHeader));
+        data = ((char *) addr) + data_offset;
+
+        if ((header.size        == size            ) &&
+            (header.crc       == crc           ) &&
+            (header.name_length == filename.size() ) &&
+            (it->size           == length          ) &&
+            (memcmp(((char *) addr) + sizeof(ItemHeader), filename.c_str(), header.name_length) == 0) &&
+            (data[size] == 0) &&
+            (Inflate::update_crc32(0, (const uint8_t *) data, size) == crc)) {
+          mappings[data] = { addr, length };
+          completed = true;
+        }
+        else {
+          munmap(addr, length);
+        }
+      }
+    }
+  #else
+    FILE * f;
+    char   name[256];
+    if ((f = fopen(item_filename.c_str(), "r")) != nullptr) {
+      if ((fread(&header, sizeof(ItemHeader), 1, f) == 1) &&
+          (header.size        == size           ) &&
+          (header.crc       == crc          ) &&
+          (header.name_length == filename.size()) &&
+          (header.name_length <  sizeof(name)   ) &&
+          (fread(name, header.name_length, 1, f) == 1) &&
+          (memcmp(name, filename.c_str(), header.name_length) == 0)) {
+
+        // The whole item in a single read
+
+        if ((data = (char *) allocate(size + 1)) != nullptr) {
+          if ((fread(data, size, 1, f) == 1) &&
+              (Inflate::update_crc32(0, (const uint8_t *) data, size) == crc)) {
+            data[size] = 0;
+            completed  = true;
+          }
+          else {
+            free(data);
+          }
+        }
+      }
+      fclose(f);
+    }
+  #endif
+
+  if (!completed) {
+    LOG_I("Cached item %s is not valid. Dropped.", filename.c_str());
+    drop(it);
+    return nullptr;
+  }
+
+  if (it != entries.begin()) {
+    entries.splice(entries.begin(), entries, it);
+    modified = true;
+  }
+
+  LOG_D("Item %s retrieved from cache.", filename.c_str());
+  return data;
+}
+
+void
+ItemCache::put(const std::string & filename, const char * data, uint32_t size)
+{
+  std::scoped_lock guard(mutex);
+
+  uint32_t item_size, crc;
+  if (!check_entry(filename, item_size, crc) || (item_size != size)) return;
+
+  uint32_t key = hash(filename);
+  if (find(key) != entries.end()) return;
+
+  if (Inflate::update_crc32(0, (const uint8_t *) data, size) != crc) {
+    LOG_E("CRC-32 mismatch for item %s. Not cached.", filename.c_str());
+    return;
+  }
+
+  uint32_t length = sizeof(ItemHeader) + filename.size() + size + 1;
+  if ((length > MAX_CACHE_SIZE) || (filename.size() > 255)) return;
+
+  while (!entries.empty() && ((total_size + length) > MAX_CACHE_SIZE)) {
+    drop(std::prev(entries.end()));
+  }
+
+  ItemHeader header;
+
+  header.size        = size;
+  header.crc       = crc;
+  header.name_length = filename.size();
+
+  std::string item_filename = get_item_filename(key);
+  FILE * f = fopen(item_filename.c_str(), "w");
+  if (f == nullptr) return;
+
+  bool ok = (fwrite(&header,          sizeof(ItemHeader),  1, f) == 1) &&
+            (fwrite(filename.c_str(), header.name_length,  1, f) == 1) &&
+            (fwrite(data,             size + 1,            1, f) == 1);
+
+  fclose(f);
+
+  if (ok) {
+    entries.push_front({ key, length });
+    total_size += length;
+    save_index();
+  }
+  else {
+    LOG_E("Unable to save item %s in cache.", filename.c_str());
+    unlink(item_filename.c_str());
+  }
+}
+
+void
+ItemCache::release(char * data)
+{
+  if (data == nullptr) return;
+
+  #if EPUB_LINUX_BUILD
+    {
+      std::scoped_lock guard(mutex);
+      Mappings::iterator it = mappings.find(data);
+      if (it != mappings.end()) {
+        munmap(it->second.addr, it->second.length);
+        mappings.erase(it);
+        return;
+      }
+    }
+  #endif
+
+  free(data);
+}
@@ -5,12 +5,14 @@
 #include "models/jpeg_image.hpp"
 
 #include "helpers/unzip.hpp"
+#include "helpers/memory_budget.hpp"
 #include "viewers/msg_viewer.hpp"
 
 #include "alloc.hpp"
 
 #if defined(BOARD_TYPE_PAPER_S3)
   #include <JPEGDEC.h>
+  #include <memory>
 #else
   #include "tjpgdec.hpp"
 #endif
@@ -168,15 +170,18 @@ JPegImage::JPegImage(std::string filename, Dim max, bool load_bitmap) : Image(fi
     return;
   }
 
-  JPEGDEC jpeg;
-  if (!jpeg.openRAM((uint8_t *)jpg_data, (int)jpg_size, JPEGDraw)) {
-    LOG_E("JPEGDEC open failed. Error: %d", jpeg.getLastError());
+  // The decoder holds about 16KB of state: too much for the stack of the
+  // tasks that load images (e.g. the HTTP server one for the book covers).
+
+  std::unique_ptr<JPEGDEC> jpeg = std::make_unique<JPEGDEC>();
+  if (!jpeg->openRAM((uint8_t *)jpg_data, (int)jpg_size, JPEGDraw)) {
+    LOG_E("JPEGDEC open failed. Error: %d", jpeg->getLastError());
     free(jpg_data);
     return;
   }
 
-    const uint16_t orig_w = (uint16_t)jpeg.getWidth();
-    const uint16_t orig_h = (uint16_t)jpeg.getHeight();
+    const uint16_t orig_w = (uint16_t)jpeg->getWidth();
+    const uint16_t orig_h = (uint16_t)jpeg->getHeight();
     orig_dim = Dim(orig_w, orig_h);
     size_retrieved = true;
 
@@ -192,21 +197,21 @@ JPegImage::JPegImage(std::string filename, Dim max, bool load_bitmap) : Image(fi
 
     if (load_bitmap) {
       image_data.dim = Dim(out_w, out_h);
-      image_data.bitmap = (uint8_t *)allocate(out_w * out_h);
+      image_data.bitmap = (uint8_t *) memory_budget.allocate(MemoryBudget::Consumer::IMAGES, out_w * out_h);
       if (image_data.bitmap == nullptr) {
-        jpeg.close();
+        jpeg->close();
         free(jpg_data);
         return;
       }
     }
     else {
       image_data.dim = Dim(out_w, out_h);
-      jpeg.close();
+      jpeg->close();
       free(jpg_data);
       return;
     }
 
-    jpeg.setPixelType(EIGHT_BIT_GRAYSCALE);
+    jpeg->setPixelType(EIGHT_BIT_GRAYSCALE);
 
     int options = JPEG_LUMA_ONLY;
     if (scale == 1) options |= JPEG_SCALE_HALF;
@@ -214,18 +219,18 @@ JPegImage::JPegImage(std::string filename, Dim max, bool load_bitmap) : Image(fi
     else if (scale == 3) options |= JPEG_SCALE_EIGHTH;
 
     JpegDecCtx ctx{&image_data};
-    jpeg.setUserPointer(&ctx);
+    jpeg->setUserPointer(&ctx);
 
     #if EPUB_INKPLATE_BUILD
       load_start_time   = ESP::millis();
       waiting_msg_shown = false;
     #endif
 
-    if (!jpeg.decode(0, 0, options)) {
-      LOG_E("JPEGDEC decode failed. Error: %d", jpeg.getLastError());
+    if (!jpeg->decode(0, 0, options)) {
+      LOG_E("JPEGDEC decode failed. Error: %d", jpeg->getLastError());
     }
 
-    jpeg.close();
+    jpeg->close();
     free(jpg_data);
 
   #else
@@ -236,7 +241,7 @@ JPegImage::JPegImage(std::string filename, Dim max, bool load_bitmap) : Image(fi
       size_t    sz_work = WORK_SIZE;
 
       /* Prepare to decompress */
-      work = (uint8_t *) allocate(sz_work);
+      work = (uint8_t *) memory_budget.allocate(MemoryBudget::Consumer::IMAGES, sz_work);
       res  = jdec_prepare(&jdec, in_func, work, sz_work, &image_data);
       if (res == JDR_OK) {
         uint8_t scale = 0;
@@ -257,7 +262,7 @@ JPegImage::JPegImage(std::string filename, Dim max, bool load_bitmap) : Image(fi
         LOG_D("Image size: [%d, %d] %d bytes.", width, height, width * height);
         
         if (load_bitmap) {
-          if ((image_data.bitmap = (uint8_t *) allocate(width * height)) != nullptr) {
+          if ((image_data.bitmap = (uint8_t *) memory_budget.allocate(MemoryBudget::Consumer::IMAGES, width * height)) != nullptr) {
             image_data.dim    = Dim(width, height);
             // first = true;
             #if EPUB_INKPLATE_BUILD
@@ -275,7 +280,7 @@ JPegImage::JPegImage(std::string filename, Dim max, bool load_bitmap) : Image(fi
         LOG_E("Unable to load image. Error code: %d", res);
       }
 
-      free(work);
+      memory_budget.release(MemoryBudget::Consumer::IMAGES, work, sz_work);
       unzip.close_stream_file();
     }
   #endif
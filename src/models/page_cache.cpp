@@ -0,0 +1,232 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __PAGE_CACHE__ 1
+#include "models/page_cache.hpp"
+
+#include "models/config.hpp"
+#include "models/item_cache.hpp"
+#include "helpers/unzip.hpp"
+#include "helpers/inflate.hpp"
+#include "helpers/perf_stats.hpp"
+
+void
+PageCache::open(const std::string & epub_filename)
+{
+  std::scoped_lock guard(mutex);
+
+  int8_t item_cache_enabled = 0;
+  config.get(Config::Ident::ITEM_CACHE, &item_cache_enabled);
+
+  if (file != nullptr) fclose(file);
+  file = nullptr;
+
+  if (item_cache_enabled == 0) return;
+
+  std::string filename = ItemCache::get_book_folder(epub_filename) + "/pages";
+
+  if ((file = fopen(filename.c_str(), "r+b")) != nullptr) {
+    if (load_index()) return;
+    fclose(file);
+  }
+
+  LOG_I("No valid pages cache. A new one is created.");
+
+  if ((file = fopen(filename.c_str(), "w+b")) == nullptr) {
+    LOG_E("Unable to create pages cache: %s", filename.c_str());
+    return;
+  }
+
+  reset();
+}
+
+void
+PageCache::close()
+{
+  std::scoped_lock guard(mutex);
+
+  if (file != nullptr) {
+    fclose(file);
+    file = nullptr;
+  }
+  entries.clear();
+}
+
+bool
+PageCache::load_index()
+{
+  entries.resize(ENTRY_COUNT);
+
+  if ((fseek(file, 0, SEEK_SET) != 0) ||
+      (fread(&header, sizeof(Header), 1, file) != 1) ||
+      (header.version != CACHE_FILE_VERSION) ||
+      (header.write_pos > DATA_SIZE) ||
+      (fread(entries.data(), sizeof(Entry), ENTRY_COUNT, file) != ENTRY_COUNT)) {
+    return false;
+  }
+
+  seq = 0;
+  for (auto & entry : entries) {
+    if ((entry.itemref_index != -1) && 
+        (((entry.position + entry.length) > DATA_SIZE) || (entry.length > MAX_PAGE_SIZE))) {
+      return false;
+    }
+    if (entry.seq >= seq) seq = entry.seq + 1;
+  }
+
+  return true;
+}
+
+bool
+PageCache::save_index()
+{
+  bool ok = (fseek(file, 0, SEEK_SET) == 0) &&
+            (fwrite(&header, sizeof(Header), 1, file) == 1) &&
+            (fwrite(entries.data(), sizeof(Entry), ENTRY_COUNT, file) == ENTRY_COUNT) &&
+            (fflush(file) == 0);
+
+  if (!ok) LOG_E("Unable to save pages cache index.");
+
+  return ok;
+}
+
+bool
+PageCache::save_entry(const Entry & entry)
+{
+  bool ok = (fseek(file, 0, SEEK_SET) == 0) &&
+            (fwrite(&header, sizeof(Header), 1, file) == 1) &&
+            (fseek(file, sizeof(Header) + (&entry - entries.data()) * sizeof(Entry), SEEK_SET) == 0) &&
+            (fwrite(&entry, sizeof(Entry), 1, file) == 1) &&
+            (fflush(file) == 0);
+
+  if (!ok) LOG_E("Unable to save pages cache entry.");
+
+  return ok;
+}
+
+void
+PageCache::reset()
+{
+  Entry empty = { .itemref_index = -1, .offset = 0, .position = 0, .length = 0, .crc = 0, .seq = 0 };
+
+  entries.assign(ENTRY_COUNT, empty);
+
+  header.version       = CACHE_FILE_VERSION;
+  header.format_params = *epub.get_book_format_params();
+  header.write_pos     = 0;
+  seq                  = 0;
+
+  save_index();
+}
+
+void
+PageCache::clear()
+{
+  std::scoped_lock guard(mutex);
+
+  if (file != nullptr) reset();
+}
+
+PageCache::Entry *
+PageCache::find(const PageLocs::PageId & page_id)
+{
+  for (auto & entry : entries) {
+    if ((entry.itemref_index == page_id.itemref_index) &&
+        (entry.offset        == page_id.offset       )) return &entry;
+  }
+  return nullptr;
+}
+
+bool
+PageCache::get(const PageLocs::PageId & page_id, std::vector<uint8_t> & data)
+{
+  std::scoped_lock guard(mutex);
+
+  if ((file == nullptr) ||
+      (memcmp(&header.format_params, epub.get_book_format_params(), sizeof(EPub::BookFormatParams)) != 0)) {
+    return false;
+  }
+
+  Entry * entry = find(page_id);
+  if (entry == nullptr) {
+    PERF_COUNT(PAGE_CACHE_MISS);
+    return false;
+  }
+
+  data.resize(entry->length);
+
+  if ((fseek(file, DATA_START + entry->position, SEEK_SET) == 0) &&
+      (fread(data.data(), entry->length, 1, file) == 1) &&
+      (Inflate::update_crc32(0, data.data(), entry->length) == entry->crc)) {
+    PERF_COUNT(PAGE_CACHE_HIT);
+    return true;
+  }
+
+  LOG_I("Cached page (%d, %d) is not valid. Dropped.", page_id.itemref_index, page_id.offset);
+  PERF_COUNT(PAGE_CACHE_MISS);
+  entry->itemref_index = -1;
+  save_entry(*entry);
+  data.clear();
+
+  return false;
+}
+
+void
+PageCache::put(const PageLocs::PageId & page_id, const std::vector<uint8_t> & data)
+{
+  std::scoped_lock guard(mutex);
+
+  if ((file == nullptr) || data.empty() || (data.size() > MAX_PAGE_SIZE)) return;
+
+  if (memcmp(&header.format_params, epub.get_book_format_params(), sizeof(EPub::BookFormatParams)) != 0) {
+    reset();
+  }
+
+  uint32_t length = data.size();
+  if ((header.write_pos + length) > DATA_SIZE) header.write_pos = 0;
+
+  // Pages overwritten in the data area are forgotten. The entry to reuse is
+  // the one of the same page, a free one or else the oldest one.
+
+  Entry * slot = nullptr;
+  for (auto & entry : entries) {
+    if (entry.itemref_index == -1) {
+      if ((slot == nullptr) || (slot->itemref_index != -1)) slot = &entry;
+      continue;
+    }
+    if ((entry.itemref_index == page_id.itemref_index) && (entry.offset == page_id.offset)) {
+      entry.itemref_index = -1;
+      slot = &entry;
+      continue;
+    }
+    if ((entry.position < (header.write_pos + length)) && 
+        (header.write_pos < (entry.position + entry.length))) {
+      entry.itemref_index = -1;
+      if ((slot == nullptr) || (slot->itemref_index != -1)) slot = &entry;
+      continue;
+    }
+    if ((slot == nullptr) || ((slot->itemref_index != -1) && (entry.seq < slot->seq))) slot = &entry;
+  }
+
+  slot->itemref_index = -1;
+
+  bool ok = (fseek(file, DATA_START + header.write_pos, SEEK_SET) == 0) &&
+            (fwrite(data.data(), length, 1, file) == 1);
+
+  if (ok) {
+    slot->itemref_index = page_id.itemref_index;
+    slot->offset        = page_id.offset;
+    slot->position      = header.write_pos;
+    slot->length        = length;
+    slot->crc           = Inflate::update_crc32(0, data.data(), length);
+    slot->seq           = seq++;
+
+    header.write_pos   += length;
+  }
+  else {
+    LOG_E("Unable to save page (%d, %d) in cache.", page_id.itemref_index, page_id.offset);
+  }
+
+  save_entry(*slot);
+}
@@ -6,13 +6,18 @@
 #include "models/page_locs.hpp"
 
 #include "models/toc.hpp"
+#include "models/search_index.hpp"
 #include "models/config.hpp"
 #include "models/fonts.hpp"
 #include "controllers/event_mgr.hpp"
+#include "models/page_cache.hpp"
 #include "viewers/screen_bottom.hpp"
 
 #include "viewers/book_viewer.hpp"
 #include "viewers/page.hpp"
+#include "viewers/form_viewer.hpp"
+#include "helpers/perf_stats.hpp"
+#include "helpers/memory_budget.hpp"
 
 #include <iostream>
 #include <fstream>
@@ -33,7 +38,7 @@ struct StateQueueData {
   int16_t itemref_count;
 };
 
-enum class RetrieveReq  : int8_t { ABORT, RETRIEVE_ITEM, GET_ASAP, SHOW_HEAP };
+enum class RetrieveReq  : int8_t { ABORT, RETRIEVE_ITEM, GET_ASAP, GET_VARIANTS, SHOW_HEAP };
 
 struct RetrieveQueueData {
   RetrieveReq req;
@@ -42,6 +47,7 @@ struct RetrieveQueueData {
 
 #if EPUB_LINUX_BUILD
   #include <chrono>
+  #include <unistd.h>
 
   static mqd_t mgr_queue;
   static mqd_t state_queue;
@@ -167,6 +173,15 @@ class StateTask
           QUEUE_SEND(retrieve_queue, retrieve_queue_data, 0);
           retriever_iddle = false;
           LOG_D("Sent RETRIEVE_ITEM to Retriever");
+        } else if ((newref = page_locs.next_deferred_item()) != -1) {
+          waiting_for_itemref = newref;
+          retrieve_queue_data = {
+            .req           = RetrieveReq::GET_VARIANTS,
+            .itemref_index = waiting_for_itemref
+          };
+          QUEUE_SEND(retrieve_queue, retrieve_queue_data, 0);
+          retriever_iddle = false;
+          LOG_D("Sent GET_VARIANTS to Retriever");
         } else {
           page_locs.computation_completed();
           retriever_iddle = true;
@@ -406,12 +421,17 @@ class RetrieverTask
             continue;
           }
 
-          LOG_D("-> %s <-", (retrieve_queue_data.req == RetrieveReq::GET_ASAP) ? "GET_ASAP" : "RETRIEVE_ITEM");
+          LOG_D("-> %s <-", (retrieve_queue_data.req == RetrieveReq::GET_ASAP    ) ? "GET_ASAP"     :
+                            (retrieve_queue_data.req == RetrieveReq::GET_VARIANTS) ? "GET_VARIANTS" : "RETRIEVE_ITEM");
 
           LOG_D("Retrieving itemref --> %d <--", retrieve_queue_data.itemref_index);
+
+          PageLocs::Pass pass = (retrieve_queue_data.req == RetrieveReq::GET_ASAP    ) ? PageLocs::Pass::BOOK     :
+                                (retrieve_queue_data.req == RetrieveReq::GET_VARIANTS) ? PageLocs::Pass::VARIANTS :
+                                                                                         PageLocs::Pass::ALL;
           
           int16_t itemref_index;
-          if (!page_locs.build_page_locs(retrieve_queue_data.itemref_index)) {
+          if (!page_locs.build_page_locs(retrieve_queue_data.itemref_index, pass)) {
             // Unable to retrieve pages location for the requested index. Send back
             // a negative value to indicate the issue to the state task
             itemref_index = -(retrieve_queue_data.itemref_index + 1);
@@ -439,19 +459,25 @@ void
 PageLocs::setup()
 {
   #if EPUB_LINUX_BUILD
-    mq_unlink("/mgr");
-    mq_unlink("/state");
-    mq_unlink("/retrieve");
+    // The queues names are made unique to the process, as several ones may
+    // compute pages locations at the same time (see PrePaginator). They are
+    // removed once open: the queues remain until the process ends.
+
+    std::string suffix = "_" + std::to_string(getpid());
 
-    mgr_queue      = mq_open("/mgr",      O_RDWR|O_CREAT, S_IRWXU, &mgr_attr);
+    mgr_queue      = mq_open(("/mgr"      + suffix).c_str(), O_RDWR|O_CREAT, S_IRWXU, &mgr_attr);
     if (mgr_queue == -1) { LOG_E("Unable to open mgr_queue: %d", errno); return; }
 
-    state_queue    = mq_open("/state",    O_RDWR|O_CREAT, S_IRWXU, &state_attr);
+    state_queue    = mq_open(("/state"    + suffix).c_str(), O_RDWR|O_CREAT, S_IRWXU, &state_attr);
     if (state_queue == -1) { LOG_E("Unable to open state_queue: %d", errno); return; }
 
-    retrieve_queue = mq_open("/retrieve", O_RDWR|O_CREAT, S_IRWXU, &retrieve_attr);
+    retrieve_queue = mq_open(("/retrieve" + suffix).c_str(), O_RDWR|O_CREAT, S_IRWXU, &retrieve_attr);
     if (retrieve_queue == -1) { LOG_E("Unable to open retrieve_queue: %d", errno); return; }
 
+    mq_unlink(("/mgr"      + suffix).c_str());
+    mq_unlink(("/state"    + suffix).c_str());
+    mq_unlink(("/retrieve" + suffix).c_str());
+
     retriever_thread = std::thread(retriever_task);
     state_thread     = std::thread(state_task);
   #else
@@ -503,13 +529,30 @@ PageLocs::abort_threads()
 class PageLocsInterp : public HTMLInterpreter 
 {
   public:
-    PageLocsInterp(Page & the_page, DOM & the_dom, Page::ComputeMode the_comp_mode, const EPub::ItemInfo & the_item) : 
-      HTMLInterpreter(the_page, the_dom, the_comp_mode, the_item) {}
+    PageLocsInterp(Page & the_page, DOM & the_dom, Page::ComputeMode the_comp_mode, const EPub::ItemInfo & the_item,
+                   PageLocs::Variant * the_variant) : 
+      HTMLInterpreter(the_page, the_dom, the_comp_mode, the_item),
+      variant(the_variant) {}
     ~PageLocsInterp() {}
     
     void doc_end(const Page::Format & fmt) { page_end(fmt); }
 
+  private:
+    Checkpoint          start_checkpoint; ///< Checkpoint of the page being computed
+    PageLocs::Variant * variant;          ///< nullptr: the book format parameters pages locations
+
+    inline SearchIndex & index() { return (variant == nullptr) ? search_index : *variant->index; }
+
   protected:
+    void word_added(const char * word, int16_t count) {
+      index().add_word(word, count);
+    }
+
+    // Gives the chance to book_viewer to show a page if required
+    void paragraph_ended() {
+      std::this_thread::yield();
+    }
+
     bool page_end(const Page::Format & fmt) {
 
       // if (page_locs.get_pages_map().size() == 38) {
@@ -521,13 +564,15 @@ class PageLocsInterp : public HTMLInterpreter
 
         PageLocs::PageId   page_id   = PageLocs::PageId(page_locs.get_item_info().itemref_index, start_offset);
         PageLocs::PageInfo page_info = PageLocs::PageInfo(current_offset - start_offset, -1);
+        page_info.checkpoint = start_checkpoint;
         
         if ((page_info.size > 0) || ((page_id.itemref_index == 0) && (page_id.offset == 0))) {
           if (page_info.size == 0) page_info.size = 1; // Patch for the case when it's the title page and no image is to be shown
           if ((page_locs.get_item_info().itemref_index > 0) && (page.is_empty())) {
             page_info.size = -page_info.size; // The page will not be counted nor displayed
           }
-          res = page_locs.insert(page_id, page_info);
+          res = (variant == nullptr) ? page_locs.insert(page_id, page_info)
+                                     : page_locs.insert(*variant, page_id, page_info);
           #if DEBUGGING
             std::cout << page_id.offset << '|' 
                       << page_id.offset + page_info.size << ", " 
@@ -535,11 +580,6 @@ class PageLocsInterp : public HTMLInterpreter
                       << page_info.size << std::endl;
           #endif
         }
-        // Gives the chance to book_viewer to show a page if required
-        book_viewer.get_mutex().unlock();
-        std::this_thread::yield();
-        book_viewer.get_mutex().lock();
-
         // LOG_D("Page %d, offset: %d, size: %d", epub.get_page_count(), loc.offset, loc.size);
     
         #if DEBUGGING
@@ -548,7 +588,10 @@ class PageLocsInterp : public HTMLInterpreter
         check_page_to_show(page_locs.get_pages_map().size()); // Debugging stuff
       //}
 
-      start_offset = current_offset;
+      start_checkpoint = get_checkpoint();
+      start_offset     = current_offset;
+
+      index().start_page(PageLocs::PageId(page_locs.get_item_info().itemref_index, start_offset));
 
       page.start(fmt); // Start a new page
       // beginning_of_page = true;
@@ -558,115 +601,150 @@ class PageLocsInterp : public HTMLInterpreter
 };
 
 bool
-PageLocs::build_page_locs(int16_t itemref_index)
+PageLocs::locate_pages(Page & page, const EPub::BookFormatParams & format_params, Variant * variant)
 {
-  std::scoped_lock guard(book_viewer.get_mutex());
+  int16_t idx;
 
-  Font * font = fonts.get(ScreenBottom::FONT);
-  page_bottom = font->get_line_height(ScreenBottom::FONT_SIZE) + (font->get_line_height(ScreenBottom::FONT_SIZE) >> 1);
+  if ((idx = fonts.get_index("Fontbase", Fonts::FaceStyle::NORMAL)) == -1) {
+    idx = 3;
+  }
   
-  //page_out.set_compute_mode(Page::ComputeMode::LOCATION);
+  int8_t font_size = format_params.font_size;
 
-  //show_images = current_format_params.show_images == 1;
+  int8_t show_title = 0;
+  config.get(Config::Ident::SHOW_TITLE, &show_title);
+
+  int16_t page_top = 0;
+
+  if (show_title != 0) {
+    Font * title_font     = fonts.get(book_viewer.TITLE_FONT);
+    page_top              = title_font->get_chars_height(book_viewer.TITLE_FONT_SIZE) + 10;
+  }
+
+  Page::Format fmt = {
+    .line_height_factor = 0.95,
+    .font_index         = idx,
+    .font_size          = font_size,
+    .indent             = 0,
+    .margin_left        = 0,
+    .margin_right       = 0,
+    .margin_top         = 0,
+    .margin_bottom      = 0,
+    .screen_left        = 10,
+    .screen_right       = 10,
+    .screen_top         = page_top,
+    .screen_bottom      = page_bottom,
+    .width              = 0,
+    .height             = 0,
+    .vertical_align     = 0,
+    .trim               = true,
+    .pre                = false,
+    .font_style         = Fonts::FaceStyle::NORMAL,
+    .align              = CSS::Align::LEFT,
+    .text_transform     = CSS::TextTransform::NONE,
+    .display            = CSS::Display::INLINE
+  };
 
   bool done = false;
 
-  if (epub.get_item_at_index(itemref_index, item_info)) {
+  DOM            * dom    = new DOM(item_info.arena);
+  PageLocsInterp * interp = new PageLocsInterp(page, 
+                                               *dom,
+                                               Page::ComputeMode::LOCATION, 
+                                               item_info,
+                                               variant);
 
-    int16_t idx;
+  #if DEBUGGING_AID
+    interp->set_pages_to_show_state(PAGE_FROM, PAGE_TO);
+    interp->check_page_to_show(pages_map.size());
+  #endif
 
-    if ((idx = fonts.get_index("Fontbase", Fonts::FaceStyle::NORMAL)) == -1) {
-      idx = 3;
-    }
-    
-    int8_t font_size = current_format_params.font_size;
+  interp->set_limits(0, 
+                     9999999,
+                     format_params.show_images == 1);
+
+  ((variant == nullptr) ? search_index : *variant->index).start_page(PageId(item_info.itemref_index, 0));
+
+  while (!done) {
+
+    // current_offset       = 0;
+    // start_of_page_offset = 0;
+    xml_node node;
+
+    if ((node = item_info.xml_doc.child("html").child("body"))) {
 
-    int8_t show_title;
-    config.get(Config::Ident::SHOW_TITLE, &show_title);
+      page.start(fmt);
 
-    int16_t page_top = 0;
+      #if EPUB_INKPLATE_BUILD && !defined(BOARD_TYPE_PAPER_S3)
+        esp_task_wdt_reset();
+      #endif
+      
+      Page::Format * new_fmt = interp->duplicate_fmt(fmt);
+      if (!interp->build_pages_recurse(node, *new_fmt, dom->body, 1)) {
+        interp->release_fmt(new_fmt);
+        LOG_D("html parsing issue or aborted by Mgr");
+        break;
+      }
+      interp->release_fmt(new_fmt);
 
-    if (show_title != 0) {
-      Font * title_font     = fonts.get(book_viewer.TITLE_FONT);
-      page_top              = title_font->get_chars_height(book_viewer.TITLE_FONT_SIZE) + 10;
+      if (page.some_data_waiting()) page.end_paragraph(fmt);
+    }
+    else {
+      LOG_D("No <body>");
+      break;
     }
 
-    Page::Format fmt = {
-      .line_height_factor = 0.95,
-      .font_index         = idx,
-      .font_size          = font_size,
-      .indent             = 0,
-      .margin_left        = 0,
-      .margin_right       = 0,
-      .margin_top         = 0,
-      .margin_bottom      = 0,
-      .screen_left        = 10,
-      .screen_right       = 10,
-      .screen_top         = page_top,
-      .screen_bottom      = page_bottom,
-      .width              = 0,
-      .height             = 0,
-      .vertical_align     = 0,
-      .trim               = true,
-      .pre                = false,
-      .font_style         = Fonts::FaceStyle::NORMAL,
-      .align              = CSS::Align::LEFT,
-      .text_transform     = CSS::TextTransform::NONE,
-      .display            = CSS::Display::INLINE
-    };
+    interp->doc_end(fmt);
 
-    DOM            * dom    = new DOM;
-    PageLocsInterp * interp = new PageLocsInterp(page_out, 
-                                                 *dom, 
-                                                 Page::ComputeMode::LOCATION, 
-                                                 item_info);
+    done = true;
+  }
 
-    #if DEBUGGING_AID
-      interp->set_pages_to_show_state(PAGE_FROM, PAGE_TO);
-      interp->check_page_to_show(pages_map.size());
-    #endif
+  //dom->show();
+  delete interp;
+  interp = nullptr;
 
-    interp->set_limits(0, 
-                       9999999,
-                       current_format_params.show_images == 1);
+  delete dom;
+  dom = nullptr;
 
-    while (!done) {
+  return done;
+}
 
-      // current_offset       = 0;
-      // start_of_page_offset = 0;
-      xml_node node;
+bool
+PageLocs::build_page_locs(int16_t itemref_index, Pass pass)
+{
+  // No viewer lock is taken here: the item is retrieved and parsed in its own
+  // ItemInfo, the format parameters are a copy made when the computation
+  // started and the fonts in use are kept alive by their snapshot.
 
-      if ((node = item_info.xml_doc.child("html").child("body"))) {
+  Fonts::Snapshot     fonts_in_use = fonts.get_snapshot();
+  MemoryBudget::InUse glyphs_in_use(MemoryBudget::Consumer::GLYPHS);
+  PERF_SCOPE(LAYOUT);
 
-        page_out.start(fmt);
+  Font * font = fonts.get(ScreenBottom::FONT);
+  page_bottom = font->get_line_height(ScreenBottom::FONT_SIZE) + (font->get_line_height(ScreenBottom::FONT_SIZE) >> 1);
+  
+  //page_out.set_compute_mode(Page::ComputeMode::LOCATION);
 
-        #if EPUB_INKPLATE_BUILD && !defined(BOARD_TYPE_PAPER_S3)
-          esp_task_wdt_reset();
-        #endif
-        
-        Page::Format * new_fmt = interp->duplicate_fmt(fmt);
-        if (!interp->build_pages_recurse(node, *new_fmt, dom->body, 1)) {
-          interp->release_fmt(new_fmt);
-          LOG_D("html parsing issue or aborted by Mgr");
-          break;
-        }
-        interp->release_fmt(new_fmt);
+  //show_images = current_format_params.show_images == 1;
 
-        if (page_out.some_data_waiting()) page_out.end_paragraph(fmt);
-      }
-      else {
-        LOG_D("No <body>");
-        break;
-      }
+  bool done = false;
 
-      interp->doc_end(fmt);
+  if (epub.get_item_at_index(itemref_index, item_info)) {
 
-      done = true;
-    }
+    done = (pass == Pass::VARIANTS) || locate_pages(page_out, current_format_params, nullptr);
+
+    // The variants lay out the same parsed item. The DOM is built again by
+    // each pass, as the interpreter computes it along the layout.
 
-    //dom->show();
-    delete dom;
-    dom = nullptr;
+    if (pass == Pass::BOOK) {
+      if (done && !variants.empty()) deferred_items.insert(itemref_index);
+    }
+    else {
+      for (auto & variant : variants) {
+        if (!done) break;
+        done = locate_pages(variant.page_out, variant.format_params, &variant);
+      }
+    }
   }
 
   //page_out.set_compute_mode(Page::ComputeMode::DISPLAY);
@@ -726,6 +804,7 @@ void
 PageLocs::start_new_document(int16_t count, int16_t itemref_index) 
 { 
   if (!state_task.retriever_is_iddle()) stop_document();
+  search_index.clear();
 
   check_for_format_changes(count, itemref_index, !load(epub.get_current_filename()));
 }
@@ -758,11 +837,27 @@ PageLocs::insert(PageId & id, PageInfo & info)
   return false;
 }
 
+// The variants are only used by the retriever thread, then by the state
+// thread once the computation is completed.
+
+bool 
+PageLocs::insert(Variant & variant, PageId & id, PageInfo & info) 
+{
+  if (state_task.forgetting_retrieval()) return false;
+
+  variant.pages_map.insert(std::make_pair(id, info));
+  return true;
+}
+
 PageLocs::PagesMap::iterator 
 PageLocs::check_and_find(const PageId & page_id) 
 {
   PagesMap::iterator it = pages_map.find(page_id);
-  if (!completed && (it == pages_map.end())) {
+
+  // Past the last item, there is nothing to retrieve. Requesting it would
+  // leave the state task looking forever for the next item to compute.
+
+  if (!completed && (it == pages_map.end()) && (page_id.itemref_index < item_count)) {
     if (retrieve_asap(page_id.itemref_index)) it = pages_map.find(page_id);
   }
   return it;
@@ -861,6 +956,18 @@ PageLocs::get_page_id(const PageId & page_id)
   return (result == pages_map.end()) ? nullptr : &result->first ;
 }
 
+const PageLocs::PageId * 
+PageLocs::get_page_id_at(int16_t page_nbr) 
+{
+  std::scoped_lock guard(mutex);
+
+  if (!completed) return nullptr;
+  for (auto & entry : pages_map) {
+    if (entry.second.page_number == page_nbr) return &entry.first;
+  }
+  return nullptr;
+}
+
 void
 PageLocs::computation_completed()
 {
@@ -874,12 +981,18 @@ PageLocs::computation_completed()
 
     page_count = page_nbr;
 
-    save(epub.get_current_filename());
+    save(epub.get_current_filename(), current_format_params, pages_map);
+    search_index.save(epub.get_current_filename(), pages_map, current_format_params);
+
+    for (auto & variant : variants) save_variant(variant);
+    clear_variants();
   
     //show();
 
-    completed = true;
+    // Both files are saved when the completion is seen
+
     toc.save();
+    completed = true;
     event_mgr.set_stay_on(false);
     // #if EPUB_INKPLATE_BUILD && (LOG_LOCAL_LEVEL == ESP_LOG_VERBOSE)
     //   ESP::show_heaps_info();
@@ -908,21 +1021,164 @@ PageLocs::computation_completed()
   }
 #endif
 
+std::string
+PageLocs::variant_filename(const std::string & epub_filename, int8_t font_size)
+{
+  return epub_filename.substr(0, epub_filename.find_last_of('.')) + 
+         '.' + std::to_string(font_size) + "pt.epub";
+}
+
+void
+PageLocs::save_variant(Variant & variant)
+{
+  int16_t page_nbr = 0;
+  for (auto & entry : variant.pages_map) {
+    if (entry.second.size >= 0) entry.second.page_number = page_nbr++;
+  }
+
+  std::string filename = variant_filename(epub.get_current_filename(), variant.format_params.font_size);
+
+  save(filename, variant.format_params, variant.pages_map);
+  variant.index->save(filename, variant.pages_map, variant.format_params);
+}
+
+void
+PageLocs::clear_variants()
+{
+  for (auto & variant : variants) delete variant.index;
+  variants.clear();
+  deferred_items.clear();
+}
+
+// The state task only asks for the deferred items when the retriever is
+// waiting for its next request: the set is not shared at that time.
+
+int16_t
+PageLocs::next_deferred_item()
+{
+  if (deferred_items.empty()) return -1;
+
+  int16_t itemref_index = *deferred_items.begin();
+  deferred_items.erase(deferred_items.begin());
+  return itemref_index;
+}
+
+static bool
+move_file(const std::string & from, const std::string & to)
+{
+  remove(to.c_str());
+  return rename(from.c_str(), to.c_str()) == 0;
+}
+
+static std::string
+sidecar_filename(const std::string & epub_filename, const char * ext)
+{
+  return epub_filename.substr(0, epub_filename.find_last_of('.')) + ext;
+}
+
+void
+PageLocs::remove_variants(const std::string & epub_filename)
+{
+  for (auto & choice : FormChoiceField::font_size_choices) {
+    std::string variant = variant_filename(epub_filename, choice.value);
+    remove(sidecar_filename(variant, ".locs").c_str());
+    remove(sidecar_filename(variant, ".sidx").c_str());
+  }
+}
+
+// The completed pages locations become the variant of their font size.
+
+void
+PageLocs::keep_as_variant()
+{
+  const std::string & filename = epub.get_current_filename();
+  std::string         previous = variant_filename(filename, current_format_params.font_size);
+
+  move_file(sidecar_filename(filename, ".locs"), sidecar_filename(previous, ".locs"));
+  move_file(sidecar_filename(filename, ".sidx"), sidecar_filename(previous, ".sidx"));
+}
+
+// The files of a variant are renamed to become the current pages locations.
+// The current ones, if completed, become the variant of their font size.
+
+bool
+PageLocs::switch_to_variant(int16_t count)
+{
+  const std::string      & filename = epub.get_current_filename();
+  EPub::BookFormatParams   format_params;
+
+  std::string variant = variant_filename(filename, epub.get_book_format_params()->font_size);
+
+  if (!read_format_params(variant, format_params) ||
+      (memcmp(epub.get_book_format_params(), &format_params, sizeof(format_params)) != 0)) {
+    return false;
+  }
+
+  LOG_D("==> Page locations from the %d points variant. <==", format_params.font_size);
+
+  if (!state_task.retriever_is_iddle()) stop_document();
+  clear_variants();
+
+  if (completed && (current_format_params.font_size != format_params.font_size)) keep_as_variant();
+
+  clear();  
+  page_cache.clear();
+  search_index.clear();
+
+  item_count = count;
+
+  return move_file(sidecar_filename(variant, ".locs"), sidecar_filename(filename, ".locs")) &&
+         move_file(sidecar_filename(variant, ".sidx"), sidecar_filename(filename, ".sidx")) &&
+         load(filename) &&
+         (memcmp(epub.get_book_format_params(), &current_format_params, sizeof(current_format_params)) == 0);
+}
+
 void
 PageLocs::check_for_format_changes(int16_t count, int16_t itemref_index, bool force)
 {
+  // A font size change is first looked for in the variants computed with the
+  // current pages locations. Failing that, everything is computed again, the
+  // completed pages locations being kept as the variant of their font size.
+
+  EPub::BookFormatParams format_params = current_format_params;
+  format_params.font_size = epub.get_book_format_params()->font_size;
+
+  bool font_size_change = (format_params.font_size != current_format_params.font_size) &&
+                          (memcmp(epub.get_book_format_params(), &format_params, sizeof(format_params)) == 0);
+
+  if (!force && font_size_change) force = !switch_to_variant(count);
+
   if (force || 
       (memcmp(epub.get_book_format_params(), &current_format_params, sizeof(current_format_params)) != 0) ||
-      !toc.load()) {
+      !toc.load() ||
+      !search_index.is_available(epub.get_current_filename(), current_format_params, page_count)) {
 
     LOG_D("==> Page locations recalc. <==");
 
     if (!state_task.retriever_is_iddle()) stop_document();
 
+    if (font_size_change && completed &&
+        search_index.is_available(epub.get_current_filename(), current_format_params, page_count)) {
+      keep_as_variant();
+    }
+
     clear();  
+    page_cache.clear();
+    search_index.clear();
 
     current_format_params = *epub.get_book_format_params();
 
+    clear_variants();
+    for (int8_t font_size : variant_font_sizes) {
+      if (font_size == current_format_params.font_size) continue;
+      variants.emplace_back();
+      Variant & variant = variants.back();
+      variant.format_params           = current_format_params;
+      variant.format_params.font_size = font_size;
+      variant.page_out.set_normal_font_size(font_size);
+      variant.index                   = new SearchIndex;
+    }
+
     if (toc.load_from_epub() && !toc.there_is_some_ids()) {
       // The table of content doesn't need to be synch with the
       // page location computation. I.e. there is no relation with HTML Ids
@@ -980,6 +1236,13 @@ bool PageLocs::load(const std::string & epub_filename)
       if (file.read(reinterpret_cast<char *>(&page_id.itemref_index), sizeof(page_id.itemref_index)).fail()) break;
       if (file.read(reinterpret_cast<char *>(&page_id.offset),        sizeof(page_id.offset       )).fail()) break;
       if (file.read(reinterpret_cast<char *>(&page_info.size),        sizeof(page_info.size       )).fail()) break;
+
+      HTMLInterpreter::Checkpoint & checkpoint = page_info.checkpoint;
+      if (file.read(reinterpret_cast<char *>(&checkpoint.offset),     sizeof(checkpoint.offset    )).fail()) break;
+      if (file.read(reinterpret_cast<char *>(&checkpoint.depth),      sizeof(checkpoint.depth     )).fail()) break;
+      if (checkpoint.depth > HTMLInterpreter::CHECKPOINT_MAX_DEPTH) { file.setstate(std::ios::failbit); break; }
+      if (file.read(reinterpret_cast<char *>(checkpoint.path), checkpoint.depth * sizeof(uint16_t)).fail()) break;
+
       page_info.page_number = (page_info.size >= 0) ? page_nbr++ : -1;
 
       page_locs.insert(page_id, page_info);
@@ -999,8 +1262,29 @@ bool PageLocs::load(const std::string & epub_filename)
   return ok;
 }
 
+bool
+PageLocs::read_format_params(const std::string & epub_filename, EPub::BookFormatParams & format_params)
+{
+  std::string   filename = epub_filename.substr(0, epub_filename.find_last_of('.')) + ".locs";
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+
+  if (!file.is_open()) return false;
+
+  int8_t version;
+
+  bool ok = !file.read(reinterpret_cast<char *>(&version), 1).fail() &&
+            (version == LOCS_FILE_VERSION) &&
+            !file.read(reinterpret_cast<char *>(&format_params), sizeof(format_params)).fail();
+
+  file.close();
+
+  return ok;
+}
+
 bool 
-PageLocs::save(const std::string & epub_filename)
+PageLocs::save(const std::string            & epub_filename,
+               const EPub::BookFormatParams & format_params,
+               const PagesMap               & map)
 {
   std::string   filename = epub_filename.substr(0, epub_filename.find_last_of('.')) + ".locs";
   std::ofstream file(filename, std::ios::out | std::ios::binary);
@@ -1012,17 +1296,22 @@ PageLocs::save(const std::string & epub_filename)
     return false;
   }
 
-  int16_t page_count = pages_map.size();
+  int16_t page_count = map.size();
 
   while (true) {
-    if (file.write(reinterpret_cast<const char *>(&LOCS_FILE_VERSION),     1                            ).fail()) break;
-    if (file.write(reinterpret_cast<const char *>(&current_format_params), sizeof(current_format_params)).fail()) break;
-    if (file.write(reinterpret_cast<const char *>(&page_count),            sizeof(page_count)           ).fail()) break;
+    if (file.write(reinterpret_cast<const char *>(&LOCS_FILE_VERSION), 1                    ).fail()) break;
+    if (file.write(reinterpret_cast<const char *>(&format_params),     sizeof(format_params)).fail()) break;
+    if (file.write(reinterpret_cast<const char *>(&page_count),        sizeof(page_count)   ).fail()) break;
 
-    for (auto & page : pages_map) {
+    for (auto & page : map) {
       if (file.write(reinterpret_cast<const char *>(&page.first.itemref_index), sizeof(page.first.itemref_index)).fail()) break;
       if (file.write(reinterpret_cast<const char *>(&page.first.offset),        sizeof(page.first.offset       )).fail()) break;
       if (file.write(reinterpret_cast<const char *>(&page.second.size),         sizeof(page.second.size        )).fail()) break;
+
+      const HTMLInterpreter::Checkpoint & checkpoint = page.second.checkpoint;
+      if (file.write(reinterpret_cast<const char *>(&checkpoint.offset), sizeof(checkpoint.offset)).fail()) break;
+      if (file.write(reinterpret_cast<const char *>(&checkpoint.depth),  sizeof(checkpoint.depth )).fail()) break;
+      if (file.write(reinterpret_cast<const char *>(checkpoint.path), checkpoint.depth * sizeof(uint16_t)).fail()) break;
     }
 
     break;
@@ -4,6 +4,7 @@
 
 #include "models/png_image.hpp"
 #include "helpers/unzip.hpp"
+#include "helpers/memory_budget.hpp"
 #include "viewers/msg_viewer.hpp"
 #include "alloc.hpp"
 
@@ -180,14 +181,14 @@ PngImage::PngImage(std::string filename, Dim max, bool load_bitmap) : Image(file
     }
 
     image_data.dim = Dim(out_w, out_h);
-    image_data.bitmap = (uint8_t *) allocate(out_w * out_h);
+    image_data.bitmap = (uint8_t *) memory_budget.allocate(MemoryBudget::Consumer::IMAGES, out_w * out_h);
     if (image_data.bitmap == nullptr) {
       png.close();
       free(png_data);
       return;
     }
 
-    uint16_t * rgb565_line = (uint16_t *) allocate(orig_w * sizeof(uint16_t));
+    uint16_t * rgb565_line = (uint16_t *) memory_budget.allocate(MemoryBudget::Consumer::IMAGES, orig_w * sizeof(uint16_t));
     if (rgb565_line == nullptr) {
       png.close();
       free(png_data);
@@ -215,7 +216,7 @@ PngImage::PngImage(std::string filename, Dim max, bool load_bitmap) : Image(file
       LOG_E("PNGdec decode failed. Error: %d", png.getLastError());
     }
 
-    free(rgb565_line);
+    memory_budget.release(MemoryBudget::Consumer::IMAGES, rgb565_line, orig_w * sizeof(uint16_t));
     png.close();
     free(png_data);
 
@@ -226,7 +227,7 @@ PngImage::PngImage(std::string filename, Dim max, bool load_bitmap) : Image(file
 
       pngle_t * pngle   = mypngle_new();
       size_t    sz_work = WORK_SIZE;
-      uint8_t * work    = (uint8_t *) allocate(sz_work);
+      uint8_t * work    = (uint8_t *) memory_budget.allocate(MemoryBudget::Consumer::IMAGES, sz_work);
       bool      first   = true;
       int32_t   total   = 0;
 
@@ -286,7 +287,7 @@ PngImage::PngImage(std::string filename, Dim max, bool load_bitmap) : Image(file
           LOG_D("Image size: [%d, %d] %d bytes.", w, h, w * h);
 
           if (load_bitmap) {
-            if ((image_data.bitmap = (uint8_t *) allocate(w * h)) == nullptr) break;
+            if ((image_data.bitmap = (uint8_t *) memory_budget.allocate(MemoryBudget::Consumer::IMAGES, w * h)) == nullptr) break;
             image_data.dim = Dim(w, h);
           }
           else {
@@ -308,7 +309,7 @@ PngImage::PngImage(std::string filename, Dim max, bool load_bitmap) : Image(file
         size = WORK_SIZE;
       }
 
-      free(work);
+      memory_budget.release(MemoryBudget::Consumer::IMAGES, work, sz_work);
       mypngle_destroy(pngle);
       unzip.close_stream_file();
 
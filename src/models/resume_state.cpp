@@ -0,0 +1,169 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __RESUME_STATE__ 1
+#include "models/resume_state.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if EPUB_INKPLATE_BUILD
+  #include "esp_attr.h"
+
+  // Initialized at power on, kept through deep sleep.
+
+  RTC_DATA_ATTR static ResumeState::Snapshot rtc_snapshot;
+#else
+  static constexpr char const * SNAPSHOT_FILE = MAIN_FOLDER "/resume.bin";
+#endif
+
+uint32_t
+ResumeState::checksum(const Snapshot & snapshot)
+{
+  // FNV-1a
+
+  const uint8_t * data = (const uint8_t *) &snapshot;
+  uint32_t        h    = 2166136261UL;
+
+  for (uint16_t i = 0; i < offsetof(Snapshot, checksum); i++) {
+    h ^= data[i];
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+static inline std::string
+related_filename(const std::string & epub_filename, const char * ext)
+{
+  return epub_filename.substr(0, epub_filename.find_last_of('.')) + ext;
+}
+
+void
+ResumeState::get_sig(const std::string & filename, FileSig & sig)
+{
+  struct stat file_stat;
+
+  if (stat(filename.c_str(), &file_stat) == 0) {
+    sig.size  = file_stat.st_size;
+    sig.mtime = file_stat.st_mtime;
+  }
+  else {
+    sig.size  = -1;
+    sig.mtime =  0;
+  }
+}
+
+bool
+ResumeState::check_sig(const std::string & filename, const FileSig & sig)
+{
+  FileSig current;
+
+  get_sig(filename, current);
+  if ((current.size == sig.size) && (current.mtime == sig.mtime)) return true;
+
+  LOG_I("File changed since deep sleep: %s", filename.c_str());
+  return false;
+}
+
+void
+ResumeState::save(uint32_t                       book_id,
+                  const std::string            & filename,
+                  const std::string            & title,
+                  const PageLocs::PageId       & page_id,
+                  const EPub::BookFormatParams & format_params)
+{
+  if (filename.size() >= MAX_FILENAME_SIZE) {
+    LOG_I("Book filename too long, no resume state saved.");
+    clear();
+    return;
+  }
+
+  Snapshot snapshot;
+
+  memset(&snapshot, 0, sizeof(Snapshot));
+
+  snapshot.magic         = MAGIC;
+  snapshot.version       = VERSION;
+  snapshot.book_id       = book_id;
+  snapshot.itemref_index = page_id.itemref_index;
+  snapshot.offset        = page_id.offset;
+  snapshot.format_params = format_params;
+
+  get_sig(filename,                            snapshot.book_sig);
+  get_sig(related_filename(filename, ".locs"), snapshot.locs_sig);
+  get_sig(related_filename(filename, ".toc" ), snapshot.toc_sig );
+
+  strncpy(snapshot.filename, filename.c_str(), MAX_FILENAME_SIZE - 1);
+  strncpy(snapshot.title,    title.c_str(),    MAX_TITLE_SIZE    - 1);
+
+  snapshot.checksum = checksum(snapshot);
+
+  #if EPUB_INKPLATE_BUILD
+    rtc_snapshot = snapshot;
+  #else
+    FILE * f = fopen(SNAPSHOT_FILE, "wb");
+    if (f != nullptr) {
+      if (fwrite(&snapshot, sizeof(Snapshot), 1, f) != 1) {
+        LOG_E("Unable to write %s", SNAPSHOT_FILE);
+      }
+      fclose(f);
+    }
+  #endif
+
+  LOG_D("Resume state saved: %s (%d, %d)",
+        snapshot.filename, snapshot.itemref_index, snapshot.offset);
+}
+
+bool
+ResumeState::retrieve(Snapshot & snapshot)
+{
+  #if EPUB_INKPLATE_BUILD
+    snapshot = rtc_snapshot;
+  #else
+    FILE * f = fopen(SNAPSHOT_FILE, "rb");
+    if (f == nullptr) return false;
+
+    bool ok = fread(&snapshot, sizeof(Snapshot), 1, f) == 1;
+    fclose(f);
+
+    if (!ok) {
+      clear();
+      return false;
+    }
+  #endif
+
+  clear();
+
+  if ((snapshot.magic    != MAGIC  ) ||
+      (snapshot.version  != VERSION) ||
+      (snapshot.checksum != checksum(snapshot))) {
+    return false;
+  }
+
+  snapshot.filename[MAX_FILENAME_SIZE - 1] = 0;
+  snapshot.title[MAX_TITLE_SIZE - 1]       = 0;
+
+  std::string filename = snapshot.filename;
+
+  bool res = check_sig(filename,                            snapshot.book_sig) &&
+             check_sig(related_filename(filename, ".locs"), snapshot.locs_sig) &&
+             check_sig(related_filename(filename, ".toc" ), snapshot.toc_sig );
+
+  LOG_I("Resume state %s.", res ? "retrieved" : "discarded");
+
+  return res;
+}
+
+void
+ResumeState::clear()
+{
+  #if EPUB_INKPLATE_BUILD
+    rtc_snapshot.magic = 0;
+  #else
+    unlink(SNAPSHOT_FILE);
+  #endif
+}
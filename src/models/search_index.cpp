@@ -0,0 +1,526 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __SEARCH_INDEX__ 1
+#include "models/search_index.hpp"
+
+#include "alloc.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <unistd.h>
+
+// Latin-1 letters 0xC0 to 0xFF without their accent. '*' is for a letter
+// kept as is (lower cased), ' ' for a separator (multiplication and
+// division signs).
+
+const char SearchIndex::LATIN1_FOLDING[64] = {
+  'a', 'a', 'a', 'a', 'a', 'a', '*', 'c', 'e', 'e', 'e', 'e', 'i', 'i', 'i', 'i',
+  '*', 'n', 'o', 'o', 'o', 'o', 'o', ' ', 'o', 'u', 'u', 'u', 'u', 'y', '*', '*',
+  'a', 'a', 'a', 'a', 'a', 'a', '*', 'c', 'e', 'e', 'e', 'e', 'i', 'i', 'i', 'i',
+  '*', 'n', 'o', 'o', 'o', 'o', 'o', ' ', 'o', 'u', 'u', 'u', 'u', 'y', '*', 'y'
+};
+
+static void
+put_varint(std::string & buff, uint32_t value)
+{
+  while (value >= 0x80) {
+    buff.push_back((char) ((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  buff.push_back((char) value);
+}
+
+static uint32_t
+get_varint(const uint8_t * & p, const uint8_t * end)
+{
+  uint32_t value = 0;
+  uint8_t  shift = 0;
+
+  while ((p < end) && (shift < 32)) {
+    uint8_t byte = *p++;
+    value |= (uint32_t) (byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) break;
+    shift += 7;
+  }
+  return value;
+}
+
+static void
+append_utf8(std::string & str, uint32_t code)
+{
+  if (code < 0x80) {
+    str.push_back((char) code);
+  }
+  else if (code < 0x800) {
+    str.push_back((char) (0xC0 | (code >> 6)));
+    str.push_back((char) (0x80 | (code & 0x3F)));
+  }
+  else if (code < 0x10000) {
+    str.push_back((char) (0xE0 |  (code >> 12)));
+    str.push_back((char) (0x80 | ((code >>  6) & 0x3F)));
+    str.push_back((char) (0x80 |  (code        & 0x3F)));
+  }
+  else {
+    str.push_back((char) (0xF0 |  (code >> 18)));
+    str.push_back((char) (0x80 | ((code >> 12) & 0x3F)));
+    str.push_back((char) (0x80 | ((code >>  6) & 0x3F)));
+    str.push_back((char) (0x80 |  (code        & 0x3F)));
+  }
+}
+
+// An invalid sequence is returned as a separator
+
+uint32_t
+SearchIndex::next_code(const uint8_t * & p, const uint8_t * end)
+{
+  uint8_t  ch = *p++;
+  uint32_t code;
+  int8_t   count;
+
+  if      (ch < 0x80)           return ch;
+  else if ((ch & 0xE0) == 0xC0) { code = ch & 0x1F; count = 1; }
+  else if ((ch & 0xF0) == 0xE0) { code = ch & 0x0F; count = 2; }
+  else if ((ch & 0xF8) == 0xF0) { code = ch & 0x07; count = 3; }
+  else return ' ';
+
+  while (count > 0) {
+    if ((p >= end) || ((*p & 0xC0) != 0x80)) return ' ';
+    code = (code << 6) | (*p++ & 0x3F);
+    count--;
+  }
+  return code;
+}
+
+// Appends a letter or a digit to the term, lower cased without accent.
+// Returns false for a separator.
+
+bool
+SearchIndex::append_folded(std::string & term, uint32_t code)
+{
+  if (code < 0x80) {
+    if      ((code >= 'a') && (code <= 'z')) ;
+    else if ((code >= '0') && (code <= '9')) ;
+    else if ((code >= 'A') && (code <= 'Z')) code += 'a' - 'A';
+    else return false;
+  }
+  else if (code < 0xC0) {
+    return false;  // Latin-1 punctuation and symbols
+  }
+  else if (code < 0x100) {
+    char ch = LATIN1_FOLDING[code - 0xC0];
+    if (ch == ' ') return false;
+    if (ch != '*') code = ch;
+    else if (code < 0xDF) code += 0x20;
+  }
+  else if (((code >= 0x2000) && (code < 0x2C00)) ||  // Punctuation, symbols, arrows...
+           ((code >= 0x3000) && (code < 0x3040)) ||  // CJK punctuation
+           ((code >= 0xFE30) && (code < 0xFE70)) ||  // CJK compatibility forms
+            (code == 0xFEFF)) {                      // Byte order mark
+    return false;
+  }
+  else if (code < 0x180) {                           // Latin Extended-A
+    if (((code < 0x138) || ((code >= 0x14A) && (code < 0x178))) && ((code & 1) == 0)) code++;
+    else if ((((code >= 0x139) && (code < 0x149)) || ((code >= 0x179) && (code < 0x17F))) && ((code & 1) == 1)) code++;
+  }
+  else if ((code >= 0x391) && (code < 0x3AC) && (code != 0x3A2)) {  // Greek
+    code += 0x20;
+  }
+  else if ((code >= 0x400) && (code < 0x410)) {      // Cyrillic
+    code += 0x50;
+  }
+  else if ((code >= 0x410) && (code < 0x430)) {
+    code += 0x20;
+  }
+
+  if (term.size() < MAX_TERM_SIZE) append_utf8(term, code);
+  return true;
+}
+
+std::string
+SearchIndex::filename_of(const std::string & epub_filename)
+{
+  return epub_filename.substr(0, epub_filename.find_last_of('.')) + ".sidx";
+}
+
+void
+SearchIndex::clear()
+{
+  std::scoped_lock guard(mutex);
+
+  Terms().swap(terms);
+  std::vector<PageLocs::PageId>().swap(pages);
+  posting_count = 0;
+  overflow      = false;
+
+  // The index of the book is about to be replaced
+
+  free_directory();
+}
+
+void
+SearchIndex::start_page(const PageLocs::PageId & page_id)
+{
+  std::scoped_lock guard(mutex);
+
+  if (pages.size() >= MAX_PAGE_COUNT) overflow = true;
+  if (overflow) return;
+
+  if (!pages.empty() && (pages.back().itemref_index == page_id.itemref_index) &&
+                        (pages.back().offset        == page_id.offset)) return;
+  pages.push_back(page_id);
+}
+
+void
+SearchIndex::add_word(const char * word, int16_t size)
+{
+  std::scoped_lock guard(mutex);
+
+  if (overflow || pages.empty()) return;
+
+  uint16_t serial = pages.size() - 1;
+
+  for_each_term(word, size, term, [this, serial](std::string & t) {
+    Postings & postings = terms[t];
+    if (postings.empty() || (postings.back() != serial)) {
+      postings.push_back(serial);
+      if (++posting_count >= MAX_POSTING_COUNT) overflow = true;
+    }
+  });
+}
+
+bool
+SearchIndex::save(const std::string            & epub_filename,
+                  const PageLocs::PagesMap     & pages_map,
+                  const EPub::BookFormatParams & params)
+{
+  std::scoped_lock guard(mutex);
+
+  std::string filename = filename_of(epub_filename);
+
+  free_directory();
+
+  if (overflow || pages.empty()) {
+    LOG_E("The book is too large to be indexed.");
+    unlink(filename.c_str());
+    Terms().swap(terms);
+    std::vector<PageLocs::PageId>().swap(pages);
+    return false;
+  }
+
+  // The page number of each page serial
+
+  std::vector<int16_t> page_nbrs(pages.size(), -1);
+  int16_t              page_count = 0;
+
+  for (uint16_t serial = 0; serial < pages.size(); serial++) {
+    auto it = pages_map.find(pages[serial]);
+    if (it != pages_map.end()) page_nbrs[serial] = it->second.page_number;
+  }
+  for (auto & entry : pages_map) {
+    if (entry.second.page_number >= page_count) page_count = entry.second.page_number + 1;
+  }
+
+  // The terms, sorted, with their pages list
+
+  std::vector<Terms::const_iterator> sorted;
+  sorted.reserve(terms.size());
+  for (auto it = terms.cbegin(); it != terms.cend(); it++) sorted.push_back(it);
+  std::sort(sorted.begin(), sorted.end(), [](const Terms::const_iterator & a, const Terms::const_iterator & b) {
+    return a->first < b->first;
+  });
+
+  std::string          directory_buff, postings_buff;
+  std::vector<int16_t> list;
+  uint32_t             term_count = 0;
+
+  for (auto & it : sorted) {
+    list.clear();
+    for (uint16_t serial : it->second) {
+      if (page_nbrs[serial] >= 0) list.push_back(page_nbrs[serial]);
+    }
+    if (list.empty()) continue;
+    std::sort(list.begin(), list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+
+    uint32_t offset = postings_buff.size();
+    directory_buff.push_back((char) it->first.size());
+    directory_buff.append(it->first);
+    directory_buff.append(reinterpret_cast<const char *>(&offset), sizeof(offset));
+
+    put_varint(postings_buff, list.size());
+    int16_t prev = 0;
+    for (int16_t page_nbr : list) {
+      put_varint(postings_buff, page_nbr - prev);
+      prev = page_nbr;
+    }
+    term_count++;
+  }
+
+  sorted.clear();
+  Terms().swap(terms);
+  std::vector<PageLocs::PageId>().swap(pages);
+
+  LOG_D("Saving search index to file %s: %u terms, %u bytes",
+        filename.c_str(), term_count, (unsigned) (directory_buff.size() + postings_buff.size()));
+
+  FILE * file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    LOG_E("Not able to open search index file.");
+    return false;
+  }
+
+  uint32_t directory_size = directory_buff.size();
+  uint32_t postings_size  = postings_buff.size();
+
+  bool res = false;
+  while (true) {
+    if (fwrite(&SEARCH_FILE_VERSION, 1,              1, file) != 1) break;
+    if (fwrite(&params,              sizeof(params), 1, file) != 1) break;
+    if (fwrite(&page_count,          sizeof(page_count),     1, file) != 1) break;
+    if (fwrite(&term_count,          sizeof(term_count),     1, file) != 1) break;
+    if (fwrite(&directory_size,      sizeof(directory_size), 1, file) != 1) break;
+    if (fwrite(&postings_size,       sizeof(postings_size),  1, file) != 1) break;
+    if (fwrite(directory_buff.data(), 1, directory_size, file) != directory_size) break;
+    if (fwrite(postings_buff.data(),  1, postings_size,  file) != postings_size ) break;
+    res = true;
+    break;
+  }
+
+  if (fclose(file) != 0) res = false;
+  if (!res) {
+    LOG_E("Search index save error.");
+    unlink(filename.c_str());
+  }
+
+  return res;
+}
+
+bool
+SearchIndex::read_header(FILE * file,
+                         const EPub::BookFormatParams & params, int16_t page_count,
+                         uint32_t & term_count, uint32_t & dir_size, uint32_t & post_size)
+{
+  int8_t                 version;
+  EPub::BookFormatParams file_params;
+  int16_t                file_page_count;
+
+  if (fread(&version,         1,                       1, file) != 1) return false;
+  if (version != SEARCH_FILE_VERSION)                                 return false;
+  if (fread(&file_params,     sizeof(file_params),     1, file) != 1) return false;
+  if (fread(&file_page_count, sizeof(file_page_count), 1, file) != 1) return false;
+  if (fread(&term_count,      sizeof(term_count),      1, file) != 1) return false;
+  if (fread(&dir_size,        sizeof(dir_size),        1, file) != 1) return false;
+  if (fread(&post_size,       sizeof(post_size),       1, file) != 1) return false;
+
+  return (memcmp(&file_params, &params, sizeof(params)) == 0) && (file_page_count == page_count);
+}
+
+bool
+SearchIndex::is_available(const std::string            & epub_filename,
+                          const EPub::BookFormatParams & params,
+                          int16_t                        page_count)
+{
+  std::scoped_lock guard(mutex);
+
+  FILE * file = fopen(filename_of(epub_filename).c_str(), "rb");
+  if (file == nullptr) return false;
+
+  uint32_t term_count, dir_size, post_size;
+  bool     res = read_header(file, params, page_count, term_count, dir_size, post_size);
+
+  fclose(file);
+  return res;
+}
+
+void
+SearchIndex::free_directory()
+{
+  if (directory != nullptr) {
+    free(directory);
+    directory = nullptr;
+  }
+  directory_size = 0;
+  std::vector<uint32_t>().swap(term_positions);
+  loaded_filename.clear();
+}
+
+bool
+SearchIndex::load_directory(const std::string & epub_filename)
+{
+  free_directory();
+
+  FILE * file = fopen(filename_of(epub_filename).c_str(), "rb");
+  if (file == nullptr) {
+    LOG_E("No search index for this book.");
+    return false;
+  }
+
+  uint32_t term_count;
+  bool     ok = false;
+
+  while (true) {
+    if (!read_header(file, *epub.get_book_format_params(), page_locs.get_page_count(),
+                     term_count, directory_size, postings_size)) break;
+
+    if ((directory = (char *) allocate(directory_size + 1)) == nullptr) break;
+    if (fread(directory, 1, directory_size, file) != directory_size) break;
+
+    postings_pos = ftell(file);
+
+    term_positions.reserve(term_count);
+    uint32_t pos = 0;
+    while ((pos < directory_size) && (term_positions.size() < term_count)) {
+      term_positions.push_back(pos);
+      pos += 1 + (uint8_t) directory[pos] + sizeof(uint32_t);
+    }
+    ok = (pos == directory_size) && (term_positions.size() == term_count);
+    break;
+  }
+
+  fclose(file);
+
+  if (ok) {
+    loaded_filename = epub_filename;
+  }
+  else {
+    LOG_E("Search index load error.");
+    free_directory();
+  }
+
+  return ok;
+}
+
+bool
+SearchIndex::read_postings(FILE * file, uint32_t term_idx, std::vector<int16_t> & page_nbrs)
+{
+  const char * entry = directory + term_positions[term_idx];
+  uint32_t     offset, end_offset;
+
+  memcpy(&offset, entry + 1 + (uint8_t) entry[0], sizeof(offset));
+  if ((term_idx + 1) < term_positions.size()) {
+    const char * next = directory + term_positions[term_idx + 1];
+    memcpy(&end_offset, next + 1 + (uint8_t) next[0], sizeof(end_offset));
+  }
+  else {
+    end_offset = postings_size;
+  }
+  if ((end_offset <= offset) || (end_offset > postings_size)) return false;
+
+  std::vector<uint8_t> buff(end_offset - offset);
+  if (fseek(file, postings_pos + offset, SEEK_SET) != 0)      return false;
+  if (fread(buff.data(), 1, buff.size(), file) != buff.size()) return false;
+
+  const uint8_t * p     = buff.data();
+  const uint8_t * end   = p + buff.size();
+  uint32_t        count = get_varint(p, end);
+  int16_t         page_nbr = 0;
+
+  while ((count-- > 0) && (p < end)) {
+    page_nbr += get_varint(p, end);
+    page_nbrs.push_back(page_nbr);
+  }
+
+  return true;
+}
+
+// The pages of a term, or of all the terms it begins, in ascending order
+
+void
+SearchIndex::term_pages(FILE * file, const std::string & term, bool prefix, std::vector<int16_t> & page_nbrs)
+{
+  uint32_t lo = 0;
+  uint32_t hi = term_positions.size();
+
+  page_nbrs.clear();
+
+  auto term_at = [this](uint32_t idx) {
+    const char * entry = directory + term_positions[idx];
+    return std::string_view(entry + 1, (uint8_t) entry[0]);
+  };
+
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) >> 1;
+    if (term_at(mid) < term) lo = mid + 1; else hi = mid;
+  }
+
+  uint16_t count = 0;
+  for (uint32_t idx = lo; idx < term_positions.size(); idx++) {
+    std::string_view t = term_at(idx);
+    if (prefix) {
+      if (t.compare(0, term.size(), term) != 0) break;
+    }
+    else if (t != term) break;
+
+    if (!read_postings(file, idx, page_nbrs)) break;
+    count++;
+    if (!prefix) break;
+  }
+
+  if (count > 1) {
+    std::sort(page_nbrs.begin(), page_nbrs.end());
+    page_nbrs.erase(std::unique(page_nbrs.begin(), page_nbrs.end()), page_nbrs.end());
+  }
+}
+
+bool
+SearchIndex::search(const std::string & epub_filename, const std::string & query, std::vector<int16_t> & page_nbrs)
+{
+  std::scoped_lock guard(mutex);
+
+  page_nbrs.clear();
+
+  if ((loaded_filename != epub_filename) && !load_directory(epub_filename)) return false;
+
+  FILE * file = fopen(filename_of(epub_filename).c_str(), "rb");
+  if (file == nullptr) return false;
+
+  std::vector<std::string> query_terms;
+  std::vector<bool>        prefixes;
+  size_t                   pos = 0;
+
+  while (pos < query.size()) {
+    size_t end = query.find(' ', pos);
+    if (end == std::string::npos) end = query.size();
+
+    std::string word   = query.substr(pos, end - pos);
+    bool        prefix = !word.empty() && (word.back() == '*');
+    if (prefix) word.pop_back();
+
+    uint16_t    before = query_terms.size();
+    std::string t;
+    for_each_term(word.c_str(), word.size(), t, [&query_terms, &prefixes](std::string & t) {
+      query_terms.push_back(t);
+      prefixes.push_back(false);
+    });
+    if (prefix && (query_terms.size() > before)) prefixes.back() = true;
+
+    pos = end + 1;
+  }
+
+  std::vector<int16_t> pages, result;
+  bool                 first = true;
+
+  for (uint16_t i = 0; i < query_terms.size(); i++) {
+    term_pages(file, query_terms[i], prefixes[i], pages);
+    if (first) {
+      page_nbrs.swap(pages);
+      first = false;
+    }
+    else {
+      result.clear();
+      std::set_intersection(page_nbrs.begin(), page_nbrs.end(), pages.begin(), pages.end(), std::back_inserter(result));
+      page_nbrs.swap(result);
+    }
+    if (page_nbrs.empty()) break;
+  }
+
+  fclose(file);
+
+  if (page_nbrs.size() > MAX_RESULT_COUNT) page_nbrs.resize(MAX_RESULT_COUNT);
+
+  return true;
+}
@@ -0,0 +1,85 @@
+#if TESTING && EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "gtest/gtest.h"
+#include "models/search_index.hpp"
+#include "models/epub.hpp"
+#include "models/page_locs.hpp"
+#include "helpers/perf_stats.hpp"
+
+#include <algorithm>
+#include <unistd.h>
+
+static constexpr char const * SEARCH_FOLDER = "/tmp/epub_search_index_tests";
+static constexpr char const * BOOK_NAME     = "Austen, Jane - Pride and Prejudice";
+
+static std::vector<std::string>
+terms_of(const char * word)
+{
+  std::vector<std::string> terms;
+  std::string              term;
+
+  SearchIndex::for_each_term(word, strlen(word), term, [&terms](std::string & t) { terms.push_back(t); });
+  return terms;
+}
+
+TEST(SearchIndexTest, words_split_in_terms) {
+  EXPECT_EQ(terms_of("“Well-known”"),         std::vector<std::string>({ "well", "known" }));
+  EXPECT_EQ(terms_of("Préjugés,"),            std::vector<std::string>({ "prejuges"      }));
+  EXPECT_EQ(terms_of("won\xC2\xAD" "derful"), std::vector<std::string>({ "wonderful"     })); // Soft hyphen
+  EXPECT_EQ(terms_of("Bennet's"),             std::vector<std::string>({ "bennet"        }));
+  EXPECT_EQ(terms_of("ΑΘΗΝΑ"),                std::vector<std::string>({ "αθηνα"         }));
+  EXPECT_TRUE(terms_of("a").empty());
+}
+
+TEST(SearchIndexTest, pages_found_in_milliseconds) {
+  std::string folder = SEARCH_FOLDER;
+  std::string book   = folder + "/" + BOOK_NAME + ".epub";
+  std::string cmd    = "rm -rf " + folder + " && mkdir -p " + folder +
+                       " && cp '" BOOKS_FOLDER "/" + BOOK_NAME + ".epub' " + folder;
+  ASSERT_EQ(system(cmd.c_str()), 0);
+
+  ASSERT_TRUE(epub.open_file(book));
+  page_locs.check_for_format_changes(epub.get_item_count(), 0, true);
+  while (page_locs.get_page_count() == -1) usleep(1000);
+
+  int16_t page_count = page_locs.get_page_count();
+  EXPECT_TRUE(search_index.is_available(book, *epub.get_book_format_params(), page_count));
+
+  std::vector<int16_t> netherfield, both, prefix, none;
+
+  int64_t start = PerfStats::get_time_us();
+  ASSERT_TRUE(search_index.search(book, "Netherfield", netherfield));
+  EXPECT_LT(PerfStats::get_time_us() - start, 50000);
+
+  ASSERT_FALSE(netherfield.empty());
+  EXPECT_TRUE(std::is_sorted(netherfield.begin(), netherfield.end()));
+  EXPECT_GE(netherfield.front(), 0);
+  EXPECT_LT(netherfield.back(), page_count);
+
+  // All terms of a query are on the pages found
+
+  ASSERT_TRUE(search_index.search(book, "netherfield bingley", both));
+  EXPECT_FALSE(both.empty());
+  EXPECT_TRUE(std::includes(netherfield.begin(), netherfield.end(), both.begin(), both.end()));
+
+  ASSERT_TRUE(search_index.search(book, "netherf*", prefix));
+  EXPECT_TRUE(std::includes(prefix.begin(), prefix.end(), netherfield.begin(), netherfield.end()));
+
+  ASSERT_TRUE(search_index.search(book, "netherfield xylophone", none));
+  EXPECT_TRUE(none.empty());
+
+  // Once saved, the index is kept with the pages locations
+
+  epub.close_file();
+  ASSERT_TRUE(epub.open_file(book));
+  page_locs.start_new_document(epub.get_item_count(), 0);
+  EXPECT_EQ(page_locs.get_page_count(), page_count);
+
+  std::vector<int16_t> again;
+  ASSERT_TRUE(search_index.search(book, "netherfield", again));
+  EXPECT_EQ(again, netherfield);
+
+  epub.close_file();
+}
+
+#endif
@@ -0,0 +1,160 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __STYLE_CACHE__ 1
+#include "models/style_cache.hpp"
+
+#include <cstdio>
+
+void
+StyleCache::open(const std::string & epub_filename)
+{
+  std::scoped_lock guard(mutex);
+
+  filename = epub_filename.substr(0, epub_filename.find_last_of('.')) + ".cssb";
+  data.clear();
+  entries.clear();
+
+  FILE * file = fopen(filename.c_str(), "rb");
+  if (file == nullptr) return;
+
+  long size = -1;
+  if (fseek(file, 0, SEEK_END) == 0) size = ftell(file);
+
+  if (size > 0) {
+    data.resize(size);
+    if ((fseek(file, 0, SEEK_SET) != 0) ||
+        (fread(data.data(), 1, size, file) != (size_t) size)) {
+      data.clear();
+    }
+  }
+
+  fclose(file);
+
+  if (!load_index()) {
+    LOG_I("No valid stylesheets cache. A new one will be created.");
+    data.clear();
+    entries.clear();
+  }
+}
+
+void
+StyleCache::close()
+{
+  std::scoped_lock guard(mutex);
+
+  filename.clear();
+  data.clear();
+  data.shrink_to_fit();
+  entries.clear();
+}
+
+bool
+StyleCache::load_index()
+{
+  if (data.empty() || (data[0] != CACHE_FILE_VERSION)) return false;
+
+  uint32_t pos = 1;
+
+  while (pos < data.size()) {
+    EntryHeader header;
+
+    if ((data.size() - pos) < sizeof(EntryHeader)) return false;
+    memcpy(&header, &data[pos], sizeof(EntryHeader));
+
+    uint32_t length = sizeof(EntryHeader) + header.name_length + header.length;
+    if ((data.size() - pos) < length) return false;
+
+    std::string name((const char *) &data[pos + sizeof(EntryHeader)], header.name_length);
+    entries[name] = { .crc = header.crc, .position = pos, .length = length };
+
+    pos += length;
+  }
+
+  return true;
+}
+
+bool
+StyleCache::save()
+{
+  FILE * file = fopen(filename.c_str(), "wb");
+
+  if (file == nullptr) {
+    LOG_E("Unable to create stylesheets cache: %s", filename.c_str());
+    return false;
+  }
+
+  bool res = fwrite(data.data(), 1, data.size(), file) == data.size();
+  res = (fclose(file) == 0) && res;
+
+  if (!res) {
+    LOG_E("Unable to save stylesheets cache: %s", filename.c_str());
+    remove(filename.c_str());
+  }
+
+  return res;
+}
+
+CSS *
+StyleCache::get(const std::string & css_filename, uint32_t crc, const char * css_id, Arena & scope)
+{
+  std::scoped_lock guard(mutex);
+
+  Entries::iterator entry = entries.find(css_filename);
+  if ((entry == entries.end()) || (entry->second.crc != crc)) return nullptr;
+
+  uint32_t rules_pos = entry->second.position + sizeof(EntryHeader) + css_filename.size();
+  uint32_t end_pos   = entry->second.position + entry->second.length;
+
+  CSS * css = new CSS(css_id, scope);
+
+  if (!css->restore(&data[rules_pos], end_pos - rules_pos)) {
+    LOG_E("Stylesheet cache entry corrupted: %s", css_filename.c_str());
+    delete css;
+    css = nullptr;
+  }
+
+  return css;
+}
+
+void
+StyleCache::put(const std::string & css_filename, uint32_t crc, const CSS & css)
+{
+  std::vector<uint8_t> rules;
+
+  if ((css_filename.size() > 0xFFFF) || !css.serialize(rules)) return;
+
+  std::scoped_lock guard(mutex);
+
+  if (filename.empty()) return;
+
+  // An outdated entry for the same file is removed first
+
+  Entries::iterator entry = entries.find(css_filename);
+  if (entry != entries.end()) {
+    if (entry->second.crc == crc) return;
+    data.erase(data.begin() + entry->second.position,
+               data.begin() + entry->second.position + entry->second.length);
+    entries.clear();
+    load_index();
+  }
+
+  if (data.empty()) data.push_back(CACHE_FILE_VERSION);
+
+  EntryHeader header = {
+    .crc         = crc,
+    .length      = (uint32_t) rules.size(),
+    .name_length = (uint16_t) css_filename.size()
+  };
+
+  uint32_t pos = data.size();
+  const uint8_t * h = (const uint8_t *) &header;
+  data.insert(data.end(), h, h + sizeof(EntryHeader));
+  data.insert(data.end(), css_filename.begin(), css_filename.end());
+  data.insert(data.end(), rules.begin(), rules.end());
+
+  entries[css_filename] = { .crc = crc, .position = pos, .length = (uint32_t) (data.size() - pos) };
+
+  save();
+}
@@ -7,18 +7,6 @@
 
 #include "models/epub.hpp"
 
-// Defined in epub.cpp
-
-extern bool    package_pred(xml_node node);
-extern bool   metadata_pred(xml_node node);
-extern bool   manifest_pred(xml_node node);
-bool              item_pred(xml_node node);
-bool             spine_pred(xml_node node);
-bool           itemref_pred(xml_node node);
-bool             xmlns_pred(xml_attribute attr);
-
-extern xml_node one_by_attr(xml_node n, const char * name1, const char * name2, const char * attr, const char * value);
-
 std::string 
 TOC::build_filename()
 {
@@ -65,16 +53,19 @@ TOC::load()
   if (db.goto_next()) {
     char_buffer_size = db.get_record_size();
     if (char_buffer_size > 0) {
-      char_buffer = (char *) allocate(char_buffer_size);
+      char_buffer = (char *) memory_budget.allocate(MemoryBudget::Consumer::TOC, char_buffer_size);
       if (db.get_record(char_buffer, char_buffer_size)) {
         uint16_t count = db.get_record_count() - 2;
         if (count > 0) {
           entries.resize(count);
           uint16_t idx = 0;
           while ((idx < count) && db.goto_next()) {
-            if (db.get_record_size() == sizeof(EntryRecord)) {
-              if (!db.get_record(&entries[idx], sizeof(EntryRecord))) break;
-              entries[idx].label = char_buffer + (size_t)entries[idx].label;
+            if (db.get_record_size() == sizeof(EntryFileRecord)) {
+              EntryFileRecord e;
+              if (!db.get_record(&e, sizeof(EntryFileRecord))) break;
+              entries[idx].label   = char_buffer + e.label_offset;
+              entries[idx].page_id = e.page_id;
+              entries[idx].level   = e.level;
               idx++;
             }
             else {
@@ -140,9 +131,12 @@ TOC::save()
       if (db.add_record(char_buffer, char_buffer_size)) {
         uint16_t idx;
         for (idx = 0; idx < entries.size(); idx++) {
-          EntryRecord e = entries[idx];
-          e.label = e.label - (size_t) char_buffer;
-          if (!db.add_record(&e, sizeof(EntryRecord))) {
+          EntryFileRecord e = {
+            .label_offset = (uint32_t) (entries[idx].label - char_buffer),
+            .page_id      = entries[idx].page_id,
+            .level        = entries[idx].level
+          };
+          if (!db.add_record(&e, sizeof(EntryFileRecord))) {
             LOG_E("Unable to add entry record.");
             break;
           }
@@ -204,7 +198,6 @@ TOC::do_nav_points(pugi::xml_node & node, uint8_t level)
     const char * label = node.child("navLabel").child("text").text().as_string();
     const char * fname = node.child("content").attribute("src").value();
 
-    xml_node n;
 
     EntryRecord  entry;
     std::string  the_id;
@@ -229,57 +222,30 @@ TOC::do_nav_points(pugi::xml_node & node, uint8_t level)
 
     clean_filename(filename_to_find);
 
-    if ((n = opf->find_child(package_pred).find_child(manifest_pred)) &&
-        (n = one_by_attr(n, "item", "opf:item", "href", filename_to_find))) {
-      // Is the node with the same filename is found, we then search the
-      // itemref in the spine with the same id associated with the item.
-      if ((attr = n.attribute("id"))) {
-        const char * idref = attr.value();
-
-        if ((n = opf->find_child(package_pred).find_child(spine_pred))) {
+    // The spine index of the file is retrieved from the package index
 
-          int16_t index = 0;
-          bool    found = false;
+    int16_t index = epub.get_itemref_index(filename_to_find);
 
-          for (auto nn: n.children()) {
-            if (strcmp(nn.attribute("idref").value(), idref) == 0) { found = true; break; }
-            index++;
-          }
-
-          if (found) {
-            entry.page_id.itemref_index = index;
-            if (!the_id.empty()) {
-              infos.insert(std::make_pair(
-                std::make_pair(index, the_id),
-                (int16_t)entries.size()
-              ));
-              some_ids = true;
-            }
-            else {
-              entry.page_id.offset = 0;
-            }
-            entries.push_back(entry);
-          }
-          else {
-            LOG_E("Unable to find reference %s in spine", idref);
-            return false;
-          }
-        }
-        else {
-          LOG_E("No spine in OPF!!");
-          return false;
-        }
+    if (index >= 0) {
+      entry.page_id.itemref_index = index;
+      if (!the_id.empty()) {
+        infos.insert(std::make_pair(
+          std::make_pair(index, the_id),
+          (int16_t)entries.size()
+        ));
+        some_ids = true;
       }
       else {
-        LOG_E("NCX inconsistency.");
-        return false;
+        entry.page_id.offset = 0;
       }
+      entries.push_back(entry);
     }
     else {
-      LOG_E("OPF inconsistency.");
+      LOG_E("Unable to find reference %s in spine", filename_to_find);
       return false;
     }
 
+    xml_node n;
     if ((n = node.child("navPoint"))) {
       if (!do_nav_points(n, level + 1)) return false;
     }
@@ -295,22 +261,19 @@ TOC::load_from_epub()
 {
   LOG_D("load_from_epub()");
 
-  xml_node      node, node2;
-  xml_attribute attr;
-  const char *  filename = nullptr;
-
-  opf = &epub.get_opf();
+  xml_node           node, node2;
+  xml_attribute      attr;
+  const char *       filename = nullptr;
+  EPub::ManifestItem ncx_item;
 
   clean();
 
   // Retrieve the ncx filename
   // Sometimes, the id is "ncx", sometimes "toc"
 
-  if (((node = opf->find_child(package_pred).find_child(manifest_pred)) &&
-       ((node2 = one_by_attr(node, "item", "opf:item", "id", "ncx")) ||
-        (node2 = one_by_attr(node, "item", "opf:item", "id", "toc")))) &&
-      (strcmp(node2.attribute("media-type").value(), "application/x-dtbncx+xml") == 0)) {
-    filename = node2.attribute("href").value();
+  if ((epub.get_manifest_item("ncx", ncx_item) && (ncx_item.media_type == EPub::MediaType::NCX)) ||
+      (epub.get_manifest_item("toc", ncx_item) && (ncx_item.media_type == EPub::MediaType::NCX))) {
+    filename = ncx_item.href.c_str();
   }
 
   // If filename was not found, returns gracefully. This is usually related
@@ -325,7 +288,7 @@ TOC::load_from_epub()
 
   if ((ncx_data = epub.retrieve_file(filename, ncx_size)) != nullptr) {
     if ((ncx_opf = new pugi::xml_document()) == nullptr) {
-      free(ncx_data);
+      epub.release_file(ncx_data);
       return false;
     }
   }
@@ -360,7 +323,7 @@ error:
   result = false;
 ok:
   ncx_opf->reset();
-  free(ncx_data);
+  epub.release_file(ncx_data);
   ncx_opf  = nullptr;
   ncx_data = nullptr;
 
@@ -379,7 +342,8 @@ TOC::compact()
 
   if (compacted) return true;
   
-  if (char_buffer != nullptr) free(char_buffer);
+  memory_budget.release(MemoryBudget::Consumer::TOC, char_buffer, char_buffer_size);
+  char_buffer      = nullptr;
   char_buffer_size = 0;
 
   if (!entries.empty()) {
@@ -387,7 +351,7 @@ TOC::compact()
       char_buffer_size += strlen(e.label) + 1;
     }
 
-    char_buffer = (char *) allocate(char_buffer_size);
+    char_buffer = (char *) memory_budget.allocate(MemoryBudget::Consumer::TOC, char_buffer_size);
     if (char_buffer == nullptr) return false;
 
     char * buff = char_buffer;
@@ -414,7 +378,7 @@ TOC::clean()
   LOG_D("clean()");
   
   if (char_pool   != nullptr) delete char_pool;
-  if (char_buffer != nullptr) free(char_buffer);
+  memory_budget.release(MemoryBudget::Consumer::TOC, char_buffer, char_buffer_size);
 
   if (ncx_opf != nullptr) {
     ncx_opf->reset();
@@ -423,12 +387,13 @@ TOC::clean()
   }
 
   if (ncx_data != nullptr) {
-    free(ncx_data);
+    epub.release_file(ncx_data);
     ncx_data = nullptr;
   }
 
-  char_pool   = nullptr;
-  char_buffer = nullptr;
+  char_pool        = nullptr;
+  char_buffer      = nullptr;
+  char_buffer_size = 0;
 
     infos.clear();
   entries.clear();
@@ -7,6 +7,7 @@
 #include "viewers/msg_viewer.hpp"
 
 #include "screen.hpp"
+#include "helpers/perf_stats.hpp"
 #include "alloc.hpp"
 
 #include <iostream>
@@ -81,9 +82,13 @@ TTF::get_glyph_internal(uint32_t charcode, int16_t glyph_size)
                ((git = cache_it->second.find(charcode)) != cache_it->second.end());
 
   if (found) {
+    PERF_COUNT(GLYPH_CACHE_HIT);
     return git->second;
   }
   else {
+    PERF_SCOPE(GLYPH);
+    PERF_COUNT(GLYPH_CACHE_MISS);
+
     if (current_font_size != glyph_size) set_font_size(glyph_size);
 
     int glyph_index = FT_Get_Char_Index(face, charcode);
@@ -170,6 +175,10 @@ TTF::get_glyph_internal(uint32_t charcode, int16_t glyph_size)
     //   " y:"  << glyph->yoff <<
     //   " a:"  << glyph->advance << std::endl;
 
+    glyph->font = this;
+    glyph->code = charcode;
+    glyph->size = glyph_size;
+
     cache[current_font_size][charcode] = glyph;
 
     return glyph;
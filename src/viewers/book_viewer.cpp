@@ -7,6 +7,7 @@
 #include "viewers/book_viewer.hpp"
 
 #include "models/config.hpp"
+#include "models/page_cache.hpp"
 #include "viewers/msg_viewer.hpp"
 #include "viewers/html_interpreter.hpp"
 #include "viewers/screen_bottom.hpp"
@@ -18,6 +19,8 @@
 #endif
 
 #include "screen.hpp"
+#include "helpers/perf_stats.hpp"
+#include "helpers/memory_budget.hpp"
 #include "alloc.hpp"
 
 #include <iomanip>
@@ -42,10 +45,55 @@ class BookViewerInterp : public HTMLInterpreter
     }
 };
 
+void
+BookViewer::complete_page(const PageLocs::PageId & page_id, 
+                          Page::Format           & fmt, 
+                          bool                     show_title, 
+                          int16_t                  title_baseline_offset)
+{
+  //TTF * font = fonts.get(0, 7);
+
+  fmt.line_height_factor = 1.0;
+  fmt.font_index         = TITLE_FONT;
+  fmt.font_size          = TITLE_FONT_SIZE;
+  fmt.font_style         = Fonts::FaceStyle::ITALIC;
+  fmt.align              = CSS::Align::CENTER;
+  
+  std::ostringstream ostr;
+
+  if (show_title) {
+    const char * t = epub.get_title();
+    if (strlen(t) > 50) {
+      // Only the first 50 characters of the title will be shown
+      char str[55];
+      strncpy(str, t, 50);
+      str[50] = 0;
+      strcat(str, "...");
+      ostr << str;
+    }
+    else {
+      ostr << t;
+    } 
+    // page.put_highlight(Dim(screen.get_width(), title_baseline_offset), Pos(0, 0));
+    page.put_str_at(ostr.str(), Pos(Page::HORIZONTAL_CENTER, title_baseline_offset), fmt);
+  }
+
+  ScreenBottom::show(page_locs.get_page_nbr(page_id), page_locs.get_page_count());
+
+  page.paint();
+}
+
 void
 BookViewer::build_page_at(const PageLocs::PageId & page_id)
 {
   LOG_D("build_page_at()");
+  PERF_SCOPE(LAYOUT);
+
+  // The glyphs and the item nodes are referenced until the page is shown
+
+  MemoryBudget::InUse glyphs_in_use(MemoryBudget::Consumer::GLYPHS);
+  MemoryBudget::InUse  items_in_use(MemoryBudget::Consumer::ITEMS );
+
   #if EPUB_INKPLATE_BUILD && (LOG_LOCAL_LEVEL == ESP_LOG_VERBOSE)
     ESP::show_heaps_info();
   #endif
@@ -57,68 +105,81 @@ BookViewer::build_page_at(const PageLocs::PageId & page_id)
 
   //show_images = epub.get_book_format_params()->show_images != 0;
 
-  if (epub.get_item_at_index(page_id.itemref_index)) {
+  int16_t idx;
+
+  int8_t show_title = 0;
+  config.get(Config::Ident::SHOW_TITLE, &show_title);
 
-    int16_t idx;
+  int16_t page_top              = 0;
+  int16_t title_baseline_offset = 0;
 
-    int8_t show_title;
-    config.get(Config::Ident::SHOW_TITLE, &show_title);
+  if (show_title != 0) {
+    Font * title_font     = fonts.get(TITLE_FONT);
+    page_top              = title_font->get_chars_height(TITLE_FONT_SIZE) + 10;
+    title_baseline_offset = page_top + 
+                            title_font->get_descender_height(TITLE_FONT_SIZE);
+  }
 
-    int16_t page_top              = 0;
-    int16_t title_baseline_offset = 0;
+  if ((idx = fonts.get_index("Fontbase", Fonts::FaceStyle::NORMAL)) == -1) {
+    idx = 3;
+  }
 
-    if (show_title != 0) {
-      Font * title_font     = fonts.get(TITLE_FONT);
-      page_top              = title_font->get_chars_height(TITLE_FONT_SIZE) + 10;
-      title_baseline_offset = page_top + 
-                              title_font->get_descender_height(TITLE_FONT_SIZE);
-    }
+  int8_t font_size = epub.get_book_format_params()->font_size;
+
+  Page::Format fmt = {
+    .line_height_factor = 0.95,
+    .font_index         = idx,
+    .font_size          = font_size,
+    .indent             =   0,
+    .margin_left        =   0,
+    .margin_right       =   0,
+    .margin_top         =   0,
+    .margin_bottom      =   0,
+    .screen_left        =  10,
+    .screen_right       =  10,
+    .screen_top         = page_top,
+    .screen_bottom      = page_bottom,
+    .width              =   0,
+    .height             =   0,
+    .vertical_align     =   0,
+    .trim               = true,
+    .pre                = false,
+    .font_style         = Fonts::FaceStyle::NORMAL,
+    .align              = CSS::Align::LEFT,
+    .text_transform     = CSS::TextTransform::NONE,
+    .display            = CSS::Display::INLINE
+  };
 
-    if ((idx = fonts.get_index("Fontbase", Fonts::FaceStyle::NORMAL)) == -1) {
-      idx = 3;
+  // A page already laid out doesn't require its item to be retrieved
+
+  if (use_page_cache && page_cache.get(page_id, page_data)) {
+    page.start(fmt);
+    if (page.restore(page_data.data(), page_data.size())) {
+      complete_page(page_id, fmt, show_title != 0, title_baseline_offset);
+      return;
     }
+  }
+
+  if (epub.get_item_at_index(page_id.itemref_index)) {
 
-    int8_t font_size = epub.get_book_format_params()->font_size;
-
-    Page::Format fmt = {
-      .line_height_factor = 0.95,
-      .font_index         = idx,
-      .font_size          = font_size,
-      .indent             =   0,
-      .margin_left        =   0,
-      .margin_right       =   0,
-      .margin_top         =   0,
-      .margin_bottom      =   0,
-      .screen_left        =  10,
-      .screen_right       =  10,
-      .screen_top         = page_top,
-      .screen_bottom      = page_bottom,
-      .width              =   0,
-      .height             =   0,
-      .vertical_align     =   0,
-      .trim               = true,
-      .pre                = false,
-      .font_style         = Fonts::FaceStyle::NORMAL,
-      .align              = CSS::Align::LEFT,
-      .text_transform     = CSS::TextTransform::NONE,
-      .display            = CSS::Display::INLINE
-    };
-
-    mutex.unlock();
-    std::this_thread::yield();
+    // The pages location retriever doesn't need the viewer lock: it can
+    // complete this page information while we wait for it.
     const PageLocs::PageInfo * page_info = page_locs.get_page_info(page_id);
-    mutex.lock();
-    
+
     if (page_info == nullptr) return;
 
+    HTMLInterpreter::Checkpoint checkpoint = page_info->checkpoint;
+
     // current_offset       = 0;
     // start_of_page_offset = page_id.offset;
     // end_of_page_offset   = page_id.offset + page_info->size;
 
-    DOM              * dom    = new DOM;
+    const EPub::ItemInfo & item_info = epub.get_current_item_info();
+
+    DOM              * dom    = new DOM(item_info.arena);
     BookViewerInterp * interp = new BookViewerInterp(page, * dom, 
                                                      Page::ComputeMode::DISPLAY, 
-                                                     epub.get_current_item_info());
+                                                     item_info);
     interp->set_limits(page_id.offset, 
                        page_id.offset + page_info->size,
                        epub.get_book_format_params()->show_images != 0);
@@ -132,6 +193,8 @@ BookViewer::build_page_at(const PageLocs::PageId & page_id)
 
     if ((node = epub.get_current_item().child("html").child("body"))) {
 
+      if (use_checkpoints) interp->set_checkpoint(checkpoint, node);
+
       page.start(fmt);
 
     #if EPUB_INKPLATE_BUILD && !defined(BOARD_TYPE_PAPER_S3)
@@ -144,36 +207,9 @@ BookViewer::build_page_at(const PageLocs::PageId & page_id)
 
         if (page.some_data_waiting()) page.end_paragraph(fmt);
 
-        //TTF * font = fonts.get(0, 7);
-
-        fmt.line_height_factor = 1.0;
-        fmt.font_index         = TITLE_FONT;
-        fmt.font_size          = TITLE_FONT_SIZE;
-        fmt.font_style         = Fonts::FaceStyle::ITALIC;
-        fmt.align              = CSS::Align::CENTER;
-        
-        std::ostringstream ostr;
-
-        if (show_title != 0) {
-          const char * t = epub.get_title();
-          if (strlen(t) > 50) {
-            // Only the first 50 characters of the title will be shown
-            char str[55];
-            strncpy(str, t, 50);
-            str[50] = 0;
-            strcat(str, "...");
-            ostr << str;
-          }
-          else {
-            ostr << t;
-          } 
-          // page.put_highlight(Dim(screen.get_width(), title_baseline_offset), Pos(0, 0));
-          page.put_str_at(ostr.str(), Pos(Page::HORIZONTAL_CENTER, title_baseline_offset), fmt);
-        }
-
-        ScreenBottom::show(page_locs.get_page_nbr(page_id), page_locs.get_page_count());
+        if (use_page_cache && page.serialize(page_data)) page_cache.put(page_id, page_data);
 
-        page.paint();
+        complete_page(page_id, fmt, show_title != 0, title_baseline_offset);
       }
       interp->show_stat();
       interp->release_fmt(new_fmt);
@@ -0,0 +1,152 @@
+#if TESTING && EPUB_LINUX_BUILD && EPUB_HEADLESS
+
+#include "gtest/gtest.h"
+#include "models/config.hpp"
+#include "models/epub.hpp"
+#include "models/page_cache.hpp"
+#include "models/page_locs.hpp"
+#include "viewers/book_viewer.hpp"
+#include "helpers/perf_stats.hpp"
+#include "screen.hpp"
+
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+
+// Every page is laid out twice: replaying its item from the start, then resuming
+// from the checkpoint kept with its location. Both must give the same pixels.
+
+TEST(BookViewerTest, checkpoint_rendering_matches_full_replay) {
+  ASSERT_TRUE(epub.open_file(BOOKS_FOLDER "/Austen, Jane - Pride and Prejudice.epub"));
+
+  page_locs.check_for_format_changes(epub.get_item_count(), 0, true);
+  while (page_locs.get_page_count() == -1) usleep(1000);
+
+  int32_t              size = Screen::get_width() * Screen::get_height();
+  std::vector<uint8_t> replayed(size);
+  int16_t              resumed = 0;
+
+  book_viewer.init();
+
+  const PageLocs::PageId * page_id = page_locs.get_page_id(PageLocs::PageId(0, 0));
+  for (int16_t i = 0; (page_id != nullptr) && (i < page_locs.get_page_count()); i++) {
+    PageLocs::PageId id = *page_id;
+
+    book_viewer.set_use_checkpoints(false);
+    book_viewer.show_page(id);
+    memcpy(replayed.data(), screen.get_frame_buffer(), size);
+
+    book_viewer.set_use_checkpoints(true);
+    book_viewer.show_page(id);
+    EXPECT_EQ(memcmp(replayed.data(), screen.get_frame_buffer(), size), 0)
+      << "Item " << id.itemref_index << ", offset " << id.offset;
+
+    if (page_locs.get_page_info(id)->checkpoint.depth > 0) resumed++;
+
+    page_id = page_locs.get_next_page_id(id);
+  }
+
+  EXPECT_GT(resumed, page_locs.get_page_count() / 2);
+}
+
+// Every page is laid out, then shown again from the pages cache. Both must
+// give the same pixels.
+
+TEST(BookViewerTest, cached_rendering_matches_layout) {
+  epub.close_file();
+  config.put(Config::Ident::ITEM_CACHE, (int8_t) 1);
+  ASSERT_TRUE(epub.open_file(BOOKS_FOLDER "/Austen, Jane - Pride and Prejudice.epub"));
+
+  page_locs.check_for_format_changes(epub.get_item_count(), 0, true);
+  while (page_locs.get_page_count() == -1) usleep(1000);
+
+  int32_t              size = Screen::get_width() * Screen::get_height();
+  std::vector<uint8_t> laid_out(size);
+  std::vector<uint8_t> data;
+  int16_t              cached = 0;
+
+  book_viewer.init();
+
+  const PageLocs::PageId * page_id = page_locs.get_page_id(PageLocs::PageId(0, 0));
+  for (int16_t i = 0; (page_id != nullptr) && (i < page_locs.get_page_count()); i++) {
+    PageLocs::PageId id = *page_id;
+
+    book_viewer.show_page(id);
+    memcpy(laid_out.data(), screen.get_frame_buffer(), size);
+
+    if (page_cache.get(id, data)) {
+      cached++;
+      book_viewer.show_page(id);
+      EXPECT_EQ(memcmp(laid_out.data(), screen.get_frame_buffer(), size), 0)
+        << "Item " << id.itemref_index << ", offset " << id.offset;
+    }
+
+    page_id = page_locs.get_next_page_id(id);
+  }
+
+  EXPECT_GT(cached, page_locs.get_page_count() / 2);
+
+  epub.close_file();
+  config.put(Config::Ident::ITEM_CACHE, (int8_t) 0);
+}
+
+// Pages are turned while the pages location are computed in the background.
+// The page turn durations depend on the host load: they are reported, not
+// checked.
+
+static int64_t
+turn_pages(const PageLocs::PageId * & page_id, int16_t count, int64_t & total)
+{
+  int64_t worst = 0;
+
+  for (int16_t i = 0; i < count; i++) {
+    int64_t start = PerfStats::get_time_us();
+
+    if (page_id != nullptr) page_id = page_locs.get_next_page_id(*page_id);
+    if (page_id == nullptr) page_id = page_locs.get_page_id(PageLocs::PageId(0, 0));
+    if (page_id != nullptr) book_viewer.show_page(*page_id);
+
+    int64_t duration = PerfStats::get_time_us() - start;
+    if (duration > worst) worst = duration;
+    total += duration;
+  }
+
+  return worst;
+}
+
+TEST(BookViewerTest, page_turns_while_paginating) {
+  ASSERT_TRUE(epub.open_file(BOOKS_FOLDER "/Austen, Jane - Pride and Prejudice.epub"));
+
+  page_locs.check_for_format_changes(epub.get_item_count(), 0, true);
+  while (page_locs.get_page_count() == -1) usleep(1000);
+
+  book_viewer.init();
+
+  const PageLocs::PageId * page_id = page_locs.get_page_id(PageLocs::PageId(0, 0));
+  int64_t idle_total = 0;
+  int64_t idle_worst = turn_pages(page_id, 40, idle_total);
+
+  // The same page turns, while all pages location are computed again
+
+  page_locs.check_for_format_changes(epub.get_item_count(), 0, true);
+
+  page_id = page_locs.get_page_id(PageLocs::PageId(0, 0));
+  int64_t busy_total = 0, busy_worst = 0;
+  int16_t turns      = 0;
+
+  while (page_locs.get_page_count() == -1) {
+    int64_t worst = turn_pages(page_id, 1, busy_total);
+    if (worst > busy_worst) busy_worst = worst;
+    turns++;
+  }
+
+  std::cout << "Page turns while idle: avg " << (idle_total / 40) << " us, worst " << idle_worst << " us" << std::endl
+            << "Page turns while paginating (" << turns << "): avg " << (busy_total / (turns ? turns : 1))
+            << " us, worst " << busy_worst << " us" << std::endl;
+
+  EXPECT_GT(turns, 0);
+
+  epub.close_file();
+}
+
+#endif
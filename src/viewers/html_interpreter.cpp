@@ -11,8 +11,6 @@
   #include "esp.hpp"
 #endif
 
-MemoryPool<Page::Format> HTMLInterpreter::fmt_pool;
-
 // This method process a single xml node and recurse for the associated children.
 // The method calls the page_end() method when it reachs the end of the page as 
 // defined by the end_offset variable, or when the page class indicated that the page
@@ -236,7 +234,7 @@ HTMLInterpreter::build_pages_recurse(xml_node       node,
       CSS *  element_css = nullptr;
       if ((attr = node.attribute("style"))) {
         const char * buffer = attr.value();
-        element_css         = new CSS("ELEMENT", tag_it->second, buffer, strlen(buffer), 99);
+        element_css         = new CSS("ELEMENT", tag_it->second, buffer, strlen(buffer), 99, dom.get_arena());
       }
 
       // Adjust the tag's format styling (the fmt struct) using both the current
@@ -250,7 +248,7 @@ HTMLInterpreter::build_pages_recurse(xml_node       node,
     if (fmt.display == CSS::Display::NONE) return true;
     if (tag_it->second == DOM::Tag::BODY) {
       if (epub.get_book_format_params()->use_fonts_in_book == 0) {
-        fmt.font_size = epub.get_book_format_params()->font_size;
+        fmt.font_size = page.get_normal_font_size();
         //fmt.font_index = ;
       }
     }
@@ -266,6 +264,7 @@ HTMLInterpreter::build_pages_recurse(xml_node       node,
           page.end_paragraph(fmt);
         }
       }
+      paragraph_ended();
 
       show_state("==> New Paragraph 1 <==", fmt);
       if (!page.new_paragraph(fmt)) {
@@ -317,10 +316,13 @@ HTMLInterpreter::build_pages_recurse(xml_node       node,
   if (named_element) { // The element possesses a tag
     // Here we recurse on each child of the currernt tag.
     current_offset++;
-    xml_node sub = node.first_child();
+    xml_node sub   = node.first_child();
+    uint16_t index = 0;
+    if (seeking) seek(sub, index, dom_current_node, level);
     while (sub != nullptr) {
       if (page.is_full() && !page_end(fmt)) return false;
       if (at_end()) break;
+      if (compute_mode == Page::ComputeMode::LOCATION) mark_checkpoint(level, index);
       Page::Format * new_fmt = duplicate_fmt(fmt);
       if (!build_pages_recurse(sub, *new_fmt, dom_current_node, level + 1)) {
         release_fmt(new_fmt);
@@ -330,6 +332,7 @@ HTMLInterpreter::build_pages_recurse(xml_node       node,
       }
       release_fmt(new_fmt);
       sub = sub.next_sibling();
+      index++;
     }
 
     // The sub-nodes have been processed. Complete the block if not Inline and check
@@ -340,6 +343,7 @@ HTMLInterpreter::build_pages_recurse(xml_node       node,
           show_state("==> End Paragraph 2 <==", fmt);
           page.end_paragraph(fmt);
           show_state("==> After End Paragraph 2 <==", fmt);
+          paragraph_ended();
         }
       }
 
@@ -423,9 +427,6 @@ HTMLInterpreter::build_pages_recurse(xml_node       node,
               to_be_started = false;
               page.new_paragraph(fmt, true);
             }       
-            std::string word;
-            word.assign(w, count);
-
             #if EPUB_INKPLATE_BUILD && (LOG_LOCAL_LEVEL == ESP_LOG_VERBOSE)
               static bool first = true;
               if (first) {
@@ -434,7 +435,7 @@ HTMLInterpreter::build_pages_recurse(xml_node       node,
               }
             #endif
 
-            if (!page.add_word(word.c_str(), fmt)) {
+            if (!page.add_word(w, count, fmt)) {
               if (!page_end(fmt)) return false;
               if (at_end()) {
                 page.break_paragraph(fmt);
@@ -443,8 +444,9 @@ HTMLInterpreter::build_pages_recurse(xml_node       node,
               show_state("==> New Paragraph 3 <==", fmt);
               page.new_paragraph(fmt, true);
               show_state("==> After New Paragraph 3 <==", fmt);
-              page.add_word(word.c_str(), fmt);
+              page.add_word(w, count, fmt);
             }
+            if (compute_mode == Page::ComputeMode::LOCATION) word_added(w, count);
           }
           current_offset += count;
         }
@@ -467,3 +469,57 @@ HTMLInterpreter::build_pages_recurse(xml_node       node,
 
   return true;
 }
+
+bool
+HTMLInterpreter::set_checkpoint(const Checkpoint & checkpoint, xml_node body)
+{
+  if ((checkpoint.depth == 0) || 
+      (checkpoint.depth > CHECKPOINT_MAX_DEPTH) ||
+      (checkpoint.offset >= start_offset)) return false;
+
+  xml_node node = body;
+  for (uint8_t level = 0; level < checkpoint.depth; level++) {
+    node = node.first_child();
+    for (uint16_t i = 0; (i < checkpoint.path[level]) && (node != nullptr); i++) {
+      node = node.next_sibling();
+    }
+    if (node == nullptr) {
+      LOG_E("Layout checkpoint not found in item.");
+      return false;
+    }
+  }
+
+  seek_point = checkpoint;
+  seeking    = true;
+
+  return true;
+}
+
+// Skip the children of a node that precede the checkpoint path. Their DOM node is
+// still added as it may be required by the CSS selectors (adjacent sibling, 
+// first-child) of the following nodes. Their own children are never looked at by
+// the selectors.
+
+void
+HTMLInterpreter::seek(xml_node & sub, uint16_t & index, DOM::Node * dom_node, int16_t level)
+{
+  uint16_t target = seek_point.path[level - 1];
+
+  for (; (sub != nullptr) && (index < target); sub = sub.next_sibling(), index++) {
+    const char * name = sub.name();
+    if ((*name == 0) || sub.attribute("hidden")) continue;
+
+    DOM::Tags::iterator tag_it = DOM::tags.find(name);
+    if ((tag_it == DOM::tags.end()) || (tag_it->second == DOM::Tag::BODY)) continue;
+
+    DOM::Node   * dom_sibling = dom_node->add_child(tag_it->second);
+    xml_attribute attr;
+    if ((attr = sub.attribute("id"   ))) dom_sibling->add_id(attr.value());
+    if ((attr = sub.attribute("class"))) dom_sibling->add_classes(attr.value());
+  }
+
+  if (level >= seek_point.depth) {
+    seeking        = false;
+    current_offset = seek_point.offset;
+  }
+}
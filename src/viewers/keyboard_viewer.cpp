@@ -2,174 +2,186 @@
 //
 // MIT License. Look at file licenses.txt for details.
 
-#if 0
-
-// Not ready yet
-
 #define __KEYBOARD_VIEWER__ 1
 #include "viewers/keyboard_viewer.hpp"
 
-#if EPUB_INKPLATE_BUILD
-  #include "nvs.h"
-  #include "inkplate_platform.hpp"
-#endif
+#if INKPLATE_6PLUS || TOUCH_TRIAL
 
-bool 
-KeyboardViewer::get_alfanum(char * str, uint16_t len, UpdateHandler handler)
-{
-  width           = Screen::get_width() - 60;
-  current_kb_type = KBType::ALFA;
+#include "models/fonts.hpp"
 
-  if (page.get_compute_mode() == Page::ComputeMode::LOCATION) return false; // Cannot be used durint location computation
+#include <cstring>
 
-  fmt = {
-    .line_height_factor = 1.0,
-    .font_index         =   0,
-    .font_size          =  24,
-    .indent             =   0,
-    .margin_left        =  10,
-    .margin_right       =  10,
-    .margin_top         =  30,
-    .margin_bottom      =  10,
-    .screen_left        =   0,
-    .screen_right       =   0,
-    .screen_top         =   0,
-    .screen_bottom      =   0,
-    .width              =   0,
-    .height             =   0,
-    .vertical_align     =   0,
-    .trim               = true,
-    .pre                = false,
-    .font_style         = Fonts::FaceStyle::NORMAL,
-    .align              = CSS::Align::CENTER,
-    .text_transform     = CSS::TextTransform::NONE,
-    .display            = CSS::Display::INLINE
-  };
+void
+KeyboardViewer::compute_layout()
+{
+  key_dim = Dim((Screen::get_width() - 20 - ((MAX_KEY_COUNT - 1) * KEY_GAP)) / MAX_KEY_COUNT,
+                KEY_HEIGHT);
 
-  fmt.screen_left        = (Screen::get_width()  - width ) >> 1;
-  fmt.screen_right       = (Screen::get_width()  - width ) >> 1;
-  fmt.screen_top         = (Screen::get_height() - HEIGHT) >> 1;
-  fmt.screen_bottom      = (Screen::get_height() - HEIGHT) >> 1;
+  keyboard_ypos = Screen::get_height() - 20 - (ROW_COUNT * (KEY_HEIGHT + KEY_GAP));
 
-  page.set_compute_mode(Page::ComputeMode::DISPLAY);
-  
-  page.start(fmt);
+  int16_t space = keyboard_ypos - 10 - FIRST_LINE_YPOS;
+  line_count    = (space > 0) ? space / LINE_HEIGHT : 0;
+}
 
-#if 0
-  page.clear_region(
-    Dim(width, HEIGHT), 
-    Pos((Screen::get_width()  - width ) >> 1, (Screen::get_height() - HEIGHT) >> 1));
+Pos
+KeyboardViewer::key_pos(uint8_t row, uint8_t col)
+{
+  int16_t count     = strlen(rows[row]);
+  int16_t row_width = (count * key_dim.width) + ((count - 1) * KEY_GAP);
 
-  page.put_highlight(
-    Dim(width - 4, HEIGHT - 4), 
-    Pos(((Screen::get_width() - width ) >> 1) + 2, ((Screen::get_height() - HEIGHT) >> 1) + 2));
+  return Pos(((Screen::get_width() - row_width) >> 1) + (col * (key_dim.width + KEY_GAP)),
+             keyboard_ypos + (row * (KEY_HEIGHT + KEY_GAP)));
+}
 
-  TTF * font = fonts.get(0);
+void
+KeyboardViewer::show_key(char ch, Pos pos)
+{
+  static Font::Glyph * glyph = nullptr;
 
-  if (font == nullptr) {
-    LOG_E("Internal error (Drawings Font not available!");
-    return;
+  if (glyph == nullptr) {
+    Font * font = fonts.get(1);
+    if (font != nullptr) glyph = font->get_glyph('0', KEY_FONT_SIZE);
   }
 
-  Font::Glyph * glyph = font->get_glyph(icon_char[severity], 24);
+  const char * label;
+  char         str[2] = { ch, 0 };
 
-  if (glyph != nullptr) {
-    page.put_char_at(
-      icon_char[severity], 
-      Pos(((Screen::get_width()  - width ) >> 1) + 50 - (glyph->dim.width >> 1), ( Screen::get_height() >> 1) + 20),
-      fmt);
+  switch (ch) {
+    case '\b': label = "BSP"; break;
+    case ' ' : label = "SPC"; break;
+    case '\r': label = "OK";  break;
+    default:   label = str;   break;
   }
-  
-  fmt.font_index =  1;
-  fmt.font_size  = 10;
 
-  // Title
+  page.put_highlight(key_dim, pos);
+  if ((ch == '\r') || (ch == '\b')) {
+    page.put_highlight(Dim(key_dim.width - 2, key_dim.height - 2), Pos(pos.x + 1, pos.y + 1));
+  }
+
+  int16_t glyph_height = (glyph == nullptr) ? 0 : glyph->dim.height;
+
+  page.put_str_at(label,
+                  Pos(pos.x + (key_dim.width >> 1), pos.y + (glyph_height >> 1) + (key_dim.height >> 1)),
+                  fmt);
+}
+
+void
+KeyboardViewer::show(const std::string & title, const std::string & text, const std::vector<std::string> & lines)
+{
+  compute_layout();
+
+  page.set_compute_mode(Page::ComputeMode::DISPLAY);
+
+  fmt = {
+    .line_height_factor =   0.8,
+    .font_index         = TITLE_FONT,
+    .font_size          = TITLE_FONT_SIZE,
+    .indent             =     0,
+    .margin_left        =     0,
+    .margin_right       =     0,
+    .margin_top         =     0,
+    .margin_bottom      =     0,
+    .screen_left        =    20,
+    .screen_right       =    20,
+    .screen_top         = TITLE_YPOS,
+    .screen_bottom      = (int16_t)(Screen::get_height() - TEXT_YPOS),
+    .width              =     0,
+    .height             =     0,
+    .vertical_align     =     0,
+    .trim               =  true,
+    .pre                = false,
+    .font_style         = Fonts::FaceStyle::BOLD,
+    .align              = CSS::Align::CENTER,
+    .text_transform     = CSS::TextTransform::NONE,
+    .display            = CSS::Display::INLINE
+  };
+
+  page.start(fmt);
 
   page.set_limits(fmt);
   page.new_paragraph(fmt);
-  std::string buffer = title;
-  page.add_text(buffer, fmt);
+  page.add_text(title, fmt);
   page.end_paragraph(fmt);
 
-  // Message
+  // The text entered, with a cursor at its end
+
+  page.put_highlight(Dim(Screen::get_width() - 40, TEXT_HEIGHT), Pos(20, TEXT_YPOS));
 
-  fmt.align       = CSS::Align::LEFT;
-  fmt.margin_top  = 80;
-  fmt.margin_left = 90;
+  fmt.font_size     = TEXT_FONT_SIZE;
+  fmt.font_style    = Fonts::FaceStyle::NORMAL;
+  fmt.align         = CSS::Align::LEFT;
+  fmt.screen_left   = 30;
+  fmt.screen_right  = 30;
+  fmt.screen_top    = TEXT_YPOS + 12;
+  fmt.screen_bottom = (int16_t)(Screen::get_height() - (TEXT_YPOS + TEXT_HEIGHT));
 
   page.set_limits(fmt);
   page.new_paragraph(fmt);
-  buffer = buff;
-  page.add_text(buffer, fmt);
+  page.add_text(text + "_", fmt);
   page.end_paragraph(fmt);
 
-  // Press a Key option
+  // Result lines
 
-  if (press_a_key) {
-    fmt.align = CSS::Align::CENTER;
-    fmt.font_size   =   9;
-    fmt.margin_left =  10;
-    fmt.margin_top  = 200;
+  fmt.font_size    = LINE_FONT_SIZE;
+  fmt.screen_left  = 20;
+  fmt.screen_right = 20;
+
+  int16_t ypos = FIRST_LINE_YPOS;
+  for (uint8_t idx = 0; (idx < line_count) && (idx < lines.size()); idx++, ypos += LINE_HEIGHT) {
+    fmt.screen_top    = ypos;
+    fmt.screen_bottom = (int16_t)(Screen::get_height() - (ypos + LINE_HEIGHT));
 
     page.set_limits(fmt);
     page.new_paragraph(fmt);
-    buffer = "[Press a key]";
-    page.add_text(buffer, fmt);
+    page.add_text(lines[idx], fmt);
     page.end_paragraph(fmt);
   }
-#endif
 
-  page.paint(false);
+  // The keyboard
 
-  return true;
-}
+  fmt.font_size     = KEY_FONT_SIZE;
+  fmt.align         = CSS::Align::CENTER;
+  fmt.screen_left   = 0;
+  fmt.screen_right  = 0;
+  fmt.screen_top    = 0;
+  fmt.screen_bottom = 0;
 
-void
-KeyboardViewer::show_kb(KBType kb_type)
-{
-  uint16_t x, y;
-
-  switch (kb_type) {
-    case KBType::ALFA:
-      show_line(alfa_line_1_low, x, y);
-      show_line(alfa_line_2_low, x, y);
-      show_line(alfa_line_3_low, x, y);
-      show_line(alfa_line_4, x, y);
-      break;
-
-    case KBType::ALFA_SHIFTED:
-      show_line(alfa_line_1_upp, x, y);
-      show_line(alfa_line_2_upp, x, y);
-      show_line(alfa_line_3_upp, x, y);
-      show_line(alfa_line_4, x, y);
-      break;
-    
-    case KBType::NUMBERS:
-      show_line(num_line_1, x, y);
-      show_line(num_line_2, x, y);
-      show_line(num_line_3, x, y);
-      show_line(num_line_4, x, y);
-      break;
-      
-    case KBType::SPECIAL:
-      show_line(special_line_1, x, y);
-      show_line(special_line_2, x, y);
-      show_line(special_line_3, x, y);
-      show_line(special_line_4, x, y);
-      break;
+  for (uint8_t row = 0; row < ROW_COUNT; row++) {
+    for (uint8_t col = 0; rows[row][col] != 0; col++) {
+      show_key(rows[row][col], key_pos(row, col));
+    }
   }
+
+  page.paint(true, false, false, RefreshScheduler::Intent::UI);
 }
 
-void 
-KeyboardViewer::show_line(const char * line, uint16_t & x, uint16_t y)
+char
+KeyboardViewer::get_key_at(uint16_t x, uint16_t y)
 {
+  compute_layout();
 
+  if (y < keyboard_ypos) return 0;
+
+  uint8_t row = (y - keyboard_ypos) / (KEY_HEIGHT + KEY_GAP);
+  if (row >= ROW_COUNT) return 0;
+
+  for (uint8_t col = 0; rows[row][col] != 0; col++) {
+    Pos pos = key_pos(row, col);
+    if ((x >= pos.x) && (x < (pos.x + key_dim.width + KEY_GAP))) return rows[row][col];
+  }
+
+  return 0;
 }
 
-void 
-KeyboardViewer::show_char(char ch, uint16_t & x, uint16_t y)
+int16_t
+KeyboardViewer::get_line_at(uint16_t x, uint16_t y)
 {
+  compute_layout();
+
+  if (y < FIRST_LINE_YPOS) return -1;
 
+  int16_t idx = (y - FIRST_LINE_YPOS) / LINE_HEIGHT;
+  return (idx < line_count) ? idx : -1;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -234,7 +234,7 @@ LinearBooksDirViewer::highlight(int16_t item_idx)
       BatteryViewer::show();
     #endif
 
-    page.paint(false);
+    page.paint(false, false, false, RefreshScheduler::Intent::UI);
   }
   #endif
 }
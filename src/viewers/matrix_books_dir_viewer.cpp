@@ -319,7 +319,7 @@ MatrixBooksDirViewer::highlight(int16_t item_idx)
 
   ScreenBottom::show(current_page_nbr, page_count);
 
-  page.paint(false);
+  page.paint(false, false, false, RefreshScheduler::Intent::UI);
 }
 
 void 
@@ -396,7 +396,7 @@ MatrixBooksDirViewer::clear_highlight()
     BatteryViewer::show();
   #endif
 
-  page.paint(false);
+  page.paint(false, false, false, RefreshScheduler::Intent::UI);
 
   current_item_idx = -1;
 }
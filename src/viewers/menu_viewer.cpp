@@ -226,7 +226,7 @@ MenuViewer::clear_highlight()
       page.put_str_at(TOUCH_AND_HOLD_STR, Pos{ 10, text_ypos }, fmt);
     }
 
-    page.paint(false);
+    page.paint(false, false, false, RefreshScheduler::Intent::UI);
   #endif
 }
 
@@ -274,7 +274,7 @@ MenuViewer::event(const EventMgr::Event & event)
           page.put_str_at(txt, Pos{ 10, text_ypos }, fmt);
           hint_shown = true;
 
-          page.paint(false);
+          page.paint(false, false, false, RefreshScheduler::Intent::UI);
         }
         break;
 
@@ -306,7 +306,7 @@ MenuViewer::event(const EventMgr::Event & event)
                 Dim(entry_locs[current_entry_index].dim.width + 8, entry_locs[current_entry_index].dim.height + 8),
                 Pos(entry_locs[current_entry_index].pos.x - 4,     entry_locs[current_entry_index].pos.y - 4     ));
 
-              page.paint(false);
+              page.paint(false, false, false, RefreshScheduler::Intent::UI);
             }
             else {
               hint_shown = false;
@@ -380,7 +380,7 @@ MenuViewer::event(const EventMgr::Event & event)
 
     ScreenBottom::show();
 
-    page.paint(false);
+    page.paint(false, false, false, RefreshScheduler::Intent::UI);
   #endif
   
   return false;
@@ -328,7 +328,7 @@ void MsgViewer::add_dot()
 
   dot_count++;
 
-  page.paint(false, true, true);
+  page.paint(false, true, true, RefreshScheduler::Intent::UI);
 }
 #endif
 
@@ -347,7 +347,7 @@ MsgViewer::out_of_memory(const char * raison)
     }
   #endif
 
-  screen.force_full_update();
+  refresh_scheduler.force_full_update();
 
   #if INKPLATE_6PLUS
     #define MSG "Press the WakUp Button to restart."
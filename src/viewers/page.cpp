@@ -8,6 +8,8 @@
 #include "viewers/page.hpp"
 #include "viewers/msg_viewer.hpp"
 #include "screen.hpp"
+#include "helpers/perf_stats.hpp"
+#include "helpers/memory_budget.hpp"
 #include "alloc.hpp"
 
 #include <iostream>
@@ -15,14 +17,9 @@
 
 #include <algorithm>
 
-static void
-no_mem()
-{
-  msg_viewer.out_of_memory("display list allocation");
-}
-
 Page::Page() :
   compute_mode(ComputeMode::DISPLAY), 
+  normal_font_size(0),
   screen_is_full(false)
 {
   clear_display_list();
@@ -39,17 +36,17 @@ Page::clean()
 }
 
 void
-Page::clear_display_list()
+Page::release_images(DisplayList & list)
 {
-  for (auto * entry: display_list) {
-    if (entry->command == DisplayListCommand::IMAGE) {
-      if (entry->kind.image_entry.image.bitmap) {
-        delete [] entry->kind.image_entry.image.bitmap;
-      }
+  for (auto & entry : list) {
+    if ((entry.command == DisplayListCommand::IMAGE) && 
+        (entry.kind.image_entry.image.bitmap != nullptr)) {
+      memory_budget.release(MemoryBudget::Consumer::IMAGES,
+                            entry.kind.image_entry.image.bitmap,
+                            entry.kind.image_entry.image.dim.width * entry.kind.image_entry.image.dim.height);
+      entry.kind.image_entry.image.bitmap = nullptr;
     }
-    display_list_entry_pool.deleteElement(entry);
   }
-  display_list.clear();
 }
 
 // 00000000 -- 0000007F: 	0xxxxxxx
@@ -57,6 +54,19 @@ Page::clear_display_list()
 // 00000800 -- 0000FFFF: 	1110xxxx 10xxxxxx 10xxxxxx
 // 00010000 -- 001FFFFF: 	11110xxx 10xxxxxx 10xxxxxx 10xxxxxx
 
+static const struct Entity {
+  const char * name;
+  uint8_t      length;
+  uint16_t     code;
+} entities[] = {
+  { "nbsp",   4,    160 }, { "lt",     2,     60 }, { "gt",     2,     62 }, 
+  { "amp",    3,     38 }, { "quot",   4,     34 }, { "apos",   4,     39 }, 
+  { "mdash",  5, 0x2014 }, { "ndash",  5, 0x2013 }, { "lsquo",  5, 0x2018 },
+  { "rsquo",  5, 0x2019 }, { "ldquo",  5, 0x201C }, { "rdquo",  5, 0x201D }, 
+  { "euro",   4, 0x20AC }, { "dagger", 6, 0x2020 }, { "Dagger", 6, 0x2021 },
+  { "copy",   4,   0xa9 }
+};
+
 int32_t 
 Page::to_unicode(const char *str, CSS::TextTransform transform, bool first, const char **str2) const
 {
@@ -69,22 +79,9 @@ Page::to_unicode(const char *str, CSS::TextTransform transform, bool first, cons
     uint8_t len = 0;
     while ((len < 7) && (*s != 0) && (*s != ';')) { s++; len++; }
     if (*s == ';') {
-      if      (strncmp("nbsp;",  (const char *) c, 5) == 0) u =    160;
-      else if (strncmp("lt;",    (const char *) c, 3) == 0) u =     60;
-      else if (strncmp("gt;",    (const char *) c, 3) == 0) u =     62;
-      else if (strncmp("amp;",   (const char *) c, 4) == 0) u =     38;
-      else if (strncmp("quot;",  (const char *) c, 5) == 0) u =     34;
-      else if (strncmp("apos;",  (const char *) c, 5) == 0) u =     39;
-      else if (strncmp("mdash;", (const char *) c, 6) == 0) u = 0x2014;
-      else if (strncmp("ndash;", (const char *) c, 6) == 0) u = 0x2013;
-      else if (strncmp("lsquo;", (const char *) c, 6) == 0) u = 0x2018;
-      else if (strncmp("rsquo;", (const char *) c, 6) == 0) u = 0x2019;
-      else if (strncmp("ldquo;", (const char *) c, 6) == 0) u = 0x201C;
-      else if (strncmp("rdquo;", (const char *) c, 6) == 0) u = 0x201D;
-      else if (strncmp("euro;",  (const char *) c, 5) == 0) u = 0x20AC;
-      else if (strncmp("dagger;",(const char *) c, 7) == 0) u = 0x2020;
-      else if (strncmp("Dagger;",(const char *) c, 7) == 0) u = 0x2021;
-      else if (strncmp("copy;",  (const char *) c, 5) == 0) u =   0xa9;
+      for (auto & entity : entities) {
+        if ((entity.length == len) && (memcmp(entity.name, c, len) == 0)) { u = entity.code; break; }
+      }
       if (u == 0) {
         u = '&';
       }
@@ -120,6 +117,7 @@ Page::to_unicode(const char *str, CSS::TextTransform transform, bool first, cons
       if (*c == 0) break; else u = (u << 6) + (*c++ & 0x3F);
       done = true;
     }
+    else c++; // Not a valid UTF-8 leading byte: skipped
     break;
   }
   *str2 = (char *) c;
@@ -131,6 +129,22 @@ Page::to_unicode(const char *str, CSS::TextTransform transform, bool first, cons
   return done ? u : ' ';
 }
 
+// All characters of a word are decoded in a single pass, entities included.
+
+void
+Page::decode_word(const char * word, int16_t length, CSS::TextTransform transform)
+{
+  const char * str   = word;
+  const char * end   = word + length;
+  bool         first = true;
+
+  word_codes.clear();
+  while (str < end) {
+    word_codes.push_back(to_unicode(str, transform, first, &str));
+    first = false;
+  }
+}
+
 void 
 Page::put_str_at(const std::string & str, Pos pos, const Format & fmt)
 {
@@ -146,8 +160,7 @@ Page::put_str_at(const std::string & str, Pos pos, const Format & fmt)
       glyph = font->get_glyph(to_unicode(s, fmt.text_transform, first, &s1), fmt.font_size);
       s = s1;
       if (glyph != nullptr) {
-        DisplayListEntry * entry = display_list_entry_pool.newElement();
-        if (entry == nullptr) no_mem();
+        DisplayListEntry * entry = new_entry(display_list);
         entry->command                   = DisplayListCommand::GLYPH;
         entry->kind.glyph_entry.glyph    = glyph;
         entry->kind.glyph_entry.kern     = glyph->advance;
@@ -163,8 +176,6 @@ Page::put_str_at(const std::string & str, Pos pos, const Format & fmt)
             LOG_E("Put_str_at with a too large location: %d %d", entry->pos.x, entry->pos.y);
           }
         #endif
-
-        display_list.push_front(entry);
       
         pos.x += glyph->advance;
       }
@@ -211,8 +222,7 @@ Page::put_str_at(const std::string & str, Pos pos, const Format & fmt)
       s = s1;
       if (glyph != nullptr) {
         
-        DisplayListEntry * entry = display_list_entry_pool.newElement();
-        if (entry == nullptr) no_mem();
+        DisplayListEntry * entry = new_entry(display_list);
 
         entry->command                   = DisplayListCommand::GLYPH;
         entry->kind.glyph_entry.glyph    = glyph;
@@ -229,8 +239,6 @@ Page::put_str_at(const std::string & str, Pos pos, const Format & fmt)
             LOG_E("Put_str_at with a too large location: %d %d", entry->pos.x, entry->pos.y);
           }
         #endif
-
-        display_list.push_front(entry);
       
         x += glyph->advance;
       }
@@ -248,8 +256,7 @@ Page::put_char_at(char ch, Pos pos, const Format & fmt)
 
   glyph = font->get_glyph(ch, fmt.font_size);
   if (glyph != nullptr) {
-    DisplayListEntry * entry = display_list_entry_pool.newElement();
-    if (entry == nullptr) no_mem();
+    DisplayListEntry * entry = new_entry(display_list);
     entry->command                   = DisplayListCommand::GLYPH;
     entry->kind.glyph_entry.glyph    = glyph;
     entry->kind.glyph_entry.kern     = glyph->advance;
@@ -265,78 +272,278 @@ Page::put_char_at(char ch, Pos pos, const Format & fmt)
         LOG_E("Put_char_at with a too large location: %d %d", entry->pos.x, entry->pos.y);
       }
     #endif
-
-    display_list.push_front(entry);
   }  
 }
 
 void
-Page::paint(bool clear_screen, bool no_full, bool do_it)
+Page::paint(bool clear_screen, bool no_full, bool do_it, RefreshScheduler::Intent intent)
 {
   if (!do_it) if ((display_list.empty()) || (compute_mode != ComputeMode::DISPLAY)) return;
   
+  PERF_SCOPE(BLIT);
+
   if (clear_screen) screen.clear();
 
-  display_list.reverse();
+  // Region covered by the display list
 
-  for (auto * entry : display_list) {
-    if (entry->command == DisplayListCommand::GLYPH) {
-      if (entry->kind.glyph_entry.glyph != nullptr) {
+  int16_t x_min = Screen::get_width(), y_min = Screen::get_height(), x_max = 0, y_max = 0;
+
+  auto extend = [&](Pos pos, Dim dim) {
+    if (pos.x              < x_min) x_min = pos.x;
+    if (pos.y              < y_min) y_min = pos.y;
+    if (pos.x + dim.width  > x_max) x_max = pos.x + dim.width;
+    if (pos.y + dim.height > y_max) y_max = pos.y + dim.height;
+  };
+
+  for (auto & entry : display_list) {
+    if (entry.command == DisplayListCommand::GLYPH) {
+      if (entry.kind.glyph_entry.glyph != nullptr) {
+        PERF_SCOPE(DRAW_GLYPH);
         screen.draw_glyph(
-          entry->kind.glyph_entry.glyph->buffer,
-          entry->kind.glyph_entry.glyph->dim,
-          entry->pos,
-          entry->kind.glyph_entry.glyph->pitch);
+          entry.kind.glyph_entry.glyph->buffer,
+          entry.kind.glyph_entry.glyph->dim,
+          entry.pos,
+          entry.kind.glyph_entry.glyph->pitch);
+        extend(entry.pos, entry.kind.glyph_entry.glyph->dim);
       }
       else {
         LOG_E("DISPLAY LIST CORRUPTED!!");
       }
+      continue;
     }
-    else if (entry->command == DisplayListCommand::IMAGE) {
+    else if (entry.command == DisplayListCommand::IMAGE) {
       screen.draw_bitmap(
-        entry->kind.image_entry.image.bitmap, 
-        entry->kind.image_entry.image.dim,  
-        entry->pos);
-    }
-    else if (entry->command == DisplayListCommand::HIGHLIGHT) {
+        entry.kind.image_entry.image.bitmap, 
+        entry.kind.image_entry.image.dim,  
+        entry.pos);
+      extend(entry.pos, entry.kind.image_entry.image.dim);
+      if (intent == RefreshScheduler::Intent::TEXT) intent = RefreshScheduler::Intent::IMAGE;
+      continue;
+    }
+    else if (entry.command == DisplayListCommand::HIGHLIGHT) {
       screen.draw_rectangle(
-        entry->kind.region_entry.dim, 
-        entry->pos, 
+        entry.kind.region_entry.dim, 
+        entry.pos, 
         Screen::BLACK_COLOR);
     }
-    else if (entry->command == DisplayListCommand::CLEAR_HIGHLIGHT) {
+    else if (entry.command == DisplayListCommand::CLEAR_HIGHLIGHT) {
       screen.draw_rectangle(
-        entry->kind.region_entry.dim, 
-        entry->pos,
+        entry.kind.region_entry.dim, 
+        entry.pos,
         Screen::WHITE_COLOR);
     }
-    else if (entry->command == DisplayListCommand::ROUNDED) {
+    else if (entry.command == DisplayListCommand::ROUNDED) {
       screen.draw_round_rectangle(
-        entry->kind.region_entry.dim, 
-        entry->pos, 
+        entry.kind.region_entry.dim, 
+        entry.pos, 
         Screen::BLACK_COLOR);
     }
-    else if (entry->command == DisplayListCommand::CLEAR_ROUNDED) {
+    else if (entry.command == DisplayListCommand::CLEAR_ROUNDED) {
       screen.draw_round_rectangle(
-        entry->kind.region_entry.dim, 
-        entry->pos,
+        entry.kind.region_entry.dim, 
+        entry.pos,
         Screen::WHITE_COLOR);
     }
-    else if (entry->command == DisplayListCommand::CLEAR_REGION) {
+    else if (entry.command == DisplayListCommand::CLEAR_REGION) {
       screen.colorize_region(
-        entry->kind.region_entry.dim, 
-        entry->pos,
+        entry.kind.region_entry.dim, 
+        entry.pos,
         Screen::WHITE_COLOR);
     }
-    else if (entry->command == DisplayListCommand::SET_REGION) {
+    else if (entry.command == DisplayListCommand::SET_REGION) {
       screen.colorize_region(
-        entry->kind.region_entry.dim, 
-        entry->pos,
+        entry.kind.region_entry.dim, 
+        entry.pos,
         Screen::BLACK_COLOR);
     }
+    extend(entry.pos, entry.kind.region_entry.dim);
+  }
+
+  PERF_SCOPE(SCREEN_UPDATE);
+  if (clear_screen || (x_max <= x_min) || (y_max <= y_min)) {
+    refresh_scheduler.update(intent, no_full);
+  }
+  else {
+    refresh_scheduler.update(intent, Dim(x_max - x_min, y_max - y_min), Pos(x_min, y_min), no_full);
+  }
+}
+
+// Serialized display list opcodes. Region entries are saved using their
+// DisplayListCommand value, followed by their position and dimensions.
+
+static constexpr uint8_t OP_FONT       = 0x80; ///< style, name length, name, size
+static constexpr uint8_t OP_BASELINE   = 0x81; ///< y of the following glyphs
+static constexpr uint8_t OP_GLYPH      = 0x82; ///< 16 bits code, x
+static constexpr uint8_t OP_WIDE_GLYPH = 0x83; ///< 32 bits code, x
+
+template <typename T>
+static inline void
+put_value(std::vector<uint8_t> & data, T value)
+{
+  const uint8_t * p = (const uint8_t *) &value;
+  data.insert(data.end(), p, p + sizeof(T));
+}
+
+template <typename T>
+static inline bool
+get_value(const uint8_t * & data, const uint8_t * end, T & value)
+{
+  if ((end - data) < (int32_t) sizeof(T)) return false;
+  memcpy(&value, data, sizeof(T));
+  data += sizeof(T);
+  return true;
+}
+
+bool
+Page::serialize(std::vector<uint8_t> & data) const
+{
+  const Font * font = nullptr;
+  int16_t      size = 0;
+  uint16_t     y    = 0xFFFF;
+  std::string  name;
+
+  data.clear();
+
+  for (auto & entry : display_list) {
+    if (entry.command == DisplayListCommand::GLYPH) {
+      const Font::Glyph * glyph = entry.kind.glyph_entry.glyph;
+      if ((glyph == nullptr) || entry.kind.glyph_entry.is_space) continue;
+
+      if ((glyph->font != font) || (glyph->size != size)) {
+        Fonts::FaceStyle style;
+        if (!fonts.get_name_and_style(glyph->font, name, style) || (name.size() > 255)) {
+          data.clear();
+          return false;
+        }
+        font = glyph->font;
+        size = glyph->size;
+
+        put_value<uint8_t>(data, OP_FONT);
+        put_value<uint8_t>(data, (uint8_t) style);
+        put_value<uint8_t>(data, name.size());
+        data.insert(data.end(), name.begin(), name.end());
+        put_value<int16_t>(data, size);
+      }
+
+      if (entry.pos.y != y) {
+        y = entry.pos.y;
+        put_value<uint8_t >(data, OP_BASELINE);
+        put_value<uint16_t>(data, y);
+      }
+
+      if (glyph->code > 0xFFFF) {
+        put_value<uint8_t >(data, OP_WIDE_GLYPH);
+        put_value<uint32_t>(data, glyph->code);
+      }
+      else {
+        put_value<uint8_t >(data, OP_GLYPH);
+        put_value<uint16_t>(data, glyph->code);
+      }
+      put_value<uint16_t>(data, entry.pos.x);
+    }
+    else if (entry.command == DisplayListCommand::IMAGE) {
+      data.clear();
+      return false;
+    }
+    else {
+      put_value<uint8_t >(data, (uint8_t) entry.command);
+      put_value<uint16_t>(data, entry.pos.x);
+      put_value<uint16_t>(data, entry.pos.y);
+      put_value<uint16_t>(data, entry.kind.region_entry.dim.width);
+      put_value<uint16_t>(data, entry.kind.region_entry.dim.height);
+    }
+  }
+
+  return true;
+}
+
+bool
+Page::restore(const uint8_t * data, uint32_t size)
+{
+  const uint8_t * end        = data + size;
+  Font          * font       = nullptr;
+  int16_t         glyph_size = 0;
+  uint16_t        y          = 0;
+  bool            ok         = true;
+
+  clear_display_list();
+
+  while (ok && (data < end)) {
+    uint8_t op = *data++;
+
+    if (op == OP_FONT) {
+      uint8_t style, length;
+      ok = get_value(data, end, style) &&
+           get_value(data, end, length) &&
+           ((end - data) >= length);
+      if (ok) {
+        std::string name((const char *) data, length);
+        data += length;
+        int16_t idx = fonts.get_index(name, (Fonts::FaceStyle) style);
+        ok = (idx != -1) && get_value(data, end, glyph_size);
+        if (ok) font = fonts.get(idx);
+      }
+    }
+    else if (op == OP_BASELINE) {
+      ok = get_value(data, end, y);
+    }
+    else if ((op == OP_GLYPH) || (op == OP_WIDE_GLYPH)) {
+      uint32_t code;
+      uint16_t code16 = 0;
+      Pos      pos(0, y);
+
+      if (op == OP_GLYPH) {
+        ok   = get_value(data, end, code16);
+        code = code16;
+      }
+      else {
+        ok = get_value(data, end, code);
+      }
+
+      Font::Glyph * glyph = nullptr;
+      ok = ok && (font != nullptr) &&
+           get_value(data, end, pos.x) &&
+           ((glyph = font->get_glyph_from_code(code, glyph_size)) != nullptr);
+
+      if (ok) {
+        DisplayListEntry * entry = new_entry(display_list);
+
+        entry->command                   = DisplayListCommand::GLYPH;
+        entry->kind.glyph_entry.glyph    = glyph;
+        entry->kind.glyph_entry.kern     = glyph->advance;
+        entry->kind.glyph_entry.is_space = false;
+        entry->pos                       = pos;
+      }
+    }
+    else if ((op >= (uint8_t) DisplayListCommand::HIGHLIGHT) && 
+             (op <= (uint8_t) DisplayListCommand::CLEAR_ROUNDED)) {
+      Pos pos(0, 0);
+      Dim dim(0, 0);
+
+      ok = get_value(data, end, pos.x    ) &&
+           get_value(data, end, pos.y    ) &&
+           get_value(data, end, dim.width) &&
+           get_value(data, end, dim.height);
+
+      if (ok) {
+        DisplayListEntry * entry = new_entry(display_list);
+
+        entry->command               = (DisplayListCommand) op;
+        entry->kind.region_entry.dim = dim;
+        entry->pos                   = pos;
+      }
+    }
+    else {
+      ok = false;
+    }
+  }
+
+  if (!ok) {
+    LOG_D("Serialized display list not restored.");
+    clear_display_list();
   }
 
-  screen.update(no_full);
+  return ok;
 }
 
 void
@@ -469,7 +676,7 @@ Page::end_paragraph(const Format & fmt)
 }
 
 void
-Page::add_line(const Format & fmt, bool justifyable)
+Page::add_line(const Format & fmt, bool justifyable, uint16_t count)
 {
   if (pos.y == 0) pos.y = min_y;
 
@@ -479,44 +686,28 @@ Page::add_line(const Format & fmt, bool justifyable)
   int16_t line_height = glyphs_height * line_height_factor;
   pos.y += top_margin + line_height; // (line_height >> 1) + (glyphs_height >> 1);
 
-  // #if DEBUGGING_AID
-  //   if (show_location) {
-  //     std::cout << "New Line: ";
-  //     show_controls(" ");
-  //     show_fmt(fmt, "   ->  ");  
-  //   }
-  // #endif
-
   // Get rid of space characters that are at the end of the line.
   // This is mainly required for the JUSTIFY alignment algo.
 
-  while (!line_list.empty()) {
-    DisplayListEntry * entry = *(line_list.begin());
-    if ((entry->command == DisplayListCommand::GLYPH) && (entry->kind.glyph_entry.is_space)) {
-      display_list_entry_pool.deleteElement(entry);
-      line_list.pop_front(); 
+  DisplayList::iterator line_begin = line_list.begin();
+  DisplayList::iterator line_end   = line_begin + count;
+
+  while (line_end != line_begin) {
+    DisplayListEntry & entry = *(line_end - 1);
+    if ((entry.command == DisplayListCommand::GLYPH) && (entry.kind.glyph_entry.is_space)) {
+      line_end--;
     }
     else break;
-    // if (entry->pos.y > 0) {
-    //   if (entry->command == DisplayListCommand::IMAGE) {
-    //     if (entry->kind.image_entry.image.bitmap != nullptr) {
-    //       delete [] entry->kind.image_entry.image.bitmap;
-    //     }
-    //   }
-    // }
-    // else break;
   }
 
-  line_list.reverse();
-  
-  if (!line_list.empty() && (compute_mode == ComputeMode::DISPLAY)) {
+  if ((line_end != line_begin) && (compute_mode == ComputeMode::DISPLAY)) {
   
     if ((fmt.align == CSS::Align::JUSTIFY) && justifyable) {
       int16_t target_width = (para_max_x - para_min_x - para_indent);
       int16_t loop_count = 0;
       while ((line_width < target_width) && (++loop_count < 50)) {
         bool at_least_once = false;
-        for (auto * entry : line_list) {
+        for (DisplayList::iterator entry = line_begin; entry != line_end; entry++) {
           if (entry->pos.x > 0) {  // This means it's a white space
             at_least_once = true;
             entry->pos.x++;
@@ -526,7 +717,7 @@ Page::add_line(const Format & fmt, bool justifyable)
         if (!at_least_once) break; // No space available in line to justify the line
       }
       if (loop_count >= 50) {
-        for (auto * entry : line_list) entry->pos.x = 0;
+        for (DisplayList::iterator entry = line_begin; entry != line_end; entry++) entry->pos.x = 0;
       }
     }
     else {
@@ -539,7 +730,7 @@ Page::add_line(const Format & fmt, bool justifyable)
     }
   }
   
-  for (auto * entry : line_list) {
+  for (DisplayList::iterator entry = line_begin; entry != line_end; entry++) {
     if (entry->command == DisplayListCommand::GLYPH) {
       int16_t x     = entry->pos.x; // x may contains the calculated gap between words
       entry->pos.x  = pos.x + entry->kind.glyph_entry.glyph->xoff;
@@ -572,13 +763,16 @@ Page::add_line(const Format & fmt, bool justifyable)
         show_fmt(fmt, "  -> ");
       }
     #endif
-
-    display_list.push_front(entry);
   };
+
+  // The line entries are moved to the display list. The entries following
+  // the line (a word that didn't fit) are kept for the next line.
+
+  display_list.insert(display_list.end(), line_begin, line_end);
+  line_list.erase(line_begin, line_begin + count);
   
   line_width = line_height = glyphs_height = 0;
   line_height_factor = 0.0;
-  clear_line_list();
 
   para_indent = 0;
   top_margin  = 0;
@@ -591,8 +785,7 @@ Page::add_glyph_to_line(Font::Glyph * glyph, const Format & fmt, Font & font, bo
 {
   if (is_space && (line_width == 0)) return;
 
-  DisplayListEntry * entry = display_list_entry_pool.newElement();
-  if (entry == nullptr) no_mem();
+  DisplayListEntry * entry = new_entry(line_list);
 
   entry->command                   = DisplayListCommand::GLYPH;
   entry->kind.glyph_entry.glyph    = glyph;
@@ -605,15 +798,12 @@ Page::add_glyph_to_line(Font::Glyph * glyph, const Format & fmt, Font & font, bo
   if (line_height_factor < fmt.line_height_factor) line_height_factor = fmt.line_height_factor;
 
   line_width += (glyph->advance);
-
-  line_list.push_front(entry);
 }
 
 void 
 Page::add_image_to_line(Image & image, int16_t advance, const Format & fmt)
 {
-  DisplayListEntry * entry = display_list_entry_pool.newElement();
-  if (entry == nullptr) no_mem();
+  DisplayListEntry * entry = new_entry(line_list);
 
   entry->command                  = DisplayListCommand::IMAGE;
   entry->kind.image_entry.advance = advance;
@@ -655,16 +845,16 @@ Page::add_image_to_line(Image & image, int16_t advance, const Format & fmt)
   //   image.width, image.height,
   //   entry->kind.image_entry.advance
   // );
-
-  line_list.push_front(entry);
 }
 
 #define NEXT_LINE_REQUIRED_SPACE (pos.y + (fmt.line_height_factor * font->get_line_height(fmt.font_size)) - font->get_descender_height(fmt.font_size))
 
 #if 1
 bool
-Page::add_word(const char * word,  const Format & fmt)
+Page::add_word(const char * word, int16_t length, const Format & fmt)
 {
+  PERF_SCOPE(ADD_WORD);
+
   Font * font = fonts.get(fmt.font_index);
   if (font == nullptr) return false;
 
@@ -673,91 +863,62 @@ Page::add_word(const char * word,  const Format & fmt)
     if ((screen_is_full = NEXT_LINE_REQUIRED_SPACE > max_y)) return false;
   }
 
-  Font::Glyph * glyph;
+  // The word glyphs are added at the end of the line list. If the word doesn't
+  // fit on the current line, the line is completed with the entries preceding them.
 
-  DisplayList      * the_list = new DisplayList;
-  const char       * str      = word;
-  int16_t            height   = font->get_line_height(fmt.font_size);
-  int16_t            width    = 0;
-  bool               first    = true;
- 
-  while (*str) {
-    bool ignore_next;
-    const char * str1, * str2;
-    uint32_t uc1, uc2;
-    int16_t  kern;
-
-    uc1 = to_unicode(str,  fmt.text_transform, first, &str1);
-    uc2 = to_unicode(str1, fmt.text_transform, false, &str2);
-
-    glyph = font->get_glyph(uc1, uc2, fmt.font_size, kern, ignore_next);
+  uint16_t word_start = line_list.size();
+  int16_t  height     = font->get_line_height(fmt.font_size);
+  int16_t  width;
 
-    str = ignore_next ? str2 : str1;    
-
-    if (glyph == nullptr) {
-      glyph = font->get_glyph(' ', fmt.font_size);
-    }
+  word_key.assign(1, (char) fmt.text_transform);
+  word_key.append(word, length);
 
-    if (glyph != nullptr) {
-      width += kern;
-      first  = false;
-
-      DisplayListEntry * entry = display_list_entry_pool.newElement();
-      if (entry == nullptr) no_mem();
+  if (font->get_word(word_key, fmt.font_size, word_glyphs, width)) {
+    PERF_COUNT(WORD_CACHE_HIT);
+  }
+  else {
+    PERF_COUNT(WORD_CACHE_MISS);
+    PERF_SCOPE(WORD_DECODE);
+    decode_word(word, length, fmt.text_transform);
+    width = font->add_word(word_key, word_codes, fmt.font_size, word_glyphs);
+  }
 
-      entry->command                   = DisplayListCommand::GLYPH;
-      entry->kind.glyph_entry.glyph    = glyph;
-      entry->kind.glyph_entry.kern     = kern;
-      entry->pos.x                     = 0;
-      entry->kind.glyph_entry.is_space = false;
-      entry->pos.y                     = fmt.vertical_align;
+  for (auto & word_glyph : word_glyphs) {
+    DisplayListEntry * entry = new_entry(line_list);
 
-      the_list->push_front(entry);
-    }
+    entry->command                   = DisplayListCommand::GLYPH;
+    entry->kind.glyph_entry.glyph    = word_glyph.glyph;
+    entry->kind.glyph_entry.kern     = word_glyph.kern;
+    entry->pos.x                     = 0;
+    entry->kind.glyph_entry.is_space = false;
+    entry->pos.y                     = fmt.vertical_align;
   }
 
   uint16_t avail_width = para_max_x - para_min_x - para_indent;
 
   if (width >= avail_width) {
-    if (strncasecmp(word, "http", 4) == 0) {
-      for (auto * entry : *the_list) {
-        display_list_entry_pool.deleteElement(entry);
-      }
-      the_list->clear();
-      delete the_list;
+    if ((length >= 4) && (strncasecmp(word, "http", 4) == 0)) {
+      line_list.resize(word_start);
       return add_word("[URL removed]", fmt);
     }
     else {
-      LOG_E("WORD TOO LARGE!! '%s'", word);
+      LOG_E("WORD TOO LARGE!! '%.*s'", length, word);
     }
   }
 
-  
   if ((line_width + width) >= avail_width) {
-    add_line(fmt, true);
+    add_line(fmt, true, word_start);
     screen_is_full = NEXT_LINE_REQUIRED_SPACE > max_y;
     if (screen_is_full) {
-      for (auto * entry : *the_list) {
-        display_list_entry_pool.deleteElement(entry);
-      }
-      the_list->clear();
-      delete the_list;
+      line_list.clear();
       return false;
     }
   }
 
-  line_list.splice_after(line_list.before_begin(), *the_list);
-
   if (glyphs_height < height) glyphs_height = height;
   if (line_height_factor < fmt.line_height_factor) line_height_factor = fmt.line_height_factor;
   line_width += width;
 
-  for (auto * entry : *the_list) {
-    display_list_entry_pool.deleteElement(entry);
-  }
-  the_list->clear();
-  delete the_list;
-
   return true;
 }
 #else
@@ -975,8 +1136,6 @@ Page::add_text(std::string str, const Format & fmt)
 {
   Format myfmt = fmt;
 
-  char * buff = new char[100];
-  if (buff == nullptr) msg_viewer.out_of_memory("temp buffer allocation");
   const char *s = str.c_str();
   while (*s) {
     if (uint8_t(*s) <= ' ') {
@@ -987,26 +1146,23 @@ Page::add_text(std::string str, const Format & fmt)
       s++;
     }
     else {
-      int16_t count = 0;
-      while (uint8_t(*s) > ' ') { buff[count++] = *s++; }
-      buff[count] = 0;
-      if (!add_word(buff, myfmt)) break;
+      const char * word = s;
+      while (uint8_t(*s) > ' ') s++;
+      if (!add_word(word, s - word, myfmt)) break;
     }
   }
-
-  delete [] buff;
 }
 
 void 
 Page::put_image(Image::ImageData & image, 
                 Pos                  pos)
 {
-  DisplayListEntry * entry = display_list_entry_pool.newElement();
-  if (entry == nullptr) no_mem();
+  DisplayListEntry * entry = new_entry(display_list);
 
   if (compute_mode == ComputeMode::DISPLAY) {
     int32_t size = image.dim.width * image.dim.height;
-    if ((entry->kind.image_entry.image.bitmap = new unsigned char [size]) == nullptr) {
+    entry->kind.image_entry.image.bitmap = (uint8_t *) memory_budget.allocate(MemoryBudget::Consumer::IMAGES, size);
+    if (entry->kind.image_entry.image.bitmap == nullptr) {
       msg_viewer.out_of_memory("image allocation");
     }
     memcpy((void *)entry->kind.image_entry.image.bitmap, image.bitmap, size);
@@ -1027,15 +1183,12 @@ Page::put_image(Image::ImageData & image,
       LOG_E("draw_bitmap with a too large location: %d %d", entry->pos.x, entry->pos.y);
     }
   #endif
-
-  display_list.push_front(entry);
 }
 
 void 
 Page::put_highlight(Dim dim, Pos pos)
 {
-  DisplayListEntry * entry = display_list_entry_pool.newElement();
-  if (entry == nullptr) no_mem();
+  DisplayListEntry * entry = new_entry(display_list);
 
   entry->command               = DisplayListCommand::HIGHLIGHT;
   entry->kind.region_entry.dim = dim;
@@ -1049,15 +1202,12 @@ Page::put_highlight(Dim dim, Pos pos)
       LOG_E("put_highlight with a too large location: %d %d", entry->pos.x, entry->pos.y);
     }
   #endif
-
-  display_list.push_front(entry);
 }
 
 void 
 Page::clear_highlight(Dim dim, Pos pos)
 {
-  DisplayListEntry * entry = display_list_entry_pool.newElement();
-  if (entry == nullptr) no_mem();
+  DisplayListEntry * entry = new_entry(display_list);
 
   entry->command               = DisplayListCommand::CLEAR_HIGHLIGHT;
   entry->kind.region_entry.dim = dim;
@@ -1071,15 +1221,12 @@ Page::clear_highlight(Dim dim, Pos pos)
       LOG_E("Put_str_at with a too large location: %d %d", entry->pos.x, entry->pos.y);
     }
   #endif
-
-  display_list.push_front(entry);
 }
 
 void 
 Page::put_rounded(Dim dim, Pos pos)
 {
-  DisplayListEntry * entry = display_list_entry_pool.newElement();
-  if (entry == nullptr) no_mem();
+  DisplayListEntry * entry = new_entry(display_list);
 
   entry->command               = DisplayListCommand::ROUNDED;
   entry->kind.region_entry.dim = dim;
@@ -1093,15 +1240,12 @@ Page::put_rounded(Dim dim, Pos pos)
       LOG_E("put_highlight with a too large location: %d %d", entry->pos.x, entry->pos.y);
     }
   #endif
-
-  display_list.push_front(entry);
 }
 
 void 
 Page::clear_rounded(Dim dim, Pos pos)
 {
-  DisplayListEntry * entry = display_list_entry_pool.newElement();
-  if (entry == nullptr) no_mem();
+  DisplayListEntry * entry = new_entry(display_list);
 
   entry->command               = DisplayListCommand::CLEAR_ROUNDED;
   entry->kind.region_entry.dim = dim;
@@ -1115,15 +1259,12 @@ Page::clear_rounded(Dim dim, Pos pos)
       LOG_E("Put_str_at with a too large location: %d %d", entry->pos.x, entry->pos.y);
     }
   #endif
-
-  display_list.push_front(entry);
 }
 
 void 
 Page::clear_region(Dim dim, Pos pos)
 {
-  DisplayListEntry * entry = display_list_entry_pool.newElement();
-  if (entry == nullptr) no_mem();
+  DisplayListEntry * entry = new_entry(display_list);
 
   entry->command               = DisplayListCommand::CLEAR_REGION;
   entry->kind.region_entry.dim = dim;
@@ -1137,16 +1278,13 @@ Page::clear_region(Dim dim, Pos pos)
       LOG_E("Put_str_at with a too large location: %d %d", entry->pos.x, entry->pos.y);
     }
   #endif
-
-  display_list.push_front(entry);
 }
 
 
 void 
 Page::set_region(Dim dim, Pos pos)
 {
-  DisplayListEntry * entry = display_list_entry_pool.newElement();
-  if (entry == nullptr) no_mem();
+  DisplayListEntry * entry = new_entry(display_list);
 
   entry->command               = DisplayListCommand::SET_REGION;
   entry->kind.region_entry.dim = dim;
@@ -1160,8 +1298,6 @@ Page::set_region(Dim dim, Pos pos)
       LOG_E("Put_str_at with a too large location: %d %d", entry->pos.x, entry->pos.y);
     }
   #endif
-
-  display_list.push_front(entry);
 }
 
 bool
@@ -1192,7 +1328,9 @@ Page::show_cover(Image & img)
 
       screen.clear();
       screen.draw_bitmap(img.get_bitmap(), img.get_dim(), pos);
-      screen.update();
+
+      PERF_SCOPE(SCREEN_UPDATE);
+      refresh_scheduler.update(RefreshScheduler::Intent::IMAGE);
     }
     else {
       LOG_D("Unable to load cover file");
@@ -1210,68 +1348,74 @@ Page::show_display_list(const DisplayList & list, const char * title) const
 {
   #if DEBUGGING
     std::cout << title << std::endl;
-    for (auto * entry : list) {
-      if (entry->command == DisplayListCommand::GLYPH) {
+    for (auto & entry : list) {
+      if (entry.command == DisplayListCommand::GLYPH) {
         std::cout << "GLYPH" <<
-          " x:" <<  entry->pos.x <<
-          " y:" <<  entry->pos.y << 
-          " w:" <<  entry->kind.glyph_entry.glyph->dim.width  <<
-          " k:" <<  entry->kind.glyph_entry.kern <<
-          " h:" <<  entry->kind.glyph_entry.glyph->dim.height << std::endl;
+          " x:" <<  entry.pos.x <<
+          " y:" <<  entry.pos.y << 
+          " w:" <<  entry.kind.glyph_entry.glyph->dim.width  <<
+          " k:" <<  entry.kind.glyph_entry.kern <<
+          " h:" <<  entry.kind.glyph_entry.glyph->dim.height << std::endl;
       }
-      else if (entry->command == DisplayListCommand::IMAGE) {
+      else if (entry.command == DisplayListCommand::IMAGE) {
         std::cout << "IMAGE" <<
-          " x:" << entry->pos.x <<
-          " y:" << entry->pos.y <<
-          " w:" << entry->kind.image_entry.image.dim.width  <<
-          " h:" << entry->kind.image_entry.image.dim.height << std::endl;
+          " x:" << entry.pos.x <<
+          " y:" << entry.pos.y <<
+          " w:" << entry.kind.image_entry.image.dim.width  <<
+          " h:" << entry.kind.image_entry.image.dim.height << std::endl;
       }
-      else if (entry->command == DisplayListCommand::HIGHLIGHT) {
+      else if (entry.command == DisplayListCommand::HIGHLIGHT) {
         std::cout << "HIGHLIGHT" <<
-          " x:" << entry->pos.x <<
-          " y:" << entry->pos.y <<
-          " w:" << entry->kind.region_entry.dim.width  <<
-          " h:" << entry->kind.region_entry.dim.height << std::endl;
+          " x:" << entry.pos.x <<
+          " y:" << entry.pos.y <<
+          " w:" << entry.kind.region_entry.dim.width  <<
+          " h:" << entry.kind.region_entry.dim.height << std::endl;
       }
-      else if (entry->command == DisplayListCommand::CLEAR_HIGHLIGHT) {
+      else if (entry.command == DisplayListCommand::CLEAR_HIGHLIGHT) {
         std::cout << "CLEAR_HIGHLIGHT" <<
-          " x:" << entry->pos.x <<
-          " y:" << entry->pos.y <<
-          " w:" << entry->kind.region_entry.dim.width  <<
-          " h:" << entry->kind.region_entry.dim.height << std::endl;
+          " x:" << entry.pos.x <<
+          " y:" << entry.pos.y <<
+          " w:" << entry.kind.region_entry.dim.width  <<
+          " h:" << entry.kind.region_entry.dim.height << std::endl;
       }
-      else if (entry->command == DisplayListCommand::ROUNDED) {
+      else if (entry.command == DisplayListCommand::ROUNDED) {
         std::cout << "ROUNDED" <<
-          " x:" << entry->pos.x <<
-          " y:" << entry->pos.y <<
-          " w:" << entry->kind.region_entry.dim.width  <<
-          " h:" << entry->kind.region_entry.dim.height << std::endl;
+          " x:" << entry.pos.x <<
+          " y:" << entry.pos.y <<
+          " w:" << entry.kind.region_entry.dim.width  <<
+          " h:" << entry.kind.region_entry.dim.height << std::endl;
       }
-      else if (entry->command == DisplayListCommand::CLEAR_ROUNDED) {
+      else if (entry.command == DisplayListCommand::CLEAR_ROUNDED) {
         std::cout << "CLEAR_ROUNDED" <<
-          " x:" << entry->pos.x <<
-          " y:" << entry->pos.y <<
-          " w:" << entry->kind.region_entry.dim.width  <<
-          " h:" << entry->kind.region_entry.dim.height << std::endl;
+          " x:" << entry.pos.x <<
+          " y:" << entry.pos.y <<
+          " w:" << entry.kind.region_entry.dim.width  <<
+          " h:" << entry.kind.region_entry.dim.height << std::endl;
       }
-      else if (entry->command == DisplayListCommand::CLEAR_REGION) {
+      else if (entry.command == DisplayListCommand::CLEAR_REGION) {
         std::cout << "CLEAR_REGION" <<
-          " x:" << entry->pos.x <<
-          " y:" << entry->pos.y <<
-          " w:" << entry->kind.region_entry.dim.width  <<
-          " h:" << entry->kind.region_entry.dim.height << std::endl;
+          " x:" << entry.pos.x <<
+          " y:" << entry.pos.y <<
+          " w:" << entry.kind.region_entry.dim.width  <<
+          " h:" << entry.kind.region_entry.dim.height << std::endl;
       }
-      else if (entry->command == DisplayListCommand::SET_REGION) {
+      else if (entry.command == DisplayListCommand::SET_REGION) {
         std::cout << "SET_REGION" <<
-          " x:" << entry->pos.x <<
-          " y:" << entry->pos.y <<
-          " w:" << entry->kind.region_entry.dim.width  <<
-          " h:" << entry->kind.region_entry.dim.height << std::endl;
+          " x:" << entry.pos.x <<
+          " y:" << entry.pos.y <<
+          " w:" << entry.kind.region_entry.dim.width  <<
+          " h:" << entry.kind.region_entry.dim.height << std::endl;
       }
     }
   #endif
 }
 
+int8_t
+Page::get_normal_font_size() const
+{
+  return (normal_font_size != 0) ? normal_font_size : epub.get_book_format_params()->font_size;
+}
+
 int16_t
 Page::get_pixel_value(const CSS::Value & value, const Format & fmt, int16_t ref, bool vertical)
 {
@@ -1307,7 +1451,7 @@ Page::get_pixel_value(const CSS::Value & value, const Format & fmt, int16_t ref,
 int16_t
 Page::get_point_value(const CSS::Value & value, const Format & fmt, int16_t ref)
 {
-  int8_t normal_size = epub.get_book_format_params()->font_size;
+  int8_t normal_size = get_normal_font_size();
 
   switch (value.value_type) {
     case CSS::ValueType::PX:
@@ -1398,8 +1542,11 @@ Page::adjust_format(DOM::Node * dom_current_node,
   }
 }
 
+// Rules found by a match, or the rules of a style attribute, in its arena
+
+template <class Rules>
 void
-Page::adjust_format_from_rules(Format & fmt, const CSS::RulesMap & rules)
+Page::adjust_format_from_rules(Format & fmt, const Rules & rules)
 {  
   const CSS::Values * vals;
 
@@ -1425,7 +1572,7 @@ Page::adjust_format_from_rules(Format & fmt, const CSS::RulesMap & rules)
   if ((vals = CSS::get_values_from_rules(rules, CSS::PropertyId::FONT_FAMILY))) {
     int16_t idx = -1;
     for (auto & font_name : *vals) {
-      if ((idx = fonts.get_index(font_name->str, new_style)) != -1) break;
+      if ((idx = fonts.get_index(font_name->str.c_str(), new_style)) != -1) break;
     }
     if (idx == -1) {
       LOG_D("Font not found 1: %s %d", vals->front()->str.c_str(), (int)new_style);
@@ -0,0 +1,309 @@
+// Copyright (c) 2020 Guy Turcotte
+//
+// MIT License. Look at file licenses.txt for details.
+
+#define __SEARCH_VIEWER__ 1
+#include "viewers/search_viewer.hpp"
+
+#include "models/fonts.hpp"
+#include "models/epub.hpp"
+#include "models/page_locs.hpp"
+#include "models/toc.hpp"
+#include "viewers/page.hpp"
+#include "viewers/screen_bottom.hpp"
+
+#include "screen.hpp"
+
+#include <algorithm>
+
+void
+SearchViewer::setup(const std::string & query, const std::vector<int16_t> & pages)
+{
+  title     = "Search: " + query;
+  page_nbrs = pages;
+
+  // The table of content entry of each page is the last one starting on
+  // it or before
+
+  std::vector<std::pair<int16_t, int16_t>> toc_pages; // page number, entry index
+
+  for (int16_t idx = 0; idx < toc.get_entry_count(); idx++) {
+    const TOC::EntryRecord & entry = toc.get_entry(idx);
+    if (entry.page_id.offset < 0) continue;
+    int16_t page_nbr = page_locs.get_page_nbr(entry.page_id);
+    if (page_nbr >= 0) toc_pages.push_back(std::make_pair(page_nbr, idx));
+  }
+  std::stable_sort(toc_pages.begin(), toc_pages.end(),
+    [](const std::pair<int16_t, int16_t> & a, const std::pair<int16_t, int16_t> & b) {
+      return a.first < b.first;
+    });
+
+  labels.clear();
+  labels.reserve(page_nbrs.size());
+
+  for (int16_t page_nbr : page_nbrs) {
+    std::string label = "Page " + std::to_string(page_nbr + 1);
+    auto it = std::upper_bound(toc_pages.begin(), toc_pages.end(), page_nbr,
+      [](int16_t nbr, const std::pair<int16_t, int16_t> & toc_page) {
+        return nbr < toc_page.first;
+      });
+    if (it != toc_pages.begin()) {
+      label += " - ";
+      label += toc.get_entry((it - 1)->second).label;
+    }
+    labels.push_back(label);
+  }
+
+  entries_per_page = (Screen::get_height() - FIRST_ENTRY_YPOS - 20) / ENTRY_HEIGHT;
+  page_count       = (page_nbrs.size() + entries_per_page - 1) / entries_per_page;
+  if (page_count == 0) page_count = 1;
+
+  current_page_nbr    = -1;
+  current_screen_idx  = -1;
+  current_entry_idx   = -1;
+
+  LOG_D("Search result count: %d", (int) page_nbrs.size());
+}
+
+void
+SearchViewer::show_entry(int16_t entry_idx, int16_t ypos, bool highlighted)
+{
+  Page::Format fmt = {
+    .line_height_factor = 0.8,
+    .font_index         = ENTRY_FONT,
+    .font_size          = ENTRY_FONT_SIZE,
+    .indent             = 0,
+    .margin_left        = 0,
+    .margin_right       = 0,
+    .margin_top         = 0,
+    .margin_bottom      = 0,
+    .screen_left        = 20,
+    .screen_right       = 10,
+    .screen_top         = ypos,
+    .screen_bottom      = (int16_t)(Screen::get_height() - (ypos + ENTRY_HEIGHT)),
+    .width              = 0,
+    .height             = 0,
+    .vertical_align     = 0,
+    .trim               = true,
+    .pre                = false,
+    .font_style         = Fonts::FaceStyle::NORMAL,
+    .align              = CSS::Align::LEFT,
+    .text_transform     = CSS::TextTransform::NONE,
+    .display            = CSS::Display::INLINE
+  };
+
+  #if !(INKPLATE_6PLUS || TOUCH_TRIAL)
+    if (highlighted) {
+      page.put_highlight(Dim(Screen::get_width() - 30, ENTRY_HEIGHT + 5), Pos(15, ypos));
+    }
+    else {
+      page.clear_highlight(Dim(Screen::get_width() - 30, ENTRY_HEIGHT + 5), Pos(15, ypos));
+    }
+  #endif
+
+  page.set_limits(fmt);
+  page.new_paragraph(fmt);
+  page.add_text(labels[entry_idx], fmt);
+  page.end_paragraph(fmt);
+}
+
+void
+SearchViewer::show_page(int16_t page_nbr, int16_t hightlight_screen_idx)
+{
+  current_page_nbr   = page_nbr;
+  current_screen_idx = hightlight_screen_idx;
+
+  int16_t entry_idx = page_nbr  * entries_per_page; // entry idx in the current page
+  int16_t last_idx  = entry_idx + entries_per_page; // last entry idx in the current page
+
+  if (last_idx > get_entry_count()) last_idx = get_entry_count();
+
+  int16_t xpos = 20;
+  int16_t ypos = TITLE_YPOS;
+
+  page.set_compute_mode(Page::ComputeMode::DISPLAY);
+
+  Page::Format fmt = {
+      .line_height_factor =   0.8,
+      .font_index         = TITLE_FONT,
+      .font_size          = TITLE_FONT_SIZE,
+      .indent             =     0,
+      .margin_left        =     0,
+      .margin_right       =     0,
+      .margin_top         =     0,
+      .margin_bottom      =     0,
+      .screen_left        =  xpos,
+      .screen_right       =    10,
+      .screen_top         =  ypos,
+      .screen_bottom      = (int16_t)(Screen::get_height() - (ypos + MAX_TITLE_SIZE + 20)),
+      .width              =     0,
+      .height             =     0,
+      .vertical_align     =     0,
+      .trim               =  true,
+      .pre                = false,
+      .font_style         = Fonts::FaceStyle::BOLD,
+      .align              = CSS::Align::CENTER,
+      .text_transform     = CSS::TextTransform::NONE,
+      .display            = CSS::Display::INLINE
+    };
+
+  page.start(fmt);
+
+  page.set_limits(fmt);
+  page.new_paragraph(fmt);
+  page.add_text(title, fmt);
+  page.end_paragraph(fmt);
+
+  ypos = FIRST_ENTRY_YPOS;
+
+  if (page_nbrs.empty()) {
+    fmt.font_index    = ENTRY_FONT;
+    fmt.font_size     = ENTRY_FONT_SIZE;
+    fmt.font_style    = Fonts::FaceStyle::ITALIC;
+    fmt.screen_top    = ypos;
+    fmt.screen_bottom = (int16_t)(Screen::get_height() - (ypos + ENTRY_HEIGHT));
+
+    page.set_limits(fmt);
+    page.new_paragraph(fmt);
+    page.add_text("No page found.", fmt);
+    page.end_paragraph(fmt);
+  }
+
+  for (int16_t screen_idx = 0; entry_idx < last_idx; screen_idx++, entry_idx++) {
+    show_entry(entry_idx, ypos, screen_idx == current_screen_idx);
+    ypos += ENTRY_HEIGHT;
+  }
+
+  ScreenBottom::show(current_page_nbr, page_count);
+
+  page.paint();
+}
+
+void
+SearchViewer::highlight(int16_t screen_idx)
+{
+  #if !(INKPLATE_6PLUS || TOUCH_TRIAL)
+  page.set_compute_mode(Page::ComputeMode::DISPLAY);
+
+  if (current_screen_idx != screen_idx) {
+
+    Page::Format fmt = {
+      .line_height_factor = 0.8,
+      .font_index         = ENTRY_FONT,
+      .font_size          = ENTRY_FONT_SIZE,
+      .indent             = 0,
+      .margin_left        = 0,
+      .margin_right       = 0,
+      .margin_top         = 0,
+      .margin_bottom      = 0,
+      .screen_left        = 20,
+      .screen_right       = 10,
+      .screen_top         = FIRST_ENTRY_YPOS,
+      .screen_bottom      = 20,
+      .width              = 0,
+      .height             = 0,
+      .vertical_align     = 0,
+      .trim               = true,
+      .pre                = false,
+      .font_style         = Fonts::FaceStyle::NORMAL,
+      .align              = CSS::Align::LEFT,
+      .text_transform     = CSS::TextTransform::NONE,
+      .display            = CSS::Display::INLINE
+    };
+
+    page.start(fmt);
+
+    // Clear the highlighting of the current entry, then highlight the new one
+
+    int16_t first_idx = current_page_nbr * entries_per_page;
+
+    show_entry(first_idx + current_screen_idx, FIRST_ENTRY_YPOS + (current_screen_idx * ENTRY_HEIGHT), false);
+
+    current_screen_idx = screen_idx;
+
+    show_entry(first_idx + current_screen_idx, FIRST_ENTRY_YPOS + (current_screen_idx * ENTRY_HEIGHT), true);
+
+    ScreenBottom::show(current_page_nbr, page_count);
+
+    page.paint(false, false, false, RefreshScheduler::Intent::UI);
+  }
+  #endif
+}
+
+int16_t
+SearchViewer::show_page_and_highlight(int16_t entry_idx)
+{
+  if (entry_idx < 0) entry_idx = 0;
+
+  int16_t page_nbr   = entry_idx / entries_per_page;
+  int16_t screen_idx = entry_idx % entries_per_page;
+
+  if (current_page_nbr != page_nbr) {
+    show_page(page_nbr, screen_idx);
+  }
+  else {
+    if (screen_idx != current_screen_idx) highlight(screen_idx);
+  }
+
+  current_entry_idx = entry_idx;
+  return current_entry_idx;
+}
+
+void
+SearchViewer::highlight_entry(int16_t entry_idx)
+{
+  highlight(entry_idx % entries_per_page);
+  current_entry_idx = entry_idx;
+}
+
+int16_t
+SearchViewer::next_page()
+{
+  return next_column();
+}
+
+int16_t
+SearchViewer::prev_page()
+{
+  return prev_column();
+}
+
+int16_t
+SearchViewer::next_item()
+{
+  int16_t entry_idx = current_entry_idx + 1;
+  if (entry_idx >= get_entry_count()) {
+    entry_idx = get_entry_count() - 1;
+  }
+  return show_page_and_highlight(entry_idx);
+}
+
+int16_t
+SearchViewer::prev_item()
+{
+  int16_t entry_idx = current_entry_idx - 1;
+  if (entry_idx < 0) entry_idx = 0;
+  return show_page_and_highlight(entry_idx);
+}
+
+int16_t
+SearchViewer::next_column()
+{
+  int16_t entry_idx = current_entry_idx + entries_per_page;
+  if (entry_idx >= get_entry_count()) {
+    entry_idx = get_entry_count() - 1;
+  }
+  else {
+    entry_idx = (entry_idx / entries_per_page) * entries_per_page;
+  }
+  return show_page_and_highlight(entry_idx);
+}
+
+int16_t
+SearchViewer::prev_column()
+{
+  int16_t entry_idx = current_entry_idx - entries_per_page;
+  if (entry_idx < 0) entry_idx = 0;
+  else entry_idx = (entry_idx / entries_per_page) * entries_per_page;
+  return show_page_and_highlight(entry_idx);
+}
@@ -189,7 +189,7 @@ TocViewer::highlight(int16_t screen_idx)
 
     ScreenBottom::show(current_page_nbr, page_count);
 
-    page.paint(false);
+    page.paint(false, false, false, RefreshScheduler::Intent::UI);
   }
   #endif
 }